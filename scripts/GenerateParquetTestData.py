@@ -13,11 +13,18 @@ for i in range(TableSize):
 
 IntColumnData = pa.array(DataList, type=pa.int32())
 
+# extra payload columns so filters have to carry whole rows, not just the predicate column
+IdColumnData = pa.array(range(TableSize), type=pa.int64())
+Categories = ['alpha', 'beta', 'gamma', 'delta', 'epsilon']
+CategoryColumnData = pa.array([Categories[i % len(Categories)] for i in range(TableSize)], type=pa.string())
+
 Schema = pa.schema([
-    pa.field('IntColumn', pa.int32())
+    pa.field('IntColumn', pa.int32()),
+    pa.field('IdColumn', pa.int64()),
+    pa.field('CategoryColumn', pa.string())
 ])
 
-Table = pa.Table.from_arrays([IntColumnData], schema=Schema)
+Table = pa.Table.from_arrays([IntColumnData, IdColumnData, CategoryColumnData], schema=Schema)
 
 pq.write_table(Table, 'TEST_DATA.parquet')
 
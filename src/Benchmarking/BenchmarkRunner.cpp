@@ -7,6 +7,7 @@
 #include <iostream>
 #include <iomanip>
 #include "../Misc/Logger.h"
+#include "../Execution/QueryMemoryPool.h"
 
 
 BenchmarkRunner::BenchmarkRunner(int NumRuns)
@@ -24,9 +25,27 @@ void BenchmarkRunner::WarmupCpu()
     }
 }
 
+void BenchmarkRunner::UseQueryArena(bool bEnable, int64_t MemoryLimit)
+{
+    this->bQueryArena = bEnable;
+    this->MemoryLimit = MemoryLimit;
+}
+
+std::shared_ptr<arrow::MemoryPool> BenchmarkRunner::MakeQueryMemory() const
+{
+    if (this->bQueryArena)
+    {
+        return std::make_shared<QueryMemoryPool>(this->MemoryLimit);
+    }
+    // same allocator as before, the proxy only counts
+    return std::make_shared<arrow::ProxyMemoryPool>(arrow::default_memory_pool());
+}
+
 BenchmarkResult BenchmarkRunner::Run(const std::string& TaskName, PlanFactory Factory, long long InputRowCount)
 {
     std::vector<long long> Times;
+    std::shared_ptr<arrow::MemoryPool> FirstRunMemory;
+    double SteadyAllocationsPerBatch = 0.0;
     std::vector<DataChunk> FirstRunResults;
     long long OutputRowCount = 0;
 
@@ -36,23 +55,39 @@ BenchmarkResult BenchmarkRunner::Run(const std::string& TaskName, PlanFactory Fa
     {
         this->WarmupCpu();
 
+        // before the results, they are allocated from it
+        std::shared_ptr<arrow::MemoryPool> QueryMemory = this->MakeQueryMemory();
         long long IterationRowCount = 0;
+        long long IterationBatchCount = 0;
         std::vector<DataChunk> CurrentResults;
 
         // Start Timer
         auto StartTime = std::chrono::high_resolution_clock::now();
 
         // Execute the query
-        std::unique_ptr<Operator> Op = Factory();
-        DataChunk Chunk;
-        while ((Chunk = Op->Next()) != nullptr)
+        try
         {
-            IterationRowCount += Chunk->num_rows();
-            if (i == 0)
+            std::unique_ptr<Operator> Op = Factory();
+            Op->UseMemoryPool(QueryMemory.get());
+            DataChunk Chunk;
+            while ((Chunk = Op->Next()) != nullptr)
             {
-                CurrentResults.push_back(Chunk);
+                IterationRowCount += Chunk->num_rows();
+                ++IterationBatchCount;
+                if (i == 0)
+                {
+                    CurrentResults.push_back(Chunk);
+                }
             }
         }
+        catch (const std::exception& Error)
+        {
+            // the plan is gone by now, scans joined their threads and the pool frees what the run allocated
+            LOG_ERROR("[ " << TaskName << " Run " << i + 1 << " ] failed: " << Error.what());
+            BenchmarkResult Failed{};
+            Failed.Error = Error.what();
+            return Failed;
+        }
 
         // Stop Timer
         auto EndTime = std::chrono::high_resolution_clock::now();
@@ -61,14 +96,24 @@ BenchmarkResult BenchmarkRunner::Run(const std::string& TaskName, PlanFactory Fa
         Times.push_back(Duration);
         LOG_MESSAGEF("[ %s Run %d ] %lld ns (%lld rows)", TaskName.c_str(), i + 1, Duration, IterationRowCount);
 
+        if (i == this->NumRuns - 1)
+        {
+            SteadyAllocationsPerBatch = IterationBatchCount > 0 ? (double)QueryMemory->num_allocations() / IterationBatchCount : 0.0;
+        }
+
         if (i == 0)
         {
+            FirstRunMemory = QueryMemory;
             FirstRunResults = std::move(CurrentResults);
             OutputRowCount = IterationRowCount;
         }
     }
 
     BenchmarkStats Stats = this->CalculateStats(Times, OutputRowCount, InputRowCount);
+    Stats.PeakMemoryBytes = FirstRunMemory->max_memory();
+    Stats.AllocationCount = FirstRunMemory->num_allocations();
+    Stats.AllocatedBytesPerRow = InputRowCount > 0 ? (double)FirstRunMemory->total_bytes_allocated() / InputRowCount : 0.0;
+    Stats.SteadyAllocationsPerBatch = SteadyAllocationsPerBatch;
 
     std::cout << std::fixed << std::setprecision(2);
     LOG_MESSAGEF("   Mean: %.2f ns", Stats.Mean);
@@ -77,8 +122,142 @@ BenchmarkResult BenchmarkRunner::Run(const std::string& TaskName, PlanFactory Fa
     std::cout << std::fixed << std::setprecision(2);
     LOG_MESSAGEF("   Mean: %.2f ns", Stats.Mean);
     LOG_MESSAGEF("   Bandwidth: %.2f GB/s", Stats.ThroughputGBps);
+    LOG_MESSAGEF("   Memory (%s): peak %.2f MB, %lld allocations, %.2f bytes/row", FirstRunMemory->backend_name().c_str(),
+        Stats.PeakMemoryBytes / (1024.0 * 1024.0), Stats.AllocationCount, Stats.AllocatedBytesPerRow);
+    LOG_MESSAGEF("   Steady state: %.3f allocations per batch (last run)", Stats.SteadyAllocationsPerBatch);
+    if (const QueryMemoryPool* Arena = dynamic_cast<const QueryMemoryPool*>(FirstRunMemory.get()))
+    {
+        // the difference to the peak above is block padding and space that was free when the peak was reached
+        LOG_MESSAGEF("   Arena blocks: peak %.2f MB reserved", Arena->PeakReservedBytes() / (1024.0 * 1024.0));
+    }
+
+    return { Stats, FirstRunMemory, FirstRunResults };
+}
+
+void BenchmarkRunner::CompareFusion(const std::string& TaskName, PlanFactory Factory, long long InputRowCount)
+{
+    bool bAnyFused = false;
+    PlanFactory FusedFactory = [&Factory, &bAnyFused]()
+    {
+        std::unique_ptr<Operator> Plan = Factory();
+        bAnyFused = Plan->FusePipelines();
+        return Plan;
+    };
+
+    BenchmarkResult Unfused = this->Run(TaskName + " (unfused)", Factory, InputRowCount);
+    BenchmarkResult Fused = this->Run(TaskName + " (fused)", FusedFactory, InputRowCount);
+
+    if (!bAnyFused)
+    {
+        LOG_WARNING("CompareFusion: nothing in '" << TaskName << "' could be fused, both runs executed the same plan");
+    }
+
+    PrintComparison(TaskName + " (unfused)", Unfused.Stats, TaskName + " (fused)", Fused.Stats);
+    Verify(Unfused.ResultChunks, Fused.ResultChunks);
+}
+
+void BenchmarkRunner::RunSelectivitySweep(const std::string& TaskName, SweepPlanFactory Factory, long long InputRowCount)
+{
+    LOG_TITLE("BENCHMARK", "SELECTIVITY SWEEP: " + TaskName);
+
+    double MinBandwidth = 0.0;
+    double MaxBandwidth = 0.0;
+
+    for (int Selectivity = 0; Selectivity <= 100; Selectivity += 10)
+    {
+        std::vector<long long> Times;
+        long long SelectedRows = 0;
+
+        for (int i = 0; i < this->NumRuns; ++i)
+        {
+            this->WarmupCpu();
+
+            long long IterationRowCount = 0;
+            auto StartTime = std::chrono::high_resolution_clock::now();
 
-    return { Stats, FirstRunResults };
+            std::unique_ptr<Operator> Op = Factory(Selectivity);
+            SelectedChunk Chunk;
+            while (!(Chunk = Op->NextSelected()).IsEnd())
+            {
+                IterationRowCount += Chunk.Count;
+            }
+
+            auto EndTime = std::chrono::high_resolution_clock::now();
+            Times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(EndTime - StartTime).count());
+            SelectedRows = IterationRowCount;
+        }
+
+        BenchmarkStats Stats = this->CalculateStats(Times, SelectedRows, InputRowCount);
+        LOG_MESSAGEF("   %3d%% selected: Median %.2f ns, Bandwidth %.2f GB/s (%lld rows)", Selectivity, Stats.Median, Stats.ThroughputGBps, SelectedRows);
+
+        if (Selectivity == 0 || Stats.ThroughputGBps < MinBandwidth) MinBandwidth = Stats.ThroughputGBps;
+        if (Selectivity == 0 || Stats.ThroughputGBps > MaxBandwidth) MaxBandwidth = Stats.ThroughputGBps;
+    }
+
+    // 1.00x means the kernel costs the same no matter how many rows pass
+    LOG_MESSAGEF("   Slowest step is %.2fx slower than the fastest (%.2f - %.2f GB/s)", MaxBandwidth / MinBandwidth, MinBandwidth, MaxBandwidth);
+}
+
+void BenchmarkRunner::RunThreadScaling(const std::string& TaskName, ScalingPlanFactory Factory, long long InputRowCount, int MaxThreads)
+{
+    LOG_TITLE("BENCHMARK", "THREAD SCALING: " + TaskName);
+
+    double SingleThreadMedian = 0.0;
+    std::vector<DataChunk> SingleThreadResults;
+
+    // 1, 2, 4, ... and MaxThreads itself even if it isn't a power of two
+    std::vector<int> ThreadCounts;
+    for (int ThreadCount = 1; ThreadCount < MaxThreads; ThreadCount *= 2)
+    {
+        ThreadCounts.push_back(ThreadCount);
+    }
+    ThreadCounts.push_back(std::max(MaxThreads, 1));
+
+    for (int ThreadCount : ThreadCounts)
+    {
+        std::vector<long long> Times;
+        std::vector<DataChunk> Results;
+        long long OutputRowCount = 0;
+
+        for (int i = 0; i < this->NumRuns; ++i)
+        {
+            this->WarmupCpu();
+
+            long long IterationRowCount = 0;
+            auto StartTime = std::chrono::high_resolution_clock::now();
+
+            std::unique_ptr<Operator> Op = Factory(ThreadCount);
+            DataChunk Chunk;
+            while ((Chunk = Op->Next()) != nullptr)
+            {
+                IterationRowCount += Chunk->num_rows();
+                if (i == 0)
+                {
+                    Results.push_back(Chunk);
+                }
+            }
+
+            auto EndTime = std::chrono::high_resolution_clock::now();
+            Times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(EndTime - StartTime).count());
+            OutputRowCount = IterationRowCount;
+        }
+
+        BenchmarkStats Stats = this->CalculateStats(Times, OutputRowCount, InputRowCount);
+        if (ThreadCount == 1)
+        {
+            SingleThreadMedian = Stats.Median;
+            SingleThreadResults = Results;
+        }
+
+        // 1.00x per thread is perfect scaling, it drops once memory bandwidth runs out
+        double Speedup = SingleThreadMedian / Stats.Median;
+        LOG_MESSAGEF("   %3d threads: Median %.2f ns, Bandwidth %.2f GB/s, %.2fx speedup (%.2fx per thread)", ThreadCount, Stats.Median, Stats.ThroughputGBps, Speedup, Speedup / ThreadCount);
+
+        if (ThreadCount > 1)
+        {
+            Verify(SingleThreadResults, Results);
+        }
+    }
 }
 
 BenchmarkStats BenchmarkRunner::CalculateStats(std::vector<long long>& Times, long long OutputRowCount, long long InputRowCount)
@@ -3,6 +3,7 @@
 #include <string>
 #include <functional>
 #include <memory>
+#include <arrow/memory_pool.h>
 #include "../OperatorImpl/Operator.h"
 struct BenchmarkStats
 {
@@ -27,12 +28,23 @@ struct BenchmarkStats
     // therefore, maximizing Throughput (GB/s) minimizes `Time`, which usually minimizes Total Energy
     // by paying off the constant Static Power cost over more data per second.
     double ThroughputGBps;
+
+    // What the plan allocated through its memory pool in the first run (only Arrow buffers, not the operators' own vectors)
+    long long PeakMemoryBytes = 0;
+    long long AllocationCount = 0;
+    double AllocatedBytesPerRow = 0.0; // every byte allocated over the run, per input row
+
+    // Allocations per returned batch in the last run, which doesn't keep its batches. Operators that reuse the buffers
+    // of released batches (FilterOperator) get this close to 0
+    double SteadyAllocationsPerBatch = 0.0;
 };
 
 struct BenchmarkResult
 {
     BenchmarkStats Stats;
+    std::shared_ptr<arrow::MemoryPool> Memory; // the pool of the first run, its results live in it. Declared first so it goes last
     std::vector<DataChunk> ResultChunks; 
+    std::string Error; // why a run failed (e.g. over the memory limit), empty when every run finished
 };
 
 class BenchmarkRunner
@@ -43,14 +55,42 @@ public:
 
     BenchmarkRunner(int NumRuns = 50);
 
+    // Builds the plan for a given selectivity in percent (0 - 100)
+    using SweepPlanFactory = std::function<std::unique_ptr<Operator>(int SelectivityPercent)>;
+
+    // A run that throws ends the benchmark, the error is logged and returned in BenchmarkResult::Error
     BenchmarkResult Run(const std::string& TaskName, PlanFactory Factory, long long InputRowCount);
 
+    // Every Run() gets a fresh QueryMemoryPool (Execution/QueryMemoryPool.h) that the whole plan allocates from and that
+    // frees everything once the run is done. A plan that needs more than MemoryLimit bytes (0 for no limit) fails the run.
+    // Off by default, then plans allocate from the default pool. The memory of a run is counted and logged either way
+    void UseQueryArena(bool bEnable, int64_t MemoryLimit = 0);
+
+    // Times the plan at 0%, 10%, ..., 100% selectivity and logs the bandwidth of each step.
+    // The root is drained through NextSelected() so a filter at the root is timed without compacting its output
+    void RunSelectivitySweep(const std::string& TaskName, SweepPlanFactory Factory, long long InputRowCount);
+
+    // Builds the plan for a given number of worker threads
+    using ScalingPlanFactory = std::function<std::unique_ptr<Operator>(int ThreadCount)>;
+
+    // Times the plan with 1, 2, 4, ... MaxThreads workers and logs the bandwidth and the speedup over 1 thread of each step.
+    // The results of every step are checked against the single threaded one
+    void RunThreadScaling(const std::string& TaskName, ScalingPlanFactory Factory, long long InputRowCount, int MaxThreads);
+
+    // Times the plan as the factory builds it and again after Operator::FusePipelines(), logs the comparison
+    // and checks that both return the same result. Warns when nothing in the plan could be fused
+    void CompareFusion(const std::string& TaskName, PlanFactory Factory, long long InputRowCount);
+
     static void PrintComparison(const std::string& BaselineName, const BenchmarkStats& Baseline, const std::string& CandidateName, const BenchmarkStats& Candidate);
 
     static void Verify(const std::vector<DataChunk>& Expected, const std::vector<DataChunk>& Actual);
 
 private:
     int NumRuns;
+    bool bQueryArena = false;
+    int64_t MemoryLimit = 0;
+
+    std::shared_ptr<arrow::MemoryPool> MakeQueryMemory() const;
 
     void WarmupCpu();
     BenchmarkStats CalculateStats(std::vector<long long>& Times, long long OutputRowCount, long long InputRowCount);
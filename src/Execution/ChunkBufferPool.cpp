@@ -0,0 +1,111 @@
+#include "pch.h"
+#include "ChunkBufferPool.h"
+#include <parquet/exception.h>
+
+constexpr int MinSizeClass = 6; // 64 bytes
+constexpr int MaxSizeClass = 48;
+
+static int SizeClassOf(int64_t Size)
+{
+    int SizeClass = MinSizeClass;
+    while (SizeClass < MaxSizeClass && (int64_t(1) << SizeClass) < Size)
+    {
+        ++SizeClass;
+    }
+    return SizeClass;
+}
+
+// Looks like any other mutable buffer to arrow, hands its memory back to the pool instead of freeing it
+class ChunkBufferPool::RecycledBuffer : public arrow::MutableBuffer
+{
+public:
+    RecycledBuffer(std::shared_ptr<ChunkBufferPool> Owner, uint8_t* Data, int64_t Size, int SizeClass)
+        : arrow::MutableBuffer(Data, Size), Owner(std::move(Owner)), SizeClass(SizeClass)
+    {
+    }
+
+    ~RecycledBuffer() override
+    {
+        this->Owner->Release(this->mutable_data(), this->SizeClass);
+    }
+
+private:
+    std::shared_ptr<ChunkBufferPool> Owner;
+    int SizeClass;
+};
+
+std::shared_ptr<ChunkBufferPool> ChunkBufferPool::Make(arrow::MemoryPool* Pool, int64_t MaxCachedBytes)
+{
+    return std::shared_ptr<ChunkBufferPool>(new ChunkBufferPool(Pool, MaxCachedBytes));
+}
+
+ChunkBufferPool::ChunkBufferPool(arrow::MemoryPool* Pool, int64_t MaxCachedBytes)
+    : Pool(Pool), MaxCachedBytes(MaxCachedBytes), FreeLists(MaxSizeClass + 1)
+{
+}
+
+ChunkBufferPool::~ChunkBufferPool()
+{
+    // every buffer handed out holds a reference, so all of them are back in here by now
+    for (int SizeClass = 0; SizeClass <= MaxSizeClass; ++SizeClass)
+    {
+        for (uint8_t* Data : this->FreeLists[SizeClass])
+        {
+            this->Pool->Free(Data, int64_t(1) << SizeClass, 64);
+        }
+    }
+}
+
+std::shared_ptr<arrow::Buffer> ChunkBufferPool::Acquire(int64_t Size)
+{
+    int SizeClass = SizeClassOf(Size);
+    uint8_t* Data = nullptr;
+    {
+        std::lock_guard<std::mutex> Guard(this->Lock);
+        std::vector<uint8_t*>& FreeList = this->FreeLists[SizeClass];
+        if (!FreeList.empty())
+        {
+            Data = FreeList.back();
+            FreeList.pop_back();
+            this->CachedBytes -= int64_t(1) << SizeClass;
+            ++this->Recycled;
+        }
+        else
+        {
+            ++this->Allocated;
+        }
+    }
+
+    if (Data == nullptr)
+    {
+        PARQUET_THROW_NOT_OK(this->Pool->Allocate(int64_t(1) << SizeClass, 64, &Data));
+    }
+    return std::make_shared<RecycledBuffer>(this->shared_from_this(), Data, Size, SizeClass);
+}
+
+void ChunkBufferPool::Release(uint8_t* Data, int SizeClass)
+{
+    int64_t Bytes = int64_t(1) << SizeClass;
+    {
+        std::lock_guard<std::mutex> Guard(this->Lock);
+        if (this->CachedBytes + Bytes <= this->MaxCachedBytes)
+        {
+            this->FreeLists[SizeClass].push_back(Data);
+            this->CachedBytes += Bytes;
+            return;
+        }
+    }
+    this->Pool->Free(Data, Bytes, 64);
+}
+
+int64_t ChunkBufferPool::RecycledCount() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->Recycled;
+}
+
+int64_t ChunkBufferPool::AllocatedCount() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->Allocated;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <arrow/buffer.h>
+#include <arrow/memory_pool.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Buffers for the batches an operator returns, taken back when the last batch using one is released.
+// A filter's output has the same few sizes chunk after chunk, so once the consumer lets go of the first batches every
+// new one is written into the buffers of an old one and a steady scan doesn't allocate any buffer memory.
+// Sizes are rounded up to a power of two (64 bytes at least), the memory comes from the pool the operator was given.
+// A released buffer goes into the free list of its size, up to MaxCachedBytes over all lists, the rest goes back.
+// Always owned through a shared_ptr (Make): every buffer handed out holds on to it, so batches may outlive the operator
+class ChunkBufferPool : public std::enable_shared_from_this<ChunkBufferPool>
+{
+public:
+    static std::shared_ptr<ChunkBufferPool> Make(arrow::MemoryPool* Pool, int64_t MaxCachedBytes = 64 * 1024 * 1024);
+    ~ChunkBufferPool();
+
+    ChunkBufferPool(const ChunkBufferPool&) = delete;
+    ChunkBufferPool& operator=(const ChunkBufferPool&) = delete;
+
+    // A 64 byte aligned buffer of Size bytes, contents undefined. Throws when the pool can't allocate
+    std::shared_ptr<arrow::Buffer> Acquire(int64_t Size);
+
+    // how many Acquire() calls were served from a free list and how many had to allocate
+    int64_t RecycledCount() const;
+    int64_t AllocatedCount() const;
+
+private:
+    class RecycledBuffer;
+
+    ChunkBufferPool(arrow::MemoryPool* Pool, int64_t MaxCachedBytes);
+
+    void Release(uint8_t* Data, int SizeClass);
+
+    arrow::MemoryPool* Pool;
+    int64_t MaxCachedBytes;
+
+    mutable std::mutex Lock; // batches are released on whatever thread drops them
+    std::vector<std::vector<uint8_t*>> FreeLists; // by size class, class c holds 1 << c bytes
+    int64_t CachedBytes = 0;
+    int64_t Recycled = 0;
+    int64_t Allocated = 0;
+};
@@ -0,0 +1,71 @@
+#include "pch.h"
+#include "MorselQueue.h"
+#include <algorithm>
+
+MorselQueue::MorselQueue(const std::vector<DataChunk>& Chunks, int WorkerCount, size_t MorselSize)
+    : SourceChunks(Chunks), MorselSize(std::max<size_t>(MorselSize, 1)), WorkerCount(std::max(WorkerCount, 1))
+{
+    this->Shares.reset(new WorkerShare[this->WorkerCount]);
+
+    size_t MorselCount = (Chunks.size() + this->MorselSize - 1) / this->MorselSize;
+    for (int Worker = 0; Worker < this->WorkerCount; ++Worker)
+    {
+        this->Shares[Worker].Begin = MorselCount * Worker / this->WorkerCount;
+        this->Shares[Worker].End = MorselCount * (Worker + 1) / this->WorkerCount;
+    }
+}
+
+bool MorselQueue::Next(int WorkerIndex, size_t& OutBegin, size_t& OutEnd)
+{
+    WorkerShare& Own = this->Shares[WorkerIndex];
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Own.Lock);
+            if (Own.Begin < Own.End)
+            {
+                size_t Morsel = Own.Begin++;
+                OutBegin = Morsel * this->MorselSize;
+                OutEnd = std::min(OutBegin + this->MorselSize, this->SourceChunks.size());
+                return true;
+            }
+        }
+
+        if (!this->Steal(WorkerIndex))
+        {
+            return false;
+        }
+    }
+}
+
+// Only one lock is held at a time, a thief never blocks while holding its own share
+bool MorselQueue::Steal(int WorkerIndex)
+{
+    for (int Offset = 1; Offset < this->WorkerCount; ++Offset)
+    {
+        WorkerShare& Victim = this->Shares[(WorkerIndex + Offset) % this->WorkerCount];
+
+        size_t StolenBegin;
+        size_t StolenEnd;
+        {
+            std::lock_guard<std::mutex> Lock(Victim.Lock);
+            size_t Remaining = Victim.End - Victim.Begin;
+            if (Remaining == 0)
+            {
+                continue;
+            }
+
+            // the victim keeps the front (it's about to read it), we take the back
+            StolenEnd = Victim.End;
+            StolenBegin = Victim.End - (Remaining + 1) / 2;
+            Victim.End = StolenBegin;
+        }
+
+        WorkerShare& Own = this->Shares[WorkerIndex];
+        std::lock_guard<std::mutex> Lock(Own.Lock);
+        Own.Begin = StolenBegin;
+        Own.End = StolenEnd;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <memory>
+#include "../OperatorImpl/DataChunk.h"
+
+// Hands out morsels (a few consecutive chunks of an in-memory table) to the workers of a parallel query.
+// Every worker starts out owning an equal, contiguous share of the morsels and takes them from the front of its share,
+// so it mostly streams through memory that no other core touches. A worker whose share ran out steals the back half
+// of another worker's remaining share, that way a slow worker (or an uneven filter) doesn't leave the others idle
+class MorselQueue
+{
+public:
+    MorselQueue(const std::vector<DataChunk>& Chunks, int WorkerCount, size_t MorselSize = 1);
+
+    // Next morsel for WorkerIndex as the chunk range [OutBegin, OutEnd). false once every morsel was handed out
+    bool Next(int WorkerIndex, size_t& OutBegin, size_t& OutEnd);
+
+    const std::vector<DataChunk>& Chunks() const { return this->SourceChunks; }
+
+private:
+    // [Begin, End) in morsels. One cache line each so workers popping their own share don't false share
+    struct alignas(64) WorkerShare
+    {
+        std::mutex Lock;
+        size_t Begin = 0;
+        size_t End = 0;
+    };
+
+    const std::vector<DataChunk>& SourceChunks;
+    size_t MorselSize;
+    int WorkerCount;
+    std::unique_ptr<WorkerShare[]> Shares;
+
+    bool Steal(int WorkerIndex);
+};
@@ -0,0 +1,281 @@
+#include "pch.h"
+#include "QueryMemoryPool.h"
+#include <algorithm>
+#include <cstring>
+
+// what zero byte allocations point to, like arrow's own pools do
+alignas(64) static uint8_t ZeroSizeArea[64];
+
+constexpr int64_t BufferAlignment = 64;
+
+// blocks kept around for reuse once nothing lives in them, the rest go back to the default pool
+constexpr size_t MaxSpareBlocks = 4;
+
+static int64_t AlignUp(int64_t Size, int64_t Alignment)
+{
+    return (Size + Alignment - 1) & ~(Alignment - 1);
+}
+
+QueryMemoryPool::QueryMemoryPool(int64_t MemoryLimit, int64_t BlockSize)
+    : Backing(arrow::default_memory_pool()), MemoryLimit(MemoryLimit), BlockSize(AlignUp(std::max<int64_t>(BlockSize, 4096), BufferAlignment))
+{
+}
+
+QueryMemoryPool::~QueryMemoryPool()
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    for (auto& [Address, B] : this->Blocks)
+    {
+        this->Backing->Free(B.Data, B.Size, B.Alignment);
+    }
+}
+
+arrow::Status QueryMemoryPool::Allocate(int64_t Size, int64_t Alignment, uint8_t** Out)
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+
+    if (this->MemoryLimit > 0 && this->LiveBytes + Size > this->MemoryLimit)
+    {
+        return arrow::Status::OutOfMemory("QueryMemoryPool: allocating ", Size, " bytes would go over the query's memory limit of ",
+            this->MemoryLimit, " bytes (", this->LiveBytes, " in use)");
+    }
+
+    return this->AllocateLocked(Size, Alignment, Out);
+}
+
+arrow::Status QueryMemoryPool::Reallocate(int64_t OldSize, int64_t NewSize, int64_t Alignment, uint8_t** Ptr)
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+
+    if (NewSize < 0)
+    {
+        return arrow::Status::Invalid("QueryMemoryPool: negative reallocation size");
+    }
+    if (this->MemoryLimit > 0 && NewSize > OldSize && this->LiveBytes + (NewSize - OldSize) > this->MemoryLimit)
+    {
+        return arrow::Status::OutOfMemory("QueryMemoryPool: growing a buffer to ", NewSize, " bytes would go over the query's memory limit of ",
+            this->MemoryLimit, " bytes (", this->LiveBytes, " in use)");
+    }
+
+    if (OldSize == 0 || *Ptr == ZeroSizeArea)
+    {
+        return this->AllocateLocked(NewSize, Alignment, Ptr);
+    }
+    if (NewSize == 0)
+    {
+        this->FreeLocked(*Ptr, OldSize);
+        *Ptr = ZeroSizeArea;
+        return arrow::Status::OK();
+    }
+
+    Block& B = this->BlockOf(*Ptr);
+    int64_t Offset = *Ptr - B.Data;
+    int64_t OldPadded = AlignUp(OldSize, BufferAlignment);
+    int64_t NewPadded = AlignUp(NewSize, BufferAlignment);
+
+    // the last allocation of the current block grows (or shrinks) where it is, and so does anything that still fits its slot
+    bool bLastInBlock = !B.bDedicated && &B == this->Current && Offset + OldPadded == B.Used;
+    if ((bLastInBlock && Offset + NewPadded <= B.Size) || NewPadded <= OldPadded)
+    {
+        if (bLastInBlock)
+        {
+            B.Used = Offset + NewPadded;
+        }
+
+        this->LiveBytes += NewSize - OldSize;
+        this->TotalBytes += std::max<int64_t>(NewSize - OldSize, 0);
+        this->PeakBytes = std::max(this->PeakBytes, this->LiveBytes);
+        ++this->Allocations;
+        return arrow::Status::OK();
+    }
+
+    // moving it holds both copies for a moment
+    if (this->MemoryLimit > 0 && this->LiveBytes + NewSize > this->MemoryLimit)
+    {
+        return arrow::Status::OutOfMemory("QueryMemoryPool: moving a buffer to ", NewSize, " bytes would go over the query's memory limit of ",
+            this->MemoryLimit, " bytes (", this->LiveBytes, " in use)");
+    }
+
+    uint8_t* NewBuffer = nullptr;
+    ARROW_RETURN_NOT_OK(this->AllocateLocked(NewSize, Alignment, &NewBuffer));
+    std::memcpy(NewBuffer, *Ptr, std::min(OldSize, NewSize));
+    this->FreeLocked(*Ptr, OldSize);
+    *Ptr = NewBuffer;
+    return arrow::Status::OK();
+}
+
+void QueryMemoryPool::Free(uint8_t* Buffer, int64_t Size, int64_t Alignment)
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    this->FreeLocked(Buffer, Size);
+}
+
+void QueryMemoryPool::ReleaseUnused()
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+
+    for (Block* B : this->SpareBlocks)
+    {
+        this->ReleaseBlock(B);
+    }
+    this->SpareBlocks.clear();
+
+    if (this->Current != nullptr && this->Current->LiveAllocations == 0)
+    {
+        this->ReleaseBlock(this->Current);
+        this->Current = nullptr;
+    }
+}
+
+int64_t QueryMemoryPool::bytes_allocated() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->LiveBytes;
+}
+
+int64_t QueryMemoryPool::max_memory() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->PeakBytes;
+}
+
+int64_t QueryMemoryPool::total_bytes_allocated() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->TotalBytes;
+}
+
+int64_t QueryMemoryPool::num_allocations() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->Allocations;
+}
+
+int64_t QueryMemoryPool::ReservedBytes() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->Reserved;
+}
+
+int64_t QueryMemoryPool::PeakReservedBytes() const
+{
+    std::lock_guard<std::mutex> Guard(this->Lock);
+    return this->PeakReserved;
+}
+
+arrow::Status QueryMemoryPool::AllocateLocked(int64_t Size, int64_t Alignment, uint8_t** Out)
+{
+    if (Size < 0)
+    {
+        return arrow::Status::Invalid("QueryMemoryPool: negative allocation size");
+    }
+    if (Size == 0)
+    {
+        *Out = ZeroSizeArea;
+        return arrow::Status::OK();
+    }
+
+    int64_t Padded = AlignUp(Size, BufferAlignment);
+    Block* Target = nullptr;
+
+    if (Padded > this->BlockSize / 4 || Alignment > BufferAlignment)
+    {
+        ARROW_RETURN_NOT_OK(this->NewBlock(AlignUp(Padded, std::max(Alignment, BufferAlignment)), std::max(Alignment, BufferAlignment), true, &Target));
+    }
+    else
+    {
+        if (this->Current == nullptr || this->Current->Used + Padded > this->Current->Size)
+        {
+            // the old block stays until its last buffer is freed. Used is always a multiple of 64, so nothing else to align
+            if (!this->SpareBlocks.empty())
+            {
+                this->Current = this->SpareBlocks.back();
+                this->SpareBlocks.pop_back();
+            }
+            else
+            {
+                ARROW_RETURN_NOT_OK(this->NewBlock(this->BlockSize, BufferAlignment, false, &this->Current));
+            }
+        }
+        Target = this->Current;
+    }
+
+    *Out = Target->Data + Target->Used;
+    Target->Used += Padded;
+    ++Target->LiveAllocations;
+
+    this->LiveBytes += Size;
+    this->PeakBytes = std::max(this->PeakBytes, this->LiveBytes);
+    this->TotalBytes += Size;
+    ++this->Allocations;
+    return arrow::Status::OK();
+}
+
+void QueryMemoryPool::FreeLocked(uint8_t* Buffer, int64_t Size)
+{
+    if (Buffer == nullptr || Buffer == ZeroSizeArea)
+    {
+        return;
+    }
+
+    Block& B = this->BlockOf(Buffer);
+    this->LiveBytes -= Size;
+    if (--B.LiveAllocations > 0)
+    {
+        return;
+    }
+
+    // nothing lives in the block anymore, its space can be handed out again from the start
+    if (B.bDedicated)
+    {
+        this->ReleaseBlock(&B);
+    }
+    else if (&B == this->Current)
+    {
+        B.Used = 0;
+    }
+    else if (this->SpareBlocks.size() < MaxSpareBlocks)
+    {
+        B.Used = 0;
+        this->SpareBlocks.push_back(&B);
+    }
+    else
+    {
+        this->ReleaseBlock(&B);
+    }
+}
+
+arrow::Status QueryMemoryPool::NewBlock(int64_t Size, int64_t Alignment, bool bDedicated, Block** Out)
+{
+    uint8_t* Data = nullptr;
+    ARROW_RETURN_NOT_OK(this->Backing->Allocate(Size, Alignment, &Data));
+
+    Block& B = this->Blocks[(uintptr_t)Data];
+    B.Data = Data;
+    B.Size = Size;
+    B.Alignment = Alignment;
+    B.bDedicated = bDedicated;
+
+    this->Reserved += Size;
+    this->PeakReserved = std::max(this->PeakReserved, this->Reserved);
+    *Out = &B;
+    return arrow::Status::OK();
+}
+
+void QueryMemoryPool::ReleaseBlock(Block* B)
+{
+    uintptr_t Address = (uintptr_t)B->Data;
+    this->Reserved -= B->Size;
+    this->Backing->Free(B->Data, B->Size, B->Alignment);
+    this->Blocks.erase(Address);
+}
+
+QueryMemoryPool::Block& QueryMemoryPool::BlockOf(uint8_t* Buffer)
+{
+    auto It = this->Blocks.upper_bound((uintptr_t)Buffer);
+    if (It == this->Blocks.begin())
+    {
+        throw std::runtime_error("QueryMemoryPool: buffer wasn't allocated from this pool");
+    }
+    return std::prev(It)->second;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <arrow/memory_pool.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// An arrow::MemoryPool that lives as long as one query and that every operator of its plan allocates from
+// (Operator::UseMemoryPool). Buffers are bump allocated out of big blocks taken from the default pool, so a batch
+// costs a pointer bump instead of a trip through the global allocator, and a block whose buffers are all freed again
+// is reused for the next batches. Everything is 64 byte aligned. Allocations bigger than a quarter block get a block
+// of their own that goes back as soon as they are freed.
+// The pool counts what the query asks for: live and peak bytes, number of allocations, and the bytes it keeps in blocks.
+// With a MemoryLimit an allocation that would go over it fails with Status::OutOfMemory, which the operators throw
+// (PARQUET_THROW_NOT_OK) and the query ends with an exception instead of taking the machine down.
+// Destroying the pool frees every block, so it has to outlive every buffer allocated from it (the query's results too)
+class QueryMemoryPool : public arrow::MemoryPool
+{
+public:
+    // MemoryLimit in bytes, 0 for no limit
+    explicit QueryMemoryPool(int64_t MemoryLimit = 0, int64_t BlockSize = 4 * 1024 * 1024);
+    ~QueryMemoryPool() override;
+
+    QueryMemoryPool(const QueryMemoryPool&) = delete;
+    QueryMemoryPool& operator=(const QueryMemoryPool&) = delete;
+
+    using arrow::MemoryPool::Allocate;
+    using arrow::MemoryPool::Free;
+    using arrow::MemoryPool::Reallocate;
+
+    arrow::Status Allocate(int64_t Size, int64_t Alignment, uint8_t** Out) override;
+    arrow::Status Reallocate(int64_t OldSize, int64_t NewSize, int64_t Alignment, uint8_t** Ptr) override;
+    void Free(uint8_t* Buffer, int64_t Size, int64_t Alignment) override;
+
+    // Gives the blocks nothing lives in back to the default pool
+    void ReleaseUnused() override;
+
+    int64_t bytes_allocated() const override;       // live bytes
+    int64_t max_memory() const override;            // peak of the live bytes
+    int64_t total_bytes_allocated() const override; // every byte ever asked for
+    int64_t num_allocations() const override;
+    std::string backend_name() const override { return "query-arena"; }
+
+    // What the pool holds in blocks right now and at most, the live bytes plus alignment padding and free space
+    int64_t ReservedBytes() const;
+    int64_t PeakReservedBytes() const;
+
+    int64_t GetMemoryLimit() const { return this->MemoryLimit; }
+
+private:
+    struct Block
+    {
+        uint8_t* Data = nullptr;
+        int64_t Size = 0;
+        int64_t Alignment = 64;
+        int64_t Used = 0;
+        int64_t LiveAllocations = 0;
+        bool bDedicated = false; // holds one big allocation
+    };
+
+    arrow::MemoryPool* Backing;
+    int64_t MemoryLimit;
+    int64_t BlockSize;
+
+    mutable std::mutex Lock;
+    std::map<uintptr_t, Block> Blocks; // by start address, a buffer belongs to the last block starting at or before it
+    Block* Current = nullptr;          // the block new allocations are bumped out of
+    std::vector<Block*> SpareBlocks;   // standard blocks nothing lives in
+
+    int64_t LiveBytes = 0;
+    int64_t PeakBytes = 0;
+    int64_t TotalBytes = 0;
+    int64_t Allocations = 0;
+    int64_t Reserved = 0;
+    int64_t PeakReserved = 0;
+
+    arrow::Status AllocateLocked(int64_t Size, int64_t Alignment, uint8_t** Out);
+    void FreeLocked(uint8_t* Buffer, int64_t Size);
+    arrow::Status NewBlock(int64_t Size, int64_t Alignment, bool bDedicated, Block** Out);
+    void ReleaseBlock(Block* B);
+    Block& BlockOf(uint8_t* Buffer);
+};
@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int ThreadCount)
+{
+    ThreadCount = std::max(ThreadCount, 1);
+    for (int WorkerIndex = 1; WorkerIndex < ThreadCount; ++WorkerIndex)
+    {
+        this->Threads.emplace_back(&ThreadPool::WorkerLoop, this, WorkerIndex);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> Lock(this->StateLock);
+        this->bStopping = true;
+    }
+    this->WorkAvailable.notify_all();
+
+    for (std::thread& Thread : this->Threads)
+    {
+        Thread.join();
+    }
+}
+
+void ThreadPool::RunJob(int WorkerIndex, const std::function<void(int)>& Job)
+{
+    try
+    {
+        Job(WorkerIndex);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> Lock(this->StateLock);
+        if (!this->FirstError)
+        {
+            this->FirstError = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::WorkerLoop(int WorkerIndex)
+{
+    uint64_t SeenGeneration = 0;
+    while (true)
+    {
+        const std::function<void(int)>* Job = nullptr;
+        {
+            std::unique_lock<std::mutex> Lock(this->StateLock);
+            this->WorkAvailable.wait(Lock, [&]() { return this->bStopping || this->Generation != SeenGeneration; });
+            if (this->bStopping)
+            {
+                return;
+            }
+
+            SeenGeneration = this->Generation;
+            if (WorkerIndex >= this->ActiveWorkers)
+            {
+                continue; // this job needs fewer threads
+            }
+            Job = this->CurrentJob;
+        }
+
+        this->RunJob(WorkerIndex, *Job);
+
+        std::lock_guard<std::mutex> Lock(this->StateLock);
+        if (--this->RemainingWorkers == 0)
+        {
+            this->WorkDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::Run(int WorkerCount, const std::function<void(int)>& Job)
+{
+    std::lock_guard<std::mutex> RunGuard(this->RunLock);
+    WorkerCount = std::clamp(WorkerCount, 1, this->Size());
+
+    {
+        std::lock_guard<std::mutex> Lock(this->StateLock);
+        this->CurrentJob = &Job;
+        this->ActiveWorkers = WorkerCount;
+        this->RemainingWorkers = WorkerCount - 1; // the caller isn't counted, it knows when it's done
+        this->FirstError = nullptr;
+        ++this->Generation;
+    }
+    if (WorkerCount > 1)
+    {
+        this->WorkAvailable.notify_all();
+    }
+
+    this->RunJob(0, Job);
+
+    std::unique_lock<std::mutex> Lock(this->StateLock);
+    this->WorkDone.wait(Lock, [&]() { return this->RemainingWorkers == 0; });
+    this->CurrentJob = nullptr;
+
+    if (this->FirstError)
+    {
+        std::exception_ptr Error = this->FirstError;
+        this->FirstError = nullptr;
+        std::rethrow_exception(Error);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// A fixed set of threads that all run the same job, one call per worker index.
+// The threads are created once and sleep between jobs, so starting a parallel query costs a wake up, not a thread spawn.
+// How the work is split is up to the job (see MorselQueue), the pool only runs it
+class ThreadPool
+{
+public:
+    // ThreadCount includes the calling thread, which always runs worker 0
+    explicit ThreadPool(int ThreadCount = (int)std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int Size() const { return (int)this->Threads.size() + 1; }
+
+    // Calls Job(WorkerIndex) for every WorkerIndex in [0, WorkerCount) in parallel and returns once all of them returned.
+    // WorkerCount is clamped to Size(). The first exception a worker throws is rethrown here.
+    // Not reentrant, a job must not call Run on the same pool
+    void Run(int WorkerCount, const std::function<void(int)>& Job);
+
+private:
+    std::vector<std::thread> Threads;
+
+    std::mutex RunLock; // one job at a time
+
+    std::mutex StateLock;
+    std::condition_variable WorkAvailable;
+    std::condition_variable WorkDone;
+    const std::function<void(int)>* CurrentJob = nullptr;
+    int ActiveWorkers = 0;
+    int RemainingWorkers = 0;
+    uint64_t Generation = 0; // bumped for every job so sleeping threads know there's something new
+    bool bStopping = false;
+    std::exception_ptr FirstError;
+
+    void WorkerLoop(int WorkerIndex);
+    void RunJob(int WorkerIndex, const std::function<void(int)>& Job);
+};
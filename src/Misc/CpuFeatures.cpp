@@ -0,0 +1,96 @@
+#include "pch.h"
+#include "CpuFeatures.h"
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace CpuFeatures
+{
+    // Regs = { eax, ebx, ecx, edx }
+    static void CpuId(uint32_t Leaf, uint32_t SubLeaf, uint32_t Regs[4])
+    {
+#if defined(_MSC_VER)
+        int Out[4];
+        __cpuidex(Out, (int)Leaf, (int)SubLeaf);
+        for (int i = 0; i < 4; ++i) Regs[i] = (uint32_t)Out[i];
+#else
+        if (!__get_cpuid_count(Leaf, SubLeaf, &Regs[0], &Regs[1], &Regs[2], &Regs[3]))
+        {
+            Regs[0] = Regs[1] = Regs[2] = Regs[3] = 0;
+        }
+#endif
+    }
+
+    // XCR0 tells us which register states the OS saves on a context switch.
+    // A CPU can support AVX-512 while the OS doesn't, using it then faults just like a missing instruction
+    static uint64_t ReadXcr0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t Eax, Edx;
+        __asm__ volatile("xgetbv" : "=a"(Eax), "=d"(Edx) : "c"(0));
+        return ((uint64_t)Edx << 32) | Eax;
+#endif
+    }
+
+    static Features Detect()
+    {
+        Features Result;
+
+        uint32_t Regs[4];
+        CpuId(0, 0, Regs);
+        uint32_t MaxLeaf = Regs[0];
+        if (MaxLeaf < 7)
+        {
+            return Result;
+        }
+
+        CpuId(1, 0, Regs);
+        bool bOsXsave = (Regs[2] >> 27) & 1;
+        bool bAvx = (Regs[2] >> 28) & 1;
+        bool bFma = (Regs[2] >> 12) & 1;
+        bool bPopcnt = (Regs[2] >> 23) & 1;
+        if (!bOsXsave || !bAvx)
+        {
+            return Result;
+        }
+
+        uint64_t Xcr0 = ReadXcr0();
+        bool bOsYmm = (Xcr0 & 0x6) == 0x6;   // SSE + AVX state
+        bool bOsZmm = (Xcr0 & 0xE6) == 0xE6; // + opmask, upper ZMM0-15, ZMM16-31
+
+        CpuId(7, 0, Regs);
+        uint32_t Ebx = Regs[1];
+        bool bBmi1 = (Ebx >> 3) & 1;
+        bool bAvx2 = (Ebx >> 5) & 1;
+        bool bBmi2 = (Ebx >> 8) & 1;
+        bool bAvx512F = (Ebx >> 16) & 1;
+        bool bAvx512DQ = (Ebx >> 17) & 1;
+        bool bAvx512BW = (Ebx >> 30) & 1;
+        bool bAvx512VL = (Ebx >> 31) & 1;
+
+        Result.bAvx2 = bOsYmm && bAvx2 && bFma && bBmi1 && bBmi2 && bPopcnt;
+        Result.bAvx512 = Result.bAvx2 && bOsZmm && bAvx512F && bAvx512DQ && bAvx512BW && bAvx512VL;
+        return Result;
+    }
+
+    const Features& Get()
+    {
+        static const Features Detected = Detect();
+        return Detected;
+    }
+
+    std::string Describe()
+    {
+        const Features& F = Get();
+        std::string Out = "SSE2";
+        if (F.bAvx2) Out += " AVX2";
+        if (F.bAvx512) Out += " AVX-512";
+        return Out;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+// The binary is compiled for baseline x86-64, SIMD kernels opt in per function with these attributes.
+// That way one binary runs on AVX2-only and AVX-512 hosts, the operators only call a kernel after
+// CpuFeatures said the instructions are there.
+// MSVC doesn't need the attributes, it lets any function use any intrinsic.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define OLAP_TARGET_AVX2
+#define OLAP_TARGET_AVX512
+#else
+#define OLAP_TARGET_AVX2 __attribute__((target("avx2,fma,bmi,bmi2,popcnt")))
+#define OLAP_TARGET_AVX512 __attribute__((target("avx512f,avx512vl,avx512bw,avx512dq,avx2,fma,bmi,bmi2,popcnt")))
+#endif
+
+namespace CpuFeatures
+{
+    struct Features
+    {
+        bool bAvx2 = false;   // AVX2 + FMA + BMI1/2, and the OS saves the YMM registers
+        bool bAvx512 = false; // AVX-512 F/VL/BW/DQ (Skylake-X and later), and the OS saves the ZMM registers
+    };
+
+    // Runs cpuid/xgetbv the first time it's called and caches the result for the rest of the process
+    const Features& Get();
+
+    // e.g. "AVX2 AVX-512" for logging
+    std::string Describe();
+}
@@ -0,0 +1,367 @@
+#include "pch.h"
+#include "AggregateOperator.h"
+#include "../Kernels/Validity.h"
+#include <algorithm>
+#include <stdexcept>
+
+AggregateOperator::AggregateOperator(std::unique_ptr<Operator> Child, std::vector<AggregateSpec> Aggregates, ExecutionMode Mode)
+    : Operator(Mode)
+{
+    this->ChildOperator = std::move(Child);
+    this->Aggregates = std::move(Aggregates);
+    this->bFinished = false;
+
+    this->ChildOperator->PushProjection(AggregateColumns(this->Aggregates));
+}
+
+std::vector<ColumnRef> AggregateColumns(const std::vector<AggregateSpec>& Aggregates)
+{
+    std::vector<ColumnRef> Columns;
+    for (const AggregateSpec& Spec : Aggregates)
+    {
+        if (Spec.Function != AggregateFunction::COUNT_STAR)
+        {
+            Columns.push_back(Spec.ColumnName.empty() ? ColumnRef::At(Spec.ColumnIndex) : ColumnRef::Named(Spec.ColumnName));
+        }
+    }
+    return Columns;
+}
+
+const char* AggregateFunctionName(AggregateFunction Function)
+{
+    switch (Function)
+    {
+    case AggregateFunction::SUM: return "sum";
+    case AggregateFunction::MIN: return "min";
+    case AggregateFunction::MAX: return "max";
+    case AggregateFunction::COUNT: return "count";
+    case AggregateFunction::COUNT_STAR: return "count";
+    case AggregateFunction::AVG: return "avg";
+    }
+    return "?";
+}
+
+void AggregateOperator::Bind(const arrow::Schema& Schema)
+{
+    this->AggregateSlots.clear();
+
+    for (AggregateSpec& Spec : this->Aggregates)
+    {
+        if (Spec.Function == AggregateFunction::COUNT_STAR)
+        {
+            this->AggregateSlots.push_back(-1);
+            continue;
+        }
+
+        if (Spec.ColumnIndex < 0)
+        {
+            Spec.ColumnIndex = Schema.GetFieldIndex(Spec.ColumnName);
+            if (Spec.ColumnIndex < 0)
+            {
+                throw std::runtime_error("AggregateOperator: no column named '" + Spec.ColumnName + "'");
+            }
+        }
+
+        if (Spec.ColumnIndex >= Schema.num_fields())
+        {
+            throw std::runtime_error("AggregateOperator: column index " + std::to_string(Spec.ColumnIndex) + " is out of range");
+        }
+
+        const std::shared_ptr<arrow::Field>& Field = Schema.field(Spec.ColumnIndex);
+        if (Field->type()->id() != arrow::Type::INT32)
+        {
+            throw std::runtime_error("AggregateOperator: column '" + Field->name() + "' must be int32, got " + Field->type()->ToString());
+        }
+
+        if (Spec.OutputName.empty())
+        {
+            Spec.OutputName = std::string(AggregateFunctionName(Spec.Function)) + "_" + Field->name();
+        }
+
+        // every aggregate over the same column shares one slot, that's what makes it a single pass
+        auto Existing = std::find(this->StatColumns.begin(), this->StatColumns.end(), Spec.ColumnIndex);
+        if (Existing == this->StatColumns.end())
+        {
+            this->StatColumns.push_back(Spec.ColumnIndex);
+            this->ColumnStats.emplace_back();
+            this->AggregateSlots.push_back((int)this->StatColumns.size() - 1);
+        }
+        else
+        {
+            this->AggregateSlots.push_back((int)(Existing - this->StatColumns.begin()));
+        }
+    }
+}
+
+// Null rows are skipped by every aggregate, so Stats.Count ends up as COUNT(col) and a column with only
+// nulls comes out as NULL like an empty one. COUNT(*) is the row count and doesn't look at the bitmap
+void AggregateOperator::Accumulate(const SelectedChunk& Chunk)
+{
+    this->RowCount += Chunk.Count;
+
+    for (size_t Slot = 0; Slot < this->StatColumns.size(); ++Slot)
+    {
+        std::shared_ptr<arrow::Int32Array> Column = std::static_pointer_cast<arrow::Int32Array>(Chunk.Batch->column(this->StatColumns[Slot]));
+        const int32_t* RawValues = Column->raw_values();
+        const uint8_t* Validity = Column->null_count() > 0 ? Column->null_bitmap_data() : nullptr;
+        Kernels::Int32Stats& Stats = this->ColumnStats[Slot];
+
+        if (Chunk.HasSelection())
+        {
+            const int32_t* Selection = Chunk.Selection;
+            int64_t Count = Chunk.Count;
+            if (Validity != nullptr)
+            {
+                this->ValidSelection.resize(Count);
+                Count = Kernels::DropNulls(Validity, Column->offset(), Selection, Count, this->ValidSelection.data());
+                Selection = this->ValidSelection.data();
+            }
+
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                Kernels::AccumulateSelectedStatsAvx512(RawValues, Selection, Count, Stats);
+                break;
+            case ExecutionMode::AVX2:
+                Kernels::AccumulateSelectedStatsAvx2(RawValues, Selection, Count, Stats);
+                break;
+            default:
+                Kernels::AccumulateSelectedStatsScalar(RawValues, Selection, Count, Stats);
+                break;
+            }
+        }
+        else if (Validity != nullptr)
+        {
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                Kernels::AccumulateNullableStatsAvx512(RawValues, Validity, Column->offset(), Column->length(), Stats);
+                break;
+            case ExecutionMode::AVX2:
+                Kernels::AccumulateNullableStatsAvx2(RawValues, Validity, Column->offset(), Column->length(), Stats);
+                break;
+            default:
+                Kernels::AccumulateNullableStatsScalar(RawValues, Validity, Column->offset(), Column->length(), Stats);
+                break;
+            }
+        }
+        else
+        {
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                Kernels::AccumulateStatsAvx512(RawValues, Column->length(), Stats);
+                break;
+            case ExecutionMode::AVX2:
+                Kernels::AccumulateStatsAvx2(RawValues, Column->length(), Stats);
+                break;
+            default:
+                Kernels::AccumulateStatsScalar(RawValues, Column->length(), Stats);
+                break;
+            }
+        }
+    }
+}
+
+DataChunk AggregateOperator::Next()
+{
+    if (this->bFinished)
+    {
+        return nullptr;
+    }
+
+    while (true)
+    {
+        // a filter below us hands over its selection, nothing gets compacted
+        SelectedChunk Chunk = this->ChildOperator->NextSelected();
+        if (Chunk.IsEnd())
+        {
+            break;
+        }
+
+        if (!this->bBound)
+        {
+            this->Bind(*Chunk.Batch->schema());
+            this->bBound = true;
+        }
+
+        this->Accumulate(Chunk);
+    }
+
+    this->bFinished = true;
+    std::vector<Kernels::Int32Stats> Stats = this->StatsByAggregate();
+    return this->bProducePartials ? this->BuildPartial(Stats) : this->BuildResult(Stats, this->RowCount, this->OutputNames());
+}
+
+std::vector<Kernels::Int32Stats> AggregateOperator::StatsByAggregate() const
+{
+    std::vector<Kernels::Int32Stats> Stats;
+    for (size_t i = 0; i < this->Aggregates.size(); ++i)
+    {
+        // the child was empty, Bind never ran
+        int Slot = i < this->AggregateSlots.size() ? this->AggregateSlots[i] : -1;
+        Stats.push_back(Slot >= 0 ? this->ColumnStats[Slot] : Kernels::Int32Stats());
+    }
+    return Stats;
+}
+
+std::vector<std::string> AggregateOperator::OutputNames() const
+{
+    std::vector<std::string> Names;
+    for (const AggregateSpec& Spec : this->Aggregates)
+    {
+        std::string Name = Spec.OutputName;
+        if (Name.empty())
+        {
+            Name = std::string(AggregateFunctionName(Spec.Function)) + "_" + (Spec.ColumnName.empty() ? std::to_string(Spec.ColumnIndex) : Spec.ColumnName);
+        }
+        Names.push_back(Name);
+    }
+    return Names;
+}
+
+DataChunk AggregateOperator::BuildPartial(const std::vector<Kernels::Int32Stats>& Stats) const
+{
+    std::vector<std::shared_ptr<arrow::Field>> Fields;
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+
+    auto AddInt64 = [&](const std::string& Name, int64_t Value, bool bNull)
+    {
+        arrow::Int64Builder Builder(this->Memory);
+        PARQUET_THROW_NOT_OK(bNull ? Builder.AppendNull() : Builder.Append(Value));
+        Columns.emplace_back();
+        PARQUET_THROW_NOT_OK(Builder.Finish(&Columns.back()));
+        Fields.push_back(arrow::field(Name, arrow::int64()));
+    };
+    auto AddInt32 = [&](const std::string& Name, int32_t Value)
+    {
+        arrow::Int32Builder Builder(this->Memory);
+        PARQUET_THROW_NOT_OK(Builder.Append(Value));
+        Columns.emplace_back();
+        PARQUET_THROW_NOT_OK(Builder.Finish(&Columns.back()));
+        Fields.push_back(arrow::field(Name, arrow::int32()));
+    };
+
+    AddInt64("rows", this->RowCount, !this->bBound);
+    std::vector<std::string> Names = this->OutputNames();
+    for (size_t i = 0; i < Stats.size(); ++i)
+    {
+        AddInt64(Names[i], Stats[i].Sum, false);
+        AddInt32(Names[i] + "_min", Stats[i].Min);
+        AddInt32(Names[i] + "_max", Stats[i].Max);
+        AddInt64(Names[i] + "_count", Stats[i].Count, false);
+    }
+
+    return arrow::RecordBatch::Make(arrow::schema(Fields), 1, std::move(Columns));
+}
+
+DataChunk AggregateOperator::BuildResult(const std::vector<Kernels::Int32Stats>& AllStats, int64_t RowCount, const std::vector<std::string>& Names) const
+{
+    std::vector<std::shared_ptr<arrow::Field>> Fields;
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+
+    for (size_t i = 0; i < this->Aggregates.size(); ++i)
+    {
+        const AggregateSpec& Spec = this->Aggregates[i];
+        const Kernels::Int32Stats& Stats = AllStats[i];
+        const std::string& Name = Names[i];
+
+        // SQL semantics: MIN/MAX/AVG of zero rows is NULL, SUM is NULL too, COUNT is 0
+        bool bEmpty = Stats.Count == 0;
+        std::shared_ptr<arrow::Array> ResultArray;
+
+        switch (Spec.Function)
+        {
+        case AggregateFunction::SUM:
+        {
+            arrow::Int64Builder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(bEmpty ? Builder.AppendNull() : Builder.Append(Stats.Sum));
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Name, arrow::int64()));
+            break;
+        }
+        case AggregateFunction::MIN:
+        case AggregateFunction::MAX:
+        {
+            arrow::Int32Builder Builder(this->Memory);
+            int32_t Value = Spec.Function == AggregateFunction::MIN ? Stats.Min : Stats.Max;
+            PARQUET_THROW_NOT_OK(bEmpty ? Builder.AppendNull() : Builder.Append(Value));
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Name, arrow::int32()));
+            break;
+        }
+        case AggregateFunction::COUNT:
+        case AggregateFunction::COUNT_STAR:
+        {
+            arrow::Int64Builder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Append(Spec.Function == AggregateFunction::COUNT_STAR ? RowCount : Stats.Count));
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Name, arrow::int64(), false));
+            break;
+        }
+        case AggregateFunction::AVG:
+        {
+            arrow::DoubleBuilder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(bEmpty ? Builder.AppendNull() : Builder.Append((double)Stats.Sum / (double)Stats.Count));
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Name, arrow::float64()));
+            break;
+        }
+        }
+
+        Columns.push_back(ResultArray);
+    }
+
+    return arrow::RecordBatch::Make(arrow::schema(Fields), 1, std::move(Columns));
+}
+
+bool AggregateOperator::FusePipelines()
+{
+    return this->ChildOperator->FusePipelines();
+}
+
+void AggregateOperator::Close()
+{
+    this->bFinished = true;
+    this->ChildOperator->Close();
+}
+
+void AggregateOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
+}
+
+// Every copy returned one BuildPartial() row. The names come from a copy that saw a batch, the others may not know them
+std::vector<DataChunk> AggregateOperator::MergePartials(std::vector<DataChunk> Partials) const
+{
+    std::vector<Kernels::Int32Stats> Stats(this->Aggregates.size());
+    int64_t RowCount = 0;
+    std::vector<std::string> Names = this->OutputNames();
+    bool bNamed = false;
+
+    for (const DataChunk& Partial : Partials)
+    {
+        const arrow::Array& Rows = *Partial->column(0);
+        RowCount += Rows.IsNull(0) ? 0 : Rows.data()->GetValues<int64_t>(1)[0];
+
+        for (size_t i = 0; i < Stats.size(); ++i)
+        {
+            int First = 1 + 4 * (int)i;
+            Kernels::Int32Stats Part;
+            Part.Sum = Partial->column(First)->data()->GetValues<int64_t>(1)[0];
+            Part.Min = Partial->column(First + 1)->data()->GetValues<int32_t>(1)[0];
+            Part.Max = Partial->column(First + 2)->data()->GetValues<int32_t>(1)[0];
+            Part.Count = Partial->column(First + 3)->data()->GetValues<int64_t>(1)[0];
+            Stats[i].Merge(Part);
+
+            if (!bNamed && !Rows.IsNull(0))
+            {
+                Names[i] = Partial->schema()->field(First)->name();
+            }
+        }
+        bNamed = bNamed || !Rows.IsNull(0);
+    }
+
+    return { this->BuildResult(Stats, RowCount, Names) };
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "../Operator.h"
+#include "../Kernels/Aggregation.h"
+#include <arrow/builder.h>
+#include <vector>
+#include <string>
+
+enum class AggregateFunction
+{
+    SUM,
+    MIN,
+    MAX,
+    COUNT,      // COUNT(column)
+    COUNT_STAR, // COUNT(*), doesn't read any column
+    AVG
+};
+
+// One aggregate of the query, e.g. SUM(IntColumn) AS total
+struct AggregateSpec
+{
+    AggregateFunction Function;
+    int ColumnIndex = -1;   // -1 until ColumnName has been resolved (unused for COUNT_STAR)
+    std::string ColumnName;
+    std::string OutputName; // generated from the function and column when left empty
+
+    AggregateSpec(AggregateFunction InFunction, int InColumnIndex, const std::string& InOutputName = "")
+        : Function(InFunction), ColumnIndex(InColumnIndex), OutputName(InOutputName)
+    {
+    }
+
+    AggregateSpec(AggregateFunction InFunction, const std::string& InColumnName, const std::string& InOutputName = "")
+        : Function(InFunction), ColumnName(InColumnName), OutputName(InOutputName)
+    {
+    }
+
+    static AggregateSpec CountStar(const std::string& InOutputName = "count_star")
+    {
+        return AggregateSpec(AggregateFunction::COUNT_STAR, -1, InOutputName);
+    }
+};
+
+// "sum", "min", ... used to name the output columns, e.g. sum_IntColumn
+const char* AggregateFunctionName(AggregateFunction Function);
+
+// the input columns the aggregates read, for PushProjection
+std::vector<ColumnRef> AggregateColumns(const std::vector<AggregateSpec>& Aggregates);
+
+// Computes any number of SUM/MIN/MAX/COUNT/AVG aggregates in one pass over the child's data.
+// Aggregates that read the same column share one kernel call per batch, which fills sum, min, max and count together,
+// so SUM(x), MIN(x), MAX(x) and AVG(x) stream x through memory once instead of four times.
+// Emits a single row with one column per aggregate, in the order they were given
+class AggregateOperator : public Operator
+{
+public:
+    AggregateOperator(std::unique_ptr<Operator> Child, std::vector<AggregateSpec> Aggregates, ExecutionMode Mode);
+
+    DataChunk Next() override;
+
+    // No fused kernels for the multi-aggregate loop (yet), only passed on to the child
+    bool FusePipelines() override;
+
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    // The copies return their running stats instead of the result (see BuildPartial), this adds them up
+    std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const override;
+
+    void ProducePartials() override { this->bProducePartials = true; }
+
+private:
+    std::unique_ptr<Operator> ChildOperator;
+    std::vector<AggregateSpec> Aggregates;
+
+    // Distinct input columns and the running stats of each one.
+    // AggregateSlots[i] is the index into StatColumns that aggregate i reads (-1 for COUNT(*))
+    std::vector<int> StatColumns;
+    std::vector<Kernels::Int32Stats> ColumnStats;
+    std::vector<int> AggregateSlots;
+    int64_t RowCount = 0;
+
+    // the rows of a filter's selection that aren't null in the column being accumulated
+    std::vector<int32_t> ValidSelection;
+
+    bool bBound = false;
+    bool bProducePartials = false;
+
+    // Resolves column names and builds StatColumns from the schema of the first batch
+    void Bind(const arrow::Schema& Schema);
+
+    void Accumulate(const SelectedChunk& Chunk);
+
+    // the output column name of every aggregate, generated ones before Bind() ran are made from the column name or index
+    std::vector<std::string> OutputNames() const;
+
+    // Stats[i] is what aggregate i reads, RowCount is COUNT(*)
+    DataChunk BuildResult(const std::vector<Kernels::Int32Stats>& Stats, int64_t RowCount, const std::vector<std::string>& Names) const;
+
+    // One row: "rows" (COUNT(*), NULL when no batch ever arrived and the names aren't resolved),
+    // then the sum, min, max and count of every aggregate's stats, named after its output column
+    DataChunk BuildPartial(const std::vector<Kernels::Int32Stats>& Stats) const;
+
+    std::vector<Kernels::Int32Stats> StatsByAggregate() const;
+};
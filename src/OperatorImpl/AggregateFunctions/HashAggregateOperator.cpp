@@ -0,0 +1,684 @@
+#include "pch.h"
+#include "HashAggregateOperator.h"
+#include "../MemoryScanOperator.h"
+#include "../Kernels/TypedKernels.h"
+#include "../Kernels/Validity.h"
+#include <algorithm>
+#include <stdexcept>
+
+HashAggregateOperator::HashAggregateOperator(std::unique_ptr<Operator> Child, std::vector<std::string> KeyColumns, std::vector<AggregateSpec> Aggregates, ExecutionMode Mode)
+    : Operator(Mode)
+{
+    this->ChildOperator = std::move(Child);
+    this->KeyColumnNames = std::move(KeyColumns);
+    this->Aggregates = std::move(Aggregates);
+    this->bFinished = false;
+
+    if (this->KeyColumnNames.empty())
+    {
+        throw std::runtime_error("HashAggregateOperator: needs at least one key column, use AggregateOperator for a whole table aggregate");
+    }
+
+    std::vector<ColumnRef> Columns = AggregateColumns(this->Aggregates);
+    for (const std::string& Name : this->KeyColumnNames)
+    {
+        Columns.push_back(ColumnRef::Named(Name));
+    }
+    this->ChildOperator->PushProjection(Columns);
+}
+
+void HashAggregateOperator::Bind(const arrow::Schema& Schema)
+{
+    for (const std::string& Name : this->KeyColumnNames)
+    {
+        int Index = Schema.GetFieldIndex(Name);
+        if (Index < 0)
+        {
+            throw std::runtime_error("HashAggregateOperator: no column named '" + Name + "'");
+        }
+
+        std::shared_ptr<arrow::Field> Field = Schema.field(Index);
+        DictionaryKey Key;
+        if (Field->type()->id() == arrow::Type::DICTIONARY)
+        {
+            const arrow::DictionaryType& Type = static_cast<const arrow::DictionaryType&>(*Field->type());
+            arrow::Type::type ValueType = Type.value_type()->id();
+            if ((ValueType != arrow::Type::STRING && ValueType != arrow::Type::BINARY) || !arrow::is_integer(Type.index_type()->id()))
+            {
+                throw std::runtime_error("HashAggregateOperator: dictionary key column '" + Name + "' must hold strings, got " + Field->type()->ToString());
+            }
+            Key.bDictionary = true;
+            Field = arrow::field(Field->name(), Type.value_type(), Field->nullable());
+        }
+        else if (Field->type()->id() != arrow::Type::INT32 && Field->type()->id() != arrow::Type::INT64)
+        {
+            throw std::runtime_error("HashAggregateOperator: key column '" + Name + "' must be int32 or int64, got " + Field->type()->ToString());
+        }
+
+        this->bNullKeyFlags = this->bNullKeyFlags || (Field->type()->id() == arrow::Type::INT64 && Field->nullable());
+        this->KeyColumns.push_back(Index);
+        this->KeyFields.push_back(Field);
+        this->DictionaryKeys.push_back(std::move(Key));
+    }
+
+    for (AggregateSpec& Spec : this->Aggregates)
+    {
+        if (Spec.Function == AggregateFunction::COUNT_STAR)
+        {
+            this->AggregateSlots.push_back(-1);
+            continue;
+        }
+
+        if (this->bMergingPartials)
+        {
+            // the sum, min, max and count of the aggregate follow each other after the keys and "rows", every one gets its own slot
+            int Column = (int)this->KeyColumns.size() + 1 + 4 * (int)this->StatColumns.size();
+            Spec.OutputName = Schema.field(Column)->name();
+            this->StatColumns.push_back(Column);
+            this->AggregateSlots.push_back((int)this->StatColumns.size() - 1);
+            continue;
+        }
+
+        if (Spec.ColumnIndex < 0)
+        {
+            Spec.ColumnIndex = Schema.GetFieldIndex(Spec.ColumnName);
+            if (Spec.ColumnIndex < 0)
+            {
+                throw std::runtime_error("HashAggregateOperator: no column named '" + Spec.ColumnName + "'");
+            }
+        }
+
+        if (Spec.ColumnIndex >= Schema.num_fields())
+        {
+            throw std::runtime_error("HashAggregateOperator: column index " + std::to_string(Spec.ColumnIndex) + " is out of range");
+        }
+
+        const std::shared_ptr<arrow::Field>& Field = Schema.field(Spec.ColumnIndex);
+        if (Field->type()->id() != arrow::Type::INT32)
+        {
+            throw std::runtime_error("HashAggregateOperator: column '" + Field->name() + "' must be int32, got " + Field->type()->ToString());
+        }
+
+        if (Spec.OutputName.empty())
+        {
+            Spec.OutputName = std::string(AggregateFunctionName(Spec.Function)) + "_" + Field->name();
+        }
+
+        auto Existing = std::find(this->StatColumns.begin(), this->StatColumns.end(), Spec.ColumnIndex);
+        if (Existing == this->StatColumns.end())
+        {
+            this->StatColumns.push_back(Spec.ColumnIndex);
+            this->AggregateSlots.push_back((int)this->StatColumns.size() - 1);
+        }
+        else
+        {
+            this->AggregateSlots.push_back((int)(Existing - this->StatColumns.begin()));
+        }
+    }
+
+    this->States.resize(this->StatColumns.size());
+    this->RowWidth = (int)this->KeyColumns.size() + (this->bNullKeyFlags ? 1 : 0);
+    this->Table = std::make_unique<Kernels::GroupHashTable>(this->RowWidth, this->CurrentMode != ExecutionMode::SCALAR);
+}
+
+// A NULL int32 key, no int32 value widens to it
+static constexpr int64_t NullInt32Key = (int64_t)INT32_MAX + 1;
+
+// Copies key column KeyIndex of the selected rows into the row major key buffer, widened to int64
+template <typename T>
+static void WidenKeys(const T* Values, const int32_t* Selection, int64_t Count, int KeyIndex, int KeyWidth, int64_t* OutKeys)
+{
+    if (Selection != nullptr)
+    {
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            OutKeys[i * KeyWidth + KeyIndex] = (int64_t)Values[Selection[i]];
+        }
+    }
+    else
+    {
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            OutKeys[i * KeyWidth + KeyIndex] = (int64_t)Values[i];
+        }
+    }
+}
+
+// The null rows of key column KeyIndex after WidenKeys: an int32 key becomes NullInt32Key, an int64 one becomes 0
+// and sets bit KeyIndex of the row's null flags (its last word)
+static void MarkNullKeys(const arrow::ArrayData& Column, const int32_t* Selection, int64_t Count, int KeyIndex, int KeyWidth, int64_t* OutKeys)
+{
+    const uint8_t* Validity = Column.buffers[0]->data();
+    bool bInt64 = Column.type->id() == arrow::Type::INT64;
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        int64_t Row = Selection != nullptr ? Selection[i] : i;
+        if (Kernels::IsValid(Validity, Column.offset + Row))
+        {
+            continue;
+        }
+
+        int64_t* Key = OutKeys + i * KeyWidth;
+        if (bInt64)
+        {
+            Key[KeyIndex] = 0;
+            Key[KeyWidth - 1] |= int64_t(1) << KeyIndex;
+        }
+        else
+        {
+            Key[KeyIndex] = NullInt32Key;
+        }
+    }
+}
+
+// Dictionary codes of the selected rows as dense ids, a null row gets -1
+template <typename T>
+static void RemapKeys(const arrow::ArrayData& Codes, const int64_t* Remap, const int32_t* Selection, int64_t Count, int KeyIndex, int KeyWidth, int64_t* OutKeys)
+{
+    const T* Values = Codes.GetValues<T>(1);
+    const uint8_t* Validity = Codes.GetNullCount() > 0 ? Codes.buffers[0]->data() : nullptr;
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        int64_t Row = Selection != nullptr ? Selection[i] : i;
+        OutKeys[i * KeyWidth + KeyIndex] = Validity != nullptr && !Kernels::IsValid(Validity, Codes.offset + Row) ? -1 : Remap[Values[Row]];
+    }
+}
+
+// The strings are only hashed here, once per dictionary entry
+void HashAggregateOperator::RemapDictionary(DictionaryKey& Key, const std::shared_ptr<arrow::ArrayData>& Dictionary)
+{
+    if (Dictionary == nullptr || (Dictionary->type->id() != arrow::Type::STRING && Dictionary->type->id() != arrow::Type::BINARY))
+    {
+        throw std::runtime_error("HashAggregateOperator: dictionary key column must come with a string dictionary");
+    }
+
+    std::shared_ptr<arrow::Array> Values = arrow::MakeArray(Dictionary);
+    const arrow::BinaryArray& Strings = static_cast<const arrow::BinaryArray&>(*Values);
+
+    Key.Dictionary = Dictionary;
+    Key.Remap.resize(Dictionary->length);
+    for (int64_t Code = 0; Code < Dictionary->length; ++Code)
+    {
+        if (Strings.IsNull(Code))
+        {
+            Key.Remap[Code] = -1;
+            continue;
+        }
+
+        auto [It, bInserted] = Key.Ids.try_emplace(std::string(Strings.GetView(Code)), (int64_t)Key.Values.size());
+        if (bInserted)
+        {
+            Key.Values.push_back(It->first);
+        }
+        Key.Remap[Code] = It->second;
+    }
+}
+
+void HashAggregateOperator::Accumulate(const SelectedChunk& Chunk)
+{
+    const int64_t Count = Chunk.Count;
+    const int KeyWidth = this->RowWidth;
+
+    if ((int64_t)this->GroupIdBuffer.size() < Count)
+    {
+        this->KeyBuffer.resize(Count * KeyWidth);
+        this->GroupIdBuffer.resize(Count);
+    }
+
+    if (this->bNullKeyFlags)
+    {
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            this->KeyBuffer[i * KeyWidth + KeyWidth - 1] = 0;
+        }
+    }
+
+    for (int k = 0; k < (int)this->KeyColumns.size(); ++k)
+    {
+        const arrow::ArrayData& KeyData = *Chunk.Batch->column_data(this->KeyColumns[k]);
+        DictionaryKey& Key = this->DictionaryKeys[k];
+        if (Key.bDictionary)
+        {
+            if (KeyData.type->id() != arrow::Type::DICTIONARY)
+            {
+                throw std::runtime_error("HashAggregateOperator: key column '" + this->KeyColumnNames[k] + "' stopped being dictionary encoded");
+            }
+            if (KeyData.dictionary != Key.Dictionary)
+            {
+                this->RemapDictionary(Key, KeyData.dictionary);
+            }
+
+            const arrow::DataType& IndexType = *static_cast<const arrow::DictionaryType&>(*KeyData.type).index_type();
+            Kernels::VisitNumericType(IndexType.id(), [&](auto Tag)
+            {
+                using T = typename decltype(Tag)::Type;
+                if constexpr (std::is_integral_v<T>)
+                {
+                    RemapKeys<T>(KeyData, Key.Remap.data(), Chunk.Selection, Count, k, KeyWidth, this->KeyBuffer.data());
+                }
+            });
+        }
+        else
+        {
+            if (KeyData.type->id() == arrow::Type::INT32)
+            {
+                WidenKeys(KeyData.GetValues<int32_t>(1), Chunk.Selection, Count, k, KeyWidth, this->KeyBuffer.data());
+            }
+            else
+            {
+                WidenKeys(KeyData.GetValues<int64_t>(1), Chunk.Selection, Count, k, KeyWidth, this->KeyBuffer.data());
+            }
+
+            if (KeyData.GetNullCount() > 0)
+            {
+                if (KeyData.type->id() == arrow::Type::INT64 && !this->bNullKeyFlags)
+                {
+                    throw std::runtime_error("HashAggregateOperator: key column '" + this->KeyColumnNames[k] + "' is declared not null but has nulls");
+                }
+                MarkNullKeys(KeyData, Chunk.Selection, Count, k, KeyWidth, this->KeyBuffer.data());
+            }
+        }
+    }
+
+    // the whole batch gets its group ids first, the aggregate loops below then only chase those ids
+    const int32_t* GroupIds = this->GroupIdBuffer.data();
+    this->Table->FindOrInsert(this->KeyBuffer.data(), Count, this->GroupIdBuffer.data());
+
+    size_t NumGroups = (size_t)this->Table->NumGroups();
+    this->GroupRowCounts.resize(NumGroups, 0);
+    for (std::vector<GroupState>& SlotStates : this->States)
+    {
+        SlotStates.resize(NumGroups);
+    }
+
+    if (this->bMergingPartials)
+    {
+        this->MergeStates(Chunk, GroupIds);
+        return;
+    }
+
+    int64_t* RowCounts = this->GroupRowCounts.data();
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        ++RowCounts[GroupIds[i]];
+    }
+
+    for (size_t Slot = 0; Slot < this->StatColumns.size(); ++Slot)
+    {
+        const arrow::ArrayData& Column = *Chunk.Batch->column_data(this->StatColumns[Slot]);
+        const int32_t* Data = Column.GetValues<int32_t>(1);
+        const uint8_t* Validity = Column.GetNullCount() > 0 ? Column.buffers[0]->data() : nullptr;
+        GroupState* SlotStates = this->States[Slot].data();
+
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int64_t Row = Chunk.Selection != nullptr ? Chunk.Selection[i] : i;
+            // a null slot holds whatever bytes, it isn't a value
+            if (Validity != nullptr && !Kernels::IsValid(Validity, Column.offset + Row))
+            {
+                continue;
+            }
+
+            int32_t Value = Data[Row];
+            GroupState& State = SlotStates[GroupIds[i]];
+            State.Sum += Value;
+            State.Min = Value < State.Min ? Value : State.Min;
+            State.Max = Value > State.Max ? Value : State.Max;
+            ++State.Count;
+        }
+    }
+}
+
+// Every row of a partial is one group of one copy, its state is added to the group it has here
+void HashAggregateOperator::MergeStates(const SelectedChunk& Chunk, const int32_t* GroupIds)
+{
+    const int64_t Count = Chunk.Count;
+    auto Row = [&](int64_t i) { return Chunk.Selection != nullptr ? Chunk.Selection[i] : i; };
+
+    const int64_t* Rows = Chunk.Batch->column_data((int)this->KeyColumns.size())->GetValues<int64_t>(1);
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        this->GroupRowCounts[GroupIds[i]] += Rows[Row(i)];
+    }
+
+    for (size_t Slot = 0; Slot < this->StatColumns.size(); ++Slot)
+    {
+        const int64_t* Sums = Chunk.Batch->column_data(this->StatColumns[Slot])->GetValues<int64_t>(1);
+        const int32_t* Mins = Chunk.Batch->column_data(this->StatColumns[Slot] + 1)->GetValues<int32_t>(1);
+        const int32_t* Maxs = Chunk.Batch->column_data(this->StatColumns[Slot] + 2)->GetValues<int32_t>(1);
+        const int64_t* Counts = Chunk.Batch->column_data(this->StatColumns[Slot] + 3)->GetValues<int64_t>(1);
+        GroupState* SlotStates = this->States[Slot].data();
+
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            GroupState& State = SlotStates[GroupIds[i]];
+            State.Sum += Sums[Row(i)];
+            State.Min = std::min(State.Min, Mins[Row(i)]);
+            State.Max = std::max(State.Max, Maxs[Row(i)]);
+            State.Count += Counts[Row(i)];
+        }
+    }
+}
+
+DataChunk HashAggregateOperator::Next()
+{
+    if (this->bFinished)
+    {
+        return nullptr;
+    }
+
+    if (!this->bDrained)
+    {
+        bool bBound = false;
+        while (true)
+        {
+            SelectedChunk Chunk = this->ChildOperator->NextSelected();
+            if (Chunk.IsEnd())
+            {
+                break;
+            }
+
+            if (!bBound)
+            {
+                this->Bind(*Chunk.Batch->schema());
+                bBound = true;
+            }
+
+            this->Accumulate(Chunk);
+        }
+        this->bDrained = true;
+    }
+
+    // GROUP BY over no rows is no rows
+    int32_t NumGroups = this->Table ? this->Table->NumGroups() : 0;
+    if (this->EmittedGroups >= NumGroups)
+    {
+        this->bFinished = true;
+        return nullptr;
+    }
+
+    int32_t Count = std::min(OutputBatchSize, NumGroups - this->EmittedGroups);
+    DataChunk Result = this->bProducePartials ? this->BuildPartial(this->EmittedGroups, Count) : this->BuildResult(this->EmittedGroups, Count);
+    this->EmittedGroups += Count;
+    return Result;
+}
+
+void HashAggregateOperator::BuildKeys(int32_t FirstGroup, int32_t Count, bool bPartial, std::vector<std::shared_ptr<arrow::Field>>& Fields, std::vector<std::shared_ptr<arrow::Array>>& Columns) const
+{
+    const int KeyWidth = this->RowWidth;
+    const int64_t* GroupKeys = this->Table->Keys();
+
+    for (int k = 0; k < (int)this->KeyColumns.size(); ++k)
+    {
+        std::shared_ptr<arrow::Array> KeyArray;
+        std::shared_ptr<arrow::Field> KeyField = this->KeyFields[k];
+        if (this->DictionaryKeys[k].bDictionary && bPartial)
+        {
+            const std::vector<std::string>& Values = this->DictionaryKeys[k].Values;
+            arrow::BinaryBuilder DictionaryBuilder(KeyField->type(), this->Memory);
+            for (const std::string& Value : Values)
+            {
+                PARQUET_THROW_NOT_OK(DictionaryBuilder.Append(Value));
+            }
+            std::shared_ptr<arrow::Array> Dictionary;
+            PARQUET_THROW_NOT_OK(DictionaryBuilder.Finish(&Dictionary));
+
+            arrow::Int32Builder CodeBuilder(this->Memory);
+            PARQUET_THROW_NOT_OK(CodeBuilder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                int64_t Id = GroupKeys[(int64_t)g * KeyWidth + k];
+                if (Id < 0)
+                {
+                    CodeBuilder.UnsafeAppendNull();
+                }
+                else
+                {
+                    CodeBuilder.UnsafeAppend((int32_t)Id);
+                }
+            }
+            std::shared_ptr<arrow::Array> Codes;
+            PARQUET_THROW_NOT_OK(CodeBuilder.Finish(&Codes));
+
+            std::shared_ptr<arrow::DataType> Type = arrow::dictionary(arrow::int32(), KeyField->type());
+            arrow::Result<std::shared_ptr<arrow::Array>> ArrayResult = arrow::DictionaryArray::FromArrays(Type, Codes, Dictionary);
+            PARQUET_THROW_NOT_OK(ArrayResult.status());
+            KeyArray = ArrayResult.ValueOrDie();
+            KeyField = arrow::field(KeyField->name(), Type, KeyField->nullable());
+        }
+        else if (this->DictionaryKeys[k].bDictionary)
+        {
+            const std::vector<std::string>& Values = this->DictionaryKeys[k].Values;
+            arrow::BinaryBuilder Builder(this->KeyFields[k]->type(), this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                int64_t Id = GroupKeys[(int64_t)g * KeyWidth + k];
+                PARQUET_THROW_NOT_OK(Id < 0 ? Builder.AppendNull() : Builder.Append(Values[Id]));
+            }
+            PARQUET_THROW_NOT_OK(Builder.Finish(&KeyArray));
+        }
+        else if (this->KeyFields[k]->type()->id() == arrow::Type::INT32)
+        {
+            arrow::Int32Builder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                int64_t Key = GroupKeys[(int64_t)g * KeyWidth + k];
+                if (Key == NullInt32Key)
+                {
+                    Builder.UnsafeAppendNull();
+                }
+                else
+                {
+                    Builder.UnsafeAppend((int32_t)Key);
+                }
+            }
+            PARQUET_THROW_NOT_OK(Builder.Finish(&KeyArray));
+        }
+        else
+        {
+            arrow::Int64Builder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                const int64_t* Key = GroupKeys + (int64_t)g * KeyWidth;
+                if (this->bNullKeyFlags && (Key[KeyWidth - 1] >> k & 1) != 0)
+                {
+                    Builder.UnsafeAppendNull();
+                }
+                else
+                {
+                    Builder.UnsafeAppend(Key[k]);
+                }
+            }
+            PARQUET_THROW_NOT_OK(Builder.Finish(&KeyArray));
+        }
+
+        Fields.push_back(KeyField);
+        Columns.push_back(KeyArray);
+    }
+}
+
+DataChunk HashAggregateOperator::BuildPartial(int32_t FirstGroup, int32_t Count) const
+{
+    std::vector<std::shared_ptr<arrow::Field>> Fields;
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+    this->BuildKeys(FirstGroup, Count, true, Fields, Columns);
+
+    std::shared_ptr<arrow::Array> RowsArray;
+    arrow::Int64Builder RowsBuilder(this->Memory);
+    PARQUET_THROW_NOT_OK(RowsBuilder.AppendValues(this->GroupRowCounts.data() + FirstGroup, Count));
+    PARQUET_THROW_NOT_OK(RowsBuilder.Finish(&RowsArray));
+    Fields.push_back(arrow::field("rows", arrow::int64(), false));
+    Columns.push_back(RowsArray);
+
+    for (size_t i = 0; i < this->Aggregates.size(); ++i)
+    {
+        int Slot = this->AggregateSlots[i];
+        if (Slot < 0)
+        {
+            continue;
+        }
+
+        const GroupState* SlotStates = this->States[Slot].data();
+        arrow::Int64Builder SumBuilder(this->Memory);
+        arrow::Int32Builder MinBuilder(this->Memory);
+        arrow::Int32Builder MaxBuilder(this->Memory);
+        arrow::Int64Builder CountBuilder(this->Memory);
+        PARQUET_THROW_NOT_OK(SumBuilder.Resize(Count));
+        PARQUET_THROW_NOT_OK(MinBuilder.Resize(Count));
+        PARQUET_THROW_NOT_OK(MaxBuilder.Resize(Count));
+        PARQUET_THROW_NOT_OK(CountBuilder.Resize(Count));
+        for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+        {
+            SumBuilder.UnsafeAppend(SlotStates[g].Sum);
+            MinBuilder.UnsafeAppend(SlotStates[g].Min);
+            MaxBuilder.UnsafeAppend(SlotStates[g].Max);
+            CountBuilder.UnsafeAppend(SlotStates[g].Count);
+        }
+
+        const std::string& Name = this->Aggregates[i].OutputName;
+        Columns.emplace_back();
+        PARQUET_THROW_NOT_OK(SumBuilder.Finish(&Columns.back()));
+        Fields.push_back(arrow::field(Name, arrow::int64()));
+        Columns.emplace_back();
+        PARQUET_THROW_NOT_OK(MinBuilder.Finish(&Columns.back()));
+        Fields.push_back(arrow::field(Name + "_min", arrow::int32()));
+        Columns.emplace_back();
+        PARQUET_THROW_NOT_OK(MaxBuilder.Finish(&Columns.back()));
+        Fields.push_back(arrow::field(Name + "_max", arrow::int32()));
+        Columns.emplace_back();
+        PARQUET_THROW_NOT_OK(CountBuilder.Finish(&Columns.back()));
+        Fields.push_back(arrow::field(Name + "_count", arrow::int64(), false));
+    }
+
+    return arrow::RecordBatch::Make(arrow::schema(Fields), Count, std::move(Columns));
+}
+
+DataChunk HashAggregateOperator::BuildResult(int32_t FirstGroup, int32_t Count) const
+{
+    std::vector<std::shared_ptr<arrow::Field>> Fields;
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+    this->BuildKeys(FirstGroup, Count, false, Fields, Columns);
+
+    // like AggregateOperator, SUM/MIN/MAX/AVG of a group without a single non-null value are NULL
+    for (size_t i = 0; i < this->Aggregates.size(); ++i)
+    {
+        const AggregateSpec& Spec = this->Aggregates[i];
+        int Slot = this->AggregateSlots[i];
+        const GroupState* SlotStates = Slot >= 0 ? this->States[Slot].data() : nullptr;
+        std::shared_ptr<arrow::Array> ResultArray;
+
+        switch (Spec.Function)
+        {
+        case AggregateFunction::SUM:
+        {
+            arrow::Int64Builder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                if (SlotStates[g].Count == 0)
+                {
+                    Builder.UnsafeAppendNull();
+                }
+                else
+                {
+                    Builder.UnsafeAppend(SlotStates[g].Sum);
+                }
+            }
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Spec.OutputName, arrow::int64()));
+            break;
+        }
+        case AggregateFunction::MIN:
+        case AggregateFunction::MAX:
+        {
+            arrow::Int32Builder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                if (SlotStates[g].Count == 0)
+                {
+                    Builder.UnsafeAppendNull();
+                }
+                else
+                {
+                    Builder.UnsafeAppend(Spec.Function == AggregateFunction::MIN ? SlotStates[g].Min : SlotStates[g].Max);
+                }
+            }
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Spec.OutputName, arrow::int32()));
+            break;
+        }
+        case AggregateFunction::COUNT:
+        case AggregateFunction::COUNT_STAR:
+        {
+            // COUNT(x) only counts the non-null values of x, COUNT(*) every row of the group
+            arrow::Int64Builder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                Builder.UnsafeAppend(Spec.Function == AggregateFunction::COUNT ? SlotStates[g].Count : this->GroupRowCounts[g]);
+            }
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Spec.OutputName, arrow::int64(), false));
+            break;
+        }
+        case AggregateFunction::AVG:
+        {
+            arrow::DoubleBuilder Builder(this->Memory);
+            PARQUET_THROW_NOT_OK(Builder.Resize(Count));
+            for (int32_t g = FirstGroup; g < FirstGroup + Count; ++g)
+            {
+                if (SlotStates[g].Count == 0)
+                {
+                    Builder.UnsafeAppendNull();
+                }
+                else
+                {
+                    Builder.UnsafeAppend((double)SlotStates[g].Sum / (double)SlotStates[g].Count);
+                }
+            }
+            PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
+            Fields.push_back(arrow::field(Spec.OutputName, arrow::float64()));
+            break;
+        }
+        }
+
+        Columns.push_back(ResultArray);
+    }
+
+    return arrow::RecordBatch::Make(arrow::schema(Fields), Count, std::move(Columns));
+}
+
+bool HashAggregateOperator::FusePipelines()
+{
+    return this->ChildOperator->FusePipelines();
+}
+
+void HashAggregateOperator::Close()
+{
+    this->bFinished = true;
+    this->ChildOperator->Close();
+}
+
+void HashAggregateOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
+}
+
+std::vector<DataChunk> HashAggregateOperator::MergePartials(std::vector<DataChunk> Partials) const
+{
+    HashAggregateOperator Merge(std::make_unique<MemoryScanOperator>(Partials, this->CurrentMode), this->KeyColumnNames, this->Aggregates, this->CurrentMode);
+    Merge.bMergingPartials = true;
+    Merge.UseMemoryPool(this->Memory);
+
+    std::vector<DataChunk> Result;
+    while (DataChunk Chunk = Merge.Next())
+    {
+        Result.push_back(Chunk);
+    }
+    return Result;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "../Operator.h"
+#include "../Kernels/GroupHashTable.h"
+#include "AggregateOperator.h"
+#include <arrow/builder.h>
+#include <climits>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// SELECT k1, k2, SUM(x), MIN(x), ... GROUP BY k1, k2
+// Keys are int32 or int64 columns. Every batch is first mapped to group ids in one go (hash the batch, then probe),
+// then the aggregates are updated column by column through the group ids.
+// A single key column with a small range skips hashing entirely and indexes an array with the key (see GroupHashTable).
+// A dictionary encoded string key (ScanOptions::DictionaryColumns) is grouped by its codes: every new dictionary maps
+// its codes to dense ids once, the rows only look their code up, and the ids are small enough for the direct array.
+// Its output column holds the strings again. A NULL key (of any key type) is a group of its own.
+// Null values are skipped by every aggregate but COUNT(*), a group with nothing but nulls in a column gets NULL for
+// SUM/MIN/MAX/AVG of it and 0 for COUNT
+// Emits one row per group in the order the groups were first seen, key columns first, then one column per aggregate
+class HashAggregateOperator : public Operator
+{
+public:
+    HashAggregateOperator(std::unique_ptr<Operator> Child, std::vector<std::string> KeyColumns, std::vector<AggregateSpec> Aggregates, ExecutionMode Mode);
+
+    DataChunk Next() override;
+
+    // No fused kernels for the grouped loop, only passed on to the child
+    bool FusePipelines() override;
+
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    // The copies return their groups' running state (see BuildPartial), this runs one more HashAggregateOperator over
+    // all of them that groups by the same keys and adds the states up
+    std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const override;
+
+    void ProducePartials() override { this->bProducePartials = true; }
+
+private:
+    static constexpr int32_t OutputBatchSize = 64 * 1024;
+
+    // Running SUM/MIN/MAX/COUNT of the non-null values of one input column for one group
+    struct GroupState
+    {
+        long long Sum = 0;
+        int32_t Min = INT32_MAX;
+        int32_t Max = INT32_MIN;
+        int64_t Count = 0;
+    };
+
+    std::unique_ptr<Operator> ChildOperator;
+    std::vector<std::string> KeyColumnNames;
+    std::vector<AggregateSpec> Aggregates;
+
+    std::vector<int> KeyColumns; // resolved from KeyColumnNames by Bind
+    std::vector<std::shared_ptr<arrow::Field>> KeyFields; // of the output, dictionary keys come out as their values
+
+    // int64 values per group in the table: one per key column, then a word of null flags (bit k for key k) when a
+    // nullable int64 key needs one, that type has no value left over to stand for NULL
+    int RowWidth = 0;
+    bool bNullKeyFlags = false;
+
+    // Dense ids of the values of a dictionary key column, shared by every dictionary the column comes with
+    struct DictionaryKey
+    {
+        bool bDictionary = false;
+        std::unordered_map<std::string, int64_t> Ids;
+        std::vector<std::string> Values;             // [Id]
+        std::shared_ptr<arrow::ArrayData> Dictionary; // the one Remap was built for, held so no other shows up at its address
+        std::vector<int64_t> Remap;                  // [Code] = Id, -1 for a NULL value
+    };
+    std::vector<DictionaryKey> DictionaryKeys; // [k]
+
+    // Same sharing as AggregateOperator: one state per distinct input column,
+    // AggregateSlots[i] is the index into StatColumns that aggregate i reads (-1 for COUNT(*))
+    std::vector<int> StatColumns;
+    std::vector<int> AggregateSlots;
+
+    // Aggregate states live outside the hash table, indexed by group id
+    std::vector<std::vector<GroupState>> States; // [Slot][GroupId]
+    std::vector<int64_t> GroupRowCounts;         // [GroupId]
+
+    std::unique_ptr<Kernels::GroupHashTable> Table; // created by Bind once the number of key columns is known
+
+    // reused between batches
+    std::vector<int64_t> KeyBuffer;
+    std::vector<int32_t> GroupIdBuffer;
+
+    bool bDrained = false;
+    int32_t EmittedGroups = 0;
+
+    bool bProducePartials = false;
+    // the input is BuildPartial() batches of the copies instead of rows
+    bool bMergingPartials = false;
+
+    void Bind(const arrow::Schema& Schema);
+
+    void Accumulate(const SelectedChunk& Chunk);
+
+    // Accumulate() of a partial once its group ids are known
+    void MergeStates(const SelectedChunk& Chunk, const int32_t* GroupIds);
+
+    void RemapDictionary(DictionaryKey& Key, const std::shared_ptr<arrow::ArrayData>& Dictionary);
+
+    // Key columns of groups [FirstGroup, FirstGroup + Count). A partial keeps dictionary keys encoded:
+    // its ids as the codes and this copy's values as the dictionary, so the merge groups them like any dictionary
+    void BuildKeys(int32_t FirstGroup, int32_t Count, bool bPartial, std::vector<std::shared_ptr<arrow::Field>>& Fields, std::vector<std::shared_ptr<arrow::Array>>& Columns) const;
+
+    // rows [FirstGroup, FirstGroup + Count) of the result
+    DataChunk BuildResult(int32_t FirstGroup, int32_t Count) const;
+
+    // Same groups, but the keys, "rows" (the group's row count), then the sum, min, max and non-null count of every
+    // aggregate except COUNT(*), named after its output column
+    DataChunk BuildPartial(int32_t FirstGroup, int32_t Count) const;
+};
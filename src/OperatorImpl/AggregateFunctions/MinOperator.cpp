@@ -1,114 +1,250 @@
 #include "pch.h"
 #include "MinOperator.h"
-#include <immintrin.h>
+#include "../Kernels/TypedKernels.h"
+#include "../ScanPredicate.h"
 #include <algorithm>
+#include <stdexcept>
 
 MinOperator::MinOperator(std::unique_ptr<Operator> Child, ExecutionMode Mode)
     : Operator(Mode)
 {
     this->ChildOperator = std::move(Child);
     this->bFinished = false;
+
+    // only column(0) is looked at
+    this->ChildOperator->PushProjection({ ColumnRef::At(0) });
 }
 
-int32_t MinOperator::HMin256(__m256i v)
+// The kernels live in Kernels/TypedKernels.h (ExtremeScalar/Avx2/Avx512 with bMax = false).
+// Every type starts from the largest value it can hold (+inf for floats) so any real value is smaller
+template <typename T>
+DataChunk MinOperator::Drain(SelectedChunk Chunk)
 {
-    // split 256-bit into two 128-bit halves
-    __m128i lo128 = _mm256_castsi256_si128(v);
-    __m128i hi128 = _mm256_extracti128_si256(v, 1);
-
-    // find min between the two halves (element wise min)
-    __m128i min128 = _mm_min_epi32(lo128, hi128);
+    const std::shared_ptr<arrow::DataType> ColumnType = Chunk.Batch->column(0)->type();
+    const T Identity = Kernels::ValueTraits<T>::MinIdentity();
+    T GlobalMin = Identity;
 
-	// spread hi64 to all lanes
-    __m128i hi64 = _mm_unpackhi_epi64(min128, min128);
-	__m128i min64 = _mm_min_epi32(min128, hi64); // find the min between the two 64-bit halves
+    // a fused filter (see FusePipelines), same as in SumOperator::Drain
+    const Kernels::ConstantFit Fit = this->bFusedFilter ? Kernels::FitGreaterConstant<T>(this->FusedFilterValue) : Kernels::ConstantFit::ALL;
+    const T FilterValue = (T)this->FusedFilterValue;
 
-    
-    __m128i hi32 = _mm_shuffle_epi32(min64, _MM_SHUFFLE(1, 1, 1, 1)); // shuffle to all lanes
-    __m128i result = _mm_min_epi32(min64, hi32);
-
-	return _mm_cvtsi128_si32(result); // extract the lowest slot which contains the horizontal min
-}
+    // consume a filter's selection directly instead of a compacted batch
+    for (; !Chunk.IsEnd(); Chunk = this->ChildOperator->NextSelected())
+    {
+        const std::shared_ptr<arrow::Array>& Column = Chunk.Batch->column(0);
+        if (Column->type_id() != ColumnType->id())
+        {
+            throw std::runtime_error("MinOperator: column type changed to " + Column->type()->ToString());
+        }
 
-int32_t MinOperator::CalculateAvxMin(const int32_t* Data, int64_t Length)
-{
-    // Initialize with INT_MAX so any real number is smaller
-    __m256i MinVector = _mm256_set1_epi32(INT_MAX);
-    int64_t i = 0;
+        if (Fit == Kernels::ConstantFit::NONE)
+        {
+            continue;
+        }
 
-    for (; i <= Length - 8; i += 8)
-    {
-        __m256i DataVector = _mm256_loadu_si256((__m256i*)(Data + i));
-        // element wise minimum
-        MinVector = _mm256_min_epi32(MinVector, DataVector);
-    }
+        const T* RawValues = Column->data()->GetValues<T>(1);
+        const uint8_t* Validity = Column->null_count() > 0 ? Column->null_bitmap_data() : nullptr;
+        T BatchMin;
 
-	// horizontal reduction to get the minimum value from the vector
-    int32_t GlobalMin = this->HMin256(MinVector);
+        if (Fit == Kernels::ConstantFit::COMPARE && !Chunk.HasSelection())
+        {
+            // the fused loop: the rows that fail the compare become the identity before the min
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                BatchMin = Validity != nullptr
+                    ? Kernels::FilterExtremeAvx512<T, false, true>(RawValues, Column->length(), FilterValue, Validity, Column->offset())
+                    : Kernels::FilterExtremeAvx512<T, false>(RawValues, Column->length(), FilterValue);
+                break;
+            case ExecutionMode::AVX2:
+                BatchMin = Validity != nullptr
+                    ? Kernels::FilterExtremeAvx2<T, false, true>(RawValues, Column->length(), FilterValue, Validity, Column->offset())
+                    : Kernels::FilterExtremeAvx2<T, false>(RawValues, Column->length(), FilterValue);
+                break;
+            default:
+                BatchMin = Validity != nullptr
+                    ? Kernels::FilterExtremeScalar<T, false, true>(RawValues, Column->length(), FilterValue, Identity, Validity, Column->offset())
+                    : Kernels::FilterExtremeScalar<T, false>(RawValues, Column->length(), FilterValue, Identity);
+                break;
+            }
+        }
+        else if (Chunk.HasSelection())
+        {
+            const int32_t* Selection = Chunk.Selection;
+            int64_t Count = Chunk.Count;
+            if ((int64_t)this->SelectionBuffer.size() < Count + 16)
+            {
+                this->SelectionBuffer.resize(Count + 16);
+            }
+
+            // rows the child already selected still have to pass the fused filter
+            if (Fit == Kernels::ConstantFit::COMPARE)
+            {
+                switch (this->CurrentMode)
+                {
+                case ExecutionMode::AVX512: Count = Kernels::RefineGreaterAvx512(RawValues, Selection, Count, FilterValue, this->SelectionBuffer.data()); break;
+                case ExecutionMode::AVX2: Count = Kernels::RefineGreaterAvx2(RawValues, Selection, Count, FilterValue, this->SelectionBuffer.data()); break;
+                default: Count = Kernels::RefineGreaterScalar(RawValues, Selection, Count, FilterValue, this->SelectionBuffer.data()); break;
+                }
+                Selection = this->SelectionBuffer.data();
+            }
+
+            // a null is never the min, take them out of the selection first
+            if (Validity != nullptr)
+            {
+                Count = Kernels::DropNulls(Validity, Column->offset(), Selection, Count, this->SelectionBuffer.data());
+                Selection = this->SelectionBuffer.data();
+            }
+
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                BatchMin = Kernels::ExtremeSelectedAvx512<T, false>(RawValues, Selection, Count);
+                break;
+            case ExecutionMode::AVX2:
+                BatchMin = Kernels::ExtremeSelectedAvx2<T, false>(RawValues, Selection, Count);
+                break;
+            default:
+                BatchMin = Kernels::ExtremeScalar<T, false>(RawValues, Selection, Count, Identity);
+                break;
+            }
+        }
+        else if (Validity != nullptr)
+        {
+            // the null lanes are replaced by the identity, they can't be smaller than anything
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                BatchMin = Kernels::ExtremeAvx512<T, false, true>(RawValues, Column->length(), Validity, Column->offset());
+                break;
+            case ExecutionMode::AVX2:
+                BatchMin = Kernels::ExtremeAvx2<T, false, true>(RawValues, Column->length(), Validity, Column->offset());
+                break;
+            default:
+                BatchMin = Kernels::ExtremeScalar<T, false, true>(RawValues, nullptr, Column->length(), Identity, Validity, Column->offset());
+                break;
+            }
+        }
+        else
+        {
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                BatchMin = Kernels::ExtremeAvx512<T, false>(RawValues, Column->length());
+                break;
+            case ExecutionMode::AVX2:
+                BatchMin = Kernels::ExtremeAvx2<T, false>(RawValues, Column->length());
+                break;
+            default:
+                BatchMin = Kernels::ExtremeScalar<T, false>(RawValues, nullptr, Column->length(), Identity);
+                break;
+            }
+        }
 
-    // scalar cleanup
-    for (; i < Length; ++i)
-    {
-        if (Data[i] < GlobalMin)
+        if (BatchMin < GlobalMin)
         {
-            GlobalMin = Data[i];
+            GlobalMin = BatchMin;
         }
     }
 
-    return GlobalMin;
+    return MakeResult(ColumnType, GlobalMin);
 }
 
-int32_t MinOperator::CalculateScalarMin(const int32_t* Data, int64_t Length)
+// MIN(x) over "x > C" becomes one loop, the filter's child is read directly
+bool MinOperator::FusePipelines()
 {
-    int32_t MinVal = INT_MAX;
-    for (int64_t i = 0; i < Length; ++i)
+    bool bFused = this->ChildOperator->FusePipelines();
+
+    ScanPredicate Predicate;
+    std::unique_ptr<Operator> FilterInput = this->ChildOperator->ReleaseFilterForFusion(ColumnRef::At(0), Predicate);
+    if (FilterInput == nullptr)
     {
-        if (Data[i] < MinVal)
-        {
-            MinVal = Data[i];
-        }
+        return bFused;
     }
-    return MinVal;
+
+    this->ChildOperator = std::move(FilterInput);
+    this->bFusedFilter = true;
+    this->FusedFilterValue = Predicate.Low;
+    return true;
+}
+
+void MinOperator::Close()
+{
+    this->bFinished = true;
+    this->ChildOperator->Close();
+}
+
+void MinOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
 }
 
 DataChunk MinOperator::Next()
 {
     if (this->bFinished) return nullptr;
 
-    int32_t GlobalMin = INT_MAX;
+    this->bFinished = true;
 
-    while (true)
+    SelectedChunk First = this->ChildOperator->NextSelected();
+    if (First.IsEnd())
     {
-        DataChunk Chunk = this->ChildOperator->Next();
-        if (Chunk == nullptr) break;
+        return MakeResult<int32_t>(arrow::int32(), INT_MAX);
+    }
 
-        std::shared_ptr<arrow::Int32Array> Column = std::static_pointer_cast<arrow::Int32Array>(Chunk->column(0));
-        const int32_t* RawValues = Column->raw_values();
-        int32_t BatchMin;
+    // the one place the column type is looked at, the whole input runs through one instantiation
+    const std::shared_ptr<arrow::DataType>& ColumnType = First.Batch->column(0)->type();
+    DataChunk Result;
+    bool bSupported = Kernels::VisitNumericType(ColumnType->id(), [&](auto Tag)
+    {
+        Result = this->Drain<typename decltype(Tag)::Type>(std::move(First));
+    });
 
-        if (this->CurrentMode == ExecutionMode::AVX2)
-        {
-            BatchMin = this->CalculateAvxMin(RawValues, Column->length());
-        }
-        else
-        {
-            BatchMin = this->CalculateScalarMin(RawValues, Column->length());
-        }
+    if (!bSupported)
+    {
+        throw std::runtime_error("MinOperator: can't take the min of a column of " + ColumnType->ToString());
+    }
+    return Result;
+}
 
-        if (BatchMin < GlobalMin)
+template <typename T>
+DataChunk MinOperator::MakeResult(const std::shared_ptr<arrow::DataType>& Type, T Min) const
+{
+    arrow::Result<std::shared_ptr<arrow::Scalar>> MinScalar = arrow::MakeScalar(Type, Min);
+    PARQUET_THROW_NOT_OK(MinScalar.status());
+    arrow::Result<std::shared_ptr<arrow::Array>> ResultArray = arrow::MakeArrayFromScalar(*MinScalar.ValueOrDie(), 1, this->Memory);
+    PARQUET_THROW_NOT_OK(ResultArray.status());
+
+    auto ResultSchema = arrow::schema({ arrow::field("min", Type) });
+    return arrow::RecordBatch::Make(ResultSchema, 1, { ResultArray.ValueOrDie() });
+}
+
+// A worker that got no rows reports an int32 INT_MAX whatever the column was, which never wins.
+// If the other partials have another type those are the ones that count
+std::vector<DataChunk> MinOperator::MergePartials(std::vector<DataChunk> Partials) const
+{
+    std::shared_ptr<arrow::DataType> ResultType = arrow::int32();
+    for (const DataChunk& Partial : Partials)
+    {
+        if (Partial->column(0)->type_id() != arrow::Type::INT32)
         {
-            GlobalMin = BatchMin;
+            ResultType = Partial->column(0)->type();
         }
     }
 
-    this->bFinished = true;
-
-    // Return result
-    arrow::Int32Builder Builder;
-    PARQUET_THROW_NOT_OK(Builder.Append(GlobalMin));
-    std::shared_ptr<arrow::Array> ResultArray;
-    PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
-
-    auto ResultSchema = arrow::schema({ arrow::field("min", arrow::int32()) });
-    return arrow::RecordBatch::Make(ResultSchema, 1, { ResultArray });
-}
\ No newline at end of file
+    std::vector<DataChunk> Merged;
+    Kernels::VisitNumericType(ResultType->id(), [&](auto Tag)
+    {
+        using T = typename decltype(Tag)::Type;
+        T GlobalMin = Kernels::ValueTraits<T>::MinIdentity();
+        for (const DataChunk& Partial : Partials)
+        {
+            if (Partial->column(0)->type_id() == ResultType->id())
+            {
+                GlobalMin = std::min(GlobalMin, Partial->column(0)->data()->GetValues<T>(1)[0]);
+            }
+        }
+        Merged.push_back(MakeResult(ResultType, GlobalMin));
+    });
+    return Merged;
+}
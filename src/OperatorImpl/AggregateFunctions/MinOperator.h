@@ -6,15 +6,35 @@
 class MinOperator : public Operator
 {
 public:
+    // column(0) can be any fixed width number type, dates and timestamps included
     MinOperator(std::unique_ptr<Operator> Child, ExecutionMode Mode);
     DataChunk Next() override;
 
+    // Takes over a filter right below us when it compares column(0), see Drain
+    bool FusePipelines() override;
+
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    // Smallest of the one row results of the partial copies
+    std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const override;
+
 private:
     std::unique_ptr<Operator> ChildOperator;
 
-    int32_t CalculateAvxMin(const int32_t* Data, int64_t Length);
-    int32_t CalculateScalarMin(const int32_t* Data, int64_t Length);
+    // the result keeps the type of the column (an int8 column has an int8 min, a timestamp column a timestamp)
+    template <typename T>
+    DataChunk MakeResult(const std::shared_ptr<arrow::DataType>& Type, T Min) const;
+
+    // Smallest value of Chunk and every chunk after it, T is the C type of column(0)
+    template <typename T>
+    DataChunk Drain(SelectedChunk Chunk);
+
+    // set by FusePipelines: only the rows with column(0) > FusedFilterValue are looked at
+    bool bFusedFilter = false;
+    int64_t FusedFilterValue = 0;
 
-    // Horizontal Min Helper
-    int32_t HMin256(__m256i V);
+    // the rows of the child's selection that pass the fused filter and aren't null
+    std::vector<int32_t> SelectionBuffer;
 };
\ No newline at end of file
@@ -1,68 +1,170 @@
 #include "pch.h"
 #include "SumOperator.h"
-#include <immintrin.h>
-
-
-
-// returns the horizontal sum of a 256-bit register containing 8 int32_t values
-int32_t SumOperator::HSum256(__m256i v)
+#include "../Kernels/TypedKernels.h"
+#include "../ScanPredicate.h"
+#include <stdexcept>
+
+// The kernels live in Kernels/TypedKernels.h, one template for every column type:
+// 8/16 bit values are added with vpsadbw/vpmaddwd, 32 bit ones widened to 64 bit before the add,
+// floats widened to double. Every accumulator is 64 bit wide, no column gets anywhere near overflowing it.
+// Null rows count as nothing, a column where every row is null adds up to 0
+template <typename T>
+DataChunk SumOperator::Drain(SelectedChunk Chunk)
 {
-	// split the 256-bit vector into two 128-bit halves
-    __m128i lo128 = _mm256_castsi256_si128(v);
-    __m128i hi128 = _mm256_extracti128_si256(v, 1);
+    using SumType = typename Kernels::ValueTraits<T>::SumType;
+    const arrow::Type::type ColumnType = Chunk.Batch->column(0)->type_id();
+    SumType GrandTotal = 0;
 
-    // add high and low 128 bits together
-    __m128i sum128 = _mm_add_epi32(lo128, hi128);
+    // x > FusedFilterValue of a filter we took over (see FusePipelines). ALL when there is none,
+    // a constant the type can't hold passes every row or none like in FilterOperator
+    const Kernels::ConstantFit Fit = this->bFusedFilter ? Kernels::FitGreaterConstant<T>(this->FusedFilterValue) : Kernels::ConstantFit::ALL;
+    const T FilterValue = (T)this->FusedFilterValue;
 
-    // [ A, B, C, D ] -> [ C, D, C, D ]
-    __m128i hi64 = _mm_unpackhi_epi64(sum128, sum128);
+    // ask for the selection instead of a compacted batch, that way a filter below us doesn't copy anything
+    for (; !Chunk.IsEnd(); Chunk = this->ChildOperator->NextSelected())
+    {
+        const std::shared_ptr<arrow::Array>& Column = Chunk.Batch->column(0);
+        if (Column->type_id() != ColumnType)
+        {
+            throw std::runtime_error("SumOperator: column type changed to " + Column->type()->ToString());
+        }
 
-    //   [ A, B, C, D ]
-    // + [ C, D, C, D ]
-	// = [ A+C, B+D, C+C, D+D ] Only the first 2 are useful
-    __m128i sum64 = _mm_add_epi32(sum128, hi64);
+        if (Fit == Kernels::ConstantFit::NONE)
+        {
+            continue;
+        }
 
-    __m128i hi32 = _mm_shuffle_epi32(sum64, _MM_SHUFFLE(1, 1, 1, 1)); // shuffle the value of index 1 to all positions
-	__m128i result = _mm_add_epi32(sum64, hi32); // add them together
+        const T* RawValues = Column->data()->GetValues<T>(1);
+        const uint8_t* Validity = Column->null_count() > 0 ? Column->null_bitmap_data() : nullptr;
 
-	return _mm_cvtsi128_si32(result); // result is in idx 0. Extract the lowest slot with cvtsi128_si32
+        if (Fit == Kernels::ConstantFit::COMPARE && !Chunk.HasSelection())
+        {
+            // the fused loop: compare, mask and add in one pass, no selection vector in between
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                GrandTotal += Validity != nullptr
+                    ? Kernels::FilterSumAvx512<T, true>(RawValues, Column->length(), FilterValue, Validity, Column->offset())
+                    : Kernels::FilterSumAvx512<T>(RawValues, Column->length(), FilterValue);
+                break;
+            case ExecutionMode::AVX2:
+                GrandTotal += Validity != nullptr
+                    ? Kernels::FilterSumAvx2<T, true>(RawValues, Column->length(), FilterValue, Validity, Column->offset())
+                    : Kernels::FilterSumAvx2<T>(RawValues, Column->length(), FilterValue);
+                break;
+            default:
+                GrandTotal += Validity != nullptr
+                    ? Kernels::FilterSumScalar<T, true>(RawValues, Column->length(), FilterValue, Validity, Column->offset())
+                    : Kernels::FilterSumScalar<T>(RawValues, Column->length(), FilterValue);
+                break;
+            }
+        }
+        else if (Chunk.HasSelection())
+        {
+            const int32_t* Selection = Chunk.Selection;
+            int64_t Count = Chunk.Count;
+            if ((int64_t)this->SelectionBuffer.size() < Count + 16)
+            {
+                this->SelectionBuffer.resize(Count + 16);
+            }
+
+            // the child already filtered (a second filter or runtime filters below the fused one), re-check its rows
+            if (Fit == Kernels::ConstantFit::COMPARE)
+            {
+                switch (this->CurrentMode)
+                {
+                case ExecutionMode::AVX512: Count = Kernels::RefineGreaterAvx512(RawValues, Selection, Count, FilterValue, this->SelectionBuffer.data()); break;
+                case ExecutionMode::AVX2: Count = Kernels::RefineGreaterAvx2(RawValues, Selection, Count, FilterValue, this->SelectionBuffer.data()); break;
+                default: Count = Kernels::RefineGreaterScalar(RawValues, Selection, Count, FilterValue, this->SelectionBuffer.data()); break;
+                }
+                Selection = this->SelectionBuffer.data();
+            }
+
+            // nulls add nothing, take them out of the selection and the kernels below never see one
+            if (Validity != nullptr)
+            {
+                Count = Kernels::DropNulls(Validity, Column->offset(), Selection, Count, this->SelectionBuffer.data());
+                Selection = this->SelectionBuffer.data();
+            }
+
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                GrandTotal += Kernels::SumSelectedAvx512(RawValues, Selection, Count);
+                break;
+            case ExecutionMode::AVX2:
+                GrandTotal += Kernels::SumSelectedAvx2(RawValues, Selection, Count);
+                break;
+            default:
+                GrandTotal += Kernels::SumScalar(RawValues, Selection, Count);
+                break;
+            }
+        }
+        else if (Validity != nullptr)
+        {
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                GrandTotal += Kernels::SumAvx512<T, true>(RawValues, Column->length(), Validity, Column->offset());
+                break;
+            case ExecutionMode::AVX2:
+                GrandTotal += Kernels::SumAvx2<T, true>(RawValues, Column->length(), Validity, Column->offset());
+                break;
+            default:
+                GrandTotal += Kernels::SumScalar<T, true>(RawValues, nullptr, Column->length(), Validity, Column->offset());
+                break;
+            }
+        }
+        else
+        {
+            switch (this->CurrentMode)
+            {
+            case ExecutionMode::AVX512:
+                GrandTotal += Kernels::SumAvx512(RawValues, Column->length());
+                break;
+            case ExecutionMode::AVX2:
+                GrandTotal += Kernels::SumAvx2(RawValues, Column->length());
+                break;
+            default:
+                GrandTotal += Kernels::SumScalar(RawValues, nullptr, Column->length());
+                break;
+            }
+        }
+    }
+
+    return MakeResult(GrandTotal);
 }
 
-long long SumOperator::CalculateAvx2Sum(const int32_t* Data, int64_t Length)
+// SUM(x) over "x > C" becomes one loop, the filter's child is read directly
+bool SumOperator::FusePipelines()
 {
-    // Initialize a vector of zeros [0, 0, 0, 0, 0, 0, 0, 0]
-    __m256i SumVector = _mm256_setzero_si256();
+    bool bFused = this->ChildOperator->FusePipelines();
 
-    int64_t i = 0;
-    // process in batches of 8 and iteratively add to SumVector (128 bit vector addition)
-    for (; i <= Length - 8; i += 8)
+    ScanPredicate Predicate;
+    std::unique_ptr<Operator> FilterInput = this->ChildOperator->ReleaseFilterForFusion(ColumnRef::At(0), Predicate);
+    if (FilterInput == nullptr)
     {
-        __m256i DataVector = _mm256_loadu_si256((__m256i*)(Data + i));
-        // perform element wise vector addition
-        SumVector = _mm256_add_epi32(SumVector, DataVector);
+        return bFused;
     }
 
-	// reduce the final vector to a single scalar sum
-    long long TotalSum = this->HSum256(SumVector);
-
-    for (; i < Length; ++i)
-    {
-        TotalSum += Data[i];
-    }
+    this->ChildOperator = std::move(FilterInput);
+    this->bFusedFilter = true;
+    this->FusedFilterValue = Predicate.Low;
+    return true;
+}
 
-    return TotalSum;
+void SumOperator::Close()
+{
+    this->bFinished = true;
+    this->ChildOperator->Close();
 }
 
-long long SumOperator::CalculateScalarSum(const int32_t* Data, int64_t Length)
+void SumOperator::UseMemoryPool(arrow::MemoryPool* Pool)
 {
-    long long Sum = 0;
-    // Standard sequential accumulation
-    for (int64_t i = 0; i < Length; ++i)
-    {
-        Sum += Data[i];
-    }
-    return Sum;
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
 }
+
 DataChunk SumOperator::Next()
 {
     if (this->bFinished)
@@ -70,38 +172,73 @@ DataChunk SumOperator::Next()
         return nullptr;
     }
 
-    long long GrandTotal = 0;
+    this->bFinished = true;
 
-    
-    while (true)
+    SelectedChunk First = this->ChildOperator->NextSelected();
+    if (First.IsEnd())
     {
-        DataChunk Chunk = this->ChildOperator->Next();
-        if (Chunk == nullptr)
-        {
-            break;
-        }
+        return MakeResult<int64_t>(0);
+    }
 
-        std::shared_ptr<arrow::Int32Array> Column = std::static_pointer_cast<arrow::Int32Array>(Chunk->column(0));
-        const int32_t* RawValues = Column->raw_values();
+    // the one place the column type is looked at, the whole input runs through one instantiation
+    const std::shared_ptr<arrow::DataType>& ColumnType = First.Batch->column(0)->type();
+    DataChunk Result;
+    bool bSupported = arrow::is_numeric(ColumnType->id()) && Kernels::VisitNumericType(ColumnType->id(), [&](auto Tag)
+    {
+        Result = this->Drain<typename decltype(Tag)::Type>(std::move(First));
+    });
 
-        if (this->CurrentMode == ExecutionMode::AVX2)
-        {
-            GrandTotal += this->CalculateAvx2Sum(RawValues, Column->length());
-        }
-        else
-        {
-            GrandTotal += this->CalculateScalarSum(RawValues, Column->length());
-        }
+    if (!bSupported)
+    {
+        throw std::runtime_error("SumOperator: can't add up a column of " + ColumnType->ToString());
     }
+    return Result;
+}
 
-    this->bFinished = true;
-
+template <typename SumType>
+DataChunk SumOperator::MakeResult(SumType Sum) const
+{
     // Return single row result
-    arrow::Int64Builder Builder;
-    PARQUET_THROW_NOT_OK(Builder.Append(GrandTotal));
+    typename arrow::CTypeTraits<SumType>::BuilderType Builder(this->Memory);
+    PARQUET_THROW_NOT_OK(Builder.Append(Sum));
     std::shared_ptr<arrow::Array> ResultArray;
     PARQUET_THROW_NOT_OK(Builder.Finish(&ResultArray));
 
-    auto ResultSchema = arrow::schema({ arrow::field("sum", arrow::int64()) });
+    auto ResultSchema = arrow::schema({ arrow::field("sum", arrow::CTypeTraits<SumType>::type_singleton()) });
     return arrow::RecordBatch::Make(ResultSchema, 1, { ResultArray });
-}
\ No newline at end of file
+}
+
+// A worker that got no rows reports an int64 0 whatever the column was,
+// so the type of the result comes from the partials of another type if there are any
+std::vector<DataChunk> SumOperator::MergePartials(std::vector<DataChunk> Partials) const
+{
+    arrow::Type::type ResultType = arrow::Type::INT64;
+    for (const DataChunk& Partial : Partials)
+    {
+        if (Partial->column(0)->type_id() != arrow::Type::INT64)
+        {
+            ResultType = Partial->column(0)->type_id();
+        }
+    }
+
+    auto Merge = [&](auto Zero)
+    {
+        using SumType = decltype(Zero);
+        SumType GrandTotal = Zero;
+        for (const DataChunk& Partial : Partials)
+        {
+            if (Partial->column(0)->type_id() == ResultType)
+            {
+                GrandTotal += Partial->column(0)->data()->GetValues<SumType>(1)[0];
+            }
+        }
+        return MakeResult(GrandTotal);
+    };
+
+    switch (ResultType)
+    {
+    case arrow::Type::UINT64: return { Merge((uint64_t)0) };
+    case arrow::Type::DOUBLE: return { Merge(0.0) };
+    default: return { Merge((int64_t)0) };
+    }
+}
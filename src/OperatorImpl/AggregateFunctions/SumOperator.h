@@ -7,22 +7,46 @@ class SumOperator : public Operator
 public:
 
 	// Child operator here is typically a ScanOperator (I/O bound) or MemoryScanOperator
+    // column(0) can be any integer or floating point type, see MakeResult for the type of the sum
     SumOperator(std::unique_ptr<Operator> child, ExecutionMode mode)
         : Operator(mode)
     {
         this->ChildOperator = std::move(child);
         this->bFinished = false;
+
+        // we only ever add up column(0)
+        this->ChildOperator->PushProjection({ ColumnRef::At(0) });
     }
 
 
     DataChunk Next() override;
 
+    // Takes over a filter right below us when it compares column(0), see Drain
+    bool FusePipelines() override;
+
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    // Adds up the one row results of the partial copies
+    std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const override;
+
 private:
     std::unique_ptr<Operator> ChildOperator;
 
-    long long CalculateAvx2Sum(const int32_t* Data, int64_t Length);
-    long long CalculateScalarSum(const int32_t* Data, int64_t Length);
+    // int64 for signed integers, uint64 for unsigned ones, double for float/double
+    template <typename SumType>
+    DataChunk MakeResult(SumType Sum) const;
+
+    // Adds up Chunk and every chunk after it, T is the C type of column(0). The type is only looked at once,
+    // for the first chunk, every chunk after that has to have the same one
+    template <typename T>
+    DataChunk Drain(SelectedChunk Chunk);
+
+    // set by FusePipelines: only the rows with column(0) > FusedFilterValue are added up
+    bool bFusedFilter = false;
+    int64_t FusedFilterValue = 0;
 
-	// returns the horizontal sum of a 256-bit register containing 8 int32_t values
-    int32_t HSum256(__m256i V);
+    // the rows of the child's selection that pass the fused filter and aren't null
+    std::vector<int32_t> SelectionBuffer;
 };
\ No newline at end of file
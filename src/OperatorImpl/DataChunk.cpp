@@ -0,0 +1,21 @@
+#include "pch.h"
+#include "DataChunk.h"
+#include "Kernels/Gather.h"
+
+DataChunk SelectedChunk::Materialize(arrow::MemoryPool* Pool, ChunkBufferPool* Recycler) const
+{
+    if (this->Batch == nullptr || this->Selection == nullptr)
+    {
+        return this->Batch;
+    }
+
+    // the same selection is applied to every column so the rows stay together
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+    Columns.reserve(this->Batch->num_columns());
+    for (int c = 0; c < this->Batch->num_columns(); ++c)
+    {
+        Columns.push_back(Kernels::GatherArray(*this->Batch->column(c), this->Selection, this->Count, Pool, Recycler));
+    }
+
+    return arrow::RecordBatch::Make(this->Batch->schema(), this->Count, std::move(Columns));
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include <arrow/record_batch.h>
+#include <arrow/memory_pool.h>
+
+class ChunkBufferPool;
+
+// a "vector" or batch of rows instead of just 1 row
+using DataChunk = std::shared_ptr<arrow::RecordBatch>;
+
+// A batch that went through a filter but was never compacted.
+// Instead of copying the survivors into a new batch we hand out the original batch
+// together with the row indices that passed (a selection vector).
+// Consumers such as SumOperator/MinOperator read the rows through the selection directly,
+// only the root of the plan (or whoever really needs a compact batch) calls Materialize().
+struct SelectedChunk
+{
+    DataChunk Batch; // untouched input batch, nullptr once the stream is exhausted
+
+    // Indices into Batch of the rows that are still alive, sorted ascending.
+    // nullptr means every row of Batch is alive.
+    // The memory is owned by the operator that produced it and is only valid until its next call
+    const int32_t* Selection = nullptr;
+
+    int64_t Count = 0; // number of live rows
+
+    SelectedChunk() = default;
+
+    // every row of the batch is alive
+    explicit SelectedChunk(DataChunk InBatch)
+        : Batch(std::move(InBatch)), Count(Batch ? Batch->num_rows() : 0)
+    {
+    }
+
+    SelectedChunk(DataChunk InBatch, const int32_t* InSelection, int64_t InCount)
+        : Batch(std::move(InBatch)), Selection(InSelection), Count(InCount)
+    {
+    }
+
+    bool IsEnd() const { return Batch == nullptr; }
+    bool HasSelection() const { return Selection != nullptr; }
+
+    // Builds a compact batch holding only the selected rows.
+    // Returns the batch as is when there is no selection and nullptr at the end of the stream.
+    // Operators pass their Operator::Memory so the copy lands in the query's pool, and a Recycler to write it into
+    // the buffers of batches that were already released
+    DataChunk Materialize(arrow::MemoryPool* Pool = arrow::default_memory_pool(), ChunkBufferPool* Recycler = nullptr) const;
+};
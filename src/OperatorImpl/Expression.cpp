@@ -0,0 +1,766 @@
+#include "pch.h"
+#include "Expression.h"
+#include "Kernels/Arithmetic.h"
+#include "Kernels/Predicates.h"
+#include "Kernels/TypedKernels.h"
+#include "../Execution/ChunkBufferPool.h"
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <stdexcept>
+
+std::vector<ColumnRef> Expression::Columns() const
+{
+    std::vector<ColumnRef> Refs;
+    if (this->Type == Kind::COLUMN)
+    {
+        Refs.push_back(this->Column);
+    }
+    if (this->Type == Kind::CASE)
+    {
+        Refs = this->When.Columns();
+    }
+    for (const Expression& Child : this->Children)
+    {
+        std::vector<ColumnRef> ChildRefs = Child.Columns();
+        Refs.insert(Refs.end(), ChildRefs.begin(), ChildRefs.end());
+    }
+    return Refs;
+}
+
+struct CompiledProjection::Step
+{
+    // An input of a kernel: a slot written by an earlier step, a column of the batch or a constant
+    struct Operand
+    {
+        int Slot = -1;
+        int Column = -1;
+        int ByteWidth = 8;     // of the column's values, to move past the slice offset
+        uint64_t Constant = 0; // bit pattern of the INT64 / DOUBLE, the kernels read it as a one element column
+    };
+
+    // Bits is the condition of a CASE, nullptr for the other kernels
+    using Kernel = void (*)(const uint64_t* Bits, const void* A, const void* B, int64_t Length, void* Out);
+
+    Kernel Run = nullptr;
+    Operand A;
+    Operand B;
+    int Condition = -1; // CASE only, index into Conditions
+    int Out = -1;
+};
+
+namespace
+{
+    using Step = CompiledProjection::Step;
+
+    // The kernels behind one function pointer type, one instantiation per op, type, constant side and mode
+    template <ArithmeticOp Op, typename T, bool bConstA, bool bConstB, ExecutionMode Mode>
+    void RunArithmetic(const uint64_t* Bits, const void* A, const void* B, int64_t Length, void* Out)
+    {
+        if constexpr (Mode == ExecutionMode::AVX512) Kernels::ArithmeticAvx512<Op, T, bConstA, bConstB>((const T*)A, (const T*)B, Length, (T*)Out);
+        else if constexpr (Mode == ExecutionMode::AVX2) Kernels::ArithmeticAvx2<Op, T, bConstA, bConstB>((const T*)A, (const T*)B, Length, (T*)Out);
+        else Kernels::ArithmeticScalar<Op, T, bConstA, bConstB>((const T*)A, (const T*)B, Length, (T*)Out);
+    }
+
+    template <typename From, typename To, ExecutionMode Mode>
+    void RunConvert(const uint64_t* Bits, const void* A, const void* B, int64_t Length, void* Out)
+    {
+        if constexpr (Mode == ExecutionMode::AVX512) Kernels::ConvertAvx512((const From*)A, Length, (To*)Out);
+        else if constexpr (Mode == ExecutionMode::AVX2) Kernels::ConvertAvx2((const From*)A, Length, (To*)Out);
+        else Kernels::ConvertScalar((const From*)A, Length, (To*)Out);
+    }
+
+    template <bool bConstThen, bool bConstElse, ExecutionMode Mode>
+    void RunSelect(const uint64_t* Bits, const void* A, const void* B, int64_t Length, void* Out)
+    {
+        if constexpr (Mode == ExecutionMode::AVX512) Kernels::SelectAvx512<bConstThen, bConstElse>(Bits, (const uint64_t*)A, (const uint64_t*)B, Length, (uint64_t*)Out);
+        else if constexpr (Mode == ExecutionMode::AVX2) Kernels::SelectAvx2<bConstThen, bConstElse>(Bits, (const uint64_t*)A, (const uint64_t*)B, Length, (uint64_t*)Out);
+        else Kernels::SelectScalar<bConstThen, bConstElse>(Bits, (const uint64_t*)A, (const uint64_t*)B, Length, (uint64_t*)Out);
+    }
+
+    template <ArithmeticOp Op, typename T, ExecutionMode Mode>
+    Step::Kernel PickArithmetic(bool bConstA, bool bConstB)
+    {
+        if (bConstA) return &RunArithmetic<Op, T, true, false, Mode>;
+        if (bConstB) return &RunArithmetic<Op, T, false, true, Mode>;
+        return &RunArithmetic<Op, T, false, false, Mode>;
+    }
+
+    template <ArithmeticOp Op, ExecutionMode Mode>
+    Step::Kernel PickArithmetic(ValueType Type, bool bConstA, bool bConstB)
+    {
+        if constexpr (Op == ArithmeticOp::DIVIDE)
+        {
+            return PickArithmetic<Op, double, Mode>(bConstA, bConstB);
+        }
+        else
+        {
+            return Type == ValueType::DOUBLE ? PickArithmetic<Op, double, Mode>(bConstA, bConstB) : PickArithmetic<Op, int64_t, Mode>(bConstA, bConstB);
+        }
+    }
+
+    template <ExecutionMode Mode>
+    Step::Kernel PickArithmetic(ArithmeticOp Op, ValueType Type, bool bConstA, bool bConstB)
+    {
+        switch (Op)
+        {
+        case ArithmeticOp::ADD: return PickArithmetic<ArithmeticOp::ADD, Mode>(Type, bConstA, bConstB);
+        case ArithmeticOp::SUBTRACT: return PickArithmetic<ArithmeticOp::SUBTRACT, Mode>(Type, bConstA, bConstB);
+        case ArithmeticOp::MULTIPLY: return PickArithmetic<ArithmeticOp::MULTIPLY, Mode>(Type, bConstA, bConstB);
+        default: return PickArithmetic<ArithmeticOp::DIVIDE, Mode>(Type, bConstA, bConstB);
+        }
+    }
+
+    template <typename From, ExecutionMode Mode>
+    Step::Kernel PickConvert(ValueType To)
+    {
+        return To == ValueType::DOUBLE ? &RunConvert<From, double, Mode> : &RunConvert<From, int64_t, Mode>;
+    }
+
+    template <ExecutionMode Mode>
+    Step::Kernel PickSelect(bool bConstThen, bool bConstElse)
+    {
+        if (bConstThen && bConstElse) return &RunSelect<true, true, Mode>;
+        if (bConstThen) return &RunSelect<true, false, Mode>;
+        if (bConstElse) return &RunSelect<false, true, Mode>;
+        return &RunSelect<false, false, Mode>;
+    }
+
+    // the mode is a template parameter of every kernel, this turns the runtime one into it
+    template <typename PickerType>
+    Step::Kernel ForMode(ExecutionMode Mode, PickerType&& Picker)
+    {
+        switch (Mode)
+        {
+        case ExecutionMode::AVX512: return Picker(std::integral_constant<ExecutionMode, ExecutionMode::AVX512>());
+        case ExecutionMode::AVX2: return Picker(std::integral_constant<ExecutionMode, ExecutionMode::AVX2>());
+        default: return Picker(std::integral_constant<ExecutionMode, ExecutionMode::SCALAR>());
+        }
+    }
+
+    uint64_t IntBits(int64_t Value)
+    {
+        uint64_t Bits;
+        std::memcpy(&Bits, &Value, 8);
+        return Bits;
+    }
+
+    uint64_t DoubleBits(double Value)
+    {
+        uint64_t Bits;
+        std::memcpy(&Bits, &Value, 8);
+        return Bits;
+    }
+
+    int64_t AsInt(uint64_t Bits)
+    {
+        int64_t Value;
+        std::memcpy(&Value, &Bits, 8);
+        return Value;
+    }
+
+    double AsDouble(uint64_t Bits)
+    {
+        double Value;
+        std::memcpy(&Value, &Bits, 8);
+        return Value;
+    }
+
+    // A subexpression while compiling: a constant, a column of the batch as it is, or a slot a step writes.
+    // Slots are numbered in the order they are written here, the real scratch columns are assigned afterwards
+    struct CompiledValue
+    {
+        enum class Kind { CONSTANT, COLUMN, SLOT };
+
+        Kind Type = Kind::CONSTANT;
+        ValueType Result = ValueType::INT64;
+        uint64_t Constant = 0;
+        int Column = -1;
+        int Slot = -1;
+        std::string Key; // the same for every occurrence of the same subexpression
+    };
+
+    uint64_t ConvertConstant(uint64_t Bits, ValueType From, ValueType To)
+    {
+        if (From == To) return Bits;
+        return To == ValueType::DOUBLE ? DoubleBits((double)AsInt(Bits)) : IntBits(Kernels::TruncateToInt64(AsDouble(Bits)));
+    }
+
+    template <ArithmeticOp Op>
+    uint64_t FoldConstants(ValueType Type, uint64_t A, uint64_t B)
+    {
+        if constexpr (Op != ArithmeticOp::DIVIDE)
+        {
+            if (Type == ValueType::INT64)
+            {
+                return IntBits(Kernels::Calculate<Op>(AsInt(A), AsInt(B)));
+            }
+        }
+        return DoubleBits(Kernels::Calculate<Op>(AsDouble(A), AsDouble(B)));
+    }
+
+    std::string OpName(ArithmeticOp Op)
+    {
+        switch (Op)
+        {
+        case ArithmeticOp::ADD: return "+";
+        case ArithmeticOp::SUBTRACT: return "-";
+        case ArithmeticOp::MULTIPLY: return "*";
+        default: return "/";
+        }
+    }
+
+    std::string KeyOf(const FilterExpression& When)
+    {
+        if (When.Type == FilterExpression::Kind::PREDICATE)
+        {
+            const ScanPredicate& P = When.Predicate;
+            std::string Key = "p(" + P.ColumnName + "#" + std::to_string(P.ColumnIndex) + "," + std::to_string((int)P.Op) + "," + std::to_string(P.Low) + "," + std::to_string(P.High);
+            for (int64_t Value : P.Values)
+            {
+                Key += "," + std::to_string(Value);
+            }
+            for (const std::string& Value : P.TextValues)
+            {
+                // length first, so no text can look like the end of another one
+                Key += ",t" + std::to_string(Value.size()) + ":" + Value;
+            }
+            return Key + ")";
+        }
+
+        std::string Key = When.Type == FilterExpression::Kind::AND ? "and(" : "or(";
+        for (const FilterExpression& Child : When.Children)
+        {
+            Key += KeyOf(Child) + ",";
+        }
+        return Key + ")";
+    }
+
+    class ProjectionCompiler
+    {
+    public:
+        ProjectionCompiler(const arrow::RecordBatch& InBatch, ExecutionMode InMode, std::vector<Step>& InSteps, std::vector<std::unique_ptr<CompiledFilter>>& InConditions)
+            : Batch(InBatch), Mode(InMode), Steps(InSteps), Conditions(InConditions)
+        {
+        }
+
+        int SlotCount = 0;
+
+        int ResolveColumn(const ColumnRef& Ref) const
+        {
+            int Index = Ref.Name.empty() ? Ref.Index : this->Batch.schema()->GetFieldIndex(Ref.Name);
+            if (Index < 0 || Index >= this->Batch.num_columns())
+            {
+                throw std::runtime_error("CompiledProjection: no column named '" + Ref.Name + "'");
+            }
+            return Index;
+        }
+
+        CompiledValue Compile(const Expression& E)
+        {
+            switch (E.Type)
+            {
+            case Expression::Kind::COLUMN: return this->CompileColumn(E);
+            case Expression::Kind::CONSTANT: return this->MakeConstant(E.ResultType, E.ResultType == ValueType::DOUBLE ? DoubleBits(E.DoubleValue) : IntBits(E.IntValue));
+            case Expression::Kind::ARITHMETIC: return this->CompileArithmetic(E);
+            case Expression::Kind::CAST: return this->CastTo(this->Compile(E.Children[0]), E.ResultType);
+            default: return this->CompileCase(E);
+            }
+        }
+
+        // Value as a kernel input of type Want, converted into a slot first if it isn't one already
+        Step::Operand Use(const CompiledValue& Value, ValueType Want)
+        {
+            Step::Operand Operand;
+            if (Value.Type == CompiledValue::Kind::CONSTANT)
+            {
+                Operand.Constant = ConvertConstant(Value.Constant, Value.Result, Want);
+            }
+            else if (Value.Type == CompiledValue::Kind::COLUMN && Value.Result == Want && this->IsWide(Value.Column))
+            {
+                Operand.Column = Value.Column;
+            }
+            else if (Value.Type == CompiledValue::Kind::SLOT && Value.Result == Want)
+            {
+                Operand.Slot = Value.Slot;
+            }
+            else
+            {
+                Operand.Slot = this->Convert(Value, Want).Slot;
+            }
+            return Operand;
+        }
+
+        // int64, uint64 and double columns (and everything stored as int64) are read in place, the narrower ones converted
+        bool IsWide(int Column) const
+        {
+            const arrow::DataType& Type = *this->Batch.column_data(Column)->type;
+            return arrow::is_fixed_width(Type.id()) && static_cast<const arrow::FixedWidthType&>(Type).bit_width() == 64;
+        }
+
+        CompiledValue CastTo(const CompiledValue& Value, ValueType To)
+        {
+            if (Value.Result == To)
+            {
+                return Value;
+            }
+            if (Value.Type == CompiledValue::Kind::CONSTANT)
+            {
+                return this->MakeConstant(To, ConvertConstant(Value.Constant, Value.Result, To));
+            }
+            return this->Convert(Value, To);
+        }
+
+    private:
+        const arrow::RecordBatch& Batch;
+        ExecutionMode Mode;
+        std::vector<Step>& Steps;
+        std::vector<std::unique_ptr<CompiledFilter>>& Conditions;
+        std::map<std::string, CompiledValue> Cache; // common subexpressions, by key
+        std::map<std::string, int> ConditionCache;
+
+        CompiledValue MakeConstant(ValueType Type, uint64_t Bits)
+        {
+            CompiledValue Value;
+            Value.Result = Type;
+            Value.Constant = Bits;
+            Value.Key = (Type == ValueType::DOUBLE ? "d" : "i") + std::to_string(Bits);
+            return Value;
+        }
+
+        CompiledValue MakeSlot(ValueType Type, const std::string& Key)
+        {
+            CompiledValue Value;
+            Value.Type = CompiledValue::Kind::SLOT;
+            Value.Result = Type;
+            Value.Slot = this->SlotCount++;
+            Value.Key = Key;
+            this->Cache[Key] = Value;
+            return Value;
+        }
+
+        const CompiledValue* Find(const std::string& Key) const
+        {
+            auto Found = this->Cache.find(Key);
+            return Found != this->Cache.end() ? &Found->second : nullptr;
+        }
+
+        CompiledValue CompileColumn(const Expression& E)
+        {
+            CompiledValue Value;
+            Value.Type = CompiledValue::Kind::COLUMN;
+            Value.Column = this->ResolveColumn(E.Column);
+            Value.Key = "#" + std::to_string(Value.Column);
+
+            const arrow::DataType& Type = *this->Batch.column_data(Value.Column)->type;
+            bool bSupported = Kernels::VisitNumericType(Type.id(), [&](auto Tag)
+            {
+                using T = typename decltype(Tag)::Type;
+                Value.Result = std::is_floating_point_v<T> ? ValueType::DOUBLE : ValueType::INT64;
+            });
+            if (!bSupported)
+            {
+                throw std::runtime_error("CompiledProjection: column must be a number, got " + Type.ToString());
+            }
+            return Value;
+        }
+
+        // one step that converts a column (any type) or a slot (INT64 <-> DOUBLE) into a new slot
+        CompiledValue Convert(const CompiledValue& Value, ValueType To)
+        {
+            std::string Key = std::string(To == ValueType::DOUBLE ? "double(" : "int64(") + Value.Key + ")";
+            if (const CompiledValue* Found = this->Find(Key))
+            {
+                return *Found;
+            }
+
+            Step Converted;
+            if (Value.Type == CompiledValue::Kind::COLUMN)
+            {
+                const arrow::DataType& Type = *this->Batch.column_data(Value.Column)->type;
+                Converted.A.Column = Value.Column;
+                Converted.A.ByteWidth = static_cast<const arrow::FixedWidthType&>(Type).bit_width() / 8;
+                Kernels::VisitNumericType(Type.id(), [&](auto Tag)
+                {
+                    // uint64 is read as its int64 bits like everywhere else in here
+                    using T = typename decltype(Tag)::Type;
+                    using From = std::conditional_t<std::is_same_v<T, uint64_t>, int64_t, T>;
+                    Converted.Run = ForMode(this->Mode, [&](auto ModeTag) { return PickConvert<From, decltype(ModeTag)::value>(To); });
+                });
+            }
+            else
+            {
+                Converted.A.Slot = Value.Slot;
+                Converted.Run = Value.Result == ValueType::DOUBLE
+                    ? ForMode(this->Mode, [&](auto ModeTag) { return PickConvert<double, decltype(ModeTag)::value>(To); })
+                    : ForMode(this->Mode, [&](auto ModeTag) { return PickConvert<int64_t, decltype(ModeTag)::value>(To); });
+            }
+
+            CompiledValue Result = this->MakeSlot(To, Key);
+            Converted.Out = Result.Slot;
+            this->Steps.push_back(Converted);
+            return Result;
+        }
+
+        CompiledValue CompileArithmetic(const Expression& E)
+        {
+            CompiledValue Left = this->Compile(E.Children[0]);
+            CompiledValue Right = this->Compile(E.Children[1]);
+            bool bDouble = E.Op == ArithmeticOp::DIVIDE || Left.Result == ValueType::DOUBLE || Right.Result == ValueType::DOUBLE;
+            ValueType Type = bDouble ? ValueType::DOUBLE : ValueType::INT64;
+
+            if (Left.Type == CompiledValue::Kind::CONSTANT && Right.Type == CompiledValue::Kind::CONSTANT)
+            {
+                uint64_t A = ConvertConstant(Left.Constant, Left.Result, Type);
+                uint64_t B = ConvertConstant(Right.Constant, Right.Result, Type);
+                switch (E.Op)
+                {
+                case ArithmeticOp::ADD: return this->MakeConstant(Type, FoldConstants<ArithmeticOp::ADD>(Type, A, B));
+                case ArithmeticOp::SUBTRACT: return this->MakeConstant(Type, FoldConstants<ArithmeticOp::SUBTRACT>(Type, A, B));
+                case ArithmeticOp::MULTIPLY: return this->MakeConstant(Type, FoldConstants<ArithmeticOp::MULTIPLY>(Type, A, B));
+                default: return this->MakeConstant(Type, FoldConstants<ArithmeticOp::DIVIDE>(Type, A, B));
+                }
+            }
+
+            // a + b and b + a are the same subexpression
+            std::string LeftKey = Left.Key;
+            std::string RightKey = Right.Key;
+            if ((E.Op == ArithmeticOp::ADD || E.Op == ArithmeticOp::MULTIPLY) && RightKey < LeftKey)
+            {
+                std::swap(LeftKey, RightKey);
+            }
+            std::string Key = OpName(E.Op) + std::string(bDouble ? "d(" : "i(") + LeftKey + "," + RightKey + ")";
+            if (const CompiledValue* Found = this->Find(Key))
+            {
+                return *Found;
+            }
+
+            Step Calculated;
+            Calculated.A = this->Use(Left, Type);
+            Calculated.B = this->Use(Right, Type);
+            bool bConstA = Left.Type == CompiledValue::Kind::CONSTANT;
+            bool bConstB = Right.Type == CompiledValue::Kind::CONSTANT;
+            Calculated.Run = ForMode(this->Mode, [&](auto ModeTag) { return PickArithmetic<decltype(ModeTag)::value>(E.Op, Type, bConstA, bConstB); });
+
+            CompiledValue Result = this->MakeSlot(Type, Key);
+            Calculated.Out = Result.Slot;
+            this->Steps.push_back(Calculated);
+            return Result;
+        }
+
+        CompiledValue CompileCase(const Expression& E)
+        {
+            CompiledValue Then = this->Compile(E.Children[0]);
+            CompiledValue Else = this->Compile(E.Children[1]);
+            ValueType Type = Then.Result == ValueType::DOUBLE || Else.Result == ValueType::DOUBLE ? ValueType::DOUBLE : ValueType::INT64;
+
+            std::string ConditionKey = KeyOf(E.When);
+            std::string Key = "case(" + ConditionKey + "," + Then.Key + "," + Else.Key + ")";
+            if (const CompiledValue* Found = this->Find(Key))
+            {
+                return *Found;
+            }
+
+            // the same condition under two CASEs is evaluated once per batch too
+            auto FoundCondition = this->ConditionCache.find(ConditionKey);
+            int Condition;
+            if (FoundCondition != this->ConditionCache.end())
+            {
+                Condition = FoundCondition->second;
+            }
+            else
+            {
+                Condition = (int)this->Conditions.size();
+                this->Conditions.push_back(std::make_unique<CompiledFilter>(E.When));
+                this->ConditionCache[ConditionKey] = Condition;
+            }
+
+            Step Selected;
+            Selected.A = this->Use(Then, Type);
+            Selected.B = this->Use(Else, Type);
+            Selected.Condition = Condition;
+            bool bConstThen = Then.Type == CompiledValue::Kind::CONSTANT;
+            bool bConstElse = Else.Type == CompiledValue::Kind::CONSTANT;
+            Selected.Run = ForMode(this->Mode, [&](auto ModeTag) { return PickSelect<decltype(ModeTag)::value>(bConstThen, bConstElse); });
+
+            CompiledValue Result = this->MakeSlot(Type, Key);
+            Selected.Out = Result.Slot;
+            this->Steps.push_back(Selected);
+            return Result;
+        }
+    };
+
+    // the columns whose nulls end up in the result, CASE conditions don't count (a null there picks ELSE)
+    void CollectValueColumns(const Expression& E, const ProjectionCompiler& Compiler, std::vector<int>& Out)
+    {
+        if (E.Type == Expression::Kind::COLUMN)
+        {
+            int Column = Compiler.ResolveColumn(E.Column);
+            if (std::find(Out.begin(), Out.end(), Column) == Out.end())
+            {
+                Out.push_back(Column);
+            }
+        }
+        for (const Expression& Child : E.Children)
+        {
+            CollectValueColumns(Child, Compiler, Out);
+        }
+    }
+
+    std::shared_ptr<arrow::Buffer> AllocateOrThrow(int64_t Size, arrow::MemoryPool* Pool, ChunkBufferPool* Recycler)
+    {
+        if (Recycler != nullptr)
+        {
+            return Recycler->Acquire(Size);
+        }
+
+        arrow::Result<std::unique_ptr<arrow::Buffer>> BufferResult = arrow::AllocateBuffer(Size, Pool);
+        PARQUET_THROW_NOT_OK(BufferResult.status());
+        return std::shared_ptr<arrow::Buffer>(std::move(BufferResult).ValueOrDie());
+    }
+}
+
+CompiledProjection::CompiledProjection(std::vector<ProjectedColumn> InColumns, ExecutionMode InMode)
+    : Columns(std::move(InColumns)), Mode(InMode)
+{
+}
+
+CompiledProjection::~CompiledProjection() = default;
+
+void CompiledProjection::Compile(const arrow::RecordBatch& Batch)
+{
+    this->Steps.clear();
+    this->Outputs.clear();
+    this->Conditions.clear();
+
+    ProjectionCompiler Compiler(Batch, this->Mode, this->Steps, this->Conditions);
+    std::vector<int> OutputSlots; // the compiler's slot of every output that has one
+    for (const ProjectedColumn& Projected : this->Columns)
+    {
+        CompiledValue Value = Compiler.Compile(Projected.Value);
+
+        Output Result;
+        Result.Type = Value.Result;
+        CollectValueColumns(Projected.Value, Compiler, Result.NullableFrom);
+        if (Value.Type == CompiledValue::Kind::CONSTANT)
+        {
+            Result.bConstant = true;
+            Result.Constant = Value.Constant;
+        }
+        else if (Value.Type == CompiledValue::Kind::COLUMN && Compiler.IsWide(Value.Column))
+        {
+            Result.Column = Value.Column; // handed out as is, no copy
+        }
+        else
+        {
+            Result.Slot = Compiler.Use(Value, Value.Result).Slot;
+        }
+        this->Outputs.push_back(Result);
+    }
+
+    // Assign the real slots: a scratch column is given back after the last step that reads it and the next step
+    // writing a result takes it again (in place is fine, the kernels only touch row i at step i).
+    // The output columns get their own buffers, the batch we return keeps them
+    std::vector<int> LastRead(Compiler.SlotCount, -1);
+    for (int i = 0; i < (int)this->Steps.size(); ++i)
+    {
+        if (this->Steps[i].A.Slot >= 0) LastRead[this->Steps[i].A.Slot] = i;
+        if (this->Steps[i].B.Slot >= 0) LastRead[this->Steps[i].B.Slot] = i;
+    }
+
+    std::vector<int> OutputIndex(Compiler.SlotCount, -1);
+    int OutputCount = 0;
+    for (const Output& Result : this->Outputs)
+    {
+        if (Result.Slot >= 0 && OutputIndex[Result.Slot] < 0)
+        {
+            OutputIndex[Result.Slot] = OutputCount++;
+        }
+    }
+
+    std::vector<int> Physical(Compiler.SlotCount, -1);
+    std::vector<int> FreeScratch;
+    int ScratchCount = 0;
+    for (int i = 0; i < (int)this->Steps.size(); ++i)
+    {
+        const Step& Current = this->Steps[i];
+        for (int Slot : { Current.A.Slot, Current.B.Slot })
+        {
+            if (Slot >= 0 && LastRead[Slot] == i && OutputIndex[Slot] < 0)
+            {
+                FreeScratch.push_back(Physical[Slot]);
+                LastRead[Slot] = -1; // a * a reads it twice, give it back once
+            }
+        }
+
+        if (OutputIndex[Current.Out] >= 0)
+        {
+            continue;
+        }
+        if (!FreeScratch.empty())
+        {
+            Physical[Current.Out] = FreeScratch.back();
+            FreeScratch.pop_back();
+        }
+        else
+        {
+            Physical[Current.Out] = ScratchCount++;
+        }
+    }
+    for (int Slot = 0; Slot < Compiler.SlotCount; ++Slot)
+    {
+        if (OutputIndex[Slot] >= 0)
+        {
+            Physical[Slot] = ScratchCount + OutputIndex[Slot];
+        }
+    }
+
+    for (Step& Current : this->Steps)
+    {
+        if (Current.A.Slot >= 0) Current.A.Slot = Physical[Current.A.Slot];
+        if (Current.B.Slot >= 0) Current.B.Slot = Physical[Current.B.Slot];
+        Current.Out = Physical[Current.Out];
+    }
+    for (Output& Result : this->Outputs)
+    {
+        if (Result.Slot >= 0)
+        {
+            Result.Slot = Physical[Result.Slot];
+        }
+    }
+
+    this->ScratchSlots = ScratchCount;
+    this->OutputSlots = OutputCount;
+    this->Scratch.resize(ScratchCount);
+
+    this->CompiledTypes.clear();
+    for (int i = 0; i < Batch.num_columns(); ++i)
+    {
+        this->CompiledTypes.push_back(Batch.column_data(i)->type->id());
+    }
+}
+
+DataChunk CompiledProjection::Evaluate(const arrow::RecordBatch& Batch, arrow::MemoryPool* Pool, ChunkBufferPool* Recycler)
+{
+    bool bTypesChanged = (int)this->CompiledTypes.size() != Batch.num_columns();
+    for (int i = 0; !bTypesChanged && i < Batch.num_columns(); ++i)
+    {
+        bTypesChanged = Batch.column_data(i)->type->id() != this->CompiledTypes[i];
+    }
+    if (bTypesChanged)
+    {
+        this->Compile(Batch);
+    }
+
+    int64_t Length = Batch.num_rows();
+    std::vector<uint64_t*> Slots(this->ScratchSlots + this->OutputSlots, nullptr);
+    for (int i = 0; i < this->ScratchSlots; ++i)
+    {
+        if ((int64_t)this->Scratch[i].size() < Length)
+        {
+            this->Scratch[i].resize(Length);
+        }
+        Slots[i] = this->Scratch[i].data();
+    }
+
+    // the result columns are written in place by their last step. The batch we return owns their buffers, so every batch
+    // gets its own, with a Recycler those are the buffers of a batch the consumer already dropped
+    std::vector<std::shared_ptr<arrow::Buffer>> OutputBuffers(this->OutputSlots);
+    for (int i = 0; i < this->OutputSlots; ++i)
+    {
+        OutputBuffers[i] = AllocateOrThrow(Length * 8, Pool, Recycler);
+        Slots[this->ScratchSlots + i] = (uint64_t*)OutputBuffers[i]->mutable_data();
+    }
+
+    // CASE conditions as bits, each evaluated once no matter how many CASEs share it
+    this->ConditionBits.resize(this->Conditions.size());
+    for (size_t i = 0; i < this->Conditions.size(); ++i)
+    {
+        if ((int64_t)this->ConditionBits[i].size() < (Length + 63) / 64)
+        {
+            this->ConditionBits[i].resize((Length + 63) / 64);
+        }
+        this->Conditions[i]->EvaluateBits(Batch, this->Mode, this->ConditionBits[i].data());
+    }
+
+    auto Resolve = [&](const Step::Operand& Operand) -> const void*
+    {
+        if (Operand.Slot >= 0)
+        {
+            return Slots[Operand.Slot];
+        }
+        if (Operand.Column >= 0)
+        {
+            const arrow::ArrayData& Column = *Batch.column_data(Operand.Column);
+            return Column.buffers[1]->data() + Column.offset * Operand.ByteWidth;
+        }
+        return &Operand.Constant;
+    };
+
+    // the whole expression list, one kernel call per step and nothing decided per row
+    for (const Step& Current : this->Steps)
+    {
+        const uint64_t* Bits = Current.Condition >= 0 ? this->ConditionBits[Current.Condition].data() : nullptr;
+        Current.Run(Bits, Resolve(Current.A), Resolve(Current.B), Length, Slots[Current.Out]);
+    }
+
+    std::vector<std::shared_ptr<arrow::Field>> Fields;
+    std::vector<std::shared_ptr<arrow::ArrayData>> Arrays;
+    for (size_t i = 0; i < this->Outputs.size(); ++i)
+    {
+        const Output& Result = this->Outputs[i];
+        if (Result.Column >= 0)
+        {
+            const std::shared_ptr<arrow::ArrayData>& Column = Batch.column_data(Result.Column);
+            Fields.push_back(arrow::field(this->Columns[i].Name, Column->type));
+            Arrays.push_back(Column);
+            continue;
+        }
+
+        std::shared_ptr<arrow::DataType> Type = Result.Type == ValueType::DOUBLE ? arrow::float64() : arrow::int64();
+        std::shared_ptr<arrow::Buffer> Values;
+        if (Result.bConstant)
+        {
+            Values = AllocateOrThrow(Length * 8, Pool, Recycler);
+            std::fill_n((uint64_t*)Values->mutable_data(), Length, Result.Constant);
+        }
+        else
+        {
+            Values = OutputBuffers[Result.Slot - this->ScratchSlots];
+        }
+
+        // null where any column the value was computed from is null
+        std::shared_ptr<arrow::Buffer> Validity;
+        int64_t NullCount = 0;
+        int64_t Words = (Length + 63) / 64;
+        for (int Source : Result.NullableFrom)
+        {
+            const arrow::ArrayData& Column = *Batch.column_data(Source);
+            if (Column.GetNullCount() == 0)
+            {
+                continue;
+            }
+            if (!Validity)
+            {
+                Validity = AllocateOrThrow(Words * 8, Pool, Recycler);
+                std::fill_n((uint64_t*)Validity->mutable_data(), Words, ~0ull);
+            }
+            Kernels::AndValidity((uint64_t*)Validity->mutable_data(), Length, Column.buffers[0]->data(), Column.offset);
+        }
+        if (Validity)
+        {
+            const uint64_t* Bits = (const uint64_t*)Validity->data();
+            NullCount = Length;
+            for (int64_t w = 0; w < Words; ++w)
+            {
+                int Count = (int)std::min<int64_t>(64, Length - w * 64);
+                NullCount -= (int64_t)std::bitset<64>(Count == 64 ? Bits[w] : Bits[w] & ((1ull << Count) - 1)).count();
+            }
+        }
+
+        Fields.push_back(arrow::field(this->Columns[i].Name, Type));
+        Arrays.push_back(arrow::ArrayData::Make(Type, Length, { Validity, Values }, NullCount));
+    }
+
+    return arrow::RecordBatch::Make(arrow::schema(Fields), Length, Arrays);
+}
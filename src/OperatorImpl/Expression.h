@@ -0,0 +1,174 @@
+#pragma once
+
+#include "Operator.h"
+#include "FilterExpression.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ChunkBufferPool;
+
+enum class ArithmeticOp
+{
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE // always in double, 7 / 2 is 3.5
+};
+
+// Expressions compute in one of two types: every integer column (dates and timestamps too, uint64 as its bits)
+// is read as INT64, float and double columns as DOUBLE. Mixing the two gives DOUBLE
+enum class ValueType
+{
+    INT64,
+    DOUBLE
+};
+
+// A computed column: price * qty, a + b, CAST(x AS DOUBLE), CASE WHEN <filter> THEN a ELSE b END.
+// The result is null in a row where any column the expression reads is null
+struct Expression
+{
+    enum class Kind
+    {
+        COLUMN,
+        CONSTANT,
+        ARITHMETIC,
+        CAST,
+        CASE
+    };
+
+    Kind Type = Kind::CONSTANT;
+    ColumnRef Column;                         // COLUMN
+    ValueType ResultType = ValueType::INT64;  // CONSTANT, CAST
+    int64_t IntValue = 0;                     // CONSTANT of INT64
+    double DoubleValue = 0.0;                 // CONSTANT of DOUBLE
+    ArithmeticOp Op = ArithmeticOp::ADD;      // ARITHMETIC
+    FilterExpression When;                    // CASE, Children[0] where it holds and Children[1] where it doesn't
+    std::vector<Expression> Children;
+
+    static Expression Named(const std::string& Name)
+    {
+        Expression Result;
+        Result.Type = Kind::COLUMN;
+        Result.Column = ColumnRef::Named(Name);
+        return Result;
+    }
+
+    static Expression At(int Index)
+    {
+        Expression Result;
+        Result.Type = Kind::COLUMN;
+        Result.Column = ColumnRef::At(Index);
+        return Result;
+    }
+
+    static Expression Int(int64_t Value)
+    {
+        Expression Result;
+        Result.IntValue = Value;
+        return Result;
+    }
+
+    static Expression Double(double Value)
+    {
+        Expression Result;
+        Result.ResultType = ValueType::DOUBLE;
+        Result.DoubleValue = Value;
+        return Result;
+    }
+
+    static Expression Arithmetic(ArithmeticOp Op, Expression Left, Expression Right)
+    {
+        Expression Result;
+        Result.Type = Kind::ARITHMETIC;
+        Result.Op = Op;
+        Result.Children.push_back(std::move(Left));
+        Result.Children.push_back(std::move(Right));
+        return Result;
+    }
+
+    static Expression Add(Expression Left, Expression Right) { return Arithmetic(ArithmeticOp::ADD, std::move(Left), std::move(Right)); }
+    static Expression Subtract(Expression Left, Expression Right) { return Arithmetic(ArithmeticOp::SUBTRACT, std::move(Left), std::move(Right)); }
+    static Expression Multiply(Expression Left, Expression Right) { return Arithmetic(ArithmeticOp::MULTIPLY, std::move(Left), std::move(Right)); }
+    static Expression Divide(Expression Left, Expression Right) { return Arithmetic(ArithmeticOp::DIVIDE, std::move(Left), std::move(Right)); }
+
+    // DOUBLE -> INT64 truncates, a value that doesn't fit (or NaN) becomes INT64_MIN
+    static Expression Cast(Expression Value, ValueType To)
+    {
+        Expression Result;
+        Result.Type = Kind::CAST;
+        Result.ResultType = To;
+        Result.Children.push_back(std::move(Value));
+        return Result;
+    }
+
+    // The condition reads the input columns like a FilterOperator would, a null there means ELSE
+    static Expression Case(FilterExpression When, Expression Then, Expression Else)
+    {
+        Expression Result;
+        Result.Type = Kind::CASE;
+        Result.When = std::move(When);
+        Result.Children.push_back(std::move(Then));
+        Result.Children.push_back(std::move(Else));
+        return Result;
+    }
+
+    // Every column the expression reads, the CASE conditions included
+    std::vector<ColumnRef> Columns() const;
+};
+
+// One output column of a ProjectOperator
+struct ProjectedColumn
+{
+    std::string Name;
+    Expression Value;
+};
+
+// A list of expressions compiled into one straight line of column kernels (Kernels/Arithmetic.h).
+// Compiling folds constants (2 * 3 is 6 before any row is read), evaluates every subexpression that shows up more than
+// once only once (a * b in a * b + 1 and a * b - 1), and gives every intermediate result a scratch column that is
+// handed to the next step once its last reader ran, so a batch needs a few scratch columns whatever the size of the tree.
+// The steps are picked for the column types of the first batch and the mode, a batch runs them without looking at a type
+class CompiledProjection
+{
+public:
+    CompiledProjection(std::vector<ProjectedColumn> InColumns, ExecutionMode InMode);
+    ~CompiledProjection();
+
+    // The projected columns of Batch, in order, computed columns are allocated from Pool (or taken from Recycler,
+    // see Execution/ChunkBufferPool.h). Recompiles when a column type changed since the last batch
+    DataChunk Evaluate(const arrow::RecordBatch& Batch, arrow::MemoryPool* Pool = arrow::default_memory_pool(), ChunkBufferPool* Recycler = nullptr);
+
+    const std::vector<ProjectedColumn>& GetColumns() const { return this->Columns; }
+
+    // One kernel call over a whole column, defined in the .cpp
+    struct Step;
+
+private:
+    void Compile(const arrow::RecordBatch& Batch);
+
+    std::vector<ProjectedColumn> Columns;
+    ExecutionMode Mode;
+
+    std::vector<Step> Steps;
+    std::vector<arrow::Type::type> CompiledTypes; // of every input column, to notice when they change
+
+    // per output column: where its values come from and the input columns whose nulls it inherits
+    struct Output
+    {
+        int Column = -1;      // the input column as is, when the expression is just a column of INT64 / DOUBLE
+        int Slot = -1;        // otherwise the slot the last step wrote
+        bool bConstant = false;
+        uint64_t Constant = 0; // bit pattern of the INT64 / DOUBLE constant
+        ValueType Type = ValueType::INT64;
+        std::vector<int> NullableFrom;
+    };
+    std::vector<Output> Outputs;
+
+    int ScratchSlots = 0; // slots [0, ScratchSlots) are scratch columns, the OutputSlots after them output buffers
+    int OutputSlots = 0;
+    std::vector<std::vector<uint64_t>> Scratch;
+    std::vector<std::unique_ptr<CompiledFilter>> Conditions; // one per distinct CASE condition
+    std::vector<std::vector<uint64_t>> ConditionBits;
+};
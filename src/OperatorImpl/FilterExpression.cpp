@@ -0,0 +1,542 @@
+#include "pch.h"
+#include "FilterExpression.h"
+#include "Kernels/Predicates.h"
+#include "Kernels/Dictionary.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+std::vector<ScanPredicate> FilterExpression::Conjuncts() const
+{
+    switch (this->Type)
+    {
+    case Kind::PREDICATE: return { this->Predicate };
+    case Kind::AND:
+    {
+        // AND(a, AND(b, c)) is a AND b AND c
+        std::vector<ScanPredicate> Predicates;
+        for (const FilterExpression& Child : this->Children)
+        {
+            std::vector<ScanPredicate> ChildPredicates = Child.Conjuncts();
+            Predicates.insert(Predicates.end(), ChildPredicates.begin(), ChildPredicates.end());
+        }
+        return Predicates;
+    }
+    default: return {}; // a row passing an OR doesn't have to satisfy any single one of its predicates
+    }
+}
+
+std::vector<ColumnRef> FilterExpression::Columns() const
+{
+    if (this->Type == Kind::PREDICATE)
+    {
+        return { this->Predicate.ColumnName.empty() ? ColumnRef::At(this->Predicate.ColumnIndex) : ColumnRef::Named(this->Predicate.ColumnName) };
+    }
+
+    std::vector<ColumnRef> Refs;
+    for (const FilterExpression& Child : this->Children)
+    {
+        std::vector<ColumnRef> ChildRefs = Child.Columns();
+        Refs.insert(Refs.end(), ChildRefs.begin(), ChildRefs.end());
+    }
+    return Refs;
+}
+
+struct CompiledFilter::BoundPredicate
+{
+    virtual ~BoundPredicate() = default;
+
+    // One bit per row of Column, 0 past its length. The nulls are cleared by the caller
+    virtual void Evaluate(const arrow::ArrayData& Column, ExecutionMode Mode, uint64_t* OutBits) const = 0;
+};
+
+namespace
+{
+    // The constant is outside of what the column's type can hold (int8 < 1000), every row has the same answer
+    struct ConstantPredicate : CompiledFilter::BoundPredicate
+    {
+        bool bMatch;
+
+        explicit ConstantPredicate(bool bInMatch) : bMatch(bInMatch) {}
+
+        void Evaluate(const arrow::ArrayData& Column, ExecutionMode Mode, uint64_t* OutBits) const override
+        {
+            int64_t Words = (Column.length + 63) / 64;
+            std::fill(OutBits, OutBits + Words, this->bMatch ? ~0ull : 0ull);
+            if (this->bMatch && Column.length % 64 != 0)
+            {
+                OutBits[Words - 1] = (1ull << (Column.length % 64)) - 1;
+            }
+        }
+    };
+
+    // One (Op, T) instantiation, the mode switch is the only thing left to decide per batch
+    template <typename T, PredicateOp Op>
+    struct TypedPredicate : CompiledFilter::BoundPredicate
+    {
+        Kernels::PredicateConstants<T> Constants;
+        std::vector<T> InValues;
+
+        void Evaluate(const arrow::ArrayData& Column, ExecutionMode Mode, uint64_t* OutBits) const override
+        {
+            const T* Data = Column.GetValues<T>(1); // already moved by the slice offset
+            switch (Mode)
+            {
+            case ExecutionMode::AVX512: Kernels::EvaluatePredicateAvx512<Op>(Data, Column.length, this->Constants, OutBits); break;
+            case ExecutionMode::AVX2: Kernels::EvaluatePredicateAvx2<Op>(Data, Column.length, this->Constants, OutBits); break;
+            default: Kernels::EvaluatePredicateScalar<Op>(Data, Column.length, this->Constants, OutBits); break;
+            }
+        }
+    };
+
+    // The constants are int64 like in ScanPredicate, a column of T can only compare against values T can hold.
+    // 8 byte integers skip the upper check, every int64 fits (uint64 only has the lower one), floats take any value
+    template <typename T>
+    bool BelowType(int64_t Value)
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            return Value < (int64_t)std::numeric_limits<T>::lowest();
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool AboveType(int64_t Value)
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            return sizeof(T) < 8 && Value > (int64_t)std::numeric_limits<T>::max();
+        }
+        return false;
+    }
+
+    template <typename T>
+    T ClampToType(int64_t Value)
+    {
+        if (BelowType<T>(Value)) return std::numeric_limits<T>::lowest();
+        if (AboveType<T>(Value)) return std::numeric_limits<T>::max();
+        return (T)Value;
+    }
+
+    template <typename T, PredicateOp Op>
+    std::unique_ptr<CompiledFilter::BoundPredicate> MakeTyped(const ScanPredicate& Predicate)
+    {
+        auto Bound = std::make_unique<TypedPredicate<T, Op>>();
+        if constexpr (Op == PredicateOp::IN)
+        {
+            for (int64_t Value : Predicate.Values)
+            {
+                if (!BelowType<T>(Value) && !AboveType<T>(Value))
+                {
+                    Bound->InValues.push_back((T)Value);
+                }
+            }
+            std::sort(Bound->InValues.begin(), Bound->InValues.end());
+            Bound->Constants.Values = Bound->InValues.data();
+            Bound->Constants.ValueCount = (int64_t)Bound->InValues.size();
+        }
+        else
+        {
+            Bound->Constants.Low = ClampToType<T>(Predicate.Low);
+            Bound->Constants.High = ClampToType<T>(Predicate.High);
+        }
+        return Bound;
+    }
+
+    template <typename T>
+    std::unique_ptr<CompiledFilter::BoundPredicate> BindPredicate(const ScanPredicate& Predicate)
+    {
+        bool bBelow = BelowType<T>(Predicate.Low);
+        bool bAbove = AboveType<T>(Predicate.Low);
+        bool bOutside = bBelow || bAbove;
+
+        switch (Predicate.Op)
+        {
+        case PredicateOp::EQUAL:
+            if (bOutside) return std::make_unique<ConstantPredicate>(false);
+            return MakeTyped<T, PredicateOp::EQUAL>(Predicate);
+        case PredicateOp::NOT_EQUAL:
+            if (bOutside) return std::make_unique<ConstantPredicate>(true);
+            return MakeTyped<T, PredicateOp::NOT_EQUAL>(Predicate);
+        case PredicateOp::LESS:
+            if (bOutside) return std::make_unique<ConstantPredicate>(bAbove);
+            return MakeTyped<T, PredicateOp::LESS>(Predicate);
+        case PredicateOp::LESS_EQUAL:
+            if (bOutside) return std::make_unique<ConstantPredicate>(bAbove);
+            return MakeTyped<T, PredicateOp::LESS_EQUAL>(Predicate);
+        case PredicateOp::GREATER:
+            if (bOutside) return std::make_unique<ConstantPredicate>(bBelow);
+            return MakeTyped<T, PredicateOp::GREATER>(Predicate);
+        case PredicateOp::GREATER_EQUAL:
+            if (bOutside) return std::make_unique<ConstantPredicate>(bBelow);
+            return MakeTyped<T, PredicateOp::GREATER_EQUAL>(Predicate);
+        case PredicateOp::BETWEEN:
+            // the part of [Low, High] the type can hold, nothing when that's empty
+            if (Predicate.Low > Predicate.High || bAbove || BelowType<T>(Predicate.High)) return std::make_unique<ConstantPredicate>(false);
+            return MakeTyped<T, PredicateOp::BETWEEN>(Predicate);
+        case PredicateOp::IN:
+        {
+            auto Bound = MakeTyped<T, PredicateOp::IN>(Predicate);
+            if (static_cast<TypedPredicate<T, PredicateOp::IN>&>(*Bound).InValues.empty()) return std::make_unique<ConstantPredicate>(false);
+            return Bound;
+        }
+        }
+        throw std::runtime_error("CompiledFilter: unknown predicate op");
+    }
+
+    bool IsStringType(arrow::Type::type Id)
+    {
+        return Id == arrow::Type::STRING || Id == arrow::Type::BINARY || Id == arrow::Type::LARGE_STRING || Id == arrow::Type::LARGE_BINARY;
+    }
+
+    // Byte wise comparison, the same order std::string sorts the IN list in
+    bool MatchesText(const ScanPredicate& Predicate, std::string_view Value)
+    {
+        const std::vector<std::string>& Text = Predicate.TextValues;
+        switch (Predicate.Op)
+        {
+        case PredicateOp::EQUAL: return Value == Text[0];
+        case PredicateOp::NOT_EQUAL: return Value != Text[0];
+        case PredicateOp::LESS: return Value < Text[0];
+        case PredicateOp::LESS_EQUAL: return Value <= Text[0];
+        case PredicateOp::GREATER: return Value > Text[0];
+        case PredicateOp::GREATER_EQUAL: return Value >= Text[0];
+        case PredicateOp::BETWEEN: return Value >= Text[0] && Value <= Text[1];
+        case PredicateOp::IN:
+        {
+            auto Found = std::lower_bound(Text.begin(), Text.end(), Value, [](const std::string& A, std::string_view B) { return A < B; });
+            return Found != Text.end() && *Found == Value;
+        }
+        }
+        return false;
+    }
+
+    void CheckTextConstants(const ScanPredicate& Predicate)
+    {
+        size_t Needed = Predicate.Op == PredicateOp::BETWEEN ? 2 : Predicate.Op == PredicateOp::IN ? 0 : 1;
+        if (Predicate.TextValues.size() < Needed)
+        {
+            throw std::runtime_error("CompiledFilter: text predicate on '" + Predicate.ColumnName + "' is missing its constants");
+        }
+    }
+
+    // A text predicate on a plain string column, one comparison per row
+    template <typename OffsetType>
+    struct StringPredicate : CompiledFilter::BoundPredicate
+    {
+        ScanPredicate Predicate;
+
+        explicit StringPredicate(const ScanPredicate& InPredicate) : Predicate(InPredicate) {}
+
+        void Evaluate(const arrow::ArrayData& Column, ExecutionMode Mode, uint64_t* OutBits) const override
+        {
+            const OffsetType* Offsets = Column.GetValues<OffsetType>(1);
+            const char* Bytes = Column.buffers[2] ? (const char*)Column.buffers[2]->data() : "";
+            for (int64_t Word = 0; Word * 64 < Column.length; ++Word)
+            {
+                int Count = (int)std::min<int64_t>(64, Column.length - Word * 64);
+                uint64_t Bits = 0;
+                for (int i = 0; i < Count; ++i)
+                {
+                    int64_t Row = Word * 64 + i;
+                    std::string_view Value(Bytes + Offsets[Row], (size_t)(Offsets[Row + 1] - Offsets[Row]));
+                    Bits |= (uint64_t)MatchesText(this->Predicate, Value) << i;
+                }
+                OutBits[Word] = Bits;
+            }
+        }
+    };
+
+    // A predicate on a dictionary encoded column. The predicate is evaluated once over the values of every new dictionary
+    // into a bitmap over the codes, the rows only look their code up in it (Kernels/Dictionary.h).
+    // Text predicates take string dictionaries, the usual ones take numeric dictionaries and reuse their typed kernel on the values
+    struct DictionaryPredicate : CompiledFilter::BoundPredicate
+    {
+        ScanPredicate Predicate;
+
+        // the matches of the last dictionary seen. Batches of one column chunk share their dictionary, so this is rebuilt
+        // about once per row group. Holding on to the dictionary keeps a new one from showing up at the same address
+        mutable std::shared_ptr<arrow::ArrayData> Dictionary;
+        mutable std::vector<uint64_t> Matches;
+        mutable std::unique_ptr<CompiledFilter::BoundPredicate> ValuePredicate;
+        mutable arrow::Type::type ValueType = arrow::Type::NA;
+
+        explicit DictionaryPredicate(const ScanPredicate& InPredicate) : Predicate(InPredicate) {}
+
+        void Evaluate(const arrow::ArrayData& Column, ExecutionMode Mode, uint64_t* OutBits) const override
+        {
+            if (Column.dictionary != this->Dictionary)
+            {
+                this->MatchDictionary(Column.dictionary, Mode);
+            }
+
+            Kernels::DictionaryMatches M{ this->Matches.data(), this->Dictionary->length };
+            arrow::Type::type IndexType = static_cast<const arrow::DictionaryType&>(*Column.type).index_type()->id();
+            if (IndexType == arrow::Type::INT32)
+            {
+                const int32_t* Codes = Column.GetValues<int32_t>(1);
+                switch (Mode)
+                {
+                case ExecutionMode::AVX512: Kernels::LookupCodesAvx512(Codes, Column.length, M, OutBits); break;
+                case ExecutionMode::AVX2: Kernels::LookupCodesAvx2(Codes, Column.length, M, OutBits); break;
+                default: Kernels::LookupCodesScalar(Codes, Column.length, M, OutBits); break;
+                }
+                return;
+            }
+
+            // other index widths don't come out of parquet, they get the plain loop
+            bool bSupported = Kernels::VisitNumericType(IndexType, [&](auto Tag)
+            {
+                using T = typename decltype(Tag)::Type;
+                if constexpr (std::is_integral_v<T>)
+                {
+                    Kernels::LookupCodesScalar(Column.GetValues<T>(1), Column.length, M, OutBits);
+                }
+            });
+            if (!bSupported)
+            {
+                throw std::runtime_error("CompiledFilter: dictionary indices must be integers, got " + Column.type->ToString());
+            }
+        }
+
+        void MatchDictionary(const std::shared_ptr<arrow::ArrayData>& Values, ExecutionMode Mode) const
+        {
+            if (Values == nullptr)
+            {
+                throw std::runtime_error("CompiledFilter: dictionary column '" + this->Predicate.ColumnName + "' has no dictionary");
+            }
+
+            this->Dictionary = Values;
+            this->Matches.assign((size_t)std::max<int64_t>((Values->length + 63) / 64, 1), 0);
+            uint64_t* Bits = this->Matches.data();
+
+            arrow::Type::type Id = Values->type->id();
+            if (this->Predicate.bText)
+            {
+                if (!IsStringType(Id))
+                {
+                    throw std::runtime_error("CompiledFilter: text predicate on '" + this->Predicate.ColumnName + "' needs string values, got " + Values->type->ToString());
+                }
+
+                std::shared_ptr<arrow::Array> Array = arrow::MakeArray(Values);
+                bool bLarge = Id == arrow::Type::LARGE_STRING || Id == arrow::Type::LARGE_BINARY;
+                for (int64_t Code = 0; Code < Values->length; ++Code)
+                {
+                    if (Array->IsNull(Code))
+                    {
+                        continue;
+                    }
+                    std::string_view Value = bLarge ?
+                        static_cast<const arrow::LargeBinaryArray&>(*Array).GetView(Code) :
+                        static_cast<const arrow::BinaryArray&>(*Array).GetView(Code);
+                    Bits[Code >> 6] |= (uint64_t)MatchesText(this->Predicate, Value) << (Code & 63);
+                }
+                return;
+            }
+
+            if (this->ValuePredicate == nullptr || this->ValueType != Id)
+            {
+                bool bSupported = Kernels::VisitNumericType(Id, [&](auto Tag)
+                {
+                    using T = typename decltype(Tag)::Type;
+                    this->ValuePredicate = BindPredicate<T>(this->Predicate);
+                });
+                if (!bSupported)
+                {
+                    throw std::runtime_error("CompiledFilter: predicate column must be a number, got dictionary of " + Values->type->ToString());
+                }
+                this->ValueType = Id;
+            }
+
+            this->ValuePredicate->Evaluate(*Values, Mode, Bits);
+            if (Values->GetNullCount() > 0)
+            {
+                Kernels::AndValidity(Bits, Values->length, Values->buffers[0]->data(), Values->offset);
+            }
+        }
+    };
+
+    // number of levels, a node at level d uses the scratch bitmap d for its children
+    int TreeDepth(const FilterExpression& Expression)
+    {
+        int Depth = 0;
+        for (const FilterExpression& Child : Expression.Children)
+        {
+            Depth = std::max(Depth, TreeDepth(Child));
+        }
+        return Depth + 1;
+    }
+}
+
+CompiledFilter::CompiledFilter(FilterExpression InExpression)
+    : Expression(std::move(InExpression))
+{
+    this->Root = this->Build(this->Expression);
+    this->Scratch.resize(TreeDepth(this->Expression));
+}
+
+CompiledFilter::~CompiledFilter() = default;
+
+CompiledFilter::Node CompiledFilter::Build(const FilterExpression& From)
+{
+    Node Built;
+    Built.Type = From.Type;
+    if (From.Type == FilterExpression::Kind::PREDICATE)
+    {
+        Built.Predicate = From.Predicate;
+        Built.ColumnIndex = From.Predicate.ColumnName.empty() ? From.Predicate.ColumnIndex : -1;
+        return Built;
+    }
+
+    if (From.Children.empty())
+    {
+        throw std::runtime_error("CompiledFilter: AND / OR needs at least one child");
+    }
+    for (const FilterExpression& Child : From.Children)
+    {
+        Built.Children.push_back(this->Build(Child));
+    }
+    return Built;
+}
+
+// The type of the column is looked at here once, every batch after that goes straight to the bound kernel
+void CompiledFilter::Bind(Node& Leaf, const arrow::RecordBatch& Batch)
+{
+    if (Leaf.ColumnIndex < 0)
+    {
+        Leaf.ColumnIndex = Batch.schema()->GetFieldIndex(Leaf.Predicate.ColumnName);
+    }
+    if (Leaf.ColumnIndex < 0 || Leaf.ColumnIndex >= Batch.num_columns())
+    {
+        throw std::runtime_error("CompiledFilter: no column named '" + Leaf.Predicate.ColumnName + "'");
+    }
+
+    const arrow::DataType& ColumnType = *Batch.column_data(Leaf.ColumnIndex)->type;
+    Leaf.BoundType = ColumnType.id();
+    if (Leaf.Predicate.bText)
+    {
+        CheckTextConstants(Leaf.Predicate);
+    }
+
+    if (ColumnType.id() == arrow::Type::DICTIONARY)
+    {
+        Leaf.Bound = std::make_unique<DictionaryPredicate>(Leaf.Predicate);
+        return;
+    }
+
+    if (Leaf.Predicate.bText)
+    {
+        switch (ColumnType.id())
+        {
+        case arrow::Type::STRING:
+        case arrow::Type::BINARY:
+            Leaf.Bound = std::make_unique<StringPredicate<int32_t>>(Leaf.Predicate);
+            return;
+        case arrow::Type::LARGE_STRING:
+        case arrow::Type::LARGE_BINARY:
+            Leaf.Bound = std::make_unique<StringPredicate<int64_t>>(Leaf.Predicate);
+            return;
+        default:
+            throw std::runtime_error("CompiledFilter: text predicate column must be a string, got " + ColumnType.ToString());
+        }
+    }
+
+    bool bSupported = Kernels::VisitNumericType(ColumnType.id(), [&](auto Tag)
+    {
+        using T = typename decltype(Tag)::Type;
+        Leaf.Bound = BindPredicate<T>(Leaf.Predicate);
+    });
+
+    if (!bSupported)
+    {
+        throw std::runtime_error("CompiledFilter: predicate column must be a number, got " + ColumnType.ToString());
+    }
+}
+
+void CompiledFilter::Evaluate(Node& N, const arrow::RecordBatch& Batch, ExecutionMode Mode, int Depth, uint64_t* OutBits)
+{
+    int64_t Words = (Batch.num_rows() + 63) / 64;
+
+    if (N.Type == FilterExpression::Kind::PREDICATE)
+    {
+        if (N.ColumnIndex < 0 || Batch.column_data(N.ColumnIndex)->type->id() != N.BoundType)
+        {
+            this->Bind(N, Batch);
+        }
+
+        const arrow::ArrayData& Column = *Batch.column_data(N.ColumnIndex);
+        N.Bound->Evaluate(Column, Mode, OutBits);
+
+        // a null never matches, whatever the comparison says about the garbage in its slot
+        if (Column.GetNullCount() > 0)
+        {
+            Kernels::AndValidity(OutBits, Column.length, Column.buffers[0]->data(), Column.offset);
+        }
+        return;
+    }
+
+    bool bAnd = N.Type == FilterExpression::Kind::AND;
+    this->Evaluate(N.Children[0], Batch, Mode, Depth + 1, OutBits);
+
+    uint64_t* ChildBits = this->Scratch[Depth].data();
+    for (size_t i = 1; i < N.Children.size(); ++i)
+    {
+        if (bAnd && std::all_of(OutBits, OutBits + Words, [](uint64_t Word) { return Word == 0; }))
+        {
+            return; // nothing left that the other predicates could keep
+        }
+
+        this->Evaluate(N.Children[i], Batch, Mode, Depth + 1, ChildBits);
+        if (bAnd)
+        {
+            for (int64_t w = 0; w < Words; ++w) OutBits[w] &= ChildBits[w];
+        }
+        else
+        {
+            for (int64_t w = 0; w < Words; ++w) OutBits[w] |= ChildBits[w];
+        }
+    }
+}
+
+void CompiledFilter::EvaluateBits(const arrow::RecordBatch& Batch, ExecutionMode Mode, uint64_t* OutBits)
+{
+    size_t Words = (size_t)((Batch.num_rows() + 63) / 64);
+    for (std::vector<uint64_t>& Bits : this->Scratch)
+    {
+        if (Bits.size() < Words)
+        {
+            Bits.resize(Words);
+        }
+    }
+    this->Evaluate(this->Root, Batch, Mode, 0, OutBits);
+}
+
+int64_t CompiledFilter::Apply(const arrow::RecordBatch& Batch, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection, ExecutionMode Mode)
+{
+    int64_t Length = Batch.num_rows();
+    size_t Words = (size_t)((Length + 63) / 64);
+    if (this->Result.size() < Words)
+    {
+        this->Result.resize(Words);
+    }
+
+    uint64_t* Bits = this->Result.data();
+    this->EvaluateBits(Batch, Mode, Bits);
+
+    if (InSelection != nullptr)
+    {
+        // the child already dropped rows, only the ones it kept can pass
+        uint64_t* Selected = this->Scratch[0].data();
+        Kernels::SelectionToBits(InSelection, InCount, Length, Selected);
+        for (size_t w = 0; w < Words; ++w) Bits[w] &= Selected[w];
+    }
+
+    switch (Mode)
+    {
+    case ExecutionMode::AVX512: return Kernels::BitsToSelectionAvx512(Bits, Length, OutSelection);
+    case ExecutionMode::AVX2: return Kernels::BitsToSelectionAvx2(Bits, Length, OutSelection);
+    default: return Kernels::BitsToSelectionScalar(Bits, Length, OutSelection);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Operator.h"
+#include "ScanPredicate.h"
+#include <memory>
+#include <vector>
+
+// A WHERE clause: predicates on one column each (ScanPredicate) combined with AND / OR, e.g.
+// FilterExpression::And({ Where(Between("x", 10, 20)), FilterExpression::Or({ Where(In("y", {1, 2})), Where(Compare("z", NOT_EQUAL, 0)) }) }).
+// A null never matches a predicate, same as x > C
+struct FilterExpression
+{
+    enum class Kind
+    {
+        PREDICATE,
+        AND,
+        OR
+    };
+
+    Kind Type = Kind::PREDICATE;
+    ScanPredicate Predicate;                // PREDICATE only
+    std::vector<FilterExpression> Children; // AND / OR only
+
+    static FilterExpression Where(const ScanPredicate& Predicate)
+    {
+        FilterExpression Expression;
+        Expression.Predicate = Predicate;
+        return Expression;
+    }
+
+    static FilterExpression And(std::vector<FilterExpression> Children)
+    {
+        FilterExpression Expression;
+        Expression.Type = Kind::AND;
+        Expression.Children = std::move(Children);
+        return Expression;
+    }
+
+    static FilterExpression Or(std::vector<FilterExpression> Children)
+    {
+        FilterExpression Expression;
+        Expression.Type = Kind::OR;
+        Expression.Children = std::move(Children);
+        return Expression;
+    }
+
+    // The predicates every row that passes satisfies (the ones ANDed at the top), those are safe to push into a scan
+    std::vector<ScanPredicate> Conjuncts() const;
+
+    // Every column a predicate reads, for PushProjection
+    std::vector<ColumnRef> Columns() const;
+};
+
+// A FilterExpression bound to the types of the batch. Every predicate gets its (PredicateOp, T) kernel from
+// Kernels/Predicates.h picked once at bind time and writes a bitmap of the rows it matches per batch, AND / OR combine
+// those bitmaps word by word and the rows are only compacted into a selection vector at the very end.
+// A predicate on a dictionary encoded column is evaluated on the dictionary's values instead, once per dictionary,
+// and the rows look their code up in the result (Kernels/Dictionary.h)
+class CompiledFilter
+{
+public:
+    explicit CompiledFilter(FilterExpression InExpression);
+    ~CompiledFilter();
+
+    // Writes the rows of InSelection (every row of Batch when InSelection is nullptr) that satisfy the expression
+    // to OutSelection and returns how many there are. OutSelection needs room for Batch.num_rows() + 16 rows and
+    // may point to InSelection. Binds on the first batch and again for a column whose type changed
+    int64_t Apply(const arrow::RecordBatch& Batch, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection, ExecutionMode Mode);
+
+    // The rows of Batch that satisfy the expression as bits (row i is bit i % 64 of word i / 64), 0 past the last row.
+    // OutBits needs room for (Batch.num_rows() + 63) / 64 words
+    void EvaluateBits(const arrow::RecordBatch& Batch, ExecutionMode Mode, uint64_t* OutBits);
+
+    const FilterExpression& GetExpression() const { return this->Expression; }
+
+    // One predicate bound to the type of its column, defined in the .cpp
+    struct BoundPredicate;
+
+private:
+    struct Node
+    {
+        FilterExpression::Kind Type = FilterExpression::Kind::PREDICATE;
+        ScanPredicate Predicate;
+        int ColumnIndex = -1;
+        arrow::Type::type BoundType = arrow::Type::NA;
+        std::unique_ptr<BoundPredicate> Bound;
+        std::vector<Node> Children;
+    };
+
+    Node Build(const FilterExpression& From);
+    void Bind(Node& Leaf, const arrow::RecordBatch& Batch);
+
+    // The rows matching N as bits. A node at Depth evaluates its first child into OutBits and the others into
+    // Scratch[Depth], the children themselves only use the bitmaps below that
+    void Evaluate(Node& N, const arrow::RecordBatch& Batch, ExecutionMode Mode, int Depth, uint64_t* OutBits);
+
+    FilterExpression Expression;
+    Node Root;
+
+    std::vector<std::vector<uint64_t>> Scratch; // one bitmap per level of the tree, reused between batches
+    std::vector<uint64_t> Result;
+};
@@ -1,117 +1,293 @@
 #include "pch.h"
 #include "FilterOperator.h"
-#include "arrow/builder.h"
+#include "Kernels/TypedKernels.h"
+#include "RuntimeFilter.h"
+#include "ScanPredicate.h"
+#include "../Execution/ChunkBufferPool.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
 
-FilterOperator::FilterOperator(std::unique_ptr<Operator> Child, int FilterValue, ExecutionMode Mode)
+FilterOperator::FilterOperator(std::unique_ptr<Operator> Child, int FilterValue, ExecutionMode Mode, int PredicateColumn)
 {
     this->ChildOperator = std::move(Child);
     this->ValueToCompare = FilterValue;
-    this->CurrentMode = Mode;
+    this->CurrentMode = ResolveExecutionMode(Mode);
+    this->PredicateColumnIndex = PredicateColumn;
+
+    // hand our own predicate down too, a scan below can then skip the row groups where nothing is > FilterValue
+    if (PredicateColumn >= 0)
+    {
+        ScanPredicate Predicate = ScanPredicate::Compare("", PredicateOp::GREATER, FilterValue);
+        Predicate.ColumnIndex = PredicateColumn;
+        this->ChildOperator->PushPredicate(Predicate);
+    }
 }
 
-DataChunk FilterOperator::Next()
+FilterOperator::FilterOperator(std::unique_ptr<Operator> Child, int FilterValue, ExecutionMode Mode, const std::string& PredicateColumnName)
+    : FilterOperator(std::move(Child), FilterValue, Mode, -1)
 {
-    DataChunk InputChunk = this->ChildOperator->Next();
-    if (InputChunk == nullptr)
+    this->PredicateColumnName = PredicateColumnName;
+    this->ChildOperator->PushPredicate(ScanPredicate::Compare(PredicateColumnName, PredicateOp::GREATER, FilterValue));
+}
+
+FilterOperator::FilterOperator(std::unique_ptr<Operator> Child, FilterExpression Where, ExecutionMode Mode)
+{
+    this->ChildOperator = std::move(Child);
+    this->ValueToCompare = 0;
+    this->CurrentMode = ResolveExecutionMode(Mode);
+    this->PredicateColumnIndex = -1;
+
+    // the predicates ANDed at the top hold for every row we return, the scan may skip on them
+    for (const ScanPredicate& Predicate : Where.Conjuncts())
     {
-        return nullptr;
+        this->ChildOperator->PushPredicate(Predicate);
     }
+    this->Where = std::make_unique<CompiledFilter>(std::move(Where));
+}
 
-    if (this->CurrentMode == ExecutionMode::AVX2)
+bool FilterOperator::PushPredicate(const ScanPredicate& Predicate)
+{
+    return this->ChildOperator->PushPredicate(Predicate);
+}
+
+bool FilterOperator::PushProjection(const std::vector<ColumnRef>& Columns)
+{
+    std::vector<ColumnRef> Needed = Columns;
+    if (this->Where)
     {
-        return this->ApplyAvx2Filter(InputChunk);
+        std::vector<ColumnRef> PredicateColumns = this->Where->GetExpression().Columns();
+        Needed.insert(Needed.end(), PredicateColumns.begin(), PredicateColumns.end());
     }
     else
     {
-        return this->ApplyScalarFilter(InputChunk);
+        Needed.push_back(this->PredicateColumnName.empty() ? ColumnRef::At(this->PredicateColumnIndex) : ColumnRef::Named(this->PredicateColumnName));
     }
+    return this->ChildOperator->PushProjection(Needed);
 }
 
-// Quick breakdown of instrinics
-// _mm256_cmpgt_epi32
-// _mm256 -> Operates on 256-bit wide vectors (8 x 32-bit integers)
-// _cmpgt -> Operation: compare greater than
-// _epi32 -> Data type: e: "extended", p: operates on all elements in the vector, i32: 32-bit signed integers
-
-// Processes 8 integers at a time to find values that are greater than ValueToCompare
-// TODO: Change this to adhere to our new standards for Operator. We no longer need to use arrow:Int32Array and can instead just use a simple int32_t*
-DataChunk FilterOperator::ApplyAvx2Filter(const DataChunk& InputChunk)
+DataChunk FilterOperator::Next()
 {
+    // we are the root (or the consumer wants real columns), so compact the survivors of every column here.
+    // The columns are written into the buffers of batches the consumer already dropped, so a steady scan allocates nothing
+    if (!this->OutputBuffers)
+    {
+        this->OutputBuffers = ChunkBufferPool::Make(this->Memory);
+    }
+    return this->NextSelected().Materialize(this->Memory, this->OutputBuffers.get());
+}
 
-    // get the input column (just the first column for now since we are testing)
-    std::shared_ptr<arrow::Int32Array> Column = std::static_pointer_cast<arrow::Int32Array>(InputChunk->column(0));
-    const int32_t* InputData = Column->raw_values();
-    int64_t InputLength = Column->length();
-    arrow::Int32Builder Builder;
-
-    
-    // We will write to this buffer inside the loops, then do one
-    // bulk append to the Arrow builder at the end. This avoids
-    // the high overhead of calling Builder.Append() repeatedly.
-    std::unique_ptr<int32_t[]> OutputBuffer(new int32_t[InputLength]);
-    int64_t OutputCount = 0;
+SelectedChunk FilterOperator::NextSelected()
+{
+    SelectedChunk Input = this->ChildOperator->NextSelected();
+    if (Input.IsEnd())
+    {
+        return Input;
+    }
 
-    // Fill the CompareVector with the ValueToCompare 8 times
-    // [v0 v0 v0 v0 v0 v0 v0 v0] where v0 = ValueToCompare
-    __m256i CompareVector = _mm256_set1_epi32(this->ValueToCompare);
-    alignas(32) int32_t TmpBuffer[8];
-    // process the data in chunks of 8 integers
-    int i = 0;
-    for (; i <= InputLength - 8; i += 8)
+    if (this->Where)
     {
-        __m256i DataVector = _mm256_load_si256((__m256i*)(InputData + i)); // aligned load
-        // compare each element in DataVector with CompareVector
-        // generates a mask where each element is all 1s (0xFFFFFFFF) if the condition is true, or all 0s if false
-        // example: [0xFFFFFFFF 0 0xFFFFFFFF 0 0 0xFFFFFFFF 0 0] for a comparison result of [true, false, true, false, false, true, false, false]
-        __m256i MaskVector = _mm256_cmpgt_epi32(DataVector, CompareVector);
-        // take the top bit from each mask and create an 8-bit integer mask
-        int Mask = _mm256_movemask_ps(_mm256_castsi256_ps(MaskVector));
+        return this->NextSelectedWhere(Input);
+    }
 
-        if (Mask == 0)
+    if (this->PredicateColumnIndex < 0)
+    {
+        this->PredicateColumnIndex = Input.Batch->schema()->GetFieldIndex(this->PredicateColumnName);
+        if (this->PredicateColumnIndex < 0)
         {
-            // all 8 elements failed the check. Skip.
-            continue;
+            throw std::runtime_error("FilterOperator: no column named '" + this->PredicateColumnName + "'");
         }
-        else if (Mask == 0xFF)
+    }
+
+    // The predicate is evaluated on one column only, the resulting selection is later applied to all of them
+    const std::shared_ptr<arrow::Array>& PredicateColumn = Input.Batch->column(this->PredicateColumnIndex);
+    if (PredicateColumn->type_id() != this->BoundType)
+    {
+        this->Bind(*PredicateColumn->type());
+    }
+
+    int64_t InputLength = PredicateColumn->length();
+
+    // worst case every row survives, +16 because the compress-store always writes a full vector
+    if ((int64_t)this->SelectionBuffer.size() < InputLength + 16)
+    {
+        this->SelectionBuffer.resize(InputLength + 16);
+    }
+    int32_t* OutSelection = this->SelectionBuffer.data();
+
+    int64_t OutputCount = Input.HasSelection()
+        ? (this->*this->Kernel)(*PredicateColumn->data(), Input.Selection, Input.Count, OutSelection)
+        : (this->*this->Kernel)(*PredicateColumn->data(), nullptr, InputLength, OutSelection);
+
+    for (const std::shared_ptr<const RuntimeFilter>& Filter : this->RuntimeFilters)
+    {
+        OutputCount = Filter->Apply(*Input.Batch, OutSelection, OutputCount, OutSelection, this->CurrentMode);
+    }
+
+    return SelectedChunk(Input.Batch, OutSelection, OutputCount);
+}
+
+// Every predicate of the expression writes a bitmap, the bitmaps are combined and the rows compacted once at the end
+SelectedChunk FilterOperator::NextSelectedWhere(const SelectedChunk& Input)
+{
+    int64_t InputLength = Input.Batch->num_rows();
+    if ((int64_t)this->SelectionBuffer.size() < InputLength + 16)
+    {
+        this->SelectionBuffer.resize(InputLength + 16);
+    }
+    int32_t* OutSelection = this->SelectionBuffer.data();
+
+    int64_t OutputCount = this->Where->Apply(*Input.Batch, Input.Selection, Input.HasSelection() ? Input.Count : InputLength, OutSelection, this->CurrentMode);
+
+    for (const std::shared_ptr<const RuntimeFilter>& Filter : this->RuntimeFilters)
+    {
+        OutputCount = Filter->Apply(*Input.Batch, OutSelection, OutputCount, OutSelection, this->CurrentMode);
+    }
+
+    return SelectedChunk(Input.Batch, OutSelection, OutputCount);
+}
+
+bool FilterOperator::PushRuntimeFilter(std::shared_ptr<const RuntimeFilter> Filter)
+{
+    this->RuntimeFilters.push_back(std::move(Filter));
+    return true;
+}
+
+bool FilterOperator::FusePipelines()
+{
+    return this->ChildOperator->FusePipelines();
+}
+
+void FilterOperator::Close()
+{
+    this->bFinished = true;
+    // the buffers still out in batches keep the recycler alive until they come back
+    this->OutputBuffers = nullptr;
+    // nullptr once the child was handed to a fused aggregate
+    if (this->ChildOperator)
+    {
+        this->ChildOperator->Close();
+    }
+}
+
+void FilterOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    if (this->ChildOperator)
+    {
+        this->ChildOperator->UseMemoryPool(Pool);
+    }
+}
+
+std::unique_ptr<Operator> FilterOperator::ReleaseFilterForFusion(const ColumnRef& Column, ScanPredicate& Predicate)
+{
+    bool bAnyColumn = Column.Name.empty() && Column.Index < 0;
+    bool bSameColumn = bAnyColumn || (this->PredicateColumnName.empty()
+        ? Column.Name.empty() && Column.Index == this->PredicateColumnIndex
+        : Column.Name == this->PredicateColumnName);
+    if (this->Where || !bSameColumn || !this->RuntimeFilters.empty())
+    {
+        return nullptr;
+    }
+
+    Predicate = ScanPredicate::Compare(this->PredicateColumnName, PredicateOp::GREATER, this->ValueToCompare);
+    Predicate.ColumnIndex = this->PredicateColumnIndex;
+    return std::move(this->ChildOperator);
+}
+
+// The type of the column is looked at here once, every batch after that goes straight to FilterColumn<T>
+void FilterOperator::Bind(const arrow::DataType& ColumnType)
+{
+    FilterKernel Bound = nullptr;
+    bool bSupported = Kernels::VisitNumericType(ColumnType.id(), [&](auto Tag)
+    {
+        using T = typename decltype(Tag)::Type;
+
+        // an int8 column is never > 200 and always > -1000, don't compare what the cast would wrap around
+        switch (Kernels::FitGreaterConstant<T>(this->ValueToCompare))
         {
-            // all 8 ints passed the check, do a fast bulk copy
-            std::memcpy(OutputBuffer.get() + OutputCount, InputData + i, 8 * sizeof(int32_t));
-            OutputCount += 8;
+        case Kernels::ConstantFit::ALL: Bound = &FilterOperator::SelectAll; break;
+        case Kernels::ConstantFit::NONE: Bound = &FilterOperator::SelectNone; break;
+        default: Bound = &FilterOperator::FilterColumn<T>; break;
         }
-        else
+    });
+
+    if (!bSupported)
+    {
+        throw std::runtime_error("FilterOperator: predicate column must be a number, got " + ColumnType.ToString());
+    }
+
+    this->Kernel = Bound;
+    this->BoundType = ColumnType.id();
+}
+
+// A null row is never > the constant. A column with nulls goes through the bNullable kernels, which AND the
+// compare mask with the validity bits; when the input is a selection the nulls are dropped from what survived
+template <typename T>
+int64_t FilterOperator::FilterColumn(const arrow::ArrayData& Column, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection)
+{
+    const T* Data = Column.GetValues<T>(1); // already moved by the slice offset
+    T Value = (T)this->ValueToCompare;
+    const uint8_t* Validity = Column.GetNullCount() > 0 ? Column.buffers[0]->data() : nullptr;
+
+    if (InSelection != nullptr)
+    {
+        // Used when the child already filtered the batch, only the selected rows get re-checked
+        int64_t OutputCount;
+        switch (this->CurrentMode)
         {
-            // Some elements passed. This is the original "slow gather" path,
-            // atleast 1 value passed the check, store the data to TmpBuffer
-            _mm256_storeu_si256((__m256i*)TmpBuffer, DataVector);
-            for (int j = 0; j < 8; ++j)
-            {
-                // find which value passed the check using the Mask
-                if ((Mask >> j) & 1)
-                {
-                    OutputBuffer[OutputCount++] = TmpBuffer[j];
-                }
-            }
+        case ExecutionMode::AVX512: OutputCount = Kernels::RefineGreaterAvx512(Data, InSelection, InCount, Value, OutSelection); break;
+        case ExecutionMode::AVX2: OutputCount = Kernels::RefineGreaterAvx2(Data, InSelection, InCount, Value, OutSelection); break;
+        default: OutputCount = Kernels::RefineGreaterScalar(Data, InSelection, InCount, Value, OutSelection); break;
         }
+        return Validity != nullptr ? Kernels::DropNulls(Validity, Column.offset, OutSelection, OutputCount, OutSelection) : OutputCount;
     }
-    // scalar processing for remaining elements that didn't fit into a vector of 8 ints
-    for (; i < InputLength; ++i)
+
+    if (Validity != nullptr)
     {
-        if (InputData[i] > this->ValueToCompare)
+        switch (this->CurrentMode)
         {
-            
-            OutputBuffer[OutputCount++] = InputData[i];
+        case ExecutionMode::AVX512: return Kernels::FilterGreaterAvx512<T, true>(Data, InCount, Value, OutSelection, Validity, Column.offset);
+        case ExecutionMode::AVX2: return Kernels::FilterGreaterAvx2<T, true>(Data, InCount, Value, OutSelection, Validity, Column.offset);
+        default: return Kernels::FilterGreaterScalar<T, true>(Data, InCount, Value, OutSelection, Validity, Column.offset);
         }
     }
 
-    // fast bulk append to the builder
-    PARQUET_THROW_NOT_OK(Builder.AppendValues(OutputBuffer.get(), OutputCount));
-
-    std::shared_ptr<arrow::Array> FilteredArray;
-    PARQUET_THROW_NOT_OK(Builder.Finish(&FilteredArray));
-    return arrow::RecordBatch::Make(InputChunk->schema(), FilteredArray->length(), { FilteredArray });
+    switch (this->CurrentMode)
+    {
+    case ExecutionMode::AVX512: return Kernels::FilterGreaterAvx512(Data, InCount, Value, OutSelection);
+    case ExecutionMode::AVX2: return Kernels::FilterGreaterAvx2(Data, InCount, Value, OutSelection);
+    default: return Kernels::FilterGreaterScalar(Data, InCount, Value, OutSelection);
+    }
 }
 
+// every row is > the constant, except the null ones
+int64_t FilterOperator::SelectAll(const arrow::ArrayData& Column, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection)
+{
+    const uint8_t* Validity = Column.GetNullCount() > 0 ? Column.buffers[0]->data() : nullptr;
+    if (InSelection != nullptr)
+    {
+        if (Validity != nullptr)
+        {
+            return Kernels::DropNulls(Validity, Column.offset, InSelection, InCount, OutSelection);
+        }
+        std::copy(InSelection, InSelection + InCount, OutSelection);
+    }
+    else
+    {
+        if (Validity != nullptr)
+        {
+            return Kernels::SelectValid(Validity, Column.offset, InCount, OutSelection);
+        }
+        std::iota(OutSelection, OutSelection + InCount, 0);
+    }
+    return InCount;
+}
 
+int64_t FilterOperator::SelectNone(const arrow::ArrayData& Column, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection)
+{
+    return 0;
+}
 
 //DataChunk FilterOperator::ApplyAvxFilter(const DataChunk& InputChunk)
 //{
@@ -170,28 +346,3 @@ DataChunk FilterOperator::ApplyAvx2Filter(const DataChunk& InputChunk)
 //
 //    return arrow::RecordBatch::Make(InputChunk->schema(), FilteredArray->length(), { FilteredArray });
 //}
-
-
-// Scalar version for comparison
-DataChunk FilterOperator::ApplyScalarFilter(const DataChunk& InputChunk)
-{
-    std::shared_ptr<arrow::Int32Array> Column = std::static_pointer_cast<arrow::Int32Array>(InputChunk->column(0));
-
-    const int* InputData = Column->raw_values();
-    int64_t InputLength = Column->length();
-
-    arrow::Int32Builder Builder;
-
-    for (int i = 0; i < InputLength; ++i)
-    {
-        if (InputData[i] > this->ValueToCompare)
-        {
-            PARQUET_THROW_NOT_OK(Builder.Append(InputData[i]));
-        }
-    }
-
-    std::shared_ptr<arrow::Array> FilteredArray;
-    PARQUET_THROW_NOT_OK(Builder.Finish(&FilteredArray));
-
-    return arrow::RecordBatch::Make(InputChunk->schema(), FilteredArray->length(), { FilteredArray });
-}
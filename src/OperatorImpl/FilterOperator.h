@@ -1,21 +1,91 @@
 #pragma once
 
 #include "Operator.h"
+#include "FilterExpression.h"
+#include <vector>
+#include <string>
+
+class ChunkBufferPool;
 
 class FilterOperator : public Operator
 {
 public:
 
 	// For our limmited example, we simplify the filter to a single integer comparison
-	// If the value in the column is greater than FilterValue, we keep it
-    FilterOperator(std::unique_ptr<Operator> Child, int FilterValue, ExecutionMode Mode);
+	// If the value in the column is greater than FilterValue, we keep it.
+    // The column can be any fixed width number type (int8 ... uint64, float, double, dates and timestamps)
+    // PredicateColumn is the column the comparison runs on, every other column of the batch is carried along
+    FilterOperator(std::unique_ptr<Operator> Child, int FilterValue, ExecutionMode Mode, int PredicateColumn = 0);
+
+    // Same but the predicate column is looked up by name in the schema of the first batch
+    FilterOperator(std::unique_ptr<Operator> Child, int FilterValue, ExecutionMode Mode, const std::string& PredicateColumnName);
+
+    // Any WHERE clause: comparisons, BETWEEN, IN and AND / OR of them over any number of columns (see FilterExpression.h)
+    FilterOperator(std::unique_ptr<Operator> Child, FilterExpression Where, ExecutionMode Mode);
 
+    // Materializes the surviving rows into a new batch, only used when the filter is the root of the plan
     DataChunk Next() override;
 
+    // Returns the child's batch untouched plus the indices of the rows that passed
+    SelectedChunk NextSelected() override;
+
+    // Filters don't change the columns, so a predicate from above is valid below us too
+    bool PushPredicate(const ScanPredicate& Predicate) override;
+
+    // Passes the columns on together with the predicate column(s)
+    bool PushProjection(const std::vector<ColumnRef>& Columns) override;
+
+    // Runtime filters are applied to the rows that passed the predicate, so they only see the survivors
+    bool PushRuntimeFilter(std::shared_ptr<const RuntimeFilter> Filter) override;
+
+    bool FusePipelines() override;
+
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    // Gives x > FilterValue and our child to the aggregate above when the predicate is on the column it reads,
+    // or to a projection above on any column. Not once runtime filters were pushed, those only run in here,
+    // and not for a FilterExpression
+    std::unique_ptr<Operator> ReleaseFilterForFusion(const ColumnRef& Column, ScanPredicate& Predicate) override;
+
 private:
-    DataChunk ApplyAvx2Filter(const DataChunk& InputChunk);
-    DataChunk ApplyScalarFilter(const DataChunk& InputChunk);
+    // Writes the indices of the rows with x > ValueToCompare to OutSelection and returns how many passed.
+    // InSelection nullptr means every row of the column (InCount is its length then)
+    using FilterKernel = int64_t (FilterOperator::*)(const arrow::ArrayData& Column, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection);
+
+    // Picks the kernel for the type of the predicate column, runs on the first batch (and again if the type ever changes)
+    void Bind(const arrow::DataType& ColumnType);
+
+    // x > ValueToCompare on a column of T, the mode switch happens in here
+    template <typename T>
+    int64_t FilterColumn(const arrow::ArrayData& Column, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection);
+
+    // NextSelected for a FilterExpression
+    SelectedChunk NextSelectedWhere(const SelectedChunk& Input);
+
+    // ValueToCompare is outside of what the type can hold, so the answer is the same for every row
+    int64_t SelectAll(const arrow::ArrayData& Column, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection);
+    int64_t SelectNone(const arrow::ArrayData& Column, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection);
+
+    FilterKernel Kernel = nullptr;
+    arrow::Type::type BoundType = arrow::Type::NA;
+
 	std::unique_ptr<Operator> ChildOperator; // Typically a ScanOperator or MemoryScanOperator
 	int ValueToCompare; // If x > ValueToCompare, keep x
-};
 
+    int PredicateColumnIndex; // -1 until PredicateColumnName has been resolved
+    std::string PredicateColumnName;
+
+    // Reused between chunks so we don't allocate a selection vector per batch
+    std::vector<int32_t> SelectionBuffer;
+
+    // Buffers of the batches Next() returns, they come back once the consumer drops a batch. Made on the first Next()
+    // so it uses the pool of UseMemoryPool()
+    std::shared_ptr<ChunkBufferPool> OutputBuffers;
+
+    // set when we were built from a FilterExpression, everything above about the single x > C predicate is unused then
+    std::unique_ptr<CompiledFilter> Where;
+
+    std::vector<std::shared_ptr<const RuntimeFilter>> RuntimeFilters;
+};
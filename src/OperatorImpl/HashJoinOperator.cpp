@@ -0,0 +1,394 @@
+#include "pch.h"
+#include "HashJoinOperator.h"
+#include "RuntimeFilter.h"
+#include "Kernels/Gather.h"
+#include "Kernels/Hash.h"
+#include "Kernels/Validity.h"
+#include <arrow/array/concatenate.h>
+#include <climits>
+#include <stdexcept>
+
+// how many probe rows ahead the bucket head gets prefetched
+static constexpr int64_t PrefetchDistance = 16;
+
+// a partition's bucket array stops fitting in L2 past this many buckets
+static constexpr int64_t BucketsPerPartition = 64 * 1024;
+
+HashJoinOperator::HashJoinOperator(std::unique_ptr<Operator> Build, std::unique_ptr<Operator> Probe, const std::string& BuildKeyColumn, const std::string& ProbeKeyColumn, JoinType Type, ExecutionMode Mode)
+    : Operator(Mode)
+{
+    this->BuildChild = std::move(Build);
+    this->ProbeChild = std::move(Probe);
+    this->BuildKeyName = BuildKeyColumn;
+    this->ProbeKeyName = ProbeKeyColumn;
+    this->Type = Type;
+    this->bFinished = false;
+
+    // semi and anti joins never output a build column, the build side only has to deliver its key
+    if (this->Type != JoinType::INNER)
+    {
+        this->BuildChild->PushProjection({ ColumnRef::Named(this->BuildKeyName) });
+    }
+}
+
+bool HashJoinOperator::FusePipelines()
+{
+    bool bBuildFused = this->BuildChild->FusePipelines();
+    bool bProbeFused = this->ProbeChild->FusePipelines();
+    return bBuildFused || bProbeFused;
+}
+
+void HashJoinOperator::Close()
+{
+    this->bFinished = true;
+    this->BuildChild->Close();
+    this->ProbeChild->Close();
+
+    this->BuildBatch = nullptr;
+    this->BuildKeys = std::vector<int64_t>();
+    this->Buckets = std::vector<int32_t>();
+    this->NextRow = std::vector<int32_t>();
+}
+
+void HashJoinOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->BuildChild->UseMemoryPool(Pool);
+    this->ProbeChild->UseMemoryPool(Pool);
+}
+
+bool HashJoinOperator::PushProjection(const std::vector<ColumnRef>& Columns)
+{
+    std::vector<ColumnRef> ProbeColumns = Columns;
+    ProbeColumns.push_back(ColumnRef::Named(this->ProbeKeyName));
+
+    if (this->Type != JoinType::INNER)
+    {
+        // the output is the probe batch itself, positions mean the same thing there
+        return this->ProbeChild->PushProjection(ProbeColumns);
+    }
+
+    // a position in the joined batch can't be mapped to a side before we know how many columns the probe side has
+    for (const ColumnRef& Ref : Columns)
+    {
+        if (Ref.Name.empty())
+        {
+            return false;
+        }
+    }
+
+    // names that belong to the other side are simply not found there
+    std::vector<ColumnRef> BuildColumns = Columns;
+    BuildColumns.push_back(ColumnRef::Named(this->BuildKeyName));
+    bool bProbeAccepted = this->ProbeChild->PushProjection(ProbeColumns);
+    bool bBuildAccepted = this->BuildChild->PushProjection(BuildColumns);
+    return bProbeAccepted || bBuildAccepted;
+}
+
+bool HashJoinOperator::ReadKeys(const arrow::RecordBatch& Batch, const std::string& ColumnName, const int32_t* Selection, int64_t Count, int64_t* OutKeys, uint8_t* OutValid)
+{
+    int ColumnIndex = Batch.schema()->GetFieldIndex(ColumnName);
+    if (ColumnIndex < 0)
+    {
+        throw std::runtime_error("HashJoinOperator: no column named '" + ColumnName + "'");
+    }
+
+    const arrow::ArrayData& KeyData = *Batch.column_data(ColumnIndex);
+    switch (KeyData.type->id())
+    {
+    case arrow::Type::INT32:
+    {
+        const int32_t* Keys = KeyData.GetValues<int32_t>(1);
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            OutKeys[i] = Keys[Selection != nullptr ? Selection[i] : i];
+        }
+        break;
+    }
+    case arrow::Type::INT64:
+    {
+        const int64_t* Keys = KeyData.GetValues<int64_t>(1);
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            OutKeys[i] = Keys[Selection != nullptr ? Selection[i] : i];
+        }
+        break;
+    }
+    default:
+        throw std::runtime_error("HashJoinOperator: key column '" + ColumnName + "' must be int32 or int64, got " + KeyData.type->ToString());
+    }
+
+    if (KeyData.GetNullCount() == 0)
+    {
+        return false;
+    }
+
+    const uint8_t* Validity = KeyData.buffers[0]->data();
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        OutValid[i] = Kernels::IsValid(Validity, KeyData.offset + (Selection != nullptr ? Selection[i] : i));
+    }
+    return true;
+}
+
+void HashJoinOperator::Build()
+{
+    this->bBuilt = true;
+
+    std::vector<DataChunk> Batches;
+    DataChunk Chunk;
+    while ((Chunk = this->BuildChild->Next()) != nullptr)
+    {
+        if (Chunk->num_rows() > 0)
+        {
+            Batches.push_back(Chunk);
+        }
+    }
+
+    if (Batches.empty())
+    {
+        return;
+    }
+
+    // one batch for the whole build side, build rows are then addressed with a plain int32 like a selection vector
+    std::shared_ptr<arrow::Schema> Schema = Batches[0]->schema();
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+    for (int c = 0; c < Schema->num_fields(); ++c)
+    {
+        arrow::ArrayVector Pieces;
+        for (const DataChunk& Batch : Batches)
+        {
+            Pieces.push_back(Batch->column(c));
+        }
+
+        arrow::Result<std::shared_ptr<arrow::Array>> ColumnResult = arrow::Concatenate(Pieces, this->Memory);
+        PARQUET_THROW_NOT_OK(ColumnResult.status());
+        Columns.push_back(ColumnResult.ValueOrDie());
+    }
+
+    this->BuildRowCount = Columns.empty() ? 0 : Columns[0]->length();
+    if (this->BuildRowCount > INT32_MAX)
+    {
+        throw std::runtime_error("HashJoinOperator: the build side has more rows than an int32 row index can address");
+    }
+    this->BuildBatch = arrow::RecordBatch::Make(Schema, this->BuildRowCount, std::move(Columns));
+
+    const int64_t RowCount = this->BuildRowCount;
+    this->BuildKeys.resize(RowCount);
+    std::vector<uint8_t> BuildValid(RowCount);
+    bool bBuildNulls = ReadKeys(*this->BuildBatch, this->BuildKeyName, nullptr, RowCount, this->BuildKeys.data(), BuildValid.data());
+
+    // a null build row can't match anything, it stays out of the table and the bloom filter
+    std::vector<int32_t> KeyedRows(RowCount);
+    int64_t KeyedCount = 0;
+    for (int64_t Row = 0; Row < RowCount; ++Row)
+    {
+        KeyedRows[KeyedCount] = (int32_t)Row;
+        KeyedCount += !bBuildNulls || BuildValid[Row];
+    }
+
+    std::vector<uint64_t> Hashes(RowCount);
+    for (int64_t Row = 0; Row < RowCount; ++Row)
+    {
+        Hashes[Row] = Kernels::HashInt64(this->BuildKeys[Row]);
+    }
+
+    this->PartitionBits = 0;
+    while (((int64_t)1 << this->PartitionBits) * BucketsPerPartition < KeyedCount && this->PartitionBits < 10)
+    {
+        ++this->PartitionBits;
+    }
+    const int64_t PartitionCount = (int64_t)1 << this->PartitionBits;
+
+    // radix partition the build rows by the top hash bits (count, prefix sum, scatter)
+    std::vector<int64_t> PartitionStart(PartitionCount + 1, 0);
+    for (int64_t i = 0; i < KeyedCount; ++i)
+    {
+        int32_t Row = KeyedRows[i];
+        uint64_t Partition = this->PartitionBits == 0 ? 0 : Hashes[Row] >> (64 - this->PartitionBits);
+        ++PartitionStart[Partition + 1];
+    }
+
+    this->PartitionOffsets.resize(PartitionCount);
+    this->PartitionMasks.resize(PartitionCount);
+    int64_t BucketCount = 0;
+    for (int64_t Partition = 0; Partition < PartitionCount; ++Partition)
+    {
+        // at least one bucket per row, so chains stay about one entry long
+        uint64_t PartitionBuckets = 1;
+        while ((int64_t)PartitionBuckets < PartitionStart[Partition + 1])
+        {
+            PartitionBuckets *= 2;
+        }
+
+        this->PartitionOffsets[Partition] = BucketCount;
+        this->PartitionMasks[Partition] = PartitionBuckets - 1;
+        BucketCount += PartitionBuckets;
+        PartitionStart[Partition + 1] += PartitionStart[Partition];
+    }
+
+    std::vector<int32_t> PartitionedRows(KeyedCount);
+    std::vector<int64_t> WritePosition(PartitionStart.begin(), PartitionStart.end() - 1);
+    for (int64_t i = 0; i < KeyedCount; ++i)
+    {
+        int32_t Row = KeyedRows[i];
+        uint64_t Partition = this->PartitionBits == 0 ? 0 : Hashes[Row] >> (64 - this->PartitionBits);
+        PartitionedRows[WritePosition[Partition]++] = Row;
+    }
+
+    // Fill one partition at a time so its buckets stay in cache. Rows are pushed in reverse
+    // so every chain lists its build rows in ascending order and the output order is deterministic
+    this->Buckets.assign(BucketCount, -1);
+    this->NextRow.assign(RowCount, -1);
+    for (int64_t Partition = 0; Partition < PartitionCount; ++Partition)
+    {
+        for (int64_t i = PartitionStart[Partition + 1] - 1; i >= PartitionStart[Partition]; --i)
+        {
+            int32_t Row = PartitionedRows[i];
+            uint64_t Bucket = this->BucketOf(Hashes[Row]);
+            this->NextRow[Row] = this->Buckets[Bucket];
+            this->Buckets[Bucket] = Row;
+        }
+    }
+
+    // an anti join needs exactly the rows the bloom filter would drop, so it doesn't get one
+    if (this->Type != JoinType::ANTI)
+    {
+        this->BuildFilter = std::make_shared<RuntimeFilter>(this->ProbeKeyName, KeyedCount);
+        for (int64_t i = 0; i < KeyedCount; ++i)
+        {
+            this->BuildFilter->Insert(this->BuildKeys[KeyedRows[i]]);
+        }
+        this->ProbeChild->PushRuntimeFilter(this->BuildFilter);
+    }
+}
+
+DataChunk HashJoinOperator::Next()
+{
+    return this->NextSelected().Materialize(this->Memory);
+}
+
+SelectedChunk HashJoinOperator::NextSelected()
+{
+    if (this->bFinished)
+    {
+        return SelectedChunk();
+    }
+
+    if (!this->bBuilt)
+    {
+        this->Build();
+    }
+
+    SelectedChunk Input = this->ProbeChild->NextSelected();
+    if (Input.IsEnd())
+    {
+        this->bFinished = true;
+        return Input;
+    }
+
+    // nothing on the build side: inner/semi can never match, anti keeps everything
+    if (this->BuildRowCount == 0)
+    {
+        if (this->Type == JoinType::ANTI)
+        {
+            return Input;
+        }
+        this->bFinished = true;
+        return SelectedChunk();
+    }
+
+    const int64_t Count = Input.Count;
+    if ((int64_t)this->ProbeKeys.size() < Count)
+    {
+        this->ProbeKeys.resize(Count);
+        this->ProbeValid.resize(Count);
+        this->ProbeBuckets.resize(Count);
+    }
+
+    // hash the whole batch first, then walk the chains with the next buckets already prefetched
+    int64_t* Keys = this->ProbeKeys.data();
+    int64_t* BucketIndexes = this->ProbeBuckets.data();
+    bool bProbeNulls = ReadKeys(*Input.Batch, this->ProbeKeyName, Input.Selection, Count, Keys, this->ProbeValid.data());
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        BucketIndexes[i] = (int64_t)this->BucketOf(Kernels::HashInt64(Keys[i]));
+    }
+
+    this->ProbeSelection.clear();
+    this->BuildSelection.clear();
+
+    const int32_t* BucketHeads = this->Buckets.data();
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        if (i + PrefetchDistance < Count)
+        {
+            _mm_prefetch((const char*)(BucketHeads + BucketIndexes[i + PrefetchDistance]), _MM_HINT_T0);
+        }
+
+        int32_t ProbeRow = Input.Selection != nullptr ? Input.Selection[i] : (int32_t)i;
+        int32_t BuildRow = BucketHeads[BucketIndexes[i]];
+
+        // a null key matches no build row, its bucket is never walked
+        if (bProbeNulls && !this->ProbeValid[i])
+        {
+            if (this->Type == JoinType::ANTI)
+            {
+                this->ProbeSelection.push_back(ProbeRow);
+            }
+            continue;
+        }
+
+        if (this->Type == JoinType::INNER)
+        {
+            for (; BuildRow >= 0; BuildRow = this->NextRow[BuildRow])
+            {
+                if (this->BuildKeys[BuildRow] == Keys[i])
+                {
+                    this->ProbeSelection.push_back(ProbeRow);
+                    this->BuildSelection.push_back(BuildRow);
+                }
+            }
+            continue;
+        }
+
+        bool bMatched = false;
+        for (; BuildRow >= 0 && !bMatched; BuildRow = this->NextRow[BuildRow])
+        {
+            bMatched = this->BuildKeys[BuildRow] == Keys[i];
+        }
+
+        if (bMatched == (this->Type == JoinType::SEMI))
+        {
+            this->ProbeSelection.push_back(ProbeRow);
+        }
+    }
+
+    if (this->Type == JoinType::INNER)
+    {
+        return SelectedChunk(this->BuildJoinedBatch(Input.Batch, (int64_t)this->ProbeSelection.size()));
+    }
+
+    // semi/anti only drop probe rows, so the probe batch goes up untouched with the surviving rows selected
+    return SelectedChunk(Input.Batch, this->ProbeSelection.data(), (int64_t)this->ProbeSelection.size());
+}
+
+DataChunk HashJoinOperator::BuildJoinedBatch(const DataChunk& ProbeBatch, int64_t Count) const
+{
+    std::vector<std::shared_ptr<arrow::Field>> Fields;
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+
+    for (int c = 0; c < ProbeBatch->num_columns(); ++c)
+    {
+        Fields.push_back(ProbeBatch->schema()->field(c));
+        Columns.push_back(Kernels::GatherArray(*ProbeBatch->column(c), this->ProbeSelection.data(), Count));
+    }
+
+    for (int c = 0; c < this->BuildBatch->num_columns(); ++c)
+    {
+        Fields.push_back(this->BuildBatch->schema()->field(c));
+        Columns.push_back(Kernels::GatherArray(*this->BuildBatch->column(c), this->BuildSelection.data(), Count));
+    }
+
+    return arrow::RecordBatch::Make(arrow::schema(Fields), Count, std::move(Columns));
+}
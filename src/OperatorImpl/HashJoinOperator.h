@@ -0,0 +1,87 @@
+#pragma once
+#include "Operator.h"
+#include <vector>
+#include <string>
+
+struct RuntimeFilter;
+
+enum class JoinType
+{
+    INNER, // every (probe row, build row) pair with equal keys, probe columns first, then build columns
+    SEMI,  // probe rows that have at least one match, probe columns only
+    ANTI   // probe rows that have no match, probe columns only
+};
+
+// Equi join on one int32/int64 key column per side. A NULL key equals nothing, not even another NULL:
+// null build rows never go into the table, null probe rows never match (so an ANTI join keeps them)
+// The build child is drained completely into a hash table, then the probe child is streamed through it a batch at a time.
+// For INNER and SEMI joins the build keys also go into a bloom filter that is pushed down into the probe child
+// (see RuntimeFilter), so probe rows without a partner are usually gone before they reach the join.
+// SEMI and ANTI hand out the probe batch with a selection vector, nothing is copied
+class HashJoinOperator : public Operator
+{
+public:
+    // Build is usually the small side (the dimension table), Probe the large one (the fact table)
+    HashJoinOperator(std::unique_ptr<Operator> Build, std::unique_ptr<Operator> Probe, const std::string& BuildKeyColumn, const std::string& ProbeKeyColumn, JoinType Type, ExecutionMode Mode);
+
+    DataChunk Next() override;
+
+    SelectedChunk NextSelected() override;
+
+    // Split between the two sides, each one also gets its key column
+    bool PushProjection(const std::vector<ColumnRef>& Columns) override;
+
+    // Nothing to fuse with the join itself, both sides are passed on
+    bool FusePipelines() override;
+
+    // Drops the hash table and closes both sides
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+private:
+    std::unique_ptr<Operator> BuildChild;
+    std::unique_ptr<Operator> ProbeChild;
+    std::string BuildKeyName;
+    std::string ProbeKeyName;
+    JoinType Type;
+
+    bool bBuilt = false;
+
+    // All build batches concatenated, so a build row is a single int32 index
+    DataChunk BuildBatch;
+    int64_t BuildRowCount = 0;
+    std::vector<int64_t> BuildKeys; // widened to int64
+
+    // The table is split into 2^PartitionBits partitions by the top bits of the hash, each one a bucket array
+    // sized to stay in cache while it is filled. Buckets hold the first build row of a chain, NextRow links the rest
+    int PartitionBits = 0;
+    std::vector<int64_t> PartitionOffsets; // first bucket of every partition
+    std::vector<uint64_t> PartitionMasks;  // bucket count - 1 of every partition
+    std::vector<int32_t> Buckets;
+    std::vector<int32_t> NextRow;
+
+    std::shared_ptr<RuntimeFilter> BuildFilter;
+
+    // reused between probe batches
+    std::vector<int64_t> ProbeKeys;
+    std::vector<uint8_t> ProbeValid;
+    std::vector<int64_t> ProbeBuckets;
+    std::vector<int32_t> ProbeSelection;
+    std::vector<int32_t> BuildSelection;
+
+    void Build();
+
+    uint64_t BucketOf(uint64_t Hash) const
+    {
+        uint64_t Partition = this->PartitionBits == 0 ? 0 : Hash >> (64 - this->PartitionBits);
+        return this->PartitionOffsets[Partition] + (Hash & this->PartitionMasks[Partition]);
+    }
+
+    // Widens the key of every selected row to int64 (Selection nullptr means all rows). Returns true when the key
+    // column has nulls, only then is OutValid filled (1 for a non-null key)
+    static bool ReadKeys(const arrow::RecordBatch& Batch, const std::string& ColumnName, const int32_t* Selection, int64_t Count, int64_t* OutKeys, uint8_t* OutValid);
+
+    // probe columns of ProbeSelection next to build columns of BuildSelection
+    DataChunk BuildJoinedBatch(const DataChunk& ProbeBatch, int64_t Count) const;
+};
@@ -0,0 +1,270 @@
+#include "pch.h"
+#include "Aggregation.h"
+#include "Validity.h"
+
+namespace Kernels
+{
+    void AccumulateStatsScalar(const int32_t* Data, int64_t Length, Int32Stats& Stats)
+    {
+        long long Sum = 0;
+        int32_t Min = Stats.Min;
+        int32_t Max = Stats.Max;
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            Sum += Data[i];
+            Min = Data[i] < Min ? Data[i] : Min;
+            Max = Data[i] > Max ? Data[i] : Max;
+        }
+
+        Stats.Sum += Sum;
+        Stats.Min = Min;
+        Stats.Max = Max;
+        Stats.Count += Length;
+    }
+
+    void AccumulateSelectedStatsScalar(const int32_t* Data, const int32_t* Selection, int64_t Count, Int32Stats& Stats)
+    {
+        long long Sum = 0;
+        int32_t Min = Stats.Min;
+        int32_t Max = Stats.Max;
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int32_t Value = Data[Selection[i]];
+            Sum += Value;
+            Min = Value < Min ? Value : Min;
+            Max = Value > Max ? Value : Max;
+        }
+
+        Stats.Sum += Sum;
+        Stats.Min = Min;
+        Stats.Max = Max;
+        Stats.Count += Count;
+    }
+
+    // 4 x int64 -> scalar
+    OLAP_TARGET_AVX2 static long long HSumEpi64(__m256i V)
+    {
+        __m128i Sum128 = _mm_add_epi64(_mm256_castsi256_si128(V), _mm256_extracti128_si256(V, 1));
+        return _mm_cvtsi128_si64(_mm_add_epi64(Sum128, _mm_unpackhi_epi64(Sum128, Sum128)));
+    }
+
+    // folds the 8 lanes of the vector accumulators into Stats
+    OLAP_TARGET_AVX2 static void ReduceAvx2(__m256i SumLo, __m256i SumHi, __m256i MinVector, __m256i MaxVector, Int32Stats& Stats)
+    {
+        alignas(32) int32_t MinLanes[8];
+        alignas(32) int32_t MaxLanes[8];
+        _mm256_store_si256((__m256i*)MinLanes, MinVector);
+        _mm256_store_si256((__m256i*)MaxLanes, MaxVector);
+
+        Stats.Sum += HSumEpi64(_mm256_add_epi64(SumLo, SumHi));
+        for (int Lane = 0; Lane < 8; ++Lane)
+        {
+            Stats.Min = MinLanes[Lane] < Stats.Min ? MinLanes[Lane] : Stats.Min;
+            Stats.Max = MaxLanes[Lane] > Stats.Max ? MaxLanes[Lane] : Stats.Max;
+        }
+    }
+
+    // One load, then the same register goes into the min, the max and (widened to int64) the sum.
+    // Count is just the length, the nullable version below is used when there are nulls to skip
+    void AccumulateStatsAvx2(const int32_t* Data, int64_t Length, Int32Stats& Stats)
+    {
+        __m256i SumLo = _mm256_setzero_si256(); // 4 x int64
+        __m256i SumHi = _mm256_setzero_si256(); // 4 x int64
+        __m256i MinVector = _mm256_set1_epi32(Stats.Min);
+        __m256i MaxVector = _mm256_set1_epi32(Stats.Max);
+
+        int64_t i = 0;
+        for (; i <= Length - 8; i += 8)
+        {
+            __m256i DataVector = _mm256_loadu_si256((const __m256i*)(Data + i));
+            SumLo = _mm256_add_epi64(SumLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(DataVector)));
+            SumHi = _mm256_add_epi64(SumHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(DataVector, 1)));
+            MinVector = _mm256_min_epi32(MinVector, DataVector);
+            MaxVector = _mm256_max_epi32(MaxVector, DataVector);
+        }
+
+        ReduceAvx2(SumLo, SumHi, MinVector, MaxVector, Stats);
+        Stats.Count += i;
+
+        AccumulateStatsScalar(Data + i, Length - i, Stats);
+    }
+
+    void AccumulateNullableStatsScalar(const int32_t* Data, const uint8_t* Validity, int64_t ValidityOffset, int64_t Length, Int32Stats& Stats)
+    {
+        long long Sum = 0;
+        int32_t Min = Stats.Min;
+        int32_t Max = Stats.Max;
+        int64_t Count = 0;
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            bool bValid = IsValid(Validity, ValidityOffset + i);
+            Sum += bValid ? Data[i] : 0;
+            Min = bValid && Data[i] < Min ? Data[i] : Min;
+            Max = bValid && Data[i] > Max ? Data[i] : Max;
+            Count += bValid;
+        }
+
+        Stats.Sum += Sum;
+        Stats.Min = Min;
+        Stats.Max = Max;
+        Stats.Count += Count;
+    }
+
+    // 8 rows and 8 validity bits per step. The bits become a lane mask, null lanes are zeroed for the sum and
+    // set to INT32_MAX / INT32_MIN for the min / max, so they can't change any of them. The rest is the loop above
+    void AccumulateNullableStatsAvx2(const int32_t* Data, const uint8_t* Validity, int64_t ValidityOffset, int64_t Length, Int32Stats& Stats)
+    {
+        __m256i SumLo = _mm256_setzero_si256();
+        __m256i SumHi = _mm256_setzero_si256();
+        __m256i MinVector = _mm256_set1_epi32(Stats.Min);
+        __m256i MaxVector = _mm256_set1_epi32(Stats.Max);
+        const __m256i MinIdentity = _mm256_set1_epi32(INT32_MAX);
+        const __m256i MaxIdentity = _mm256_set1_epi32(INT32_MIN);
+        const __m256i BitOfLane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        int64_t Count = 0;
+
+        int64_t i = 0;
+        for (; i <= Length - 8; i += 8)
+        {
+            uint32_t Bits = (uint32_t)ReadValidity<8>(Validity, ValidityOffset + i);
+            __m256i Valid = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)Bits), BitOfLane), BitOfLane);
+            Count += _mm_popcnt_u32(Bits);
+
+            __m256i DataVector = _mm256_loadu_si256((const __m256i*)(Data + i));
+            __m256i SumVector = _mm256_and_si256(DataVector, Valid);
+            SumLo = _mm256_add_epi64(SumLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(SumVector)));
+            SumHi = _mm256_add_epi64(SumHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(SumVector, 1)));
+            MinVector = _mm256_min_epi32(MinVector, _mm256_blendv_epi8(MinIdentity, DataVector, Valid));
+            MaxVector = _mm256_max_epi32(MaxVector, _mm256_blendv_epi8(MaxIdentity, DataVector, Valid));
+        }
+
+        ReduceAvx2(SumLo, SumHi, MinVector, MaxVector, Stats);
+        Stats.Count += Count;
+
+        AccumulateNullableStatsScalar(Data + i, Validity, ValidityOffset + i, Length - i, Stats);
+    }
+
+    void AccumulateSelectedStatsAvx2(const int32_t* Data, const int32_t* Selection, int64_t Count, Int32Stats& Stats)
+    {
+        __m256i SumLo = _mm256_setzero_si256();
+        __m256i SumHi = _mm256_setzero_si256();
+        __m256i MinVector = _mm256_set1_epi32(Stats.Min);
+        __m256i MaxVector = _mm256_set1_epi32(Stats.Max);
+
+        int64_t i = 0;
+        for (; i <= Count - 8; i += 8)
+        {
+            __m256i IndexVector = _mm256_loadu_si256((const __m256i*)(Selection + i));
+            __m256i DataVector = _mm256_i32gather_epi32((const int*)Data, IndexVector, 4);
+            SumLo = _mm256_add_epi64(SumLo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(DataVector)));
+            SumHi = _mm256_add_epi64(SumHi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(DataVector, 1)));
+            MinVector = _mm256_min_epi32(MinVector, DataVector);
+            MaxVector = _mm256_max_epi32(MaxVector, DataVector);
+        }
+
+        ReduceAvx2(SumLo, SumHi, MinVector, MaxVector, Stats);
+        Stats.Count += i;
+
+        AccumulateSelectedStatsScalar(Data, Selection + i, Count - i, Stats);
+    }
+
+    // 16 lanes, the tail is a masked load. Lanes outside the tail are loaded as 0 for the sum
+    // and left out of the min/max with a masked min/max so they keep the old value
+    void AccumulateStatsAvx512(const int32_t* Data, int64_t Length, Int32Stats& Stats)
+    {
+        __m512i SumLo = _mm512_setzero_si512(); // 8 x int64
+        __m512i SumHi = _mm512_setzero_si512(); // 8 x int64
+        __m512i MinVector = _mm512_set1_epi32(Stats.Min);
+        __m512i MaxVector = _mm512_set1_epi32(Stats.Max);
+
+        int64_t i = 0;
+        for (; i <= Length - 16; i += 16)
+        {
+            __m512i DataVector = _mm512_loadu_si512((const void*)(Data + i));
+            SumLo = _mm512_add_epi64(SumLo, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(DataVector)));
+            SumHi = _mm512_add_epi64(SumHi, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(DataVector, 1)));
+            MinVector = _mm512_min_epi32(MinVector, DataVector);
+            MaxVector = _mm512_max_epi32(MaxVector, DataVector);
+        }
+
+        if (i < Length)
+        {
+            __mmask16 TailMask = (__mmask16)((1u << (Length - i)) - 1);
+            __m512i DataVector = _mm512_maskz_loadu_epi32(TailMask, (const void*)(Data + i));
+            SumLo = _mm512_add_epi64(SumLo, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(DataVector)));
+            SumHi = _mm512_add_epi64(SumHi, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(DataVector, 1)));
+            MinVector = _mm512_mask_min_epi32(MinVector, TailMask, MinVector, DataVector);
+            MaxVector = _mm512_mask_max_epi32(MaxVector, TailMask, MaxVector, DataVector);
+        }
+
+        Stats.Sum += _mm512_reduce_add_epi64(_mm512_add_epi64(SumLo, SumHi));
+        Stats.Min = _mm512_reduce_min_epi32(MinVector);
+        Stats.Max = _mm512_reduce_max_epi32(MaxVector);
+        Stats.Count += Length;
+    }
+
+    // The validity bits are the load mask: null lanes read as 0 for the sum and are left out of the masked min/max
+    void AccumulateNullableStatsAvx512(const int32_t* Data, const uint8_t* Validity, int64_t ValidityOffset, int64_t Length, Int32Stats& Stats)
+    {
+        __m512i SumLo = _mm512_setzero_si512();
+        __m512i SumHi = _mm512_setzero_si512();
+        __m512i MinVector = _mm512_set1_epi32(Stats.Min);
+        __m512i MaxVector = _mm512_set1_epi32(Stats.Max);
+        int64_t Count = 0;
+
+        int64_t i = 0;
+        for (; i <= Length - 16; i += 16)
+        {
+            __mmask16 Valid = (__mmask16)ReadValidity<16>(Validity, ValidityOffset + i);
+            Count += _mm_popcnt_u32(Valid);
+
+            __m512i DataVector = _mm512_maskz_loadu_epi32(Valid, (const void*)(Data + i));
+            SumLo = _mm512_add_epi64(SumLo, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(DataVector)));
+            SumHi = _mm512_add_epi64(SumHi, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(DataVector, 1)));
+            MinVector = _mm512_mask_min_epi32(MinVector, Valid, MinVector, DataVector);
+            MaxVector = _mm512_mask_max_epi32(MaxVector, Valid, MaxVector, DataVector);
+        }
+
+        Stats.Sum += _mm512_reduce_add_epi64(_mm512_add_epi64(SumLo, SumHi));
+        Stats.Min = _mm512_reduce_min_epi32(MinVector);
+        Stats.Max = _mm512_reduce_max_epi32(MaxVector);
+        Stats.Count += Count;
+
+        AccumulateNullableStatsScalar(Data + i, Validity, ValidityOffset + i, Length - i, Stats);
+    }
+
+    void AccumulateSelectedStatsAvx512(const int32_t* Data, const int32_t* Selection, int64_t Count, Int32Stats& Stats)
+    {
+        __m512i SumLo = _mm512_setzero_si512();
+        __m512i SumHi = _mm512_setzero_si512();
+        __m512i MinVector = _mm512_set1_epi32(Stats.Min);
+        __m512i MaxVector = _mm512_set1_epi32(Stats.Max);
+
+        int64_t i = 0;
+        for (; i <= Count - 16; i += 16)
+        {
+            __m512i IndexVector = _mm512_loadu_si512((const void*)(Selection + i));
+            __m512i DataVector = _mm512_i32gather_epi32(IndexVector, (const void*)Data, 4);
+            SumLo = _mm512_add_epi64(SumLo, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(DataVector)));
+            SumHi = _mm512_add_epi64(SumHi, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(DataVector, 1)));
+            MinVector = _mm512_min_epi32(MinVector, DataVector);
+            MaxVector = _mm512_max_epi32(MaxVector, DataVector);
+        }
+
+        if (i < Count)
+        {
+            __mmask16 TailMask = (__mmask16)((1u << (Count - i)) - 1);
+            __m512i IndexVector = _mm512_maskz_loadu_epi32(TailMask, (const void*)(Selection + i));
+            __m512i DataVector = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), TailMask, IndexVector, (const void*)Data, 4);
+            SumLo = _mm512_add_epi64(SumLo, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(DataVector)));
+            SumHi = _mm512_add_epi64(SumHi, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(DataVector, 1)));
+            MinVector = _mm512_mask_min_epi32(MinVector, TailMask, MinVector, DataVector);
+            MaxVector = _mm512_mask_max_epi32(MaxVector, TailMask, MaxVector, DataVector);
+        }
+
+        Stats.Sum += _mm512_reduce_add_epi64(_mm512_add_epi64(SumLo, SumHi));
+        Stats.Min = _mm512_reduce_min_epi32(MinVector);
+        Stats.Max = _mm512_reduce_max_epi32(MaxVector);
+        Stats.Count += Count;
+    }
+}
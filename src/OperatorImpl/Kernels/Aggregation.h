@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <immintrin.h>
+#include "../../Misc/CpuFeatures.h"
+
+// Single pass kernels for the basic aggregates. One load of the data feeds sum, min, max and count at once,
+// so computing several aggregates over the same column costs one trip through memory instead of one per aggregate
+namespace Kernels
+{
+    // Everything SUM/MIN/MAX/COUNT/AVG over one int32 column need
+    struct Int32Stats
+    {
+        long long Sum = 0; // int32 values are widened before they are added, can't overflow
+        int32_t Min = INT32_MAX;
+        int32_t Max = INT32_MIN;
+        int64_t Count = 0;
+
+        // combines the stats of two disjoint sets of rows
+        void Merge(const Int32Stats& Other)
+        {
+            this->Sum += Other.Sum;
+            this->Min = Other.Min < this->Min ? Other.Min : this->Min;
+            this->Max = Other.Max > this->Max ? Other.Max : this->Max;
+            this->Count += Other.Count;
+        }
+    };
+
+    // Adds Data[0..Length) to Stats
+    void AccumulateStatsScalar(const int32_t* Data, int64_t Length, Int32Stats& Stats);
+    OLAP_TARGET_AVX2 void AccumulateStatsAvx2(const int32_t* Data, int64_t Length, Int32Stats& Stats);
+    OLAP_TARGET_AVX512 void AccumulateStatsAvx512(const int32_t* Data, int64_t Length, Int32Stats& Stats);
+
+    // Same for a column with nulls: null rows are left out of everything, Count included (it is the popcount of the validity bits).
+    // ValidityOffset is the bit of row 0, see Validity.h
+    void AccumulateNullableStatsScalar(const int32_t* Data, const uint8_t* Validity, int64_t ValidityOffset, int64_t Length, Int32Stats& Stats);
+    OLAP_TARGET_AVX2 void AccumulateNullableStatsAvx2(const int32_t* Data, const uint8_t* Validity, int64_t ValidityOffset, int64_t Length, Int32Stats& Stats);
+    OLAP_TARGET_AVX512 void AccumulateNullableStatsAvx512(const int32_t* Data, const uint8_t* Validity, int64_t ValidityOffset, int64_t Length, Int32Stats& Stats);
+
+    // Adds Data[Selection[0..Count)] to Stats (input came from a filter), nulls have to be dropped from the selection first
+    void AccumulateSelectedStatsScalar(const int32_t* Data, const int32_t* Selection, int64_t Count, Int32Stats& Stats);
+    OLAP_TARGET_AVX2 void AccumulateSelectedStatsAvx2(const int32_t* Data, const int32_t* Selection, int64_t Count, Int32Stats& Stats);
+    OLAP_TARGET_AVX512 void AccumulateSelectedStatsAvx512(const int32_t* Data, const int32_t* Selection, int64_t Count, Int32Stats& Stats);
+}
@@ -0,0 +1,428 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <immintrin.h>
+#include "../Expression.h"
+#include "../../Misc/CpuFeatures.h"
+
+// Column at a time arithmetic for computed columns (see Expression.h). Expressions are evaluated in two types only,
+// int64 for every integer column and double for float/double ones, so the kernels below are
+//   Convert*     a column of any number type widened to int64 or double, and the two casts between those
+//   Arithmetic*  A op B over whole columns, either side can be a constant (bConstA/bConstB, read from [0])
+//   Select*      CASE WHEN: Then where the bit of the row is set, Else where it isn't
+// Integer + - * wrap around like the hardware does (no overflow checks), / always divides in double.
+// Every kernel only reads and writes row i at step i, so Out may be one of the inputs
+namespace Kernels
+{
+    // double -> int64 the way cvttpd2qq does it: truncated, and 0x8000000000000000 when it doesn't fit (NaN included),
+    // so the scalar and SIMD paths agree on every input
+    inline int64_t TruncateToInt64(double Value)
+    {
+        if (!(Value >= -9223372036854775808.0 && Value < 9223372036854775808.0))
+        {
+            return std::numeric_limits<int64_t>::min();
+        }
+        return (int64_t)Value;
+    }
+
+    template <typename From, typename To>
+    inline To ConvertValue(From Value)
+    {
+        if constexpr (std::is_same_v<To, int64_t> && std::is_floating_point_v<From>)
+        {
+            return TruncateToInt64((double)Value);
+        }
+        else
+        {
+            return (To)Value;
+        }
+    }
+
+    template <typename From, typename To>
+    void ConvertScalar(const From* In, int64_t Length, To* Out)
+    {
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            Out[i] = ConvertValue<From, To>(In[i]);
+        }
+    }
+
+    template <ArithmeticOp Op, typename T>
+    inline T Calculate(T A, T B)
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            static_assert(Op != ArithmeticOp::DIVIDE, "integers are divided as doubles");
+
+            // through uint64 so an overflow wraps instead of being undefined
+            if constexpr (Op == ArithmeticOp::ADD) return (T)((uint64_t)A + (uint64_t)B);
+            else if constexpr (Op == ArithmeticOp::SUBTRACT) return (T)((uint64_t)A - (uint64_t)B);
+            else return (T)((uint64_t)A * (uint64_t)B);
+        }
+        else
+        {
+            if constexpr (Op == ArithmeticOp::ADD) return A + B;
+            else if constexpr (Op == ArithmeticOp::SUBTRACT) return A - B;
+            else if constexpr (Op == ArithmeticOp::MULTIPLY) return A * B;
+            else return A / B;
+        }
+    }
+
+    template <ArithmeticOp Op, typename T, bool bConstA, bool bConstB>
+    void ArithmeticScalar(const T* A, const T* B, int64_t Length, T* Out)
+    {
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            Out[i] = Calculate<Op>(bConstA ? A[0] : A[i], bConstB ? B[0] : B[i]);
+        }
+    }
+
+    // Values are moved as raw 64 bit patterns, the same loop serves int64 and double
+    template <bool bConstThen, bool bConstElse>
+    void SelectScalar(const uint64_t* Bits, const uint64_t* Then, const uint64_t* Else, int64_t Length, uint64_t* Out)
+    {
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            bool bThen = (Bits[i >> 6] >> (i & 63)) & 1;
+            Out[i] = bThen ? Then[bConstThen ? 0 : i] : Else[bConstElse ? 0 : i];
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // AVX2, 4 x 64 bit per register. There is no 64 bit multiply and no int64 <-> double conversion before AVX-512,
+    // the multiply is put together from three 32 x 32 -> 64 bit ones and the conversions stay scalar
+    // ---------------------------------------------------------------------------------------------
+    template <typename T>
+    struct Avx2Arithmetic;
+
+    template <>
+    struct Avx2Arithmetic<int64_t>
+    {
+        using Vec = __m256i;
+        OLAP_TARGET_AVX2 static Vec Load(const int64_t* P) { return _mm256_loadu_si256((const __m256i*)P); }
+        OLAP_TARGET_AVX2 static Vec Set1(int64_t V) { return _mm256_set1_epi64x(V); }
+        OLAP_TARGET_AVX2 static void Store(int64_t* P, Vec V) { _mm256_storeu_si256((__m256i*)P, V); }
+
+        template <ArithmeticOp Op>
+        OLAP_TARGET_AVX2 static Vec Calculate(Vec A, Vec B)
+        {
+            static_assert(Op != ArithmeticOp::DIVIDE, "integers are divided as doubles");
+            if constexpr (Op == ArithmeticOp::ADD) return _mm256_add_epi64(A, B);
+            else if constexpr (Op == ArithmeticOp::SUBTRACT) return _mm256_sub_epi64(A, B);
+            else
+            {
+                // lo(a) * lo(b) + ((hi(a) * lo(b) + lo(a) * hi(b)) << 32), the hi * hi part is shifted out anyway
+                Vec Low = _mm256_mul_epu32(A, B);
+                Vec Cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(A, 32), B), _mm256_mul_epu32(A, _mm256_srli_epi64(B, 32)));
+                return _mm256_add_epi64(Low, _mm256_slli_epi64(Cross, 32));
+            }
+        }
+    };
+
+    template <>
+    struct Avx2Arithmetic<double>
+    {
+        using Vec = __m256d;
+        OLAP_TARGET_AVX2 static Vec Load(const double* P) { return _mm256_loadu_pd(P); }
+        OLAP_TARGET_AVX2 static Vec Set1(double V) { return _mm256_set1_pd(V); }
+        OLAP_TARGET_AVX2 static void Store(double* P, Vec V) { _mm256_storeu_pd(P, V); }
+
+        template <ArithmeticOp Op>
+        OLAP_TARGET_AVX2 static Vec Calculate(Vec A, Vec B)
+        {
+            if constexpr (Op == ArithmeticOp::ADD) return _mm256_add_pd(A, B);
+            else if constexpr (Op == ArithmeticOp::SUBTRACT) return _mm256_sub_pd(A, B);
+            else if constexpr (Op == ArithmeticOp::MULTIPLY) return _mm256_mul_pd(A, B);
+            else return _mm256_div_pd(A, B);
+        }
+    };
+
+    template <ArithmeticOp Op, typename T, bool bConstA, bool bConstB>
+    OLAP_TARGET_AVX2 void ArithmeticAvx2(const T* A, const T* B, int64_t Length, T* Out)
+    {
+        using Ops = Avx2Arithmetic<T>;
+        const typename Ops::Vec ConstA = Ops::Set1(bConstA ? A[0] : T(0));
+        const typename Ops::Vec ConstB = Ops::Set1(bConstB ? B[0] : T(0));
+
+        int64_t i = 0;
+        for (; i + 4 <= Length; i += 4)
+        {
+            typename Ops::Vec X = bConstA ? ConstA : Ops::Load(A + i);
+            typename Ops::Vec Y = bConstB ? ConstB : Ops::Load(B + i);
+            Ops::Store(Out + i, Ops::template Calculate<Op>(X, Y));
+        }
+
+        for (; i < Length; ++i)
+        {
+            Out[i] = Calculate<Op>(bConstA ? A[0] : A[i], bConstB ? B[0] : B[i]);
+        }
+    }
+
+    // The next 4 values of From as int64 (bInt64) or double (bDouble) lanes. Only the conversions AVX2 has an instruction for
+    template <typename From>
+    struct Avx2Widen
+    {
+        static constexpr bool bInt64 = std::is_integral_v<From> && sizeof(From) <= 4;
+        static constexpr bool bDouble = std::is_same_v<From, float> || (std::is_integral_v<From> && sizeof(From) < 4) || std::is_same_v<From, int32_t>;
+
+        OLAP_TARGET_AVX2 static __m256i ToInt64(const From* P)
+        {
+            if constexpr (sizeof(From) == 1)
+            {
+                int32_t Bytes;
+                std::memcpy(&Bytes, P, 4);
+                return std::is_signed_v<From> ? _mm256_cvtepi8_epi64(_mm_cvtsi32_si128(Bytes)) : _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(Bytes));
+            }
+            else if constexpr (sizeof(From) == 2)
+            {
+                __m128i Words = _mm_loadl_epi64((const __m128i*)P);
+                return std::is_signed_v<From> ? _mm256_cvtepi16_epi64(Words) : _mm256_cvtepu16_epi64(Words);
+            }
+            else
+            {
+                __m128i Dwords = _mm_loadu_si128((const __m128i*)P);
+                return std::is_signed_v<From> ? _mm256_cvtepi32_epi64(Dwords) : _mm256_cvtepu32_epi64(Dwords);
+            }
+        }
+
+        OLAP_TARGET_AVX2 static __m256d ToDouble(const From* P)
+        {
+            if constexpr (std::is_same_v<From, float>)
+            {
+                return _mm256_cvtps_pd(_mm_loadu_ps(P));
+            }
+            else if constexpr (sizeof(From) == 4)
+            {
+                return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)P));
+            }
+            else
+            {
+                // 8 and 16 bit values fit int32 whatever their sign, go through that
+                __m128i Dwords;
+                if constexpr (sizeof(From) == 1)
+                {
+                    int32_t Bytes;
+                    std::memcpy(&Bytes, P, 4);
+                    Dwords = std::is_signed_v<From> ? _mm_cvtepi8_epi32(_mm_cvtsi32_si128(Bytes)) : _mm_cvtepu8_epi32(_mm_cvtsi32_si128(Bytes));
+                }
+                else
+                {
+                    __m128i Words = _mm_loadl_epi64((const __m128i*)P);
+                    Dwords = std::is_signed_v<From> ? _mm_cvtepi16_epi32(Words) : _mm_cvtepu16_epi32(Words);
+                }
+                return _mm256_cvtepi32_pd(Dwords);
+            }
+        }
+    };
+
+    template <typename From, typename To>
+    OLAP_TARGET_AVX2 void ConvertAvx2(const From* In, int64_t Length, To* Out)
+    {
+        int64_t i = 0;
+        if constexpr (std::is_same_v<To, int64_t> && Avx2Widen<From>::bInt64)
+        {
+            for (; i + 4 <= Length; i += 4)
+            {
+                _mm256_storeu_si256((__m256i*)(Out + i), Avx2Widen<From>::ToInt64(In + i));
+            }
+        }
+        else if constexpr (std::is_same_v<To, double> && Avx2Widen<From>::bDouble)
+        {
+            for (; i + 4 <= Length; i += 4)
+            {
+                _mm256_storeu_pd(Out + i, Avx2Widen<From>::ToDouble(In + i));
+            }
+        }
+        ConvertScalar(In + i, Length - i, Out + i);
+    }
+
+    template <bool bConstThen, bool bConstElse>
+    OLAP_TARGET_AVX2 void SelectAvx2(const uint64_t* Bits, const uint64_t* Then, const uint64_t* Else, int64_t Length, uint64_t* Out)
+    {
+        const __m256i LaneBits = _mm256_setr_epi64x(1, 2, 4, 8);
+        const __m256i ConstThen = _mm256_set1_epi64x(bConstThen ? (int64_t)Then[0] : 0);
+        const __m256i ConstElse = _mm256_set1_epi64x(bConstElse ? (int64_t)Else[0] : 0);
+
+        int64_t i = 0;
+        for (; i + 4 <= Length; i += 4)
+        {
+            // the 4 bits of these rows spread over the lanes, then all ones in the lanes whose bit is set
+            __m256i Spread = _mm256_and_si256(_mm256_set1_epi64x((int64_t)(Bits[i >> 6] >> (i & 63))), LaneBits);
+            __m256i Mask = _mm256_cmpeq_epi64(Spread, LaneBits);
+            __m256i X = bConstThen ? ConstThen : _mm256_loadu_si256((const __m256i*)(Then + i));
+            __m256i Y = bConstElse ? ConstElse : _mm256_loadu_si256((const __m256i*)(Else + i));
+            _mm256_storeu_si256((__m256i*)(Out + i), _mm256_blendv_epi8(Y, X, Mask));
+        }
+
+        for (; i < Length; ++i)
+        {
+            bool bThen = (Bits[i >> 6] >> (i & 63)) & 1;
+            Out[i] = bThen ? Then[bConstThen ? 0 : i] : Else[bConstElse ? 0 : i];
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // AVX-512, 8 x 64 bit per register. DQ brings the 64 bit multiply and the int64 <-> double conversions
+    // ---------------------------------------------------------------------------------------------
+    template <typename T>
+    struct Avx512Arithmetic;
+
+    template <>
+    struct Avx512Arithmetic<int64_t>
+    {
+        using Vec = __m512i;
+        OLAP_TARGET_AVX512 static Vec Load(const int64_t* P) { return _mm512_loadu_si512(P); }
+        OLAP_TARGET_AVX512 static Vec Set1(int64_t V) { return _mm512_set1_epi64(V); }
+        OLAP_TARGET_AVX512 static void Store(int64_t* P, Vec V) { _mm512_storeu_si512(P, V); }
+
+        template <ArithmeticOp Op>
+        OLAP_TARGET_AVX512 static Vec Calculate(Vec A, Vec B)
+        {
+            static_assert(Op != ArithmeticOp::DIVIDE, "integers are divided as doubles");
+            if constexpr (Op == ArithmeticOp::ADD) return _mm512_add_epi64(A, B);
+            else if constexpr (Op == ArithmeticOp::SUBTRACT) return _mm512_sub_epi64(A, B);
+            else return _mm512_mullo_epi64(A, B);
+        }
+    };
+
+    template <>
+    struct Avx512Arithmetic<double>
+    {
+        using Vec = __m512d;
+        OLAP_TARGET_AVX512 static Vec Load(const double* P) { return _mm512_loadu_pd(P); }
+        OLAP_TARGET_AVX512 static Vec Set1(double V) { return _mm512_set1_pd(V); }
+        OLAP_TARGET_AVX512 static void Store(double* P, Vec V) { _mm512_storeu_pd(P, V); }
+
+        template <ArithmeticOp Op>
+        OLAP_TARGET_AVX512 static Vec Calculate(Vec A, Vec B)
+        {
+            if constexpr (Op == ArithmeticOp::ADD) return _mm512_add_pd(A, B);
+            else if constexpr (Op == ArithmeticOp::SUBTRACT) return _mm512_sub_pd(A, B);
+            else if constexpr (Op == ArithmeticOp::MULTIPLY) return _mm512_mul_pd(A, B);
+            else return _mm512_div_pd(A, B);
+        }
+    };
+
+    template <ArithmeticOp Op, typename T, bool bConstA, bool bConstB>
+    OLAP_TARGET_AVX512 void ArithmeticAvx512(const T* A, const T* B, int64_t Length, T* Out)
+    {
+        using Ops = Avx512Arithmetic<T>;
+        const typename Ops::Vec ConstA = Ops::Set1(bConstA ? A[0] : T(0));
+        const typename Ops::Vec ConstB = Ops::Set1(bConstB ? B[0] : T(0));
+
+        int64_t i = 0;
+        for (; i + 8 <= Length; i += 8)
+        {
+            typename Ops::Vec X = bConstA ? ConstA : Ops::Load(A + i);
+            typename Ops::Vec Y = bConstB ? ConstB : Ops::Load(B + i);
+            Ops::Store(Out + i, Ops::template Calculate<Op>(X, Y));
+        }
+
+        for (; i < Length; ++i)
+        {
+            Out[i] = Calculate<Op>(bConstA ? A[0] : A[i], bConstB ? B[0] : B[i]);
+        }
+    }
+
+    // The next 8 values of From as int64 or double lanes, every conversion but uint64 has an instruction here
+    template <typename From>
+    struct Avx512Widen
+    {
+        static constexpr bool bInt64 = std::is_integral_v<From> && sizeof(From) <= 4;
+        static constexpr bool bDouble = !std::is_same_v<From, uint64_t> && !std::is_same_v<From, double>;
+        static constexpr bool bTruncate = std::is_same_v<From, double>; // double -> int64
+
+        OLAP_TARGET_AVX512 static __m512i ToInt64(const From* P)
+        {
+            if constexpr (std::is_same_v<From, double>)
+            {
+                return _mm512_cvttpd_epi64(_mm512_loadu_pd(P));
+            }
+            else if constexpr (sizeof(From) == 1)
+            {
+                __m128i Bytes = _mm_loadl_epi64((const __m128i*)P);
+                return std::is_signed_v<From> ? _mm512_cvtepi8_epi64(Bytes) : _mm512_cvtepu8_epi64(Bytes);
+            }
+            else if constexpr (sizeof(From) == 2)
+            {
+                __m128i Words = _mm_loadu_si128((const __m128i*)P);
+                return std::is_signed_v<From> ? _mm512_cvtepi16_epi64(Words) : _mm512_cvtepu16_epi64(Words);
+            }
+            else
+            {
+                __m256i Dwords = _mm256_loadu_si256((const __m256i*)P);
+                return std::is_signed_v<From> ? _mm512_cvtepi32_epi64(Dwords) : _mm512_cvtepu32_epi64(Dwords);
+            }
+        }
+
+        OLAP_TARGET_AVX512 static __m512d ToDouble(const From* P)
+        {
+            if constexpr (std::is_same_v<From, float>)
+            {
+                return _mm512_cvtps_pd(_mm256_loadu_ps(P));
+            }
+            else if constexpr (std::is_same_v<From, int64_t>)
+            {
+                return _mm512_cvtepi64_pd(_mm512_loadu_si512(P));
+            }
+            else if constexpr (std::is_same_v<From, uint32_t>)
+            {
+                return _mm512_cvtepu32_pd(_mm256_loadu_si256((const __m256i*)P));
+            }
+            else if constexpr (std::is_same_v<From, int32_t>)
+            {
+                return _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)P));
+            }
+            else
+            {
+                return _mm512_cvtepi64_pd(ToInt64(P));
+            }
+        }
+    };
+
+    template <typename From, typename To>
+    OLAP_TARGET_AVX512 void ConvertAvx512(const From* In, int64_t Length, To* Out)
+    {
+        int64_t i = 0;
+        if constexpr (std::is_same_v<To, int64_t> && (Avx512Widen<From>::bInt64 || Avx512Widen<From>::bTruncate))
+        {
+            for (; i + 8 <= Length; i += 8)
+            {
+                _mm512_storeu_si512(Out + i, Avx512Widen<From>::ToInt64(In + i));
+            }
+        }
+        else if constexpr (std::is_same_v<To, double> && Avx512Widen<From>::bDouble)
+        {
+            for (; i + 8 <= Length; i += 8)
+            {
+                _mm512_storeu_pd(Out + i, Avx512Widen<From>::ToDouble(In + i));
+            }
+        }
+        ConvertScalar(In + i, Length - i, Out + i);
+    }
+
+    template <bool bConstThen, bool bConstElse>
+    OLAP_TARGET_AVX512 void SelectAvx512(const uint64_t* Bits, const uint64_t* Then, const uint64_t* Else, int64_t Length, uint64_t* Out)
+    {
+        const __m512i ConstThen = _mm512_set1_epi64(bConstThen ? (int64_t)Then[0] : 0);
+        const __m512i ConstElse = _mm512_set1_epi64(bConstElse ? (int64_t)Else[0] : 0);
+
+        int64_t i = 0;
+        for (; i + 8 <= Length; i += 8)
+        {
+            __mmask8 Mask = (__mmask8)(Bits[i >> 6] >> (i & 63));
+            __m512i X = bConstThen ? ConstThen : _mm512_loadu_si512(Then + i);
+            __m512i Y = bConstElse ? ConstElse : _mm512_loadu_si512(Else + i);
+            _mm512_storeu_si512(Out + i, _mm512_mask_blend_epi64(Mask, Y, X));
+        }
+
+        for (; i < Length; ++i)
+        {
+            bool bThen = (Bits[i >> 6] >> (i & 63)) & 1;
+            Out[i] = bThen ? Then[bConstThen ? 0 : i] : Else[bConstElse ? 0 : i];
+        }
+    }
+}
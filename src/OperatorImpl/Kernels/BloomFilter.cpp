@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "BloomFilter.h"
+
+namespace Kernels
+{
+    // odd constants, multiplying the key by each of them and keeping the top 5 bits gives 8 independent bit positions
+    alignas(32) static const uint32_t Salts[8] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+        0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+    };
+
+    BloomFilter::BloomFilter(int64_t ExpectedKeys)
+    {
+        // 256 bits per block, 16 bits per key
+        int64_t BlockCount = (ExpectedKeys * 16 + 255) / 256;
+        this->Blocks.resize(BlockCount > 0 ? BlockCount : 1, Block{});
+    }
+
+    void BloomFilter::Insert(uint64_t Hash)
+    {
+        Block& Target = this->Blocks[this->BlockIndex(Hash)];
+        uint32_t Key = (uint32_t)Hash;
+        for (int Word = 0; Word < 8; ++Word)
+        {
+            Target.Words[Word] |= 1u << ((Key * Salts[Word]) >> 27);
+        }
+    }
+
+    bool BloomFilter::MayContain(uint64_t Hash) const
+    {
+        const Block& Target = this->Blocks[this->BlockIndex(Hash)];
+        uint32_t Key = (uint32_t)Hash;
+        for (int Word = 0; Word < 8; ++Word)
+        {
+            if ((Target.Words[Word] & (1u << ((Key * Salts[Word]) >> 27))) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // all 8 bit positions at once: multiply by the salts, shift the top 5 bits down, turn them into one bit per lane
+    // and check that every one of them is set in the block (testc: (~Block & Mask) == 0)
+    bool BloomFilter::MayContainAvx2(uint64_t Hash) const
+    {
+        const Block& Target = this->Blocks[this->BlockIndex(Hash)];
+        __m256i SaltVector = _mm256_load_si256((const __m256i*)Salts);
+        __m256i Positions = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32((int)(uint32_t)Hash), SaltVector), 27);
+        __m256i Mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), Positions);
+        __m256i BlockVector = _mm256_load_si256((const __m256i*)Target.Words);
+        return _mm256_testc_si256(BlockVector, Mask) != 0;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <immintrin.h>
+#include "../../Misc/CpuFeatures.h"
+
+// Split block bloom filter (the layout Parquet and Impala use). The filter is an array of 32 byte blocks,
+// a key picks one block from its hash and sets one bit in each of the block's 8 words.
+// A lookup therefore touches a single cache line, and with AVX2 it is one load, one multiply and one test
+namespace Kernels
+{
+    class BloomFilter
+    {
+    public:
+        // sized for ~16 bits per key, which gives about 0.1% false positives
+        explicit BloomFilter(int64_t ExpectedKeys);
+
+        void Insert(uint64_t Hash);
+
+        // false means the key was definitely never inserted
+        bool MayContain(uint64_t Hash) const;
+        OLAP_TARGET_AVX2 bool MayContainAvx2(uint64_t Hash) const;
+
+    private:
+        struct alignas(32) Block
+        {
+            uint32_t Words[8];
+        };
+
+        std::vector<Block> Blocks;
+
+        // the upper half of the hash picks the block, the lower half the 8 bits inside it
+        uint64_t BlockIndex(uint64_t Hash) const
+        {
+            return ((Hash >> 32) * (uint64_t)this->Blocks.size()) >> 32;
+        }
+    };
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <immintrin.h>
+#include "../../Misc/CpuFeatures.h"
+
+// SIMD compress-store: writes the lanes of a vector whose mask bit is set to the front of Out, in order,
+// and returns how many were written. Instead of looping over the mask bits (which mispredicts at every
+// selectivity that isn't close to 0% or 100%) a lookup table maps the mask to a shuffle that moves the
+// selected lanes to the front. The whole vector is always stored, so Out needs room for a full vector
+// past the current position. The caller advances by the returned count, no branches involved.
+namespace Kernels
+{
+    // Generated at compile time. Entry [Mask] lists the source lanes of the set bits first,
+    // the lanes past the popcount are don't-care since the next store overwrites them
+    struct CompressTables
+    {
+        // [Mask][Lane] -> source lane, 8 x 32-bit lanes for _mm256_permutevar8x32_epi32
+        alignas(32) uint32_t Permutation32[256][8] = {};
+        // [Mask][Lane] -> 4 x 64-bit lanes expressed as pairs of 32-bit lanes
+        alignas(32) uint32_t Permutation64[16][8] = {};
+        // [Mask][Byte] -> source byte, 8 x 16-bit lanes for _mm_shuffle_epi8
+        alignas(16) uint8_t Shuffle16[256][16] = {};
+        // [Mask] -> number of set bits
+        uint8_t PopCount[256] = {};
+
+        constexpr CompressTables()
+        {
+            for (int Mask = 0; Mask < 256; ++Mask)
+            {
+                int Count = 0;
+                for (int Lane = 0; Lane < 8; ++Lane)
+                {
+                    if ((Mask >> Lane) & 1)
+                    {
+                        Permutation32[Mask][Count] = (uint32_t)Lane;
+                        Shuffle16[Mask][Count * 2] = (uint8_t)(Lane * 2);
+                        Shuffle16[Mask][Count * 2 + 1] = (uint8_t)(Lane * 2 + 1);
+                        ++Count;
+                    }
+                }
+                PopCount[Mask] = (uint8_t)Count;
+            }
+
+            // a 64-bit lane is the pair of 32-bit lanes (2 * Lane, 2 * Lane + 1)
+            for (int Mask = 0; Mask < 16; ++Mask)
+            {
+                int Count = 0;
+                for (int Lane = 0; Lane < 4; ++Lane)
+                {
+                    if ((Mask >> Lane) & 1)
+                    {
+                        Permutation64[Mask][Count * 2] = (uint32_t)(Lane * 2);
+                        Permutation64[Mask][Count * 2 + 1] = (uint32_t)(Lane * 2 + 1);
+                        ++Count;
+                    }
+                }
+            }
+        }
+    };
+
+    inline constexpr CompressTables CompressLUT{};
+
+    // Mask comes from _mm256_movemask_ps, bit i selects 32-bit lane i
+    OLAP_TARGET_AVX2 inline int CompressStore32(int32_t* Out, __m256i Data, int Mask)
+    {
+        __m256i Permutation = _mm256_load_si256((const __m256i*)CompressLUT.Permutation32[Mask]);
+        _mm256_storeu_si256((__m256i*)Out, _mm256_permutevar8x32_epi32(Data, Permutation));
+        return CompressLUT.PopCount[Mask];
+    }
+
+    // Mask comes from _mm256_movemask_pd, bit i selects 64-bit lane i
+    OLAP_TARGET_AVX2 inline int CompressStore64(int64_t* Out, __m256i Data, int Mask)
+    {
+        __m256i Permutation = _mm256_load_si256((const __m256i*)CompressLUT.Permutation64[Mask]);
+        _mm256_storeu_si256((__m256i*)Out, _mm256_permutevar8x32_epi32(Data, Permutation));
+        return CompressLUT.PopCount[Mask];
+    }
+
+    // 8 x 16-bit lanes in a 128-bit register, bit i selects lane i
+    // (get the mask with _mm_movemask_epi8(_mm_packs_epi16(CompareResult, _mm_setzero_si128())))
+    OLAP_TARGET_AVX2 inline int CompressStore16(int16_t* Out, __m128i Data, int Mask)
+    {
+        __m128i Shuffle = _mm_load_si128((const __m128i*)CompressLUT.Shuffle16[Mask]);
+        _mm_storeu_si128((__m128i*)Out, _mm_shuffle_epi8(Data, Shuffle));
+        return CompressLUT.PopCount[Mask];
+    }
+
+    // AVX-512 has compress built in (vpcompressd), no table needed. We compress in a register and do a
+    // normal full-width store, that's faster than the memory form of vpcompressd on most cores.
+    // Out needs room for 16 ints past the current position
+    OLAP_TARGET_AVX512 inline int CompressStore32x16(int32_t* Out, __m512i Data, __mmask16 Mask)
+    {
+        _mm512_storeu_si512((void*)Out, _mm512_maskz_compress_epi32(Mask, Data));
+        return (int)_mm_popcnt_u32((unsigned)Mask);
+    }
+}
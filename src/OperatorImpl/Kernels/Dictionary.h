@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <immintrin.h>
+#include "../../Misc/CpuFeatures.h"
+
+// Predicates on dictionary encoded columns. The predicate runs once over the dictionary's values into a bitmap over
+// the codes (code c matches when bit c is set), after that a row is only the lookup of its code's bit, whatever the
+// predicate or the value type was. Writes row bits the same way as Predicates.h, bit i of word w is row 64 * w + i.
+// A code outside of the dictionary looks up 0, that's what the slot of a null row may hold. Nulls are cleared by the caller
+namespace Kernels
+{
+    // The matches of one dictionary, (Size + 63) / 64 words with the bits past Size 0
+    struct DictionaryMatches
+    {
+        const uint64_t* Bits = nullptr;
+        int64_t Size = 0;
+    };
+
+    // Length rows into (Length + 63) / 64 words, the bits past Length in the last word are 0. Any index type
+    template <typename IndexType>
+    void LookupCodesScalar(const IndexType* Codes, int64_t Length, const DictionaryMatches& M, uint64_t* OutBits)
+    {
+        using Unsigned = std::make_unsigned_t<IndexType>;
+        for (int64_t Word = 0; Word * 64 < Length; ++Word)
+        {
+            const IndexType* Rows = Codes + Word * 64;
+            int Count = (int)std::min<int64_t>(64, Length - Word * 64);
+            uint64_t Bits = 0;
+            for (int i = 0; i < Count; ++i)
+            {
+                uint64_t Code = (Unsigned)Rows[i]; // a negative code turns huge and fails the bounds check
+                Bits |= (uint64_t)(Code < (uint64_t)M.Size && ((M.Bits[Code >> 6] >> (Code & 63)) & 1)) << i;
+            }
+            OutBits[Word] = Bits;
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // int32 codes, what parquet hands out. Up to 64 entries the whole bitmap sits in two registers and a code is a
+    // variable shift, srlv gives 0 for any count >= 32, which is also what keeps codes outside of [0, 64) at 0.
+    // Bigger dictionaries gather the bitmap word of every code, masked to the codes that are in range
+
+    OLAP_TARGET_AVX2 inline uint64_t LookupSmallAvx2(__m256i Codes, __m256i Low, __m256i High)
+    {
+        const __m256i ThirtyTwo = _mm256_set1_epi32(32);
+        __m256i Bit = _mm256_or_si256(_mm256_srlv_epi32(Low, Codes), _mm256_srlv_epi32(High, _mm256_sub_epi32(Codes, ThirtyTwo)));
+        return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(Bit, 31)));
+    }
+
+    OLAP_TARGET_AVX2 inline uint64_t LookupLargeAvx2(__m256i Codes, __m256i Size, const int* Words)
+    {
+        __m256i InRange = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), Codes), _mm256_cmpgt_epi32(Size, Codes));
+        __m256i Word = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), Words, _mm256_srli_epi32(Codes, 5), InRange, 4);
+        __m256i Bit = _mm256_srlv_epi32(Word, _mm256_and_si256(Codes, _mm256_set1_epi32(31)));
+        return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(Bit, 31)));
+    }
+
+    OLAP_TARGET_AVX2 inline void LookupCodesAvx2(const int32_t* Codes, int64_t Length, const DictionaryMatches& M, uint64_t* OutBits)
+    {
+        bool bSmall = M.Size <= 64;
+        uint64_t Small = M.Size > 0 ? M.Bits[0] : 0;
+        const __m256i Low = _mm256_set1_epi32((int)(uint32_t)Small);
+        const __m256i High = _mm256_set1_epi32((int)(uint32_t)(Small >> 32));
+        const __m256i Size = _mm256_set1_epi32((int)std::min<int64_t>(M.Size, INT32_MAX));
+        const int* Words = (const int*)M.Bits;
+
+        int64_t Word = 0;
+        for (; (Word + 1) * 64 <= Length; ++Word)
+        {
+            const int32_t* Rows = Codes + Word * 64;
+            uint64_t Bits = 0;
+            for (int Part = 0; Part < 64; Part += 8)
+            {
+                __m256i X = _mm256_loadu_si256((const __m256i*)(Rows + Part));
+                Bits |= (bSmall ? LookupSmallAvx2(X, Low, High) : LookupLargeAvx2(X, Size, Words)) << Part;
+            }
+            OutBits[Word] = Bits;
+        }
+
+        LookupCodesScalar(Codes + Word * 64, Length - Word * 64, M, OutBits + Word);
+    }
+
+    OLAP_TARGET_AVX512 inline void LookupCodesAvx512(const int32_t* Codes, int64_t Length, const DictionaryMatches& M, uint64_t* OutBits)
+    {
+        bool bSmall = M.Size <= 64;
+        uint64_t Small = M.Size > 0 ? M.Bits[0] : 0;
+        const __m512i Low = _mm512_set1_epi32((int)(uint32_t)Small);
+        const __m512i High = _mm512_set1_epi32((int)(uint32_t)(Small >> 32));
+        const __m512i ThirtyTwo = _mm512_set1_epi32(32);
+        const __m512i One = _mm512_set1_epi32(1);
+        const __m512i ThirtyOne = _mm512_set1_epi32(31);
+        const __m512i Size = _mm512_set1_epi32((int)std::min<int64_t>(M.Size, INT32_MAX));
+        const int* Words = (const int*)M.Bits;
+
+        int64_t Word = 0;
+        for (; (Word + 1) * 64 <= Length; ++Word)
+        {
+            const int32_t* Rows = Codes + Word * 64;
+            uint64_t Bits = 0;
+            for (int Part = 0; Part < 64; Part += 16)
+            {
+                __m512i X = _mm512_loadu_si512(Rows + Part);
+                __m512i Bit;
+                if (bSmall)
+                {
+                    Bit = _mm512_or_si512(_mm512_srlv_epi32(Low, X), _mm512_srlv_epi32(High, _mm512_sub_epi32(X, ThirtyTwo)));
+                }
+                else
+                {
+                    // unsigned compare, a negative code is out of range as well
+                    __mmask16 InRange = _mm512_cmplt_epu32_mask(X, Size);
+                    __m512i Gathered = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), InRange, _mm512_srli_epi32(X, 5), Words, 4);
+                    Bit = _mm512_srlv_epi32(Gathered, _mm512_and_si512(X, ThirtyOne));
+                }
+                Bits |= (uint64_t)_mm512_test_epi32_mask(Bit, One) << Part;
+            }
+            OutBits[Word] = Bits;
+        }
+
+        LookupCodesScalar(Codes + Word * 64, Length - Word * 64, M, OutBits + Word);
+    }
+}
@@ -0,0 +1,256 @@
+#include "pch.h"
+#include "Gather.h"
+#include "../../Misc/CpuFeatures.h"
+#include "../../Execution/ChunkBufferPool.h"
+#include <arrow/util/bit_util.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace Kernels
+{
+    template <typename T>
+    static void GatherScalar(const T* In, const int32_t* Selection, int64_t Count, T* Out)
+    {
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            Out[i] = In[Selection[i]];
+        }
+    }
+
+    // 16 rows per iteration, one hardware gather loads In[Selection[i + 0..15]]
+    OLAP_TARGET_AVX512 static void Gather32Avx512(const int32_t* In, const int32_t* Selection, int64_t Count, int32_t* Out)
+    {
+        int64_t i = 0;
+        for (; i <= Count - 16; i += 16)
+        {
+            __m512i IndexVector = _mm512_loadu_si512((const void*)(Selection + i));
+            __m512i DataVector = _mm512_i32gather_epi32(IndexVector, (const void*)In, 4);
+            _mm512_storeu_si512((void*)(Out + i), DataVector);
+        }
+        GatherScalar(In, Selection + i, Count - i, Out + i);
+    }
+
+    // 8 rows per iteration
+    OLAP_TARGET_AVX2 static void Gather32Avx2(const int32_t* In, const int32_t* Selection, int64_t Count, int32_t* Out)
+    {
+        int64_t i = 0;
+        for (; i <= Count - 8; i += 8)
+        {
+            __m256i IndexVector = _mm256_loadu_si256((const __m256i*)(Selection + i));
+            __m256i DataVector = _mm256_i32gather_epi32((const int*)In, IndexVector, 4);
+            _mm256_storeu_si256((__m256i*)(Out + i), DataVector);
+        }
+        GatherScalar(In, Selection + i, Count - i, Out + i);
+    }
+
+    // 8 byte values, 8 indices widen into a full 512-bit register
+    OLAP_TARGET_AVX512 static void Gather64Avx512(const int64_t* In, const int32_t* Selection, int64_t Count, int64_t* Out)
+    {
+        int64_t i = 0;
+        for (; i <= Count - 8; i += 8)
+        {
+            __m256i IndexVector = _mm256_loadu_si256((const __m256i*)(Selection + i));
+            __m512i DataVector = _mm512_i32gather_epi64(IndexVector, (const void*)In, 8);
+            _mm512_storeu_si512((void*)(Out + i), DataVector);
+        }
+        GatherScalar(In, Selection + i, Count - i, Out + i);
+    }
+
+    // a 256-bit register only fits 4 of them
+    OLAP_TARGET_AVX2 static void Gather64Avx2(const int64_t* In, const int32_t* Selection, int64_t Count, int64_t* Out)
+    {
+        int64_t i = 0;
+        for (; i <= Count - 4; i += 4)
+        {
+            __m128i IndexVector = _mm_loadu_si128((const __m128i*)(Selection + i));
+            __m256i DataVector = _mm256_i32gather_epi64((const long long*)In, IndexVector, 8);
+            _mm256_storeu_si256((__m256i*)(Out + i), DataVector);
+        }
+        GatherScalar(In, Selection + i, Count - i, Out + i);
+    }
+
+    // Materialize has no execution mode of its own, so these pick the widest kernel the CPU supports
+    void Gather32(const int32_t* In, const int32_t* Selection, int64_t Count, int32_t* Out)
+    {
+        const CpuFeatures::Features& Features = CpuFeatures::Get();
+        if (Features.bAvx512) Gather32Avx512(In, Selection, Count, Out);
+        else if (Features.bAvx2) Gather32Avx2(In, Selection, Count, Out);
+        else GatherScalar(In, Selection, Count, Out);
+    }
+
+    void Gather64(const int64_t* In, const int32_t* Selection, int64_t Count, int64_t* Out)
+    {
+        const CpuFeatures::Features& Features = CpuFeatures::Get();
+        if (Features.bAvx512) Gather64Avx512(In, Selection, Count, Out);
+        else if (Features.bAvx2) Gather64Avx2(In, Selection, Count, Out);
+        else GatherScalar(In, Selection, Count, Out);
+    }
+
+    // Where the output buffers come from: the recycler when there is one, a fresh buffer from Pool otherwise
+    struct BufferSource
+    {
+        arrow::MemoryPool* Pool;
+        ChunkBufferPool* Recycler;
+
+        std::shared_ptr<arrow::Buffer> Allocate(int64_t Size) const
+        {
+            if (this->Recycler != nullptr)
+            {
+                return this->Recycler->Acquire(Size);
+            }
+
+            arrow::Result<std::unique_ptr<arrow::Buffer>> BufferResult = arrow::AllocateBuffer(Size, this->Pool);
+            PARQUET_THROW_NOT_OK(BufferResult.status());
+            return std::shared_ptr<arrow::Buffer>(std::move(BufferResult).ValueOrDie());
+        }
+    };
+
+    // Copies bit Offset + Selection[i] of InBits to bit i of a new bitmap, returns how many bits were 0
+    static std::shared_ptr<arrow::Buffer> GatherBits(const uint8_t* InBits, int64_t Offset, const int32_t* Selection, int64_t Count, const BufferSource& Buffers, int64_t* OutZeroCount)
+    {
+        std::shared_ptr<arrow::Buffer> Bitmap = Buffers.Allocate(arrow::bit_util::BytesForBits(Count));
+        uint8_t* OutBits = Bitmap->mutable_data();
+        std::memset(OutBits, 0, Bitmap->size());
+
+        int64_t ZeroCount = 0;
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            if (arrow::bit_util::GetBit(InBits, Offset + Selection[i]))
+            {
+                arrow::bit_util::SetBit(OutBits, i);
+            }
+            else
+            {
+                ++ZeroCount;
+            }
+        }
+
+        *OutZeroCount = ZeroCount;
+        return Bitmap;
+    }
+
+    // validity bitmap of the output, nullptr when the input has no nulls at all
+    static std::shared_ptr<arrow::Buffer> GatherValidity(const arrow::ArrayData& Data, const int32_t* Selection, int64_t Count, const BufferSource& Buffers, int64_t* OutNullCount)
+    {
+        *OutNullCount = 0;
+        if (Data.buffers[0] == nullptr || Data.GetNullCount() == 0)
+        {
+            return nullptr;
+        }
+        return GatherBits(Data.buffers[0]->data(), Data.offset, Selection, Count, Buffers, OutNullCount);
+    }
+
+    static std::shared_ptr<arrow::Buffer> GatherFixedWidthValues(const arrow::ArrayData& Data, int ByteWidth, const int32_t* Selection, int64_t Count, const BufferSource& Buffers)
+    {
+        std::shared_ptr<arrow::Buffer> Values = Buffers.Allocate(Count * ByteWidth);
+        const uint8_t* In = Data.buffers[1]->data() + Data.offset * ByteWidth;
+        uint8_t* Out = Values->mutable_data();
+
+        switch (ByteWidth)
+        {
+        case 1:
+            GatherScalar((const uint8_t*)In, Selection, Count, Out);
+            break;
+        case 2:
+            GatherScalar((const uint16_t*)In, Selection, Count, (uint16_t*)Out);
+            break;
+        case 4:
+            Gather32((const int32_t*)In, Selection, Count, (int32_t*)Out);
+            break;
+        case 8:
+            Gather64((const int64_t*)In, Selection, Count, (int64_t*)Out);
+            break;
+        default:
+            // decimals, fixed size binary, intervals...
+            for (int64_t i = 0; i < Count; ++i)
+            {
+                std::memcpy(Out + i * ByteWidth, In + (int64_t)Selection[i] * ByteWidth, ByteWidth);
+            }
+            break;
+        }
+
+        return Values;
+    }
+
+    // string / binary columns: first build the new offsets, then copy every selected value's bytes
+    template <typename OffsetType>
+    static std::shared_ptr<arrow::ArrayData> GatherVarWidth(const arrow::ArrayData& Data, const int32_t* Selection, int64_t Count, const BufferSource& Buffers)
+    {
+        const OffsetType* InOffsets = Data.GetValues<OffsetType>(1);
+        const uint8_t* InBytes = Data.buffers[2] ? Data.buffers[2]->data() : nullptr;
+
+        std::shared_ptr<arrow::Buffer> Offsets = Buffers.Allocate((Count + 1) * sizeof(OffsetType));
+        OffsetType* OutOffsets = (OffsetType*)Offsets->mutable_data();
+
+        OutOffsets[0] = 0;
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int32_t Row = Selection[i];
+            OutOffsets[i + 1] = OutOffsets[i] + (InOffsets[Row + 1] - InOffsets[Row]);
+        }
+
+        std::shared_ptr<arrow::Buffer> Bytes = Buffers.Allocate(OutOffsets[Count]);
+        uint8_t* OutBytes = Bytes->mutable_data();
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int32_t Row = Selection[i];
+            std::memcpy(OutBytes + OutOffsets[i], InBytes + InOffsets[Row], OutOffsets[i + 1] - OutOffsets[i]);
+        }
+
+        int64_t NullCount;
+        std::shared_ptr<arrow::Buffer> Validity = GatherValidity(Data, Selection, Count, Buffers, &NullCount);
+        return arrow::ArrayData::Make(Data.type, Count, { Validity, Offsets, Bytes }, NullCount);
+    }
+
+    std::shared_ptr<arrow::Array> GatherArray(const arrow::Array& Input, const int32_t* Selection, int64_t Count, arrow::MemoryPool* Pool, ChunkBufferPool* Recycler)
+    {
+        BufferSource Buffers{ Pool, Recycler };
+        const arrow::ArrayData& Data = *Input.data();
+        const std::shared_ptr<arrow::DataType>& Type = Data.type;
+
+        switch (Type->id())
+        {
+        case arrow::Type::NA:
+            return arrow::MakeArray(arrow::ArrayData::Make(Type, Count, { nullptr }, Count));
+        case arrow::Type::BOOL:
+        {
+            // values are bit packed just like the validity bitmap
+            int64_t FalseCount;
+            std::shared_ptr<arrow::Buffer> Values = GatherBits(Data.buffers[1]->data(), Data.offset, Selection, Count, Buffers, &FalseCount);
+            int64_t NullCount;
+            std::shared_ptr<arrow::Buffer> Validity = GatherValidity(Data, Selection, Count, Buffers, &NullCount);
+            return arrow::MakeArray(arrow::ArrayData::Make(Type, Count, { Validity, Values }, NullCount));
+        }
+        case arrow::Type::STRING:
+        case arrow::Type::BINARY:
+            return arrow::MakeArray(GatherVarWidth<int32_t>(Data, Selection, Count, Buffers));
+        case arrow::Type::LARGE_STRING:
+        case arrow::Type::LARGE_BINARY:
+            return arrow::MakeArray(GatherVarWidth<int64_t>(Data, Selection, Count, Buffers));
+        case arrow::Type::DICTIONARY:
+        {
+            // only the codes move, the gathered rows keep pointing into the same dictionary
+            int ByteWidth = static_cast<const arrow::DictionaryType&>(*Type).index_type()->byte_width();
+            std::shared_ptr<arrow::Buffer> Indices = GatherFixedWidthValues(Data, ByteWidth, Selection, Count, Buffers);
+            int64_t NullCount;
+            std::shared_ptr<arrow::Buffer> Validity = GatherValidity(Data, Selection, Count, Buffers, &NullCount);
+            std::shared_ptr<arrow::ArrayData> Gathered = arrow::ArrayData::Make(Type, Count, { Validity, Indices }, NullCount);
+            Gathered->dictionary = Data.dictionary;
+            return arrow::MakeArray(Gathered);
+        }
+        default:
+            break;
+        }
+
+        if (arrow::is_fixed_width(Type->id()))
+        {
+            int ByteWidth = static_cast<const arrow::FixedWidthType&>(*Type).bit_width() / 8;
+            std::shared_ptr<arrow::Buffer> Values = GatherFixedWidthValues(Data, ByteWidth, Selection, Count, Buffers);
+            int64_t NullCount;
+            std::shared_ptr<arrow::Buffer> Validity = GatherValidity(Data, Selection, Count, Buffers, &NullCount);
+            return arrow::MakeArray(arrow::ArrayData::Make(Type, Count, { Validity, Values }, NullCount));
+        }
+
+        throw std::runtime_error("Can't compact a column of type " + Type->ToString());
+    }
+}
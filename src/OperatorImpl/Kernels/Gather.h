@@ -0,0 +1,23 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include <arrow/array.h>
+#include <arrow/memory_pool.h>
+
+class ChunkBufferPool;
+
+// Kernels that copy the rows listed in a selection vector into a new, compact array.
+// The selection is computed once by the filter and then reused for every column of the batch
+namespace Kernels
+{
+    // Builds a new array holding Input[Selection[0]], ..., Input[Selection[Count - 1]]
+    // Handles every fixed-width type (including booleans), string/binary and dictionary columns, validity bitmaps are carried over.
+    // Throws for column types we don't know how to compact yet (nested types).
+    // The new buffers come from Recycler when one is given (see Execution/ChunkBufferPool.h), from Pool otherwise
+    std::shared_ptr<arrow::Array> GatherArray(const arrow::Array& Input, const int32_t* Selection, int64_t Count,
+        arrow::MemoryPool* Pool = arrow::default_memory_pool(), ChunkBufferPool* Recycler = nullptr);
+
+    // Out[i] = In[Selection[i]]. These are the raw value loops used by GatherArray
+    void Gather32(const int32_t* In, const int32_t* Selection, int64_t Count, int32_t* Out);
+    void Gather64(const int64_t* In, const int32_t* Selection, int64_t Count, int64_t* Out);
+}
@@ -0,0 +1,269 @@
+#include "pch.h"
+#include "GroupHashTable.h"
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Kernels
+{
+    // how many rows ahead the bucket of a row gets prefetched, far enough to hide a cache miss
+    static constexpr int64_t PrefetchDistance = 16;
+
+    static inline int CountTrailingZeros(uint32_t Value)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long Index;
+        _BitScanForward(&Index, Value);
+        return (int)Index;
+#else
+        return __builtin_ctz(Value);
+#endif
+    }
+
+    GroupHashTable::GroupHashTable(int KeyWidth, bool bSimdProbe)
+        : KeyWidth(KeyWidth), bSimdProbe(bSimdProbe), bDirect(KeyWidth == 1)
+    {
+        // multi column keys never use the direct array, start with a small table right away
+        if (!this->bDirect)
+        {
+            this->Rehash(64);
+        }
+    }
+
+    // every key column is mixed in, then a murmur3 finalizer so both the low bits (bucket)
+    // and the high bits (tag) depend on all of the key
+    uint64_t GroupHashTable::HashKey(const int64_t* Key) const
+    {
+        uint64_t Hash = 0x9E3779B97F4A7C15ull;
+        for (int k = 0; k < this->KeyWidth; ++k)
+        {
+            Hash = (Hash ^ (uint64_t)Key[k]) * 0xFF51AFD7ED558CCDull;
+            Hash ^= Hash >> 32;
+        }
+
+        Hash ^= Hash >> 33;
+        Hash *= 0xC4CEB9FE1A85EC53ull;
+        Hash ^= Hash >> 33;
+        return Hash;
+    }
+
+    int32_t GroupHashTable::AddGroup(const int64_t* Key, uint64_t Hash)
+    {
+        this->GroupKeys.insert(this->GroupKeys.end(), Key, Key + this->KeyWidth);
+        this->GroupHashes.push_back(Hash);
+        return this->GroupCount++;
+    }
+
+    void GroupHashTable::FindOrInsert(const int64_t* Keys, int64_t Count, int32_t* OutGroupIds)
+    {
+        if (Count == 0)
+        {
+            return;
+        }
+
+        if (this->bDirect)
+        {
+            int64_t Min = Keys[0];
+            int64_t Max = Keys[0];
+            for (int64_t i = 1; i < Count; ++i)
+            {
+                Min = Keys[i] < Min ? Keys[i] : Min;
+                Max = Keys[i] > Max ? Keys[i] : Max;
+            }
+
+            if (this->GrowDirect(Min, Max))
+            {
+                this->FindOrInsertDirect(Keys, Count, OutGroupIds);
+                return;
+            }
+
+            // the domain isn't small after all, move the groups we have into a real hash table.
+            // Group ids don't change, so the aggregate states collected so far stay valid
+            this->bDirect = false;
+            std::vector<int32_t>().swap(this->DirectIds);
+
+            uint64_t BucketCount = 64;
+            while ((int64_t)BucketCount * GroupSize * 7 / 8 <= (int64_t)this->GroupCount * 2)
+            {
+                BucketCount *= 2;
+            }
+            this->Rehash(BucketCount);
+        }
+
+        this->FindOrInsertHashed(Keys, Count, OutGroupIds);
+    }
+
+    bool GroupHashTable::GrowDirect(int64_t Min, int64_t Max)
+    {
+        int64_t NewBase = Min;
+        int64_t NewLast = Max;
+        if (!this->DirectIds.empty())
+        {
+            NewBase = std::min(NewBase, this->DirectBase);
+            NewLast = std::max(NewLast, this->DirectBase + (int64_t)this->DirectIds.size() - 1);
+        }
+
+        // unsigned so a range spanning most of int64 can't overflow
+        uint64_t NewRange = (uint64_t)NewLast - (uint64_t)NewBase + 1;
+        if (NewRange == 0 || NewRange > (uint64_t)MaxDirectRange)
+        {
+            return false;
+        }
+
+        if (NewRange == this->DirectIds.size())
+        {
+            return true;
+        }
+
+        std::vector<int32_t> NewIds(NewRange, -1);
+        if (!this->DirectIds.empty())
+        {
+            std::copy(this->DirectIds.begin(), this->DirectIds.end(), NewIds.begin() + (this->DirectBase - NewBase));
+        }
+
+        this->DirectIds.swap(NewIds);
+        this->DirectBase = NewBase;
+        return true;
+    }
+
+    void GroupHashTable::FindOrInsertDirect(const int64_t* Keys, int64_t Count, int32_t* OutGroupIds)
+    {
+        int32_t* Ids = this->DirectIds.data();
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int32_t& GroupId = Ids[Keys[i] - this->DirectBase];
+            if (GroupId < 0)
+            {
+                // hashed now (once per group) in case we have to switch to the hash table later
+                GroupId = this->AddGroup(Keys + i, this->HashKey(Keys + i));
+            }
+            OutGroupIds[i] = GroupId;
+        }
+    }
+
+    // Hashes the whole batch first (a tight loop with no dependencies between rows), then probes.
+    // While probing row i the bucket of row i + PrefetchDistance is already on its way into the cache
+    void GroupHashTable::FindOrInsertHashed(const int64_t* Keys, int64_t Count, int32_t* OutGroupIds)
+    {
+        if ((int64_t)this->HashBuffer.size() < Count)
+        {
+            this->HashBuffer.resize(Count);
+        }
+        uint64_t* Hashes = this->HashBuffer.data();
+
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            Hashes[i] = this->HashKey(Keys + i * this->KeyWidth);
+        }
+
+        const __m128i EmptyVector = _mm_set1_epi8((char)EmptyTag);
+
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            if (i + PrefetchDistance < Count)
+            {
+                uint64_t PrefetchBucket = Hashes[i + PrefetchDistance] & this->BucketMask;
+                _mm_prefetch((const char*)(this->Tags.data() + PrefetchBucket * GroupSize), _MM_HINT_T0);
+            }
+
+            if (this->GroupCount >= this->GrowThreshold)
+            {
+                this->Rehash((this->BucketMask + 1) * 2);
+            }
+
+            const int64_t* Key = Keys + i * this->KeyWidth;
+            uint64_t Hash = Hashes[i];
+            uint8_t Tag = (uint8_t)(0x80 | (Hash >> 57));
+            uint64_t Bucket = Hash & this->BucketMask;
+
+            while (true)
+            {
+                const uint8_t* BucketTags = this->Tags.data() + Bucket * GroupSize;
+
+                // bit j of Match: slot j has the same tag (probably the same key), bit j of Empty: slot j is free
+                uint32_t Match = 0;
+                uint32_t Empty = 0;
+                if (this->bSimdProbe)
+                {
+                    __m128i TagVector = _mm_loadu_si128((const __m128i*)BucketTags);
+                    Match = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(TagVector, _mm_set1_epi8((char)Tag)));
+                    Empty = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(TagVector, EmptyVector));
+                }
+                else
+                {
+                    for (int Lane = 0; Lane < GroupSize; ++Lane)
+                    {
+                        Match |= (uint32_t)(BucketTags[Lane] == Tag) << Lane;
+                        Empty |= (uint32_t)(BucketTags[Lane] == EmptyTag) << Lane;
+                    }
+                }
+
+                int32_t Found = -1;
+                while (Match != 0)
+                {
+                    int32_t GroupId = this->Slots[Bucket * GroupSize + CountTrailingZeros(Match)];
+                    const int64_t* GroupKey = this->GroupKeys.data() + (int64_t)GroupId * this->KeyWidth;
+                    if (std::equal(Key, Key + this->KeyWidth, GroupKey))
+                    {
+                        Found = GroupId;
+                        break;
+                    }
+                    Match &= Match - 1;
+                }
+
+                if (Found >= 0)
+                {
+                    OutGroupIds[i] = Found;
+                    break;
+                }
+
+                // slots are filled front to back and never removed, so a free slot means the key isn't in the table
+                if (Empty != 0)
+                {
+                    uint64_t Slot = Bucket * GroupSize + CountTrailingZeros(Empty);
+                    this->Tags[Slot] = Tag;
+                    this->Slots[Slot] = this->AddGroup(Key, Hash);
+                    OutGroupIds[i] = this->Slots[Slot];
+                    break;
+                }
+
+                Bucket = (Bucket + 1) & this->BucketMask;
+            }
+        }
+    }
+
+    void GroupHashTable::Rehash(uint64_t NewBucketCount)
+    {
+        this->Tags.assign(NewBucketCount * GroupSize, EmptyTag);
+        this->Slots.assign(NewBucketCount * GroupSize, -1);
+        this->BucketMask = NewBucketCount - 1;
+        this->GrowThreshold = (int64_t)NewBucketCount * GroupSize * 7 / 8;
+
+        for (int32_t GroupId = 0; GroupId < this->GroupCount; ++GroupId)
+        {
+            this->InsertSlot(this->GroupHashes[GroupId], GroupId);
+        }
+    }
+
+    // every group is unique here, so we only look for the first free slot along the probe sequence
+    void GroupHashTable::InsertSlot(uint64_t Hash, int32_t GroupId)
+    {
+        uint64_t Bucket = Hash & this->BucketMask;
+        while (true)
+        {
+            uint8_t* BucketTags = this->Tags.data() + Bucket * GroupSize;
+            for (int Lane = 0; Lane < GroupSize; ++Lane)
+            {
+                if (BucketTags[Lane] == EmptyTag)
+                {
+                    BucketTags[Lane] = (uint8_t)(0x80 | (Hash >> 57));
+                    this->Slots[Bucket * GroupSize + Lane] = GroupId;
+                    return;
+                }
+            }
+            Bucket = (Bucket + 1) & this->BucketMask;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Maps GROUP BY keys to dense group ids (0, 1, 2, ... in the order the groups were first seen).
+// The operators keep their aggregate states in plain arrays indexed by group id, the table only stores
+// the keys, so a probe touches 1 byte of tag per slot instead of a whole key + state entry
+namespace Kernels
+{
+    class GroupHashTable
+    {
+    public:
+        // KeyWidth is the number of key columns, every key is widened to int64.
+        // bSimdProbe compares the 16 tags of a bucket group with one SSE2 compare instead of a byte loop
+        GroupHashTable(int KeyWidth, bool bSimdProbe);
+
+        // Keys holds Count rows of KeyWidth values each (row major).
+        // Writes the group id of every row to OutGroupIds, rows with a key that wasn't seen before get a new group
+        void FindOrInsert(const int64_t* Keys, int64_t Count, int32_t* OutGroupIds);
+
+        int32_t NumGroups() const { return this->GroupCount; }
+
+        // KeyWidth values per group, in group id order
+        const int64_t* Keys() const { return this->GroupKeys.data(); }
+
+        // true while the keys fit the direct indexed array and no hashing happens at all
+        bool IsDirect() const { return this->bDirect; }
+
+    private:
+        static constexpr int GroupSize = 16;             // tags compared per probe step, one SSE2 register
+        static constexpr uint8_t EmptyTag = 0;           // occupied tags always have the top bit set
+        static constexpr int64_t MaxDirectRange = 1 << 16; // 256 KB of group ids, stays in L2
+
+        int KeyWidth;
+        bool bSimdProbe;
+        int32_t GroupCount = 0;
+
+        std::vector<int64_t> GroupKeys;   // [GroupId * KeyWidth + k]
+        std::vector<uint64_t> GroupHashes; // so growing doesn't have to rehash the keys
+
+        // Open addressing over buckets of GroupSize slots. Tags[i] is 7 bits of the hash of slot i (top bit set)
+        // or EmptyTag, Slots[i] is the group id stored in slot i
+        std::vector<uint8_t> Tags;
+        std::vector<int32_t> Slots;
+        uint64_t BucketMask = 0;
+        int64_t GrowThreshold = 0; // the table doubles once it holds this many groups (7/8 full)
+
+        // Small dense domain of a single key column: DirectIds[Key - DirectBase] is the group id or -1
+        bool bDirect;
+        int64_t DirectBase = 0;
+        std::vector<int32_t> DirectIds;
+
+        std::vector<uint64_t> HashBuffer; // hashes of the current batch, reused between batches
+
+        uint64_t HashKey(const int64_t* Key) const;
+        int32_t AddGroup(const int64_t* Key, uint64_t Hash);
+
+        void FindOrInsertDirect(const int64_t* Keys, int64_t Count, int32_t* OutGroupIds);
+        void FindOrInsertHashed(const int64_t* Keys, int64_t Count, int32_t* OutGroupIds);
+
+        // Tries to widen the direct array so it covers [Min, Max], returns false when the range got too big
+        bool GrowDirect(int64_t Min, int64_t Max);
+
+        // Leaves direct mode (or doubles the table) and puts every existing group into the hash table again
+        void Rehash(uint64_t NewBucketCount);
+        void InsertSlot(uint64_t Hash, int32_t GroupId);
+    };
+}
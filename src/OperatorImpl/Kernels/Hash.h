@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+
+namespace Kernels
+{
+    // murmur3 finalizer. Every output bit depends on every input bit, so the low bits can pick a bucket
+    // and the high bits a partition (or a bloom filter block) without the two being correlated
+    inline uint64_t HashInt64(int64_t Key)
+    {
+        uint64_t Hash = (uint64_t)Key;
+        Hash ^= Hash >> 33;
+        Hash *= 0xFF51AFD7ED558CCDull;
+        Hash ^= Hash >> 33;
+        Hash *= 0xC4CEB9FE1A85EC53ull;
+        Hash ^= Hash >> 33;
+        return Hash;
+    }
+}
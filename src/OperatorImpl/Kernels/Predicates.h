@@ -0,0 +1,447 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <immintrin.h>
+#include "TypedKernels.h"
+#include "Compaction.h"
+#include "Validity.h"
+#include "../ScanPredicate.h"
+#include "../../Misc/CpuFeatures.h"
+
+// Column predicates (x < C, x BETWEEN A AND B, x IN (...), ...) evaluated into bitmaps, one bit per row (bit i of word w is row 64 * w + i).
+// The comparison is a template parameter, so every (PredicateOp, T) pair is its own loop with the compare picked at compile time,
+// the only runtime dispatch is once per batch and column. AND / OR of several predicates are ANDs / ORs of the bitmaps,
+// the rows are only turned into a selection vector (BitsToSelection*) once the whole expression has been evaluated
+namespace Kernels
+{
+    // The constants of one predicate, already converted to the column's type (see FilterExpression.cpp for the range checks)
+    template <typename T>
+    struct PredicateConstants
+    {
+        T Low = T(0);                   // the constant of a comparison, the lower bound of BETWEEN
+        T High = T(0);                  // the upper bound of BETWEEN
+        const T* Values = nullptr;      // IN list, sorted
+        int64_t ValueCount = 0;
+    };
+
+    // IN lists up to this long are compared against every value with SIMD, longer ones binary search per row
+    constexpr int64_t MaxSimdInValues = 16;
+
+    template <PredicateOp Op, typename T>
+    inline bool Matches(T Value, const PredicateConstants<T>& C)
+    {
+        if constexpr (Op == PredicateOp::EQUAL) return Value == C.Low;
+        else if constexpr (Op == PredicateOp::NOT_EQUAL) return Value != C.Low;
+        else if constexpr (Op == PredicateOp::LESS) return Value < C.Low;
+        else if constexpr (Op == PredicateOp::LESS_EQUAL) return Value <= C.Low;
+        else if constexpr (Op == PredicateOp::GREATER) return Value > C.Low;
+        else if constexpr (Op == PredicateOp::GREATER_EQUAL) return Value >= C.Low;
+        else if constexpr (Op == PredicateOp::BETWEEN) return Value >= C.Low && Value <= C.High;
+        else
+        {
+            // not binary_search, that one finds a NaN (it is neither < nor > anything)
+            const T* Found = std::lower_bound(C.Values, C.Values + C.ValueCount, Value);
+            return Found != C.Values + C.ValueCount && *Found == Value;
+        }
+    }
+
+    // Length rows into (Length + 63) / 64 words, the bits past Length in the last word are 0
+    template <PredicateOp Op, typename T>
+    void EvaluatePredicateScalar(const T* Data, int64_t Length, const PredicateConstants<T>& C, uint64_t* OutBits)
+    {
+        for (int64_t Word = 0; Word * 64 < Length; ++Word)
+        {
+            const T* Rows = Data + Word * 64;
+            int Count = (int)std::min<int64_t>(64, Length - Word * 64);
+            uint64_t Bits = 0;
+            for (int i = 0; i < Count; ++i)
+            {
+                Bits |= (uint64_t)Matches<Op>(Rows[i], C) << i;
+            }
+            OutBits[Word] = Bits;
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // AVX2: integers only have > and ==, the other comparisons are those with the operands swapped and/or the result negated
+    // (x <= C is !(x > C)). Unsigned values are shifted by the sign bit so the signed compares order them right.
+    // Floats use the vcmpps/pd predicates directly, negating would turn NaN into a match
+    // ---------------------------------------------------------------------------------------------
+    template <typename T>
+    struct Avx2Compare
+    {
+        using Vec = __m256i;
+        static constexpr int Lanes = (int)(32 / sizeof(T));
+
+        static OLAP_TARGET_AVX2 Vec Bias()
+        {
+            if constexpr (sizeof(T) == 1) return _mm256_set1_epi8((char)0x80);
+            else if constexpr (sizeof(T) == 2) return _mm256_set1_epi16((short)0x8000);
+            else if constexpr (sizeof(T) == 4) return _mm256_set1_epi32((int)0x80000000u);
+            else return _mm256_set1_epi64x((long long)0x8000000000000000ull);
+        }
+
+        static OLAP_TARGET_AVX2 Vec Signed(Vec Values)
+        {
+            return std::is_signed_v<T> ? Values : _mm256_xor_si256(Values, Bias());
+        }
+
+        static OLAP_TARGET_AVX2 Vec Load(const T* Data) { return Signed(_mm256_loadu_si256((const __m256i*)Data)); }
+
+        static OLAP_TARGET_AVX2 Vec Set1(T Value)
+        {
+            if constexpr (sizeof(T) == 1) return Signed(_mm256_set1_epi8((char)Value));
+            else if constexpr (sizeof(T) == 2) return Signed(_mm256_set1_epi16((short)Value));
+            else if constexpr (sizeof(T) == 4) return Signed(_mm256_set1_epi32((int)Value));
+            else return Signed(_mm256_set1_epi64x((long long)Value));
+        }
+
+        static OLAP_TARGET_AVX2 Vec Greater(Vec A, Vec B)
+        {
+            if constexpr (sizeof(T) == 1) return _mm256_cmpgt_epi8(A, B);
+            else if constexpr (sizeof(T) == 2) return _mm256_cmpgt_epi16(A, B);
+            else if constexpr (sizeof(T) == 4) return _mm256_cmpgt_epi32(A, B);
+            else return _mm256_cmpgt_epi64(A, B);
+        }
+
+        static OLAP_TARGET_AVX2 Vec Equal(Vec A, Vec B)
+        {
+            if constexpr (sizeof(T) == 1) return _mm256_cmpeq_epi8(A, B);
+            else if constexpr (sizeof(T) == 2) return _mm256_cmpeq_epi16(A, B);
+            else if constexpr (sizeof(T) == 4) return _mm256_cmpeq_epi32(A, B);
+            else return _mm256_cmpeq_epi64(A, B);
+        }
+
+        // one bit per lane
+        static OLAP_TARGET_AVX2 uint64_t Bits(Vec LaneMask)
+        {
+            if constexpr (sizeof(T) == 1) return (uint32_t)_mm256_movemask_epi8(LaneMask);
+            else if constexpr (sizeof(T) == 2) return MoveMask16(LaneMask);
+            else if constexpr (sizeof(T) == 4) return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(LaneMask));
+            else return (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(LaneMask));
+        }
+    };
+
+    template <>
+    struct Avx2Compare<float>
+    {
+        using Vec = __m256;
+        static constexpr int Lanes = 8;
+        static OLAP_TARGET_AVX2 Vec Load(const float* Data) { return _mm256_loadu_ps(Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(float Value) { return _mm256_set1_ps(Value); }
+        template <int Predicate>
+        static OLAP_TARGET_AVX2 uint64_t Compare(Vec A, Vec B) { return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(A, B, Predicate)); }
+    };
+
+    template <>
+    struct Avx2Compare<double>
+    {
+        using Vec = __m256d;
+        static constexpr int Lanes = 4;
+        static OLAP_TARGET_AVX2 Vec Load(const double* Data) { return _mm256_loadu_pd(Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(double Value) { return _mm256_set1_pd(Value); }
+        template <int Predicate>
+        static OLAP_TARGET_AVX2 uint64_t Compare(Vec A, Vec B) { return (uint32_t)_mm256_movemask_pd(_mm256_cmp_pd(A, B, Predicate)); }
+    };
+
+    // the vcmpps/pd predicate that gives the same answer as the C++ operator, NaN included (only != is true for it)
+    template <PredicateOp Op>
+    constexpr int FloatPredicate()
+    {
+        switch (Op)
+        {
+        case PredicateOp::EQUAL: return _CMP_EQ_OQ;
+        case PredicateOp::NOT_EQUAL: return _CMP_NEQ_UQ;
+        case PredicateOp::LESS: return _CMP_LT_OQ;
+        case PredicateOp::LESS_EQUAL: return _CMP_LE_OQ;
+        case PredicateOp::GREATER: return _CMP_GT_OQ;
+        default: return _CMP_GE_OQ;
+        }
+    }
+
+    // The constants broadcast once per batch
+    template <typename T>
+    struct Avx2PredicateVectors
+    {
+        using Vec = typename Avx2Compare<T>::Vec;
+        Vec Low;
+        Vec High;
+        Vec Values[MaxSimdInValues];
+        int ValueCount;
+
+        OLAP_TARGET_AVX2 explicit Avx2PredicateVectors(const PredicateConstants<T>& C)
+        {
+            this->Low = Avx2Compare<T>::Set1(C.Low);
+            this->High = Avx2Compare<T>::Set1(C.High);
+            this->ValueCount = (int)std::min<int64_t>(C.ValueCount, MaxSimdInValues);
+            for (int i = 0; i < this->ValueCount; ++i)
+            {
+                this->Values[i] = Avx2Compare<T>::Set1(C.Values[i]);
+            }
+        }
+    };
+
+    // Avx2Compare<T>::Lanes match bits of one register
+    template <PredicateOp Op, typename T>
+    OLAP_TARGET_AVX2 uint64_t MatchBitsAvx2(typename Avx2Compare<T>::Vec X, const Avx2PredicateVectors<T>& C)
+    {
+        using Ops = Avx2Compare<T>;
+        constexpr uint64_t AllLanes = (1ull << Ops::Lanes) - 1;
+
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            if constexpr (Op == PredicateOp::BETWEEN)
+            {
+                return Ops::template Compare<_CMP_GE_OQ>(X, C.Low) & Ops::template Compare<_CMP_LE_OQ>(X, C.High);
+            }
+            else if constexpr (Op == PredicateOp::IN)
+            {
+                uint64_t Bits = 0;
+                for (int i = 0; i < C.ValueCount; ++i)
+                {
+                    Bits |= Ops::template Compare<_CMP_EQ_OQ>(X, C.Values[i]);
+                }
+                return Bits;
+            }
+            else
+            {
+                return Ops::template Compare<FloatPredicate<Op>()>(X, C.Low);
+            }
+        }
+        else
+        {
+            if constexpr (Op == PredicateOp::EQUAL) return Ops::Bits(Ops::Equal(X, C.Low));
+            else if constexpr (Op == PredicateOp::NOT_EQUAL) return ~Ops::Bits(Ops::Equal(X, C.Low)) & AllLanes;
+            else if constexpr (Op == PredicateOp::LESS) return Ops::Bits(Ops::Greater(C.Low, X));
+            else if constexpr (Op == PredicateOp::LESS_EQUAL) return ~Ops::Bits(Ops::Greater(X, C.Low)) & AllLanes;
+            else if constexpr (Op == PredicateOp::GREATER) return Ops::Bits(Ops::Greater(X, C.Low));
+            else if constexpr (Op == PredicateOp::GREATER_EQUAL) return ~Ops::Bits(Ops::Greater(C.Low, X)) & AllLanes;
+            else if constexpr (Op == PredicateOp::BETWEEN)
+            {
+                // outside is below Low or above High
+                return ~Ops::Bits(_mm256_or_si256(Ops::Greater(C.Low, X), Ops::Greater(X, C.High))) & AllLanes;
+            }
+            else
+            {
+                __m256i Any = _mm256_setzero_si256();
+                for (int i = 0; i < C.ValueCount; ++i)
+                {
+                    Any = _mm256_or_si256(Any, Ops::Equal(X, C.Values[i]));
+                }
+                return Ops::Bits(Any);
+            }
+        }
+    }
+
+    template <PredicateOp Op, typename T>
+    OLAP_TARGET_AVX2 void EvaluatePredicateAvx2(const T* Data, int64_t Length, const PredicateConstants<T>& C, uint64_t* OutBits)
+    {
+        using Ops = Avx2Compare<T>;
+        if (Op == PredicateOp::IN && C.ValueCount > MaxSimdInValues)
+        {
+            return EvaluatePredicateScalar<Op>(Data, Length, C, OutBits);
+        }
+
+        const Avx2PredicateVectors<T> Vectors(C);
+        int64_t Word = 0;
+        for (; (Word + 1) * 64 <= Length; ++Word)
+        {
+            const T* Rows = Data + Word * 64;
+            uint64_t Bits = 0;
+            for (int Part = 0; Part < 64; Part += Ops::Lanes) // constant trip count, this unrolls
+            {
+                Bits |= MatchBitsAvx2<Op, T>(Ops::Load(Rows + Part), Vectors) << Part;
+            }
+            OutBits[Word] = Bits;
+        }
+
+        EvaluatePredicateScalar<Op>(Data + Word * 64, Length - Word * 64, C, OutBits + Word);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // AVX-512 compares straight into a mask register with the predicate as an immediate, for every width and signedness
+    // ---------------------------------------------------------------------------------------------
+    template <PredicateOp Op>
+    constexpr int IntegerPredicate()
+    {
+        switch (Op)
+        {
+        case PredicateOp::EQUAL: return _MM_CMPINT_EQ;
+        case PredicateOp::NOT_EQUAL: return _MM_CMPINT_NE;
+        case PredicateOp::LESS: return _MM_CMPINT_LT;
+        case PredicateOp::LESS_EQUAL: return _MM_CMPINT_LE;
+        case PredicateOp::GREATER: return _MM_CMPINT_NLE;
+        default: return _MM_CMPINT_NLT;
+        }
+    }
+
+    // one of the six plain comparisons, A Op B per lane
+    template <PredicateOp Op, typename T>
+    OLAP_TARGET_AVX512 uint64_t CompareAvx512(typename Avx512Vec<T>::Type A, typename Avx512Vec<T>::Type B)
+    {
+        constexpr int Imm = IntegerPredicate<Op>();
+        constexpr bool bSigned = std::is_signed_v<T>;
+        if constexpr (std::is_same_v<T, float>) return _mm512_cmp_ps_mask(A, B, FloatPredicate<Op>());
+        else if constexpr (std::is_same_v<T, double>) return _mm512_cmp_pd_mask(A, B, FloatPredicate<Op>());
+        else if constexpr (sizeof(T) == 1) return bSigned ? _mm512_cmp_epi8_mask(A, B, Imm) : _mm512_cmp_epu8_mask(A, B, Imm);
+        else if constexpr (sizeof(T) == 2) return bSigned ? _mm512_cmp_epi16_mask(A, B, Imm) : _mm512_cmp_epu16_mask(A, B, Imm);
+        else if constexpr (sizeof(T) == 4) return bSigned ? _mm512_cmp_epi32_mask(A, B, Imm) : _mm512_cmp_epu32_mask(A, B, Imm);
+        else return bSigned ? _mm512_cmp_epi64_mask(A, B, Imm) : _mm512_cmp_epu64_mask(A, B, Imm);
+    }
+
+    template <typename T>
+    struct Avx512PredicateVectors
+    {
+        using Vec = typename Avx512Vec<T>::Type;
+        Vec Low;
+        Vec High;
+        Vec Values[MaxSimdInValues];
+        int ValueCount;
+
+        OLAP_TARGET_AVX512 explicit Avx512PredicateVectors(const PredicateConstants<T>& C)
+        {
+            this->Low = Set1Avx512<T>(C.Low);
+            this->High = Set1Avx512<T>(C.High);
+            this->ValueCount = (int)std::min<int64_t>(C.ValueCount, MaxSimdInValues);
+            for (int i = 0; i < this->ValueCount; ++i)
+            {
+                this->Values[i] = Set1Avx512<T>(C.Values[i]);
+            }
+        }
+    };
+
+    template <PredicateOp Op, typename T>
+    OLAP_TARGET_AVX512 uint64_t MatchBitsAvx512(typename Avx512Vec<T>::Type X, const Avx512PredicateVectors<T>& C)
+    {
+        if constexpr (Op == PredicateOp::BETWEEN)
+        {
+            return CompareAvx512<PredicateOp::GREATER_EQUAL, T>(X, C.Low) & CompareAvx512<PredicateOp::LESS_EQUAL, T>(X, C.High);
+        }
+        else if constexpr (Op == PredicateOp::IN)
+        {
+            uint64_t Bits = 0;
+            for (int i = 0; i < C.ValueCount; ++i)
+            {
+                Bits |= CompareAvx512<PredicateOp::EQUAL, T>(X, C.Values[i]);
+            }
+            return Bits;
+        }
+        else
+        {
+            return CompareAvx512<Op, T>(X, C.Low);
+        }
+    }
+
+    template <PredicateOp Op, typename T>
+    OLAP_TARGET_AVX512 void EvaluatePredicateAvx512(const T* Data, int64_t Length, const PredicateConstants<T>& C, uint64_t* OutBits)
+    {
+        constexpr int Lanes = Lanes512<T>;
+        if (Op == PredicateOp::IN && C.ValueCount > MaxSimdInValues)
+        {
+            return EvaluatePredicateScalar<Op>(Data, Length, C, OutBits);
+        }
+
+        const Avx512PredicateVectors<T> Vectors(C);
+        int64_t Word = 0;
+        for (; (Word + 1) * 64 <= Length; ++Word)
+        {
+            const T* Rows = Data + Word * 64;
+            uint64_t Bits = 0;
+            for (int Part = 0; Part < 64; Part += Lanes)
+            {
+                Bits |= MatchBitsAvx512<Op, T>(LoadAvx512<T>(Rows + Part), Vectors) << Part;
+            }
+            OutBits[Word] = Bits;
+        }
+
+        EvaluatePredicateScalar<Op>(Data + Word * 64, Length - Word * 64, C, OutBits + Word);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Bitmap helpers
+    // ---------------------------------------------------------------------------------------------
+
+    // Clears the bits of the null rows. Whole words take 64 validity bits at once, the last partial one goes bit by bit
+    // so the bitmap is never read past its end
+    inline void AndValidity(uint64_t* Bits, int64_t Length, const uint8_t* Validity, int64_t ValidityOffset)
+    {
+        int64_t Word = 0;
+        for (; (Word + 1) * 64 <= Length; ++Word)
+        {
+            Bits[Word] &= ReadValidity<64>(Validity, ValidityOffset + Word * 64);
+        }
+        for (int64_t Row = Word * 64; Row < Length; ++Row)
+        {
+            Bits[Word] &= ~((uint64_t)!IsValid(Validity, ValidityOffset + Row) << (Row & 63));
+        }
+    }
+
+    // the rows of a selection vector as bits, for a filter whose child already selected rows
+    inline void SelectionToBits(const int32_t* Selection, int64_t Count, int64_t Length, uint64_t* OutBits)
+    {
+        std::fill(OutBits, OutBits + (Length + 63) / 64, 0ull);
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            OutBits[Selection[i] >> 6] |= 1ull << (Selection[i] & 63);
+        }
+    }
+
+    // The set bits of the first Length rows as row indices, in order. Returns how many.
+    // Every row is written and the position only advances for set bits, like DropNulls
+    inline int64_t BitsToSelectionScalar(const uint64_t* Bits, int64_t Length, int32_t* Out)
+    {
+        int64_t OutputCount = 0;
+        for (int64_t Row = 0; Row < Length; ++Row)
+        {
+            Out[OutputCount] = (int32_t)Row;
+            OutputCount += (Bits[Row >> 6] >> (Row & 63)) & 1;
+        }
+        return OutputCount;
+    }
+
+    // 8 rows per compress store, Out needs room for 8 more indices than it gets
+    OLAP_TARGET_AVX2 inline int64_t BitsToSelectionAvx2(const uint64_t* Bits, int64_t Length, int32_t* Out)
+    {
+        int64_t OutputCount = 0;
+        __m256i IndexVector = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i IndexStep = _mm256_set1_epi32(8);
+
+        int64_t Row = 0;
+        for (; Row + 8 <= Length; Row += 8)
+        {
+            int Mask = (int)((Bits[Row >> 6] >> (Row & 63)) & 0xFF);
+            OutputCount += CompressStore32(Out + OutputCount, IndexVector, Mask);
+            IndexVector = _mm256_add_epi32(IndexVector, IndexStep);
+        }
+
+        for (; Row < Length; ++Row)
+        {
+            Out[OutputCount] = (int32_t)Row;
+            OutputCount += (Bits[Row >> 6] >> (Row & 63)) & 1;
+        }
+        return OutputCount;
+    }
+
+    // 16 rows per compress store, Out needs room for 16 more indices than it gets
+    OLAP_TARGET_AVX512 inline int64_t BitsToSelectionAvx512(const uint64_t* Bits, int64_t Length, int32_t* Out)
+    {
+        int64_t OutputCount = 0;
+        __m512i IndexVector = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m512i IndexStep = _mm512_set1_epi32(16);
+
+        int64_t Row = 0;
+        for (; Row + 16 <= Length; Row += 16)
+        {
+            __mmask16 Mask = (__mmask16)(Bits[Row >> 6] >> (Row & 63));
+            OutputCount += CompressStore32x16(Out + OutputCount, IndexVector, Mask);
+            IndexVector = _mm512_add_epi32(IndexVector, IndexStep);
+        }
+
+        for (; Row < Length; ++Row)
+        {
+            Out[OutputCount] = (int32_t)Row;
+            OutputCount += (Bits[Row >> 6] >> (Row & 63)) & 1;
+        }
+        return OutputCount;
+    }
+}
@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "Sort.h"
+#include <algorithm>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace Kernels
+{
+    void SortSmallScalar(uint64_t* Data, uint64_t* Scratch, int64_t Count)
+    {
+        for (int64_t i = 1; i < Count; ++i)
+        {
+            uint64_t Item = Data[i];
+            int64_t j = i;
+            for (; j > 0 && Data[j - 1] > Item; --j)
+            {
+                Data[j] = Data[j - 1];
+            }
+            Data[j] = Item;
+        }
+    }
+
+    // Merges the sorted blocks of BlockSize items into one sorted run, the result ends up in Data
+    static void MergeBlocks(uint64_t* Data, uint64_t* Scratch, int64_t Count, int64_t BlockSize)
+    {
+        uint64_t* From = Data;
+        uint64_t* To = Scratch;
+        for (int64_t Width = BlockSize; Width < Count; Width *= 2)
+        {
+            for (int64_t Begin = 0; Begin < Count; Begin += 2 * Width)
+            {
+                int64_t Middle = std::min(Begin + Width, Count);
+                int64_t End = std::min(Begin + 2 * Width, Count);
+                std::merge(From + Begin, From + Middle, From + Middle, From + End, To + Begin);
+            }
+            std::swap(From, To);
+        }
+
+        if (From != Data)
+        {
+            std::memcpy(Data, From, Count * sizeof(uint64_t));
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Bitonic sorting network. Every layer compares lane i with lane i ^ j (a permute), takes the min and the max of
+    // the pair and keeps one of them per lane (a blend): lane i keeps the max where (i & j) != 0 differs from
+    // (i & k) != 0, k being the size of the bitonic sequences the layer is building. log2(n) * (log2(n) + 1) / 2 layers
+    // sort n lanes, 3 for the 4 lanes of AVX2, 6 for the 8 lanes of AVX-512
+    // ---------------------------------------------------------------------------------------------
+
+    // there is no unsigned 64 bit compare before AVX-512, flipping the sign bit of both sides gives it from the signed one
+    template <int Permutation, int MaxLanes>
+    OLAP_TARGET_AVX2 static __m256i NetworkLayerAvx2(__m256i Values)
+    {
+        const __m256i SignBit = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+        __m256i Partner = _mm256_permute4x64_epi64(Values, Permutation);
+        __m256i Greater = _mm256_cmpgt_epi64(_mm256_xor_si256(Values, SignBit), _mm256_xor_si256(Partner, SignBit));
+        __m256i Min = _mm256_blendv_epi8(Values, Partner, Greater);
+        __m256i Max = _mm256_blendv_epi8(Partner, Values, Greater);
+        return _mm256_blend_epi32(Min, Max, MaxLanes);
+    }
+
+    OLAP_TARGET_AVX2 static __m256i SortNetworkAvx2(__m256i Values)
+    {
+        // (k, j) = (2, 1), (4, 2), (4, 1). The blend masks are per 32 bit half, two bits per 64 bit lane
+        Values = NetworkLayerAvx2<_MM_SHUFFLE(2, 3, 0, 1), 0x3C>(Values); // max in lanes 1, 2
+        Values = NetworkLayerAvx2<_MM_SHUFFLE(1, 0, 3, 2), 0xF0>(Values); // max in lanes 2, 3
+        Values = NetworkLayerAvx2<_MM_SHUFFLE(2, 3, 0, 1), 0xCC>(Values); // max in lanes 1, 3
+        return Values;
+    }
+
+    OLAP_TARGET_AVX2 void SortSmallAvx2(uint64_t* Data, uint64_t* Scratch, int64_t Count)
+    {
+        int64_t i = 0;
+        for (; i + 4 <= Count; i += 4)
+        {
+            __m256i Values = _mm256_loadu_si256((const __m256i*)(Data + i));
+            _mm256_storeu_si256((__m256i*)(Data + i), SortNetworkAvx2(Values));
+        }
+
+        // the last block is padded with the largest key, which sorts behind the real items
+        if (i < Count)
+        {
+            alignas(32) uint64_t Block[4] = { UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX };
+            std::memcpy(Block, Data + i, (Count - i) * sizeof(uint64_t));
+            _mm256_store_si256((__m256i*)Block, SortNetworkAvx2(_mm256_load_si256((const __m256i*)Block)));
+            std::memcpy(Data + i, Block, (Count - i) * sizeof(uint64_t));
+        }
+
+        MergeBlocks(Data, Scratch, Count, 4);
+    }
+
+    OLAP_TARGET_AVX512 static __m512i NetworkLayerAvx512(__m512i Values, __m512i Permutation, __mmask8 MaxLanes)
+    {
+        __m512i Partner = _mm512_permutexvar_epi64(Permutation, Values);
+        return _mm512_mask_blend_epi64(MaxLanes, _mm512_min_epu64(Values, Partner), _mm512_max_epu64(Values, Partner));
+    }
+
+    OLAP_TARGET_AVX512 static __m512i SortNetworkAvx512(__m512i Values)
+    {
+        const __m512i Swap1 = _mm512_set_epi64(6, 7, 4, 5, 2, 3, 0, 1); // i ^ 1
+        const __m512i Swap2 = _mm512_set_epi64(5, 4, 7, 6, 1, 0, 3, 2); // i ^ 2
+        const __m512i Swap4 = _mm512_set_epi64(3, 2, 1, 0, 7, 6, 5, 4); // i ^ 4
+
+        Values = NetworkLayerAvx512(Values, Swap1, 0x66); // (2, 1)
+        Values = NetworkLayerAvx512(Values, Swap2, 0x3C); // (4, 2)
+        Values = NetworkLayerAvx512(Values, Swap1, 0x5A); // (4, 1)
+        Values = NetworkLayerAvx512(Values, Swap4, 0xF0); // (8, 4)
+        Values = NetworkLayerAvx512(Values, Swap2, 0xCC); // (8, 2)
+        Values = NetworkLayerAvx512(Values, Swap1, 0xAA); // (8, 1)
+        return Values;
+    }
+
+    OLAP_TARGET_AVX512 void SortSmallAvx512(uint64_t* Data, uint64_t* Scratch, int64_t Count)
+    {
+        for (int64_t i = 0; i < Count; i += 8)
+        {
+            // masked load and store, the lanes past the end are the largest key and never written back
+            __mmask8 Lanes = Count - i >= 8 ? (__mmask8)0xFF : (__mmask8)((1u << (Count - i)) - 1);
+            __m512i Values = _mm512_mask_loadu_epi64(_mm512_set1_epi64((long long)UINT64_MAX), Lanes, Data + i);
+            _mm512_mask_storeu_epi64(Data + i, Lanes, SortNetworkAvx512(Values));
+        }
+
+        MergeBlocks(Data, Scratch, Count, 8);
+    }
+}
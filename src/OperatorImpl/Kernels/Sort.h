@@ -0,0 +1,184 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include "../../Misc/CpuFeatures.h"
+
+// Sorting of normalized keys (see SortOperator.cpp for how rows are turned into them).
+// A key is an unsigned integer whose order is the order of the rows, so sorting never looks at a column type:
+//   - uint64_t items are packed keys: the key in the high 32 bits, the row index in the low 32, every item is unique
+//     and sorting them as plain integers gives the rows in key order with ties in row order
+//   - KeyRow items carry a key of up to 8 bytes next to the row
+// Big inputs go through LSD radix sort one byte at a time (stable, bytes that are the same in every key are skipped),
+// runs of up to SmallSortRows items are sorted with a sorting network on SIMD registers and merged
+namespace Kernels
+{
+    struct KeyRow
+    {
+        uint64_t Key;
+        uint32_t Row;
+    };
+
+    // A number as an unsigned integer with the same order. Signed integers get the sign bit flipped, so the smallest
+    // value is 0. Floats get the sign bit flipped when positive and every bit flipped when negative, -0.0 is made 0.0
+    // and every NaN the same NaN, which sorts behind +inf. Floats keep their width, a float's bits are the low 32
+    template <typename T>
+    inline uint64_t OrderedBits(T Value)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+            constexpr Bits SignBit = Bits(1) << (8 * sizeof(T) - 1);
+
+            if (Value == T(0)) Value = T(0);
+            if (std::isnan(Value)) Value = std::numeric_limits<T>::quiet_NaN();
+
+            Bits Code;
+            std::memcpy(&Code, &Value, sizeof(T));
+            return (Code & SignBit) ? (Bits)~Code : (Bits)(Code | SignBit);
+        }
+        else if constexpr (std::is_signed_v<T>)
+        {
+            return (uint64_t)(int64_t)Value ^ 0x8000000000000000ull;
+        }
+        else
+        {
+            return (uint64_t)Value;
+        }
+    }
+
+    inline uint64_t SortBitsOf(uint64_t Item) { return Item; }
+    inline uint64_t SortBitsOf(const KeyRow& Item) { return Item.Key; }
+
+    // below this many items a radix pass costs more than it saves
+    constexpr int64_t SmallSortRows = 64;
+
+    // Sorts Data[0, Count) ascending as plain integers. Scratch holds Count items
+    using SmallSortKernel = void (*)(uint64_t* Data, uint64_t* Scratch, int64_t Count);
+
+    // Insertion sort
+    void SortSmallScalar(uint64_t* Data, uint64_t* Scratch, int64_t Count);
+
+    // Sorting network over blocks of 4 items (one 256-bit register), then the blocks are merged
+    void SortSmallAvx2(uint64_t* Data, uint64_t* Scratch, int64_t Count);
+
+    // Same with blocks of 8 items (one 512-bit register)
+    void SortSmallAvx512(uint64_t* Data, uint64_t* Scratch, int64_t Count);
+
+    // stable, only compares the keys
+    inline void InsertionSort(KeyRow* Data, int64_t Count)
+    {
+        for (int64_t i = 1; i < Count; ++i)
+        {
+            KeyRow Item = Data[i];
+            int64_t j = i;
+            for (; j > 0 && Data[j - 1].Key > Item.Key; --j)
+            {
+                Data[j] = Data[j - 1];
+            }
+            Data[j] = Item;
+        }
+    }
+
+    // Counts[b][d] += number of items whose byte b (counted from LowShift) is d, for the ByteCount lowest key bytes
+    template <typename Item>
+    void CountDigits(const Item* Data, int64_t Count, int LowShift, int ByteCount, int64_t (*Counts)[256])
+    {
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            uint64_t Bits = SortBitsOf(Data[i]) >> LowShift;
+            for (int b = 0; b < ByteCount; ++b)
+            {
+                ++Counts[b][(Bits >> (8 * b)) & 0xFF];
+            }
+        }
+    }
+
+    // Moves every item to Out[Offsets[digit]++], items with the same digit keep their order
+    template <typename Item>
+    void ScatterDigits(const Item* Data, int64_t Count, int Shift, int64_t* Offsets, Item* Out)
+    {
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            Out[Offsets[(SortBitsOf(Data[i]) >> Shift) & 0xFF]++] = Data[i];
+        }
+    }
+
+    // true when every one of the Count items has the same digit
+    inline bool IsConstantDigit(const int64_t* Counts, int64_t Count)
+    {
+        for (int d = 0; d < 256; ++d)
+        {
+            if (Counts[d] != 0)
+            {
+                return Counts[d] == Count;
+            }
+        }
+        return true;
+    }
+
+    // Stable LSD radix sort over the ByteCount key bytes starting at LowShift, the result ends up in Data.
+    // One read pass counts the digits of every byte, then one scatter pass per byte that isn't constant
+    template <typename Item>
+    void RadixSortLsd(Item* Data, Item* Scratch, int64_t Count, int LowShift, int ByteCount)
+    {
+        int64_t Counts[8][256] = {};
+        CountDigits(Data, Count, LowShift, ByteCount, Counts);
+
+        Item* From = Data;
+        Item* To = Scratch;
+        for (int b = 0; b < ByteCount; ++b)
+        {
+            if (IsConstantDigit(Counts[b], Count))
+            {
+                continue;
+            }
+
+            int64_t Offsets[256];
+            int64_t Offset = 0;
+            for (int d = 0; d < 256; ++d)
+            {
+                Offsets[d] = Offset;
+                Offset += Counts[b][d];
+            }
+
+            ScatterDigits(From, Count, LowShift + 8 * b, Offsets, To);
+            std::swap(From, To);
+        }
+
+        if (From != Data)
+        {
+            std::memcpy(Data, From, Count * sizeof(Item));
+        }
+    }
+
+    // Sorts one bucket of an MSD pass by its ByteCount low key bytes (the bytes above are the same for every item).
+    // Small buckets go through the sorting network (packed keys) or insertion sort (KeyRow), the rest through LSD radix
+    template <typename Item>
+    void SortBucket(Item* Data, Item* Scratch, int64_t Count, int LowShift, int ByteCount, SmallSortKernel SmallSort)
+    {
+        if (Count <= 1 || ByteCount <= 0)
+        {
+            return;
+        }
+
+        if (Count <= SmallSortRows)
+        {
+            if constexpr (std::is_same_v<Item, uint64_t>)
+            {
+                // the whole item is compared, the high bytes are equal and the row index keeps ties in order
+                SmallSort(Data, Scratch, Count);
+            }
+            else
+            {
+                InsertionSort(Data, Count);
+            }
+            return;
+        }
+
+        RadixSortLsd(Data, Scratch, Count, LowShift, ByteCount);
+    }
+}
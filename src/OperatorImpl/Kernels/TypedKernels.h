@@ -0,0 +1,1441 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <immintrin.h>
+#include <arrow/type_fwd.h>
+#include "Compaction.h"
+#include "Validity.h"
+#include "../../Misc/CpuFeatures.h"
+
+// Filter (x > C), SUM and MIN/MAX (and the two fused: SUM/MIN/MAX of the rows with x > C) for every fixed width number type, one template per kernel.
+// T is the C type of the column's values, every type gets its own compares and widening adds at compile time:
+// epi8/16/32/64 compares (unsigned ones through the sign bit flip or the epu forms), ps/pd compares, sad/madd for the narrow sums.
+// The operators look at the arrow type once (VisitNumericType) and run one instantiation for the whole column.
+// Gathers only exist for 32 and 64 bit lanes, so 8 and 16 bit columns under a selection vector use the scalar loops.
+// The dense kernels have a second instantiation (bNullable) that reads the validity bitmap along with the data,
+// kernels under a selection vector expect the nulls to be dropped from the selection first (DropNulls)
+namespace Kernels
+{
+    template <typename T>
+    struct ValueTraits
+    {
+        // what a SUM over T adds up in: doubles for floats, 64 bit integers for the rest
+        using SumType = std::conditional_t<std::is_floating_point_v<T>, double, std::conditional_t<std::is_same_v<T, uint64_t>, uint64_t, int64_t>>;
+
+        // the MIN/MAX of nothing, loses against every real value
+        static constexpr T MinIdentity() { return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max(); }
+        static constexpr T MaxIdentity() { return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest(); }
+    };
+
+    template <typename T>
+    struct TypeTag
+    {
+        using Type = T;
+    };
+
+    // Calls Visitor(TypeTag<T>()) with the C type that holds a value of the arrow type.
+    // Dates, times, timestamps and durations are plain int32/int64 underneath. False for anything else (strings, decimals, ...)
+    template <typename VisitorType>
+    bool VisitNumericType(arrow::Type::type Id, VisitorType&& Visitor)
+    {
+        switch (Id)
+        {
+        case arrow::Type::INT8: Visitor(TypeTag<int8_t>()); return true;
+        case arrow::Type::INT16: Visitor(TypeTag<int16_t>()); return true;
+        case arrow::Type::INT32:
+        case arrow::Type::DATE32:
+        case arrow::Type::TIME32: Visitor(TypeTag<int32_t>()); return true;
+        case arrow::Type::INT64:
+        case arrow::Type::DATE64:
+        case arrow::Type::TIME64:
+        case arrow::Type::TIMESTAMP:
+        case arrow::Type::DURATION: Visitor(TypeTag<int64_t>()); return true;
+        case arrow::Type::UINT8: Visitor(TypeTag<uint8_t>()); return true;
+        case arrow::Type::UINT16: Visitor(TypeTag<uint16_t>()); return true;
+        case arrow::Type::UINT32: Visitor(TypeTag<uint32_t>()); return true;
+        case arrow::Type::UINT64: Visitor(TypeTag<uint64_t>()); return true;
+        case arrow::Type::FLOAT: Visitor(TypeTag<float>()); return true;
+        case arrow::Type::DOUBLE: Visitor(TypeTag<double>()); return true;
+        default: return false;
+        }
+    }
+
+    // Quick breakdown of instrinics
+    // _mm256_cmpgt_epi32
+    // _mm256 -> Operates on 256-bit wide vectors (8 x 32-bit integers)
+    // _cmpgt -> Operation: compare greater than
+    // _epi32 -> Data type: e: "extended", p: operates on all elements in the vector, i32: 32-bit signed integers
+    // (_epi8/_epi16/_epi64 the same for the other widths, _epu for unsigned, _ps/_pd for float/double)
+
+    // ---------------------------------------------------------------------------------------------
+    // AVX2 building blocks, one specialization per type.
+    //   Vec             register holding 32 bytes of T
+    //   Load/Set1       plain loads and broadcasts
+    //   Constant/Greater  the compare constant and "which of the next Step values are > it", one bit per value.
+    //                   Unsigned types flip the sign bit of both sides so the signed compare gives the unsigned order
+    //   Min/Max         lane wise
+    //   Gather          8 values through 32 bit indices (only for 32 and 64 bit types, bGather)
+    // ---------------------------------------------------------------------------------------------
+    template <typename T>
+    struct Avx2Ops;
+
+    // values compared per step, a full register but at least the 8 indices one compress store takes
+    template <typename T>
+    struct Avx2IntegerBase
+    {
+        static constexpr int Step = 32 / sizeof(T) > 8 ? (int)(32 / sizeof(T)) : 8;
+    };
+
+    template <>
+    struct Avx2Ops<int8_t> : Avx2IntegerBase<int8_t>
+    {
+        using Vec = __m256i;
+        static constexpr bool bGather = false;
+        static OLAP_TARGET_AVX2 Vec Load(const int8_t* Data) { return _mm256_loadu_si256((const __m256i*)Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(int8_t Value) { return _mm256_set1_epi8(Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(int8_t Value) { return Set1(Value); }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const int8_t* Data, Vec C) { return (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(Load(Data), C)); }
+        static OLAP_TARGET_AVX2 Vec Min(Vec A, Vec B) { return _mm256_min_epi8(A, B); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec A, Vec B) { return _mm256_max_epi8(A, B); }
+    };
+
+    template <>
+    struct Avx2Ops<uint8_t> : Avx2IntegerBase<uint8_t>
+    {
+        using Vec = __m256i;
+        static constexpr bool bGather = false;
+        static OLAP_TARGET_AVX2 Vec Load(const uint8_t* Data) { return _mm256_loadu_si256((const __m256i*)Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(uint8_t Value) { return _mm256_set1_epi8((char)Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(uint8_t Value) { return _mm256_set1_epi8((char)(Value ^ 0x80)); }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const uint8_t* Data, Vec C)
+        {
+            return (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_xor_si256(Load(Data), _mm256_set1_epi8((char)0x80)), C));
+        }
+        static OLAP_TARGET_AVX2 Vec Min(Vec A, Vec B) { return _mm256_min_epu8(A, B); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec A, Vec B) { return _mm256_max_epu8(A, B); }
+    };
+
+    // 16 results of a 16 bit compare as one bit each, the saturating pack keeps 0 and -1 as they are
+    OLAP_TARGET_AVX2 inline uint64_t MoveMask16(__m256i CompareResult)
+    {
+        __m128i Packed = _mm_packs_epi16(_mm256_castsi256_si128(CompareResult), _mm256_extracti128_si256(CompareResult, 1));
+        return (uint16_t)_mm_movemask_epi8(Packed);
+    }
+
+    template <>
+    struct Avx2Ops<int16_t> : Avx2IntegerBase<int16_t>
+    {
+        using Vec = __m256i;
+        static constexpr bool bGather = false;
+        static OLAP_TARGET_AVX2 Vec Load(const int16_t* Data) { return _mm256_loadu_si256((const __m256i*)Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(int16_t Value) { return _mm256_set1_epi16(Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(int16_t Value) { return Set1(Value); }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const int16_t* Data, Vec C) { return MoveMask16(_mm256_cmpgt_epi16(Load(Data), C)); }
+        static OLAP_TARGET_AVX2 Vec Min(Vec A, Vec B) { return _mm256_min_epi16(A, B); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec A, Vec B) { return _mm256_max_epi16(A, B); }
+    };
+
+    template <>
+    struct Avx2Ops<uint16_t> : Avx2IntegerBase<uint16_t>
+    {
+        using Vec = __m256i;
+        static constexpr bool bGather = false;
+        static OLAP_TARGET_AVX2 Vec Load(const uint16_t* Data) { return _mm256_loadu_si256((const __m256i*)Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(uint16_t Value) { return _mm256_set1_epi16((short)Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(uint16_t Value) { return _mm256_set1_epi16((short)(Value ^ 0x8000)); }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const uint16_t* Data, Vec C)
+        {
+            return MoveMask16(_mm256_cmpgt_epi16(_mm256_xor_si256(Load(Data), _mm256_set1_epi16((short)0x8000)), C));
+        }
+        static OLAP_TARGET_AVX2 Vec Min(Vec A, Vec B) { return _mm256_min_epu16(A, B); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec A, Vec B) { return _mm256_max_epu16(A, B); }
+    };
+
+    template <>
+    struct Avx2Ops<int32_t> : Avx2IntegerBase<int32_t>
+    {
+        using Vec = __m256i;
+        static constexpr bool bGather = true;
+        static OLAP_TARGET_AVX2 Vec Load(const int32_t* Data) { return _mm256_loadu_si256((const __m256i*)Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(int32_t Value) { return _mm256_set1_epi32(Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(int32_t Value) { return Set1(Value); }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const int32_t* Data, Vec C) { return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(Load(Data), C))); }
+        static OLAP_TARGET_AVX2 Vec Min(Vec A, Vec B) { return _mm256_min_epi32(A, B); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec A, Vec B) { return _mm256_max_epi32(A, B); }
+        static OLAP_TARGET_AVX2 Vec Gather(const int32_t* Data, __m256i Index) { return _mm256_i32gather_epi32((const int*)Data, Index, 4); }
+        static OLAP_TARGET_AVX2 uint64_t GatherGreater(const int32_t* Data, __m256i Index, Vec C) { return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(Gather(Data, Index), C))); }
+    };
+
+    template <>
+    struct Avx2Ops<uint32_t> : Avx2IntegerBase<uint32_t>
+    {
+        using Vec = __m256i;
+        static constexpr bool bGather = true;
+        static OLAP_TARGET_AVX2 Vec Load(const uint32_t* Data) { return _mm256_loadu_si256((const __m256i*)Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(uint32_t Value) { return _mm256_set1_epi32((int)Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(uint32_t Value) { return _mm256_set1_epi32((int)(Value ^ 0x80000000u)); }
+        static OLAP_TARGET_AVX2 uint64_t CompareBiased(Vec Data, Vec C)
+        {
+            return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_xor_si256(Data, _mm256_set1_epi32((int)0x80000000u)), C)));
+        }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const uint32_t* Data, Vec C) { return CompareBiased(Load(Data), C); }
+        static OLAP_TARGET_AVX2 Vec Min(Vec A, Vec B) { return _mm256_min_epu32(A, B); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec A, Vec B) { return _mm256_max_epu32(A, B); }
+        static OLAP_TARGET_AVX2 Vec Gather(const uint32_t* Data, __m256i Index) { return _mm256_i32gather_epi32((const int*)Data, Index, 4); }
+        static OLAP_TARGET_AVX2 uint64_t GatherGreater(const uint32_t* Data, __m256i Index, Vec C) { return CompareBiased(Gather(Data, Index), C); }
+    };
+
+    // 4 lanes per register, two registers make the 8 values one compress store takes
+    template <typename T, bool bUnsigned>
+    struct Avx2Int64Ops
+    {
+        using Vec = __m256i;
+        static constexpr int Step = 8;
+        static constexpr bool bGather = true;
+        static constexpr long long Bias = bUnsigned ? (long long)0x8000000000000000ull : 0;
+
+        static OLAP_TARGET_AVX2 Vec Load(const T* Data) { return _mm256_loadu_si256((const __m256i*)Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(T Value) { return _mm256_set1_epi64x((long long)Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(T Value) { return _mm256_set1_epi64x((long long)Value ^ Bias); }
+        static OLAP_TARGET_AVX2 Vec Biased(Vec Data) { return bUnsigned ? _mm256_xor_si256(Data, _mm256_set1_epi64x(Bias)) : Data; }
+        static OLAP_TARGET_AVX2 uint64_t CompareBiased(Vec Lo, Vec Hi, Vec C)
+        {
+            uint64_t MaskLo = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(Biased(Lo), C)));
+            uint64_t MaskHi = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(Biased(Hi), C)));
+            return MaskLo | (MaskHi << 4);
+        }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const T* Data, Vec C) { return CompareBiased(Load(Data), Load(Data + 4), C); }
+
+        // no vpminsq before AVX-512, compare and blend instead
+        static OLAP_TARGET_AVX2 Vec Min(Vec A, Vec B) { return _mm256_blendv_epi8(A, B, _mm256_cmpgt_epi64(Biased(A), Biased(B))); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec A, Vec B) { return _mm256_blendv_epi8(B, A, _mm256_cmpgt_epi64(Biased(A), Biased(B))); }
+
+        static OLAP_TARGET_AVX2 uint64_t GatherGreater(const T* Data, __m256i Index, Vec C)
+        {
+            __m256i Lo = _mm256_i32gather_epi64((const long long*)Data, _mm256_castsi256_si128(Index), 8);
+            __m256i Hi = _mm256_i32gather_epi64((const long long*)Data, _mm256_extracti128_si256(Index, 1), 8);
+            return CompareBiased(Lo, Hi, C);
+        }
+    };
+
+    template <> struct Avx2Ops<int64_t> : Avx2Int64Ops<int64_t, false> {};
+    template <> struct Avx2Ops<uint64_t> : Avx2Int64Ops<uint64_t, true> {};
+
+    template <>
+    struct Avx2Ops<float>
+    {
+        using Vec = __m256;
+        static constexpr int Step = 8;
+        static constexpr bool bGather = true;
+        static OLAP_TARGET_AVX2 Vec Load(const float* Data) { return _mm256_loadu_ps(Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(float Value) { return _mm256_set1_ps(Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(float Value) { return Set1(Value); }
+        // ordered compare, NaN is never greater than anything (same as the scalar >)
+        static OLAP_TARGET_AVX2 uint64_t Greater(const float* Data, Vec C) { return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(Load(Data), C, _CMP_GT_OQ)); }
+        // minps returns the second operand when either is NaN, with the accumulator second NaNs are skipped
+        static OLAP_TARGET_AVX2 Vec Min(Vec Data, Vec Acc) { return _mm256_min_ps(Data, Acc); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec Data, Vec Acc) { return _mm256_max_ps(Data, Acc); }
+        static OLAP_TARGET_AVX2 uint64_t GatherGreater(const float* Data, __m256i Index, Vec C)
+        {
+            return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_i32gather_ps(Data, Index, 4), C, _CMP_GT_OQ));
+        }
+    };
+
+    template <>
+    struct Avx2Ops<double>
+    {
+        using Vec = __m256d;
+        static constexpr int Step = 8;
+        static constexpr bool bGather = true;
+        static OLAP_TARGET_AVX2 Vec Load(const double* Data) { return _mm256_loadu_pd(Data); }
+        static OLAP_TARGET_AVX2 Vec Set1(double Value) { return _mm256_set1_pd(Value); }
+        static OLAP_TARGET_AVX2 Vec Constant(double Value) { return Set1(Value); }
+        static OLAP_TARGET_AVX2 uint64_t CompareTwo(Vec Lo, Vec Hi, Vec C)
+        {
+            uint64_t MaskLo = (uint32_t)_mm256_movemask_pd(_mm256_cmp_pd(Lo, C, _CMP_GT_OQ));
+            uint64_t MaskHi = (uint32_t)_mm256_movemask_pd(_mm256_cmp_pd(Hi, C, _CMP_GT_OQ));
+            return MaskLo | (MaskHi << 4);
+        }
+        static OLAP_TARGET_AVX2 uint64_t Greater(const double* Data, Vec C) { return CompareTwo(Load(Data), Load(Data + 4), C); }
+        static OLAP_TARGET_AVX2 Vec Min(Vec Data, Vec Acc) { return _mm256_min_pd(Data, Acc); }
+        static OLAP_TARGET_AVX2 Vec Max(Vec Data, Vec Acc) { return _mm256_max_pd(Data, Acc); }
+        static OLAP_TARGET_AVX2 uint64_t GatherGreater(const double* Data, __m256i Index, Vec C)
+        {
+            return CompareTwo(_mm256_i32gather_pd(Data, _mm256_castsi256_si128(Index), 8), _mm256_i32gather_pd(Data, _mm256_extracti128_si256(Index, 1), 8), C);
+        }
+    };
+
+    // ---------------------------------------------------------------------------------------------
+    // AVX-512 building blocks. Compares go straight into mask registers and every type has native
+    // unsigned compares (epu8/16/32/64), so 16 values are compared per step whatever their width,
+    // which is what one vpcompressd of row indices takes
+    // ---------------------------------------------------------------------------------------------
+    template <typename T>
+    struct Avx512Ops;
+
+    template <>
+    struct Avx512Ops<int8_t>
+    {
+        using Constant = __m128i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(int8_t Value) { return _mm_set1_epi8(Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const int8_t* Data, Constant C) { return _mm_cmpgt_epi8_mask(_mm_loadu_si128((const __m128i*)Data), C); }
+    };
+
+    template <>
+    struct Avx512Ops<uint8_t>
+    {
+        using Constant = __m128i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(uint8_t Value) { return _mm_set1_epi8((char)Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const uint8_t* Data, Constant C) { return _mm_cmpgt_epu8_mask(_mm_loadu_si128((const __m128i*)Data), C); }
+    };
+
+    template <>
+    struct Avx512Ops<int16_t>
+    {
+        using Constant = __m256i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(int16_t Value) { return _mm256_set1_epi16(Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const int16_t* Data, Constant C) { return _mm256_cmpgt_epi16_mask(_mm256_loadu_si256((const __m256i*)Data), C); }
+    };
+
+    template <>
+    struct Avx512Ops<uint16_t>
+    {
+        using Constant = __m256i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(uint16_t Value) { return _mm256_set1_epi16((short)Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const uint16_t* Data, Constant C) { return _mm256_cmpgt_epu16_mask(_mm256_loadu_si256((const __m256i*)Data), C); }
+    };
+
+    template <>
+    struct Avx512Ops<int32_t>
+    {
+        using Constant = __m512i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(int32_t Value) { return _mm512_set1_epi32(Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const int32_t* Data, Constant C) { return _mm512_cmpgt_epi32_mask(_mm512_loadu_si512((const void*)Data), C); }
+        static OLAP_TARGET_AVX512 __mmask16 GatherGreater(const int32_t* Data, __m512i Index, Constant C) { return _mm512_cmpgt_epi32_mask(_mm512_i32gather_epi32(Index, (const void*)Data, 4), C); }
+    };
+
+    template <>
+    struct Avx512Ops<uint32_t>
+    {
+        using Constant = __m512i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(uint32_t Value) { return _mm512_set1_epi32((int)Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const uint32_t* Data, Constant C) { return _mm512_cmpgt_epu32_mask(_mm512_loadu_si512((const void*)Data), C); }
+        static OLAP_TARGET_AVX512 __mmask16 GatherGreater(const uint32_t* Data, __m512i Index, Constant C) { return _mm512_cmpgt_epu32_mask(_mm512_i32gather_epi32(Index, (const void*)Data, 4), C); }
+    };
+
+    template <>
+    struct Avx512Ops<int64_t>
+    {
+        using Constant = __m512i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(int64_t Value) { return _mm512_set1_epi64(Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const int64_t* Data, Constant C)
+        {
+            return (__mmask16)(_mm512_cmpgt_epi64_mask(_mm512_loadu_si512((const void*)Data), C) | (_mm512_cmpgt_epi64_mask(_mm512_loadu_si512((const void*)(Data + 8)), C) << 8));
+        }
+        static OLAP_TARGET_AVX512 __mmask16 GatherGreater(const int64_t* Data, __m512i Index, Constant C)
+        {
+            __m512i Lo = _mm512_i32gather_epi64(_mm512_castsi512_si256(Index), (const void*)Data, 8);
+            __m512i Hi = _mm512_i32gather_epi64(_mm512_extracti64x4_epi64(Index, 1), (const void*)Data, 8);
+            return (__mmask16)(_mm512_cmpgt_epi64_mask(Lo, C) | (_mm512_cmpgt_epi64_mask(Hi, C) << 8));
+        }
+    };
+
+    template <>
+    struct Avx512Ops<uint64_t>
+    {
+        using Constant = __m512i;
+        static OLAP_TARGET_AVX512 Constant Broadcast(uint64_t Value) { return _mm512_set1_epi64((long long)Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const uint64_t* Data, Constant C)
+        {
+            return (__mmask16)(_mm512_cmpgt_epu64_mask(_mm512_loadu_si512((const void*)Data), C) | (_mm512_cmpgt_epu64_mask(_mm512_loadu_si512((const void*)(Data + 8)), C) << 8));
+        }
+        static OLAP_TARGET_AVX512 __mmask16 GatherGreater(const uint64_t* Data, __m512i Index, Constant C)
+        {
+            __m512i Lo = _mm512_i32gather_epi64(_mm512_castsi512_si256(Index), (const void*)Data, 8);
+            __m512i Hi = _mm512_i32gather_epi64(_mm512_extracti64x4_epi64(Index, 1), (const void*)Data, 8);
+            return (__mmask16)(_mm512_cmpgt_epu64_mask(Lo, C) | (_mm512_cmpgt_epu64_mask(Hi, C) << 8));
+        }
+    };
+
+    template <>
+    struct Avx512Ops<float>
+    {
+        using Constant = __m512;
+        static OLAP_TARGET_AVX512 Constant Broadcast(float Value) { return _mm512_set1_ps(Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const float* Data, Constant C) { return _mm512_cmp_ps_mask(_mm512_loadu_ps(Data), C, _CMP_GT_OQ); }
+        static OLAP_TARGET_AVX512 __mmask16 GatherGreater(const float* Data, __m512i Index, Constant C) { return _mm512_cmp_ps_mask(_mm512_i32gather_ps(Index, Data, 4), C, _CMP_GT_OQ); }
+    };
+
+    template <>
+    struct Avx512Ops<double>
+    {
+        using Constant = __m512d;
+        static OLAP_TARGET_AVX512 Constant Broadcast(double Value) { return _mm512_set1_pd(Value); }
+        static OLAP_TARGET_AVX512 __mmask16 Greater(const double* Data, Constant C)
+        {
+            return (__mmask16)(_mm512_cmp_pd_mask(_mm512_loadu_pd(Data), C, _CMP_GT_OQ) | (_mm512_cmp_pd_mask(_mm512_loadu_pd(Data + 8), C, _CMP_GT_OQ) << 8));
+        }
+        static OLAP_TARGET_AVX512 __mmask16 GatherGreater(const double* Data, __m512i Index, Constant C)
+        {
+            __m512d Lo = _mm512_i32gather_pd(_mm512_castsi512_si256(Index), Data, 8);
+            __m512d Hi = _mm512_i32gather_pd(_mm512_extracti64x4_epi64(Index, 1), Data, 8);
+            return (__mmask16)(_mm512_cmp_pd_mask(Lo, C, _CMP_GT_OQ) | (_mm512_cmp_pd_mask(Hi, C, _CMP_GT_OQ) << 8));
+        }
+    };
+
+    // ---------------------------------------------------------------------------------------------
+    // Filter: writes the indices of the rows with x > Value to OutSelection and returns how many passed.
+    // OutSelection needs room for 16 more indices than can pass (the compress store writes whole vectors).
+    // The Refine versions only look at the rows in InSelection (a filter below already ran), nulls are dropped afterwards
+    // ---------------------------------------------------------------------------------------------
+    // the rows [From, Length) that didn't fill a whole vector. A null is never > anything
+    template <typename T, bool bNullable = false>
+    int64_t FilterGreaterScalarTail(const T* Data, int64_t From, int64_t Length, T Value, int32_t* OutSelection, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        int64_t OutputCount = 0;
+        for (int64_t i = From; i < Length; ++i)
+        {
+            if (Data[i] > Value && (!bNullable || IsValid(Validity, ValidityOffset + i)))
+            {
+                OutSelection[OutputCount++] = (int32_t)i;
+            }
+        }
+        return OutputCount;
+    }
+
+    template <typename T, bool bNullable = false>
+    int64_t FilterGreaterScalar(const T* Data, int64_t Length, T Value, int32_t* OutSelection, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        return FilterGreaterScalarTail<T, bNullable>(Data, 0, Length, Value, OutSelection, Validity, ValidityOffset);
+    }
+
+    template <typename T>
+    int64_t RefineGreaterScalar(const T* Data, const int32_t* InSelection, int64_t InCount, T Value, int32_t* OutSelection)
+    {
+        int64_t OutputCount = 0;
+        for (int64_t i = 0; i < InCount; ++i)
+        {
+            int32_t Row = InSelection[i];
+            if (Data[Row] > Value)
+            {
+                OutSelection[OutputCount++] = Row;
+            }
+        }
+        return OutputCount;
+    }
+
+    // Step values per iteration, their mask is handed to the 8 lane compress store 8 bits at a time.
+    // With nulls the compare mask is ANDed with the validity bits of the same rows
+    template <typename T, bool bNullable = false>
+    OLAP_TARGET_AVX2 int64_t FilterGreaterAvx2(const T* Data, int64_t Length, T Value, int32_t* OutSelection, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Ops = Avx2Ops<T>;
+        const typename Ops::Vec CompareVector = Ops::Constant(Value);
+
+        int64_t OutputCount = 0;
+        __m256i IndexVector = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i IndexStep = _mm256_set1_epi32(8);
+
+        int64_t i = 0;
+        for (; i <= Length - Ops::Step; i += Ops::Step)
+        {
+            uint64_t Mask = Ops::Greater(Data + i, CompareVector);
+            if constexpr (bNullable)
+            {
+                Mask &= ReadValidity<Ops::Step>(Validity, ValidityOffset + i);
+            }
+            for (int Block = 0; Block < Ops::Step / 8; ++Block) // Step is a constant, this unrolls
+            {
+                OutputCount += CompressStore32(OutSelection + OutputCount, IndexVector, (int)((Mask >> (Block * 8)) & 0xFF));
+                IndexVector = _mm256_add_epi32(IndexVector, IndexStep);
+            }
+        }
+
+        return OutputCount + FilterGreaterScalarTail<T, bNullable>(Data, i, Length, Value, OutSelection + OutputCount, Validity, ValidityOffset);
+    }
+
+    template <typename T>
+    OLAP_TARGET_AVX2 int64_t RefineGreaterAvx2(const T* Data, const int32_t* InSelection, int64_t InCount, T Value, int32_t* OutSelection)
+    {
+        using Ops = Avx2Ops<T>;
+        if constexpr (!Ops::bGather)
+        {
+            return RefineGreaterScalar(Data, InSelection, InCount, Value, OutSelection);
+        }
+        else
+        {
+            const typename Ops::Vec CompareVector = Ops::Constant(Value);
+            int64_t OutputCount = 0;
+
+            int64_t i = 0;
+            for (; i <= InCount - 8; i += 8)
+            {
+                __m256i IndexVector = _mm256_loadu_si256((const __m256i*)(InSelection + i));
+                int Mask = (int)Ops::GatherGreater(Data, IndexVector, CompareVector);
+                OutputCount += CompressStore32(OutSelection + OutputCount, IndexVector, Mask);
+            }
+
+            return OutputCount + RefineGreaterScalar(Data, InSelection + i, InCount - i, Value, OutSelection + OutputCount);
+        }
+    }
+
+    template <typename T, bool bNullable = false>
+    OLAP_TARGET_AVX512 int64_t FilterGreaterAvx512(const T* Data, int64_t Length, T Value, int32_t* OutSelection, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Ops = Avx512Ops<T>;
+        const typename Ops::Constant CompareVector = Ops::Broadcast(Value);
+
+        int64_t OutputCount = 0;
+        __m512i IndexVector = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m512i IndexStep = _mm512_set1_epi32(16);
+
+        int64_t i = 0;
+        for (; i <= Length - 16; i += 16)
+        {
+            __mmask16 Mask = Ops::Greater(Data + i, CompareVector);
+            if constexpr (bNullable)
+            {
+                Mask &= (__mmask16)ReadValidity<16>(Validity, ValidityOffset + i);
+            }
+            OutputCount += CompressStore32x16(OutSelection + OutputCount, IndexVector, Mask);
+            IndexVector = _mm512_add_epi32(IndexVector, IndexStep);
+        }
+
+        return OutputCount + FilterGreaterScalarTail<T, bNullable>(Data, i, Length, Value, OutSelection + OutputCount, Validity, ValidityOffset);
+    }
+
+    template <typename T>
+    OLAP_TARGET_AVX512 int64_t RefineGreaterAvx512(const T* Data, const int32_t* InSelection, int64_t InCount, T Value, int32_t* OutSelection)
+    {
+        using Ops = Avx512Ops<T>;
+        if constexpr (sizeof(T) < 4)
+        {
+            return RefineGreaterScalar(Data, InSelection, InCount, Value, OutSelection);
+        }
+        else
+        {
+            const typename Ops::Constant CompareVector = Ops::Broadcast(Value);
+            int64_t OutputCount = 0;
+
+            int64_t i = 0;
+            for (; i <= InCount - 16; i += 16)
+            {
+                __m512i IndexVector = _mm512_loadu_si512((const void*)(InSelection + i));
+                __mmask16 Mask = Ops::GatherGreater(Data, IndexVector, CompareVector);
+                OutputCount += CompressStore32x16(OutSelection + OutputCount, IndexVector, Mask);
+            }
+
+            return OutputCount + RefineGreaterScalar(Data, InSelection + i, InCount - i, Value, OutSelection + OutputCount);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // SUM, widened to ValueTraits<T>::SumType. Selection nullptr means every row
+    // ---------------------------------------------------------------------------------------------
+    template <typename T, bool bNullable = false>
+    typename ValueTraits<T>::SumType SumScalar(const T* Data, const int32_t* Selection, int64_t Count, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        typename ValueTraits<T>::SumType Sum = 0;
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int64_t Row = Selection != nullptr ? Selection[i] : i;
+            if constexpr (bNullable)
+            {
+                Sum += IsValid(Validity, ValidityOffset + Row) ? Data[Row] : T(0);
+            }
+            else
+            {
+                Sum += Data[Row];
+            }
+        }
+        return Sum;
+    }
+
+    OLAP_TARGET_AVX2 inline long long ReduceAdd64(__m256i V)
+    {
+        __m128i Sum128 = _mm_add_epi64(_mm256_castsi256_si128(V), _mm256_extracti128_si256(V, 1));
+        return _mm_cvtsi128_si64(_mm_add_epi64(Sum128, _mm_unpackhi_epi64(Sum128, Sum128)));
+    }
+
+    OLAP_TARGET_AVX2 inline double ReduceAddPd(__m256d V)
+    {
+        __m128d Sum128 = _mm_add_pd(_mm256_castpd256_pd128(V), _mm256_extractf128_pd(V, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(Sum128, _mm_unpackhi_pd(Sum128, Sum128)));
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Nulls: right after the load the lanes of null rows are replaced by the identity of the aggregate
+    // (0 for SUM, the largest value for MIN, ...), everything after that is the code that runs without nulls.
+    // AVX2 turns the validity bits into a lane mask and blends, AVX-512 uses the bits as the mask of a masked load
+    // ---------------------------------------------------------------------------------------------
+    template <typename T>
+    constexpr int Lanes256 = (int)(32 / sizeof(T));
+
+    // all ones in the lanes whose bit in Bits is set (bit 0 -> lane 0)
+    template <typename T>
+    OLAP_TARGET_AVX2 __m256i ValidLanesAvx2(uint64_t Bits)
+    {
+        if constexpr (sizeof(T) == 1)
+        {
+            // every byte gets a copy of the validity byte its bit is in, then keeps only its own bit
+            // (the shuffle works per 128 bit half, the upper half indexes bytes 2 and 3 of the same broadcast)
+            const __m256i Spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+            const __m256i BitOfLane = _mm256_set1_epi64x((long long)0x8040201008040201ull);
+            __m256i Bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int)Bits), Spread);
+            return _mm256_cmpeq_epi8(_mm256_and_si256(Bytes, BitOfLane), BitOfLane);
+        }
+        else if constexpr (sizeof(T) == 2)
+        {
+            const __m256i BitOfLane = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, (short)0x8000);
+            return _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16((short)Bits), BitOfLane), BitOfLane);
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+            const __m256i BitOfLane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)Bits), BitOfLane), BitOfLane);
+        }
+        else
+        {
+            const __m256i BitOfLane = _mm256_setr_epi64x(1, 2, 4, 8);
+            return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x((long long)Bits), BitOfLane), BitOfLane);
+        }
+    }
+
+    // Data in the valid lanes, Identity in the null ones
+    template <typename T>
+    OLAP_TARGET_AVX2 typename Avx2Ops<T>::Vec KeepValidAvx2(typename Avx2Ops<T>::Vec Data, uint64_t Bits, typename Avx2Ops<T>::Vec Identity)
+    {
+        __m256i Valid = ValidLanesAvx2<T>(Bits);
+        if constexpr (std::is_same_v<T, float>)
+        {
+            return _mm256_blendv_ps(Identity, Data, _mm256_castsi256_ps(Valid));
+        }
+        else if constexpr (std::is_same_v<T, double>)
+        {
+            return _mm256_blendv_pd(Identity, Data, _mm256_castsi256_pd(Valid));
+        }
+        else
+        {
+            return _mm256_blendv_epi8(Identity, Data, Valid);
+        }
+    }
+
+    // Running SUM of whole registers of T, widened on the way in:
+    //   8 bit:  vpsadbw against zero adds 8 bytes into a 64 bit lane, signed bytes are shifted to unsigned first (x ^ 0x80 = x + 128)
+    //   16 bit: vpmaddwd with ones adds pairs into 32 bit lanes, which are widened to 64 bit, unsigned shifted like above
+    //   32 bit: every value widened to 64 bit (vpmovsxdq / vpmovzxdq)
+    //   64 bit: plain 64 bit adds, wrap around like the scalar loop
+    //   float:  widened to double, double: as is
+    // A null lane holds 0 when it gets here, the shift and its correction cancel out for it like for any other 0
+    template <typename T>
+    struct Avx2SumState
+    {
+        using Vec = typename Avx2Ops<T>::Vec;
+        using AccVec = std::conditional_t<std::is_floating_point_v<T>, __m256d, __m256i>;
+
+        AccVec SumA;
+        AccVec SumB;
+
+        OLAP_TARGET_AVX2 Avx2SumState()
+        {
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                this->SumA = _mm256_setzero_pd();
+                this->SumB = _mm256_setzero_pd();
+            }
+            else
+            {
+                this->SumA = _mm256_setzero_si256();
+                this->SumB = _mm256_setzero_si256();
+            }
+        }
+
+        OLAP_TARGET_AVX2 void Add(Vec Values)
+        {
+            if constexpr (std::is_same_v<T, float>)
+            {
+                this->SumA = _mm256_add_pd(this->SumA, _mm256_cvtps_pd(_mm256_castps256_ps128(Values)));
+                this->SumB = _mm256_add_pd(this->SumB, _mm256_cvtps_pd(_mm256_extractf128_ps(Values, 1)));
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                this->SumA = _mm256_add_pd(this->SumA, Values);
+            }
+            else if constexpr (sizeof(T) == 1)
+            {
+                if constexpr (std::is_signed_v<T>)
+                {
+                    Values = _mm256_xor_si256(Values, _mm256_set1_epi8((char)0x80));
+                }
+                this->SumA = _mm256_add_epi64(this->SumA, _mm256_sad_epu8(Values, _mm256_setzero_si256()));
+            }
+            else if constexpr (sizeof(T) == 2)
+            {
+                if constexpr (!std::is_signed_v<T>)
+                {
+                    Values = _mm256_xor_si256(Values, _mm256_set1_epi16((short)0x8000));
+                }
+                __m256i Pairs = _mm256_madd_epi16(Values, _mm256_set1_epi16(1)); // 8 x int32
+                this->SumA = _mm256_add_epi64(this->SumA, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(Pairs)));
+                this->SumB = _mm256_add_epi64(this->SumB, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(Pairs, 1)));
+            }
+            else if constexpr (sizeof(T) == 4)
+            {
+                if constexpr (std::is_signed_v<T>)
+                {
+                    this->SumA = _mm256_add_epi64(this->SumA, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(Values)));
+                    this->SumB = _mm256_add_epi64(this->SumB, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(Values, 1)));
+                }
+                else
+                {
+                    this->SumA = _mm256_add_epi64(this->SumA, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(Values)));
+                    this->SumB = _mm256_add_epi64(this->SumB, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(Values, 1)));
+                }
+            }
+            else
+            {
+                this->SumA = _mm256_add_epi64(this->SumA, Values);
+            }
+        }
+
+        // Count is how many values went in (null lanes included), it undoes the shift of the 8/16 bit values
+        OLAP_TARGET_AVX2 typename ValueTraits<T>::SumType Total(int64_t Count) const
+        {
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                return ReduceAddPd(_mm256_add_pd(this->SumA, this->SumB));
+            }
+            else
+            {
+                long long Correction = 0;
+                if constexpr (sizeof(T) == 1 && std::is_signed_v<T>)
+                {
+                    Correction = -128ll * Count;
+                }
+                else if constexpr (sizeof(T) == 2 && !std::is_signed_v<T>)
+                {
+                    Correction = 32768ll * Count;
+                }
+                return (typename ValueTraits<T>::SumType)(ReduceAdd64(_mm256_add_epi64(this->SumA, this->SumB)) + Correction);
+            }
+        }
+    };
+
+    // Two registers per iteration into two states, so the adds of one don't wait on the other
+    template <typename T, bool bNullable = false>
+    OLAP_TARGET_AVX2 typename ValueTraits<T>::SumType SumAvx2(const T* Data, int64_t Length, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Ops = Avx2Ops<T>;
+        constexpr int Lanes = Lanes256<T>;
+        const typename Ops::Vec Zero = Ops::Set1(T(0));
+        Avx2SumState<T> Sum0;
+        Avx2SumState<T> Sum1;
+
+        int64_t i = 0;
+        for (; i <= Length - 2 * Lanes; i += 2 * Lanes)
+        {
+            typename Ops::Vec Values0 = Ops::Load(Data + i);
+            typename Ops::Vec Values1 = Ops::Load(Data + i + Lanes);
+            if constexpr (bNullable)
+            {
+                uint64_t Bits = ReadValidity<2 * Lanes>(Validity, ValidityOffset + i);
+                Values0 = KeepValidAvx2<T>(Values0, Bits, Zero);
+                Values1 = KeepValidAvx2<T>(Values1, Bits >> Lanes, Zero);
+            }
+            Sum0.Add(Values0);
+            Sum1.Add(Values1);
+        }
+
+        return Sum0.Total(i / 2) + Sum1.Total(i / 2) + SumScalar<T, bNullable>(Data + i, nullptr, Length - i, Validity, ValidityOffset + i);
+    }
+
+    template <typename T>
+    OLAP_TARGET_AVX2 typename ValueTraits<T>::SumType SumSelectedAvx2(const T* Data, const int32_t* Selection, int64_t Count)
+    {
+        using SumType = typename ValueTraits<T>::SumType;
+        int64_t i = 0;
+
+        if constexpr (sizeof(T) < 4)
+        {
+            return SumScalar(Data, Selection, Count);
+        }
+        else if constexpr (std::is_same_v<T, float>)
+        {
+            __m256d Sum = _mm256_setzero_pd();
+            for (; i <= Count - 8; i += 8)
+            {
+                __m256 Values = _mm256_i32gather_ps(Data, _mm256_loadu_si256((const __m256i*)(Selection + i)), 4);
+                Sum = _mm256_add_pd(Sum, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(Values)), _mm256_cvtps_pd(_mm256_extractf128_ps(Values, 1))));
+            }
+            return ReduceAddPd(Sum) + SumScalar(Data, Selection + i, Count - i);
+        }
+        else if constexpr (std::is_same_v<T, double>)
+        {
+            __m256d Sum0 = _mm256_setzero_pd();
+            __m256d Sum1 = _mm256_setzero_pd();
+            for (; i <= Count - 8; i += 8)
+            {
+                Sum0 = _mm256_add_pd(Sum0, _mm256_i32gather_pd(Data, _mm_loadu_si128((const __m128i*)(Selection + i)), 8));
+                Sum1 = _mm256_add_pd(Sum1, _mm256_i32gather_pd(Data, _mm_loadu_si128((const __m128i*)(Selection + i + 4)), 8));
+            }
+            return ReduceAddPd(_mm256_add_pd(Sum0, Sum1)) + SumScalar(Data, Selection + i, Count - i);
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+            __m256i Sum0 = _mm256_setzero_si256();
+            __m256i Sum1 = _mm256_setzero_si256();
+            for (; i <= Count - 8; i += 8)
+            {
+                __m256i Values = _mm256_i32gather_epi32((const int*)Data, _mm256_loadu_si256((const __m256i*)(Selection + i)), 4);
+                if constexpr (std::is_signed_v<T>)
+                {
+                    Sum0 = _mm256_add_epi64(Sum0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(Values)));
+                    Sum1 = _mm256_add_epi64(Sum1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(Values, 1)));
+                }
+                else
+                {
+                    Sum0 = _mm256_add_epi64(Sum0, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(Values)));
+                    Sum1 = _mm256_add_epi64(Sum1, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(Values, 1)));
+                }
+            }
+            return (SumType)ReduceAdd64(_mm256_add_epi64(Sum0, Sum1)) + SumScalar(Data, Selection + i, Count - i);
+        }
+        else
+        {
+            __m256i Sum0 = _mm256_setzero_si256();
+            __m256i Sum1 = _mm256_setzero_si256();
+            for (; i <= Count - 8; i += 8)
+            {
+                Sum0 = _mm256_add_epi64(Sum0, _mm256_i32gather_epi64((const long long*)Data, _mm_loadu_si128((const __m128i*)(Selection + i)), 8));
+                Sum1 = _mm256_add_epi64(Sum1, _mm256_i32gather_epi64((const long long*)Data, _mm_loadu_si128((const __m128i*)(Selection + i + 4)), 8));
+            }
+            return (SumType)ReduceAdd64(_mm256_add_epi64(Sum0, Sum1)) + SumScalar(Data, Selection + i, Count - i);
+        }
+    }
+
+    template <typename T>
+    struct Avx512Vec
+    {
+        using Type = __m512i;
+    };
+
+    template <>
+    struct Avx512Vec<float>
+    {
+        using Type = __m512;
+    };
+
+    template <>
+    struct Avx512Vec<double>
+    {
+        using Type = __m512d;
+    };
+
+    template <typename T>
+    constexpr int Lanes512 = (int)(64 / sizeof(T));
+
+    template <typename T>
+    OLAP_TARGET_AVX512 typename Avx512Vec<T>::Type Set1Avx512(T Value)
+    {
+        if constexpr (std::is_same_v<T, float>) return _mm512_set1_ps(Value);
+        else if constexpr (std::is_same_v<T, double>) return _mm512_set1_pd(Value);
+        else if constexpr (sizeof(T) == 1) return _mm512_set1_epi8((char)Value);
+        else if constexpr (sizeof(T) == 2) return _mm512_set1_epi16((short)Value);
+        else if constexpr (sizeof(T) == 4) return _mm512_set1_epi32((int)Value);
+        else return _mm512_set1_epi64((long long)Value);
+    }
+
+    template <typename T>
+    OLAP_TARGET_AVX512 typename Avx512Vec<T>::Type LoadAvx512(const T* Data)
+    {
+        if constexpr (std::is_same_v<T, float>) return _mm512_loadu_ps(Data);
+        else if constexpr (std::is_same_v<T, double>) return _mm512_loadu_pd(Data);
+        else return _mm512_loadu_si512((const void*)Data);
+    }
+
+    // Lanes512<T> values, the ones whose bit in Bits is clear are never read and come back as Identity
+    template <typename T>
+    OLAP_TARGET_AVX512 typename Avx512Vec<T>::Type LoadValidAvx512(const T* Data, uint64_t Bits, typename Avx512Vec<T>::Type Identity)
+    {
+        if constexpr (std::is_same_v<T, float>) return _mm512_mask_loadu_ps(Identity, (__mmask16)Bits, Data);
+        else if constexpr (std::is_same_v<T, double>) return _mm512_mask_loadu_pd(Identity, (__mmask8)Bits, Data);
+        else if constexpr (sizeof(T) == 1) return _mm512_mask_loadu_epi8(Identity, (__mmask64)Bits, (const void*)Data);
+        else if constexpr (sizeof(T) == 2) return _mm512_mask_loadu_epi16(Identity, (__mmask32)Bits, (const void*)Data);
+        else if constexpr (sizeof(T) == 4) return _mm512_mask_loadu_epi32(Identity, (__mmask16)Bits, (const void*)Data);
+        else return _mm512_mask_loadu_epi64(Identity, (__mmask8)Bits, (const void*)Data);
+    }
+
+    // Same widening as Avx2SumState with twice the lanes
+    template <typename T>
+    struct Avx512SumState
+    {
+        using Vec = typename Avx512Vec<T>::Type;
+        using AccVec = std::conditional_t<std::is_floating_point_v<T>, __m512d, __m512i>;
+
+        AccVec SumA;
+        AccVec SumB;
+
+        OLAP_TARGET_AVX512 Avx512SumState()
+        {
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                this->SumA = _mm512_setzero_pd();
+                this->SumB = _mm512_setzero_pd();
+            }
+            else
+            {
+                this->SumA = _mm512_setzero_si512();
+                this->SumB = _mm512_setzero_si512();
+            }
+        }
+
+        OLAP_TARGET_AVX512 void Add(Vec Values)
+        {
+            if constexpr (std::is_same_v<T, float>)
+            {
+                __m256 Lo = _mm512_castps512_ps256(Values);
+                __m256 Hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(Values), 1));
+                this->SumA = _mm512_add_pd(this->SumA, _mm512_cvtps_pd(Lo));
+                this->SumB = _mm512_add_pd(this->SumB, _mm512_cvtps_pd(Hi));
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                this->SumA = _mm512_add_pd(this->SumA, Values);
+            }
+            else if constexpr (sizeof(T) == 1)
+            {
+                if constexpr (std::is_signed_v<T>)
+                {
+                    Values = _mm512_xor_si512(Values, _mm512_set1_epi8((char)0x80));
+                }
+                this->SumA = _mm512_add_epi64(this->SumA, _mm512_sad_epu8(Values, _mm512_setzero_si512()));
+            }
+            else if constexpr (sizeof(T) == 2)
+            {
+                if constexpr (!std::is_signed_v<T>)
+                {
+                    Values = _mm512_xor_si512(Values, _mm512_set1_epi16((short)0x8000));
+                }
+                __m512i Pairs = _mm512_madd_epi16(Values, _mm512_set1_epi16(1)); // 16 x int32
+                this->SumA = _mm512_add_epi64(this->SumA, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(Pairs)));
+                this->SumB = _mm512_add_epi64(this->SumB, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(Pairs, 1)));
+            }
+            else if constexpr (sizeof(T) == 4)
+            {
+                if constexpr (std::is_signed_v<T>)
+                {
+                    this->SumA = _mm512_add_epi64(this->SumA, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(Values)));
+                    this->SumB = _mm512_add_epi64(this->SumB, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(Values, 1)));
+                }
+                else
+                {
+                    this->SumA = _mm512_add_epi64(this->SumA, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(Values)));
+                    this->SumB = _mm512_add_epi64(this->SumB, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(Values, 1)));
+                }
+            }
+            else
+            {
+                this->SumA = _mm512_add_epi64(this->SumA, Values);
+            }
+        }
+
+        OLAP_TARGET_AVX512 typename ValueTraits<T>::SumType Total(int64_t Count) const
+        {
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                return _mm512_reduce_add_pd(_mm512_add_pd(this->SumA, this->SumB));
+            }
+            else
+            {
+                long long Correction = 0;
+                if constexpr (sizeof(T) == 1 && std::is_signed_v<T>)
+                {
+                    Correction = -128ll * Count;
+                }
+                else if constexpr (sizeof(T) == 2 && !std::is_signed_v<T>)
+                {
+                    Correction = 32768ll * Count;
+                }
+                return (typename ValueTraits<T>::SumType)(_mm512_reduce_add_epi64(_mm512_add_epi64(this->SumA, this->SumB)) + Correction);
+            }
+        }
+    };
+
+    template <typename T, bool bNullable = false>
+    OLAP_TARGET_AVX512 typename ValueTraits<T>::SumType SumAvx512(const T* Data, int64_t Length, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        constexpr int Lanes = Lanes512<T>;
+        const typename Avx512Vec<T>::Type Zero = Set1Avx512<T>(T(0));
+        Avx512SumState<T> Sum0;
+        Avx512SumState<T> Sum1;
+
+        int64_t i = 0;
+        for (; i <= Length - 2 * Lanes; i += 2 * Lanes)
+        {
+            if constexpr (bNullable)
+            {
+                Sum0.Add(LoadValidAvx512<T>(Data + i, ReadValidity<Lanes>(Validity, ValidityOffset + i), Zero));
+                Sum1.Add(LoadValidAvx512<T>(Data + i + Lanes, ReadValidity<Lanes>(Validity, ValidityOffset + i + Lanes), Zero));
+            }
+            else
+            {
+                Sum0.Add(LoadAvx512<T>(Data + i));
+                Sum1.Add(LoadAvx512<T>(Data + i + Lanes));
+            }
+        }
+
+        return Sum0.Total(i / 2) + Sum1.Total(i / 2) + SumScalar<T, bNullable>(Data + i, nullptr, Length - i, Validity, ValidityOffset + i);
+    }
+
+    template <typename T>
+    OLAP_TARGET_AVX512 typename ValueTraits<T>::SumType SumSelectedAvx512(const T* Data, const int32_t* Selection, int64_t Count)
+    {
+        using SumType = typename ValueTraits<T>::SumType;
+        int64_t i = 0;
+
+        if constexpr (sizeof(T) < 4)
+        {
+            return SumScalar(Data, Selection, Count);
+        }
+        else if constexpr (std::is_same_v<T, float>)
+        {
+            __m512d Sum = _mm512_setzero_pd();
+            for (; i <= Count - 16; i += 16)
+            {
+                __m512 Values = _mm512_i32gather_ps(_mm512_loadu_si512((const void*)(Selection + i)), Data, 4);
+                __m256 Lo = _mm512_castps512_ps256(Values);
+                __m256 Hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(Values), 1));
+                Sum = _mm512_add_pd(Sum, _mm512_add_pd(_mm512_cvtps_pd(Lo), _mm512_cvtps_pd(Hi)));
+            }
+            return _mm512_reduce_add_pd(Sum) + SumScalar(Data, Selection + i, Count - i);
+        }
+        else if constexpr (std::is_same_v<T, double>)
+        {
+            __m512d Sum = _mm512_setzero_pd();
+            for (; i <= Count - 8; i += 8)
+            {
+                Sum = _mm512_add_pd(Sum, _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(Selection + i)), Data, 8));
+            }
+            return _mm512_reduce_add_pd(Sum) + SumScalar(Data, Selection + i, Count - i);
+        }
+        else if constexpr (sizeof(T) == 4)
+        {
+            __m512i Sum0 = _mm512_setzero_si512();
+            __m512i Sum1 = _mm512_setzero_si512();
+            for (; i <= Count - 16; i += 16)
+            {
+                __m512i Values = _mm512_i32gather_epi32(_mm512_loadu_si512((const void*)(Selection + i)), (const void*)Data, 4);
+                if constexpr (std::is_signed_v<T>)
+                {
+                    Sum0 = _mm512_add_epi64(Sum0, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(Values)));
+                    Sum1 = _mm512_add_epi64(Sum1, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(Values, 1)));
+                }
+                else
+                {
+                    Sum0 = _mm512_add_epi64(Sum0, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(Values)));
+                    Sum1 = _mm512_add_epi64(Sum1, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(Values, 1)));
+                }
+            }
+            return (SumType)_mm512_reduce_add_epi64(_mm512_add_epi64(Sum0, Sum1)) + SumScalar(Data, Selection + i, Count - i);
+        }
+        else
+        {
+            __m512i Sum = _mm512_setzero_si512();
+            for (; i <= Count - 8; i += 8)
+            {
+                Sum = _mm512_add_epi64(Sum, _mm512_i32gather_epi64(_mm256_loadu_si256((const __m256i*)(Selection + i)), (const void*)Data, 8));
+            }
+            return (SumType)_mm512_reduce_add_epi64(Sum) + SumScalar(Data, Selection + i, Count - i);
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // MIN (bMax false) / MAX (bMax true). Returns the identity (see ValueTraits) when there are no rows.
+    // NaNs are skipped like the scalar compare skips them
+    // ---------------------------------------------------------------------------------------------
+    template <typename T, bool bMax, bool bNullable = false>
+    T ExtremeScalar(const T* Data, const int32_t* Selection, int64_t Count, T Initial, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        T Result = Initial;
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int64_t Row = Selection != nullptr ? Selection[i] : i;
+            T Value = Data[Row];
+            if ((bMax ? Value > Result : Value < Result) && (!bNullable || IsValid(Validity, ValidityOffset + Row)))
+            {
+                Result = Value;
+            }
+        }
+        return Result;
+    }
+
+    template <typename T, bool bMax>
+    constexpr T ExtremeIdentity()
+    {
+        return bMax ? ValueTraits<T>::MaxIdentity() : ValueTraits<T>::MinIdentity();
+    }
+
+    // lanes of Ops::Vec reduced through memory, runs once per batch
+    template <typename T, bool bMax, typename VecType>
+    T ReduceExtreme(const VecType& Vector, T Initial)
+    {
+        alignas(64) T Lanes[sizeof(VecType) / sizeof(T)];
+        std::memcpy(Lanes, &Vector, sizeof(VecType));
+        return ExtremeScalar<T, bMax>(Lanes, nullptr, (int64_t)(sizeof(VecType) / sizeof(T)), Initial);
+    }
+
+    template <typename T, bool bMax, bool bNullable = false>
+    OLAP_TARGET_AVX2 T ExtremeAvx2(const T* Data, int64_t Length, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Ops = Avx2Ops<T>;
+        constexpr int Lanes = Lanes256<T>;
+        const typename Ops::Vec Identity = Ops::Set1(ExtremeIdentity<T, bMax>());
+        typename Ops::Vec Acc0 = Identity;
+        typename Ops::Vec Acc1 = Identity;
+
+        int64_t i = 0;
+        for (; i <= Length - 2 * Lanes; i += 2 * Lanes)
+        {
+            typename Ops::Vec Values0 = Ops::Load(Data + i);
+            typename Ops::Vec Values1 = Ops::Load(Data + i + Lanes);
+            if constexpr (bNullable)
+            {
+                uint64_t Bits = ReadValidity<2 * Lanes>(Validity, ValidityOffset + i);
+                Values0 = KeepValidAvx2<T>(Values0, Bits, Identity);
+                Values1 = KeepValidAvx2<T>(Values1, Bits >> Lanes, Identity);
+            }
+
+            if constexpr (bMax)
+            {
+                Acc0 = Ops::Max(Values0, Acc0);
+                Acc1 = Ops::Max(Values1, Acc1);
+            }
+            else
+            {
+                Acc0 = Ops::Min(Values0, Acc0);
+                Acc1 = Ops::Min(Values1, Acc1);
+            }
+        }
+
+        T Result = ReduceExtreme<T, bMax>(Acc0, ExtremeIdentity<T, bMax>());
+        Result = ReduceExtreme<T, bMax>(Acc1, Result);
+        return ExtremeScalar<T, bMax, bNullable>(Data + i, nullptr, Length - i, Result, Validity, ValidityOffset + i);
+    }
+
+    template <typename T, bool bMax>
+    OLAP_TARGET_AVX2 T ExtremeSelectedAvx2(const T* Data, const int32_t* Selection, int64_t Count)
+    {
+        using Ops = Avx2Ops<T>;
+        if constexpr (!Ops::bGather || sizeof(T) == 8)
+        {
+            // 8/16 bit can't be gathered, and the 64 bit ones only 4 at a time into a compare + blend, not worth it
+            return ExtremeScalar<T, bMax>(Data, Selection, Count, ExtremeIdentity<T, bMax>());
+        }
+        else
+        {
+            typename Ops::Vec Acc = Ops::Set1(ExtremeIdentity<T, bMax>());
+            int64_t i = 0;
+            for (; i <= Count - 8; i += 8)
+            {
+                typename Ops::Vec Values;
+                if constexpr (std::is_same_v<T, float>)
+                {
+                    Values = _mm256_i32gather_ps(Data, _mm256_loadu_si256((const __m256i*)(Selection + i)), 4);
+                }
+                else
+                {
+                    Values = Ops::Gather(Data, _mm256_loadu_si256((const __m256i*)(Selection + i)));
+                }
+                Acc = bMax ? Ops::Max(Values, Acc) : Ops::Min(Values, Acc);
+            }
+            T Result = ReduceExtreme<T, bMax>(Acc, ExtremeIdentity<T, bMax>());
+            return ExtremeScalar<T, bMax>(Data, Selection + i, Count - i, Result);
+        }
+    }
+
+    // AVX-512 has a native min/max for every width (vpminsb ... vpminuq, vminps/pd).
+    // Data first so a NaN in the data loses against the accumulator, like in the scalar compare
+    template <typename T, bool bMax>
+    OLAP_TARGET_AVX512 typename Avx512Vec<T>::Type ExtremeStepAvx512(typename Avx512Vec<T>::Type Values, typename Avx512Vec<T>::Type Acc)
+    {
+        constexpr bool bSigned = std::is_signed_v<T>;
+        if constexpr (std::is_same_v<T, float>) return bMax ? _mm512_max_ps(Values, Acc) : _mm512_min_ps(Values, Acc);
+        else if constexpr (std::is_same_v<T, double>) return bMax ? _mm512_max_pd(Values, Acc) : _mm512_min_pd(Values, Acc);
+        else if constexpr (sizeof(T) == 1) return bMax ? (bSigned ? _mm512_max_epi8(Values, Acc) : _mm512_max_epu8(Values, Acc)) : (bSigned ? _mm512_min_epi8(Values, Acc) : _mm512_min_epu8(Values, Acc));
+        else if constexpr (sizeof(T) == 2) return bMax ? (bSigned ? _mm512_max_epi16(Values, Acc) : _mm512_max_epu16(Values, Acc)) : (bSigned ? _mm512_min_epi16(Values, Acc) : _mm512_min_epu16(Values, Acc));
+        else if constexpr (sizeof(T) == 4) return bMax ? (bSigned ? _mm512_max_epi32(Values, Acc) : _mm512_max_epu32(Values, Acc)) : (bSigned ? _mm512_min_epi32(Values, Acc) : _mm512_min_epu32(Values, Acc));
+        else return bMax ? (bSigned ? _mm512_max_epi64(Values, Acc) : _mm512_max_epu64(Values, Acc)) : (bSigned ? _mm512_min_epi64(Values, Acc) : _mm512_min_epu64(Values, Acc));
+    }
+
+    template <typename T, bool bMax, bool bNullable = false>
+    OLAP_TARGET_AVX512 T ExtremeAvx512(const T* Data, int64_t Length, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        constexpr int Lanes = Lanes512<T>;
+        const T Identity = ExtremeIdentity<T, bMax>();
+        const typename Avx512Vec<T>::Type IdentityVector = Set1Avx512<T>(Identity);
+        typename Avx512Vec<T>::Type Acc = IdentityVector;
+
+        int64_t i = 0;
+        for (; i <= Length - Lanes; i += Lanes)
+        {
+            if constexpr (bNullable)
+            {
+                Acc = ExtremeStepAvx512<T, bMax>(LoadValidAvx512<T>(Data + i, ReadValidity<Lanes>(Validity, ValidityOffset + i), IdentityVector), Acc);
+            }
+            else
+            {
+                Acc = ExtremeStepAvx512<T, bMax>(LoadAvx512<T>(Data + i), Acc);
+            }
+        }
+
+        return ExtremeScalar<T, bMax, bNullable>(Data + i, nullptr, Length - i, ReduceExtreme<T, bMax>(Acc, Identity), Validity, ValidityOffset + i);
+    }
+
+    // Lanes512<T> values from Data[Selection[0..)], 32 and 64 bit types only
+    template <typename T>
+    OLAP_TARGET_AVX512 typename Avx512Vec<T>::Type GatherAvx512(const T* Data, const int32_t* Selection)
+    {
+        if constexpr (std::is_same_v<T, float>) return _mm512_i32gather_ps(_mm512_loadu_si512((const void*)Selection), Data, 4);
+        else if constexpr (std::is_same_v<T, double>) return _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)Selection), Data, 8);
+        else if constexpr (sizeof(T) == 4) return _mm512_i32gather_epi32(_mm512_loadu_si512((const void*)Selection), (const void*)Data, 4);
+        else return _mm512_i32gather_epi64(_mm256_loadu_si256((const __m256i*)Selection), (const void*)Data, 8);
+    }
+
+    template <typename T, bool bMax>
+    OLAP_TARGET_AVX512 T ExtremeSelectedAvx512(const T* Data, const int32_t* Selection, int64_t Count)
+    {
+        const T Identity = ExtremeIdentity<T, bMax>();
+        if constexpr (sizeof(T) < 4)
+        {
+            return ExtremeScalar<T, bMax>(Data, Selection, Count, Identity);
+        }
+        else
+        {
+            constexpr int Lanes = Lanes512<T>;
+            typename Avx512Vec<T>::Type Acc = Set1Avx512<T>(Identity);
+
+            int64_t i = 0;
+            for (; i <= Count - Lanes; i += Lanes)
+            {
+                Acc = ExtremeStepAvx512<T, bMax>(GatherAvx512<T>(Data, Selection + i), Acc);
+            }
+            return ExtremeScalar<T, bMax>(Data, Selection + i, Count - i, ReduceExtreme<T, bMax>(Acc, Identity));
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // Filter fused into the aggregate: SUM / MIN / MAX of the rows with x > Value, in one pass over the column.
+    // The compare mask goes straight into the add (or min/max), the rows that fail are replaced by the identity
+    // like the null ones above. No selection vector is written, so this runs at close to the speed of the plain aggregate
+    // ---------------------------------------------------------------------------------------------
+
+    // How x > Value turns out on a column of T when Value can't be stored in a T:
+    // an int8 column is never > 200 (NONE) and always > -1000 (ALL). Floats hold every int
+    enum class ConstantFit
+    {
+        COMPARE,
+        ALL,
+        NONE
+    };
+
+    template <typename T>
+    ConstantFit FitGreaterConstant(int64_t Value)
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            if (Value < (int64_t)std::numeric_limits<T>::lowest())
+            {
+                return ConstantFit::ALL;
+            }
+            if (sizeof(T) < 8 && Value >= (int64_t)std::numeric_limits<T>::max())
+            {
+                return ConstantFit::NONE;
+            }
+        }
+        return ConstantFit::COMPARE;
+    }
+
+    template <typename T, bool bNullable = false>
+    typename ValueTraits<T>::SumType FilterSumScalar(const T* Data, int64_t Length, T Value, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        typename ValueTraits<T>::SumType Sum = 0;
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            bool bPass = Data[i] > Value && (!bNullable || IsValid(Validity, ValidityOffset + i));
+            Sum += bPass ? Data[i] : T(0);
+        }
+        return Sum;
+    }
+
+    template <typename T, bool bMax, bool bNullable = false>
+    T FilterExtremeScalar(const T* Data, int64_t Length, T Value, T Initial, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        T Result = Initial;
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            T Candidate = Data[i];
+            if (Candidate > Value && (bMax ? Candidate > Result : Candidate < Result) && (!bNullable || IsValid(Validity, ValidityOffset + i)))
+            {
+                Result = Candidate;
+            }
+        }
+        return Result;
+    }
+
+    // x > C for the 2 * Lanes256<T> values at Data as bits (bit 0 -> Data[0]), the same compares FilterGreaterAvx2 runs
+    template <typename T>
+    OLAP_TARGET_AVX2 uint64_t GreaterBitsAvx2(const T* Data, typename Avx2Ops<T>::Vec C)
+    {
+        using Ops = Avx2Ops<T>;
+        uint64_t Bits = 0;
+        for (int Part = 0; Part < 2 * Lanes256<T>; Part += Ops::Step) // constant trip count, this unrolls
+        {
+            Bits |= Ops::Greater(Data + Part, C) << Part;
+        }
+        return Bits;
+    }
+
+    template <typename T, bool bNullable = false>
+    OLAP_TARGET_AVX2 typename ValueTraits<T>::SumType FilterSumAvx2(const T* Data, int64_t Length, T Value, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Ops = Avx2Ops<T>;
+        constexpr int Lanes = Lanes256<T>;
+        const typename Ops::Vec CompareVector = Ops::Constant(Value);
+        const typename Ops::Vec Zero = Ops::Set1(T(0));
+        Avx2SumState<T> Sum0;
+        Avx2SumState<T> Sum1;
+
+        int64_t i = 0;
+        for (; i <= Length - 2 * Lanes; i += 2 * Lanes)
+        {
+            uint64_t Bits = GreaterBitsAvx2<T>(Data + i, CompareVector);
+            if constexpr (bNullable)
+            {
+                Bits &= ReadValidity<2 * Lanes>(Validity, ValidityOffset + i);
+            }
+            Sum0.Add(KeepValidAvx2<T>(Ops::Load(Data + i), Bits, Zero));
+            Sum1.Add(KeepValidAvx2<T>(Ops::Load(Data + i + Lanes), Bits >> Lanes, Zero));
+        }
+
+        return Sum0.Total(i / 2) + Sum1.Total(i / 2) + FilterSumScalar<T, bNullable>(Data + i, Length - i, Value, Validity, ValidityOffset + i);
+    }
+
+    template <typename T, bool bMax, bool bNullable = false>
+    OLAP_TARGET_AVX2 T FilterExtremeAvx2(const T* Data, int64_t Length, T Value, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Ops = Avx2Ops<T>;
+        constexpr int Lanes = Lanes256<T>;
+        const typename Ops::Vec CompareVector = Ops::Constant(Value);
+        const typename Ops::Vec Identity = Ops::Set1(ExtremeIdentity<T, bMax>());
+        typename Ops::Vec Acc0 = Identity;
+        typename Ops::Vec Acc1 = Identity;
+
+        int64_t i = 0;
+        for (; i <= Length - 2 * Lanes; i += 2 * Lanes)
+        {
+            uint64_t Bits = GreaterBitsAvx2<T>(Data + i, CompareVector);
+            if constexpr (bNullable)
+            {
+                Bits &= ReadValidity<2 * Lanes>(Validity, ValidityOffset + i);
+            }
+            typename Ops::Vec Values0 = KeepValidAvx2<T>(Ops::Load(Data + i), Bits, Identity);
+            typename Ops::Vec Values1 = KeepValidAvx2<T>(Ops::Load(Data + i + Lanes), Bits >> Lanes, Identity);
+
+            if constexpr (bMax)
+            {
+                Acc0 = Ops::Max(Values0, Acc0);
+                Acc1 = Ops::Max(Values1, Acc1);
+            }
+            else
+            {
+                Acc0 = Ops::Min(Values0, Acc0);
+                Acc1 = Ops::Min(Values1, Acc1);
+            }
+        }
+
+        T Result = ReduceExtreme<T, bMax>(Acc0, ExtremeIdentity<T, bMax>());
+        Result = ReduceExtreme<T, bMax>(Acc1, Result);
+        return FilterExtremeScalar<T, bMax, bNullable>(Data + i, Length - i, Value, Result, Validity, ValidityOffset + i);
+    }
+
+    // x > C on a whole register, one mask bit per lane. Unsigned types use the epu compares, no bias needed
+    template <typename T>
+    OLAP_TARGET_AVX512 uint64_t GreaterAvx512(typename Avx512Vec<T>::Type Values, typename Avx512Vec<T>::Type C)
+    {
+        constexpr bool bSigned = std::is_signed_v<T>;
+        if constexpr (std::is_same_v<T, float>) return _mm512_cmp_ps_mask(Values, C, _CMP_GT_OQ);
+        else if constexpr (std::is_same_v<T, double>) return _mm512_cmp_pd_mask(Values, C, _CMP_GT_OQ);
+        else if constexpr (sizeof(T) == 1) return bSigned ? _mm512_cmpgt_epi8_mask(Values, C) : _mm512_cmpgt_epu8_mask(Values, C);
+        else if constexpr (sizeof(T) == 2) return bSigned ? _mm512_cmpgt_epi16_mask(Values, C) : _mm512_cmpgt_epu16_mask(Values, C);
+        else if constexpr (sizeof(T) == 4) return bSigned ? _mm512_cmpgt_epi32_mask(Values, C) : _mm512_cmpgt_epu32_mask(Values, C);
+        else return bSigned ? _mm512_cmpgt_epi64_mask(Values, C) : _mm512_cmpgt_epu64_mask(Values, C);
+    }
+
+    // Values in the lanes whose bit is set, Identity in the rest
+    template <typename T>
+    OLAP_TARGET_AVX512 typename Avx512Vec<T>::Type KeepAvx512(typename Avx512Vec<T>::Type Values, uint64_t Bits, typename Avx512Vec<T>::Type Identity)
+    {
+        if constexpr (std::is_same_v<T, float>) return _mm512_mask_mov_ps(Identity, (__mmask16)Bits, Values);
+        else if constexpr (std::is_same_v<T, double>) return _mm512_mask_mov_pd(Identity, (__mmask8)Bits, Values);
+        else if constexpr (sizeof(T) == 1) return _mm512_mask_mov_epi8(Identity, (__mmask64)Bits, Values);
+        else if constexpr (sizeof(T) == 2) return _mm512_mask_mov_epi16(Identity, (__mmask32)Bits, Values);
+        else if constexpr (sizeof(T) == 4) return _mm512_mask_mov_epi32(Identity, (__mmask16)Bits, Values);
+        else return _mm512_mask_mov_epi64(Identity, (__mmask8)Bits, Values);
+    }
+
+    template <typename T, bool bNullable = false>
+    OLAP_TARGET_AVX512 typename ValueTraits<T>::SumType FilterSumAvx512(const T* Data, int64_t Length, T Value, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Vec = typename Avx512Vec<T>::Type;
+        constexpr int Lanes = Lanes512<T>;
+        const Vec CompareVector = Set1Avx512<T>(Value);
+        const Vec Zero = Set1Avx512<T>(T(0));
+        Avx512SumState<T> Sum0;
+        Avx512SumState<T> Sum1;
+
+        int64_t i = 0;
+        for (; i <= Length - 2 * Lanes; i += 2 * Lanes)
+        {
+            Vec Values0 = LoadAvx512<T>(Data + i);
+            Vec Values1 = LoadAvx512<T>(Data + i + Lanes);
+            uint64_t Bits0 = GreaterAvx512<T>(Values0, CompareVector);
+            uint64_t Bits1 = GreaterAvx512<T>(Values1, CompareVector);
+            if constexpr (bNullable)
+            {
+                Bits0 &= ReadValidity<Lanes>(Validity, ValidityOffset + i);
+                Bits1 &= ReadValidity<Lanes>(Validity, ValidityOffset + i + Lanes);
+            }
+            Sum0.Add(KeepAvx512<T>(Values0, Bits0, Zero));
+            Sum1.Add(KeepAvx512<T>(Values1, Bits1, Zero));
+        }
+
+        return Sum0.Total(i / 2) + Sum1.Total(i / 2) + FilterSumScalar<T, bNullable>(Data + i, Length - i, Value, Validity, ValidityOffset + i);
+    }
+
+    template <typename T, bool bMax, bool bNullable = false>
+    OLAP_TARGET_AVX512 T FilterExtremeAvx512(const T* Data, int64_t Length, T Value, const uint8_t* Validity = nullptr, int64_t ValidityOffset = 0)
+    {
+        using Vec = typename Avx512Vec<T>::Type;
+        constexpr int Lanes = Lanes512<T>;
+        const T Identity = ExtremeIdentity<T, bMax>();
+        const Vec CompareVector = Set1Avx512<T>(Value);
+        const Vec IdentityVector = Set1Avx512<T>(Identity);
+        Vec Acc = IdentityVector;
+
+        int64_t i = 0;
+        for (; i <= Length - Lanes; i += Lanes)
+        {
+            Vec Values = LoadAvx512<T>(Data + i);
+            uint64_t Bits = GreaterAvx512<T>(Values, CompareVector);
+            if constexpr (bNullable)
+            {
+                Bits &= ReadValidity<Lanes>(Validity, ValidityOffset + i);
+            }
+            Acc = ExtremeStepAvx512<T, bMax>(KeepAvx512<T>(Values, Bits, IdentityVector), Acc);
+        }
+
+        return FilterExtremeScalar<T, bMax, bNullable>(Data + i, Length - i, Value, ReduceExtreme<T, bMax>(Acc, Identity), Validity, ValidityOffset + i);
+    }
+}
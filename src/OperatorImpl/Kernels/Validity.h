@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Helpers for Arrow validity bitmaps: bit i (LSB first) of the bitmap is set when row i is not null.
+// Bit positions include the array's offset, a slice starting at row 5 reads its first row from bit 5.
+// Kernels take nullptr for the bitmap when the column has no nulls, that's the fast path
+namespace Kernels
+{
+    inline bool IsValid(const uint8_t* Validity, int64_t Bit)
+    {
+        return (Validity[Bit >> 3] >> (Bit & 7)) & 1;
+    }
+
+    // The Count (8, 16, 32 or 64) validity bits starting at Bit as the low bits of the result.
+    // Only reads the bytes those bits live in, so it never runs past the end of the bitmap
+    template <int Count>
+    inline uint64_t ReadValidity(const uint8_t* Validity, int64_t Bit)
+    {
+        static_assert(Count % 8 == 0 && Count <= 64, "whole bytes only");
+        if constexpr (Count == 64)
+        {
+            return ReadValidity<32>(Validity, Bit) | (ReadValidity<32>(Validity, Bit + 32) << 32);
+        }
+        else
+        {
+            const uint8_t* Bytes = Validity + (Bit >> 3);
+            int Shift = (int)(Bit & 7);
+            uint64_t Word = 0;
+            if (Shift == 0)
+            {
+                std::memcpy(&Word, Bytes, Count / 8);
+                return Word;
+            }
+
+            // not byte aligned (a sliced array), the bits straddle one more byte
+            std::memcpy(&Word, Bytes, Count / 8 + 1);
+            return (Word >> Shift) & ((1ull << Count) - 1);
+        }
+    }
+
+    // Keeps the rows of Selection that aren't null and returns how many. Out may be Selection itself.
+    // Every row is written and the position only advances for valid ones, no branch on the bit
+    inline int64_t DropNulls(const uint8_t* Validity, int64_t Offset, const int32_t* Selection, int64_t Count, int32_t* Out)
+    {
+        int64_t OutputCount = 0;
+        for (int64_t i = 0; i < Count; ++i)
+        {
+            int32_t Row = Selection[i];
+            Out[OutputCount] = Row;
+            OutputCount += IsValid(Validity, Offset + Row);
+        }
+        return OutputCount;
+    }
+
+    // The rows [0, Length) that aren't null
+    inline int64_t SelectValid(const uint8_t* Validity, int64_t Offset, int64_t Length, int32_t* Out)
+    {
+        int64_t OutputCount = 0;
+        for (int64_t i = 0; i < Length; ++i)
+        {
+            Out[OutputCount] = (int32_t)i;
+            OutputCount += IsValid(Validity, Offset + i);
+        }
+        return OutputCount;
+    }
+}
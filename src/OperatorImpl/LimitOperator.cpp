@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "LimitOperator.h"
+#include <algorithm>
+#include <stdexcept>
+
+LimitOperator::LimitOperator(std::unique_ptr<Operator> Child, int64_t Limit, ExecutionMode Mode)
+    : Operator(Mode), ChildOperator(std::move(Child)), Limit(Limit), Remaining(Limit)
+{
+    if (this->Limit < 0)
+    {
+        throw std::runtime_error("LimitOperator: the limit can't be negative");
+    }
+}
+
+DataChunk LimitOperator::Next()
+{
+    return this->NextSelected().Materialize(this->Memory);
+}
+
+SelectedChunk LimitOperator::NextSelected()
+{
+    if (this->bFinished)
+    {
+        return SelectedChunk();
+    }
+
+    // LIMIT 0 never reads anything
+    if (this->Remaining == 0)
+    {
+        this->Close();
+        return SelectedChunk();
+    }
+
+    SelectedChunk Input = this->ChildOperator->NextSelected();
+    if (Input.IsEnd())
+    {
+        this->bFinished = true;
+        return Input;
+    }
+
+    SelectedChunk Output = Input;
+    if (Input.Count > this->Remaining)
+    {
+        // a selection is in row order, its first Remaining entries are the first rows. Without one the batch is sliced (no copy)
+        Output = Input.HasSelection() ? SelectedChunk(Input.Batch, Input.Selection, this->Remaining)
+                                      : SelectedChunk(Input.Batch->Slice(0, this->Remaining));
+    }
+    this->Remaining -= Output.Count;
+
+    // done: the child stops now, not when the consumer comes back for more.
+    // Closing leaves the batch and selection it returned last alone, Output still points into them
+    if (this->Remaining == 0)
+    {
+        this->Close();
+    }
+    return Output;
+}
+
+bool LimitOperator::PushProjection(const std::vector<ColumnRef>& Columns)
+{
+    return this->ChildOperator->PushProjection(Columns);
+}
+
+bool LimitOperator::FusePipelines()
+{
+    return this->ChildOperator->FusePipelines();
+}
+
+void LimitOperator::Close()
+{
+    this->bFinished = true;
+    this->ChildOperator->Close();
+}
+
+void LimitOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
+}
+
+std::vector<DataChunk> LimitOperator::MergePartials(std::vector<DataChunk> Partials) const
+{
+    std::vector<DataChunk> Result;
+    int64_t Left = this->Limit;
+    for (const DataChunk& Batch : Partials)
+    {
+        if (Left == 0)
+        {
+            break;
+        }
+
+        int64_t Count = std::min<int64_t>(Left, Batch->num_rows());
+        Result.push_back(Count == Batch->num_rows() ? Batch : Batch->Slice(0, Count));
+        Left -= Count;
+    }
+    return Result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Operator.h"
+#include <vector>
+
+// LIMIT n: hands out the first n rows of the child and stops. As soon as the n-th row is out the child is closed
+// (Operator::Close), so a scan below stops decoding and joins its threads right away instead of reading the rest of the file.
+// Rows pass through untouched, a selection from the child stays a selection, only the last batch is cut short.
+// Predicates and runtime filters aren't passed on, the first n rows below us aren't the first n rows of a filtered input.
+// Under a ParallelOperator every worker stops after its own n rows, MergePartials keeps the first n of all of them
+class LimitOperator : public Operator
+{
+public:
+    LimitOperator(std::unique_ptr<Operator> Child, int64_t Limit, ExecutionMode Mode = ExecutionMode::SCALAR);
+
+    DataChunk Next() override;
+
+    SelectedChunk NextSelected() override;
+
+    bool PushProjection(const std::vector<ColumnRef>& Columns) override;
+
+    bool FusePipelines() override;
+
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const override;
+
+private:
+    std::unique_ptr<Operator> ChildOperator;
+    int64_t Limit;
+    int64_t Remaining;
+};
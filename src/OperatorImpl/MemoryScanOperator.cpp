@@ -1,13 +1,19 @@
 #include "pch.h"
 #include "MemoryScanOperator.h"
+#include "RuntimeFilter.h"
 
-MemoryScanOperator::MemoryScanOperator(const std::vector<DataChunk>& Chunks)
-    : SourceChunks(Chunks), CurrentIndex(0)
+MemoryScanOperator::MemoryScanOperator(const std::vector<DataChunk>& Chunks, ExecutionMode Mode)
+    : Operator(Mode), SourceChunks(Chunks), CurrentIndex(0)
 {
 }
 
 DataChunk MemoryScanOperator::Next()
 {
+    if (!this->RuntimeFilters.empty())
+    {
+        return this->NextSelected().Materialize(this->Memory);
+    }
+
     if (this->CurrentIndex >= this->SourceChunks.size())
     {
         return nullptr;
@@ -15,4 +21,47 @@ DataChunk MemoryScanOperator::Next()
 
     // return chunk and advance index
     return this->SourceChunks[this->CurrentIndex++];
-}
\ No newline at end of file
+}
+
+SelectedChunk MemoryScanOperator::NextSelected()
+{
+    if (this->RuntimeFilters.empty())
+    {
+        return SelectedChunk(this->Next());
+    }
+
+    // not through Next(), with filters that one comes back here
+    if (this->CurrentIndex >= this->SourceChunks.size())
+    {
+        return SelectedChunk();
+    }
+
+    DataChunk Chunk = this->SourceChunks[this->CurrentIndex++];
+    if ((int64_t)this->SelectionBuffer.size() < Chunk->num_rows())
+    {
+        this->SelectionBuffer.resize(Chunk->num_rows());
+    }
+
+    // the first filter looks at every row, the others only at what is left
+    int32_t* Selection = this->SelectionBuffer.data();
+    int64_t Count = this->RuntimeFilters[0]->Apply(*Chunk, nullptr, Chunk->num_rows(), Selection, this->CurrentMode);
+    for (size_t i = 1; i < this->RuntimeFilters.size(); ++i)
+    {
+        Count = this->RuntimeFilters[i]->Apply(*Chunk, Selection, Count, Selection, this->CurrentMode);
+    }
+
+    return SelectedChunk(Chunk, Selection, Count);
+}
+
+void MemoryScanOperator::Close()
+{
+    this->bFinished = true;
+    this->CurrentIndex = this->SourceChunks.size();
+    this->RuntimeFilters.clear();
+}
+
+bool MemoryScanOperator::PushRuntimeFilter(std::shared_ptr<const RuntimeFilter> Filter)
+{
+    this->RuntimeFilters.push_back(std::move(Filter));
+    return true;
+}
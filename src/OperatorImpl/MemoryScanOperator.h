@@ -5,11 +5,22 @@
 class MemoryScanOperator : public Operator
 {
 public:
-    MemoryScanOperator(const std::vector<DataChunk>& Chunks);
+    MemoryScanOperator(const std::vector<DataChunk>& Chunks, ExecutionMode Mode = ExecutionMode::SCALAR);
 
     DataChunk Next() override;
 
+    // Without runtime filters every row is alive, with them the rows that can't pass are left out of the selection
+    SelectedChunk NextSelected() override;
+
+    bool PushRuntimeFilter(std::shared_ptr<const RuntimeFilter> Filter) override;
+
+    // Skips the chunks that are left
+    void Close() override;
+
 private:
     const std::vector<DataChunk>& SourceChunks;
     size_t CurrentIndex;
-};
\ No newline at end of file
+
+    std::vector<std::shared_ptr<const RuntimeFilter>> RuntimeFilters;
+    std::vector<int32_t> SelectionBuffer;
+};
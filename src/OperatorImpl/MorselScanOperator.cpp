@@ -0,0 +1,32 @@
+#include "pch.h"
+#include "MorselScanOperator.h"
+#include "../Execution/MorselQueue.h"
+
+MorselScanOperator::MorselScanOperator(MorselQueue& Queue, int WorkerIndex)
+    : Queue(Queue), WorkerIndex(WorkerIndex)
+{
+}
+
+DataChunk MorselScanOperator::Next()
+{
+    if (this->bFinished)
+    {
+        return nullptr;
+    }
+
+    if (this->CurrentIndex >= this->MorselEnd)
+    {
+        if (!this->Queue.Next(this->WorkerIndex, this->CurrentIndex, this->MorselEnd))
+        {
+            return nullptr;
+        }
+    }
+
+    return this->Queue.Chunks()[this->CurrentIndex++];
+}
+
+void MorselScanOperator::Close()
+{
+    this->bFinished = true;
+    this->CurrentIndex = this->MorselEnd;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Operator.h"
+
+class MorselQueue;
+
+// Scan at the bottom of one worker's copy of a parallel plan. Instead of walking a chunk vector from start to end
+// it asks the shared MorselQueue for the next morsel whenever the current one is used up
+class MorselScanOperator : public Operator
+{
+public:
+    MorselScanOperator(MorselQueue& Queue, int WorkerIndex);
+
+    DataChunk Next() override;
+
+    // Stops taking morsels, the ones this worker didn't get to are left for the others to steal
+    void Close() override;
+
+private:
+    MorselQueue& Queue;
+    int WorkerIndex;
+
+    // chunks of the current morsel that haven't been returned yet
+    size_t CurrentIndex = 0;
+    size_t MorselEnd = 0;
+};
@@ -1,9 +1,24 @@
 #pragma once
-#include <memory> 
+#include <memory>
+#include <vector>
+#include <string>
 #include <arrow/record_batch.h>
+#include <arrow/memory_pool.h>
+#include "DataChunk.h"
+#include "../Misc/CpuFeatures.h"
 
-// a "vector" or batch of rows instead of just 1 row
-using DataChunk = std::shared_ptr<arrow::RecordBatch>;
+struct RuntimeFilter;
+struct ScanPredicate;
+
+// A column an operator reads from its child, by name or, for operators that address columns by position, by index
+struct ColumnRef
+{
+    std::string Name;
+    int Index = -1; // used when Name is empty
+
+    static ColumnRef Named(const std::string& Name) { ColumnRef Ref; Ref.Name = Name; return Ref; }
+    static ColumnRef At(int Index) { ColumnRef Ref; Ref.Index = Index; return Ref; }
+};
 
 enum class ExecutionMode
 {
@@ -11,12 +26,30 @@ enum class ExecutionMode
     AVX2,
     AVX512
 };
+
+// Best mode the CPU we're running on supports
+inline ExecutionMode BestExecutionMode()
+{
+    const CpuFeatures::Features& Features = CpuFeatures::Get();
+    if (Features.bAvx512) return ExecutionMode::AVX512;
+    if (Features.bAvx2) return ExecutionMode::AVX2;
+    return ExecutionMode::SCALAR;
+}
+
+// Steps the requested mode down to something this CPU can execute, so asking for AVX512 on an
+// AVX2 host runs the AVX2 kernels instead of faulting
+inline ExecutionMode ResolveExecutionMode(ExecutionMode Requested)
+{
+    ExecutionMode Best = BestExecutionMode();
+    return (int)Requested <= (int)Best ? Requested : Best;
+}
+
 class Operator
 {
 public:
 
     Operator(ExecutionMode mode = ExecutionMode::SCALAR)
-        : CurrentMode(mode)
+        : CurrentMode(ResolveExecutionMode(mode))
     {
     }
 
@@ -24,7 +57,89 @@ public:
 
     virtual DataChunk Next() = 0;  // Every operator must implement Next()
 
+    // Same as Next() but the operator may return its input batch plus a selection vector
+    // instead of compacting it (late materialization). Only filtering operators override this,
+    // everything else just says "all rows are alive"
+    virtual SelectedChunk NextSelected()
+    {
+        return SelectedChunk(this->Next());
+    }
+
+    // Offers a filter that another operator built while the query runs (e.g. the bloom filter of a join's build side).
+    // Operators that can drop rows early keep it and return true, everything else ignores it
+    virtual bool PushRuntimeFilter(std::shared_ptr<const RuntimeFilter> Filter)
+    {
+        return false;
+    }
+
+    // Offers a predicate the rows above this operator will be filtered with. A scan that keeps min/max statistics
+    // uses it to skip whole parts of the file, operators that don't change the rows pass it on to their child.
+    // Only valid before the first Next(), the filter above still has to check every row it gets
+    virtual bool PushPredicate(const ScanPredicate& Predicate)
+    {
+        return false;
+    }
+
+    // Tells the child which of its columns the operators above will ever read, so a scan can leave the rest in the file.
+    // Operators that pass their input through add their own columns and forward it, the ones that don't know better ignore it
+    // (returning false), then everything is read like before. Only valid before the first Next()
+    virtual bool PushProjection(const std::vector<ColumnRef>& Columns)
+    {
+        return false;
+    }
+
+    // Operator fusion: runs over this operator and everything below it and merges the pairs that have a fused kernel
+    // into one loop, e.g. a SUM over a filter adds the rows straight from the compare mask instead of going through a
+    // selection vector. Returns true when anything got fused. Only valid before the first Next()
+    virtual bool FusePipelines()
+    {
+        return false;
+    }
+
+    // Asked by the operator above during FusePipelines(). A filter whose predicate is on Column hands it over:
+    // it fills Predicate and gives away its child, which the caller reads from directly from then on.
+    // An empty Column (no name, no index) takes the predicate whatever column it is on, Predicate says which.
+    // Everything else returns nullptr and stays as it is
+    virtual std::unique_ptr<Operator> ReleaseFilterForFusion(const ColumnRef& Column, ScanPredicate& Predicate)
+    {
+        return nullptr;
+    }
+
+    // The consumer is done with this operator and won't call Next() again, e.g. a LIMIT that has all of its rows.
+    // Scans stop reading and join their decode threads, everything drops the batches it buffered, and operators with
+    // children close those too. The batch (and selection) returned last stays valid. Safe to call more than once,
+    // also before the first Next(). The default only marks the operator as finished
+    virtual void Close()
+    {
+        this->bFinished = true;
+    }
+
+    // Every buffer the operator allocates (materialized batches, computed columns, results) comes from Pool from now on,
+    // e.g. the query's QueryMemoryPool (Execution/QueryMemoryPool.h). Operators with children pass it on.
+    // Only valid before the first Next(), the pool has to outlive the plan and every batch it returned
+    virtual void UseMemoryPool(arrow::MemoryPool* Pool)
+    {
+        this->Memory = Pool;
+    }
+
+    // Parallel execution runs one copy of the plan per worker (see ParallelOperator), each over part of the input.
+    // This combines what those copies returned into what a single copy over all of the input would have returned.
+    // The default just keeps every batch, which is right for anything that works row by row (scans, filters, joins probing
+    // a full build side). Aggregates override it, anything whose partial results can't be combined throws
+    virtual std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const
+    {
+        return Partials;
+    }
+
+    // Called by ParallelOperator on the root of every copy before the first Next(): the copy returns the state
+    // MergePartials needs instead of its final result. Only aggregates have such a state that differs from their
+    // result (AVG needs its sum and count), everything else ignores it
+    virtual void ProducePartials()
+    {
+    }
+
 protected:
     ExecutionMode CurrentMode;
     bool bFinished = false;
-};
\ No newline at end of file
+    arrow::MemoryPool* Memory = arrow::default_memory_pool();
+};
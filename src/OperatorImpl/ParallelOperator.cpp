@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "ParallelOperator.h"
+#include "MorselScanOperator.h"
+#include "../Execution/MorselQueue.h"
+#include "../Execution/ThreadPool.h"
+#include <algorithm>
+
+ParallelOperator::ParallelOperator(const std::vector<DataChunk>& Chunks, PipelineFactory Factory, ThreadPool& Pool, int WorkerCount, size_t MorselSize)
+    : SourceChunks(Chunks), Factory(std::move(Factory)), Pool(Pool), MorselSize(MorselSize)
+{
+    this->WorkerCount = std::clamp(WorkerCount, 1, Pool.Size());
+    this->bFinished = false;
+}
+
+void ParallelOperator::Execute()
+{
+    MorselQueue Queue(this->SourceChunks, this->WorkerCount, this->MorselSize);
+
+    // built up front on this thread, the factory doesn't have to be thread safe
+    std::vector<std::unique_ptr<Operator>> Pipelines;
+    for (int Worker = 0; Worker < this->WorkerCount; ++Worker)
+    {
+        Pipelines.push_back(this->Factory(std::make_unique<MorselScanOperator>(Queue, Worker)));
+        Pipelines.back()->ProducePartials();
+        // every copy allocates from the same pool, QueryMemoryPool is thread safe
+        Pipelines.back()->UseMemoryPool(this->Memory);
+    }
+
+    std::vector<std::vector<DataChunk>> WorkerResults(this->WorkerCount);
+    this->Pool.Run(this->WorkerCount, [&](int Worker)
+    {
+        DataChunk Chunk;
+        while ((Chunk = Pipelines[Worker]->Next()) != nullptr)
+        {
+            WorkerResults[Worker].push_back(Chunk);
+        }
+    });
+
+    std::vector<DataChunk> Partials;
+    for (std::vector<DataChunk>& Batches : WorkerResults)
+    {
+        Partials.insert(Partials.end(), Batches.begin(), Batches.end());
+    }
+
+    this->Results = Pipelines[0]->MergePartials(std::move(Partials));
+    this->bExecuted = true;
+}
+
+DataChunk ParallelOperator::Next()
+{
+    if (this->bFinished)
+    {
+        return nullptr;
+    }
+
+    if (!this->bExecuted)
+    {
+        this->Execute();
+    }
+
+    if (this->ResultIndex >= this->Results.size())
+    {
+        this->bFinished = true;
+        return nullptr;
+    }
+    return this->Results[this->ResultIndex++];
+}
+
+void ParallelOperator::Close()
+{
+    this->bFinished = true;
+    this->Results = std::vector<DataChunk>();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "Operator.h"
+#include <vector>
+#include <functional>
+
+class ThreadPool;
+
+// Morsel-driven parallel execution of a pipeline over an in-memory table.
+// Every worker gets its own copy of the pipeline on top of a MorselScanOperator, the copies pull morsels from one
+// shared MorselQueue (stealing from each other once their own share is done) and run without any synchronization.
+// When all of them are finished the root of the first copy merges the partial results (Operator::MergePartials),
+// the roots are told to return the state that merge needs up front (Operator::ProducePartials).
+// Batches of row-by-row pipelines come out grouped by worker, not in the order of the input chunks
+class ParallelOperator : public Operator
+{
+public:
+    // Puts the per-worker operators on top of the scan it is given and returns the root of that copy
+    using PipelineFactory = std::function<std::unique_ptr<Operator>(std::unique_ptr<Operator> Source)>;
+
+    // MorselSize is in chunks
+    ParallelOperator(const std::vector<DataChunk>& Chunks, PipelineFactory Factory, ThreadPool& Pool, int WorkerCount, size_t MorselSize = 1);
+
+    DataChunk Next() override;
+
+    // Drops the merged results that weren't returned yet
+    void Close() override;
+
+private:
+    const std::vector<DataChunk>& SourceChunks;
+    PipelineFactory Factory;
+    ThreadPool& Pool;
+    int WorkerCount;
+    size_t MorselSize;
+
+    bool bExecuted = false;
+    std::vector<DataChunk> Results;
+    size_t ResultIndex = 0;
+
+    void Execute();
+};
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "ProjectOperator.h"
+#include "ScanPredicate.h"
+#include "../Execution/ChunkBufferPool.h"
+
+ProjectOperator::ProjectOperator(std::unique_ptr<Operator> Child, std::vector<ProjectedColumn> Columns, ExecutionMode Mode)
+    : Operator(Mode), Program(std::move(Columns), ResolveExecutionMode(Mode))
+{
+    this->ChildOperator = std::move(Child);
+
+    std::vector<ColumnRef> Needed;
+    for (const ProjectedColumn& Projected : this->Program.GetColumns())
+    {
+        std::vector<ColumnRef> Refs = Projected.Value.Columns();
+        Needed.insert(Needed.end(), Refs.begin(), Refs.end());
+    }
+    this->ChildOperator->PushProjection(Needed);
+}
+
+DataChunk ProjectOperator::Next()
+{
+    return this->NextSelected().Materialize(this->Memory);
+}
+
+SelectedChunk ProjectOperator::NextSelected()
+{
+    if (!this->OutputBuffers)
+    {
+        this->OutputBuffers = ChunkBufferPool::Make(this->Memory);
+    }
+
+    SelectedChunk Input = this->ChildOperator->NextSelected();
+    if (Input.IsEnd())
+    {
+        return Input;
+    }
+
+    if (!this->FusedFilter)
+    {
+        // the child's selection stays valid until its next call, same as ours, so it can be handed on as is
+        return SelectedChunk(this->Program.Evaluate(*Input.Batch, this->Memory, this->OutputBuffers.get()), Input.Selection, Input.Count);
+    }
+
+    // the filter we took over, run on the batch it would have read
+    int64_t Length = Input.Batch->num_rows();
+    if ((int64_t)this->SelectionBuffer.size() < Length + 16)
+    {
+        this->SelectionBuffer.resize(Length + 16);
+    }
+    int64_t Count = this->FusedFilter->Apply(*Input.Batch, Input.Selection, Input.HasSelection() ? Input.Count : Length, this->SelectionBuffer.data(), this->CurrentMode);
+
+    // nothing passed, the expressions only run over zero rows so the consumer still sees the columns' types
+    DataChunk Source = Count > 0 ? Input.Batch : Input.Batch->Slice(0, 0);
+    return SelectedChunk(this->Program.Evaluate(*Source, this->Memory, this->OutputBuffers.get()), this->SelectionBuffer.data(), Count);
+}
+
+bool ProjectOperator::PushPredicate(const ScanPredicate& Predicate)
+{
+    const std::vector<ProjectedColumn>& Columns = this->Program.GetColumns();
+    for (size_t i = 0; i < Columns.size(); ++i)
+    {
+        bool bSameColumn = Predicate.ColumnName.empty() ? Predicate.ColumnIndex == (int)i : Predicate.ColumnName == Columns[i].Name;
+        if (!bSameColumn || Columns[i].Value.Type != Expression::Kind::COLUMN)
+        {
+            continue;
+        }
+
+        ScanPredicate Renamed = Predicate;
+        Renamed.ColumnName = Columns[i].Value.Column.Name;
+        Renamed.ColumnIndex = Columns[i].Value.Column.Index;
+        return this->ChildOperator->PushPredicate(Renamed);
+    }
+    return false;
+}
+
+bool ProjectOperator::PushProjection(const std::vector<ColumnRef>& Columns)
+{
+    return true;
+}
+
+bool ProjectOperator::FusePipelines()
+{
+    bool bFused = this->ChildOperator->FusePipelines();
+
+    ScanPredicate Predicate;
+    std::unique_ptr<Operator> FilterInput = this->ChildOperator->ReleaseFilterForFusion(ColumnRef(), Predicate);
+    if (FilterInput == nullptr)
+    {
+        return bFused;
+    }
+
+    this->ChildOperator = std::move(FilterInput);
+    this->FusedFilter = std::make_unique<CompiledFilter>(FilterExpression::Where(Predicate));
+    return true;
+}
+
+void ProjectOperator::Close()
+{
+    this->bFinished = true;
+    // the buffers still out in batches keep the recycler alive until they come back
+    this->OutputBuffers = nullptr;
+    this->ChildOperator->Close();
+}
+
+void ProjectOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
+}
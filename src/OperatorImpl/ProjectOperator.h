@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Operator.h"
+#include "Expression.h"
+#include <vector>
+
+class ChunkBufferPool;
+
+// SELECT price * qty AS revenue, ...: every output column is an Expression over the child's columns,
+// the batch we return has exactly the projected columns. The rows the child selected stay selected,
+// the expressions are evaluated over the whole batch (whole columns at a time is what the kernels are good at)
+// and the aggregate above only reads the selected rows.
+// Fused (FusePipelines), a filter right below us is taken over: its predicate runs here on the batch it would have
+// read, so filter and projection are one step over the source batch, and a batch without a single match only runs
+// the expression kernels over zero rows
+class ProjectOperator : public Operator
+{
+public:
+    ProjectOperator(std::unique_ptr<Operator> Child, std::vector<ProjectedColumn> Columns, ExecutionMode Mode);
+
+    // Compacts the selected rows, only used when the projection is the root of the plan
+    DataChunk Next() override;
+
+    SelectedChunk NextSelected() override;
+
+    // A predicate on an output column that is just an input column is handed down renamed, the rest stays with us
+    bool PushPredicate(const ScanPredicate& Predicate) override;
+
+    // Nothing above can read a column we didn't compute, the child was already told which ones our expressions read
+    bool PushProjection(const std::vector<ColumnRef>& Columns) override;
+
+    // Takes over the filter right below us (on any column), see NextSelected
+    bool FusePipelines() override;
+
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+private:
+    std::unique_ptr<Operator> ChildOperator;
+    CompiledProjection Program;
+
+    // The computed columns of the batches we return, they come back once the consumer drops a batch.
+    // Made on the first batch so it uses the pool of UseMemoryPool()
+    std::shared_ptr<ChunkBufferPool> OutputBuffers;
+
+    // set by FusePipelines: the predicate of the filter we took over, next to the projection
+    std::unique_ptr<CompiledFilter> FusedFilter;
+    std::vector<int32_t> SelectionBuffer;
+};
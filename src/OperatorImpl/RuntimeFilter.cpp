@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "RuntimeFilter.h"
+#include "Kernels/Hash.h"
+#include "Kernels/Predicates.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+std::shared_ptr<RuntimeFilter> RuntimeFilter::MakeBound(const std::string& ColumnName, bool bKeepBelow, bool bInclusive)
+{
+    // the bloom filter is never used, 0 keys gives it a single block
+    auto Filter = std::make_shared<RuntimeFilter>(ColumnName, 0);
+    Filter->Type = Kind::BOUND;
+    Filter->bKeepBelow = bKeepBelow;
+    Filter->bInclusive = bInclusive;
+    return Filter;
+}
+
+void RuntimeFilter::Insert(int64_t Key)
+{
+    this->Bloom.Insert(Kernels::HashInt64(Key));
+}
+
+void RuntimeFilter::SetBound(int64_t Value)
+{
+    // a stale bound read by a scan is only a looser one, no ordering with anything else is needed
+    this->Bound.store(Value, std::memory_order_relaxed);
+    this->bHasBound.store(true, std::memory_order_release);
+}
+
+// Branch free: the row index is always written and the output only advances when the key passed,
+// a bloom filter that drops ~half the rows would otherwise mispredict on every other row
+template <typename T, bool bAvx2>
+static int64_t ApplyBloom(const Kernels::BloomFilter& Bloom, const T* Keys, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection)
+{
+    int64_t OutputCount = 0;
+    for (int64_t i = 0; i < InCount; ++i)
+    {
+        int32_t Row = InSelection != nullptr ? InSelection[i] : (int32_t)i;
+        uint64_t Hash = Kernels::HashInt64((int64_t)Keys[Row]);
+        bool bPass = bAvx2 ? Bloom.MayContainAvx2(Hash) : Bloom.MayContain(Hash);
+        OutSelection[OutputCount] = Row;
+        OutputCount += bPass;
+    }
+    return OutputCount;
+}
+
+// With a selection the rows are checked one by one, branch free like ApplyBloom. Without one the compare kernels
+// turn the whole column into a bitmap first, a word of 64 rows that all fail is skipped with one test
+template <PredicateOp Op, typename T>
+static int64_t ApplyBound(const T* Keys, T Bound, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection, ExecutionMode Mode)
+{
+    Kernels::PredicateConstants<T> Constants;
+    Constants.Low = Bound;
+
+    int64_t OutputCount = 0;
+    if (InSelection != nullptr)
+    {
+        for (int64_t i = 0; i < InCount; ++i)
+        {
+            int32_t Row = InSelection[i];
+            OutSelection[OutputCount] = Row;
+            OutputCount += Kernels::Matches<Op>(Keys[Row], Constants);
+        }
+        return OutputCount;
+    }
+
+    std::vector<uint64_t> Bits((InCount + 63) / 64);
+    switch (Mode)
+    {
+    case ExecutionMode::AVX512:
+        Kernels::EvaluatePredicateAvx512<Op>(Keys, InCount, Constants, Bits.data());
+        break;
+    case ExecutionMode::AVX2:
+        Kernels::EvaluatePredicateAvx2<Op>(Keys, InCount, Constants, Bits.data());
+        break;
+    default:
+        Kernels::EvaluatePredicateScalar<Op>(Keys, InCount, Constants, Bits.data());
+        break;
+    }
+
+    for (int64_t Word = 0; Word < (int64_t)Bits.size(); ++Word)
+    {
+        uint64_t WordBits = Bits[Word];
+        if (WordBits == 0)
+        {
+            continue;
+        }
+
+        int64_t Begin = Word * 64;
+        int Count = (int)std::min<int64_t>(64, InCount - Begin);
+        for (int i = 0; i < Count; ++i)
+        {
+            OutSelection[OutputCount] = (int32_t)(Begin + i);
+            OutputCount += (WordBits >> i) & 1;
+        }
+    }
+    return OutputCount;
+}
+
+template <typename T>
+static int64_t ApplyBound(const RuntimeFilter& Filter, const T* Keys, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection, ExecutionMode Mode)
+{
+    // the owner reads the bound from this column, clamping only matters for a bound set by someone else
+    int64_t Wide = Filter.Bound.load(std::memory_order_relaxed);
+    T Bound = (T)std::clamp<int64_t>(Wide, std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+
+    if (Filter.bKeepBelow)
+    {
+        return Filter.bInclusive ? ApplyBound<PredicateOp::LESS_EQUAL>(Keys, Bound, InSelection, InCount, OutSelection, Mode)
+                                 : ApplyBound<PredicateOp::LESS>(Keys, Bound, InSelection, InCount, OutSelection, Mode);
+    }
+    return Filter.bInclusive ? ApplyBound<PredicateOp::GREATER_EQUAL>(Keys, Bound, InSelection, InCount, OutSelection, Mode)
+                             : ApplyBound<PredicateOp::GREATER>(Keys, Bound, InSelection, InCount, OutSelection, Mode);
+}
+
+int64_t RuntimeFilter::Apply(const arrow::RecordBatch& Batch, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection, ExecutionMode Mode) const
+{
+    int ColumnIndex = Batch.schema()->GetFieldIndex(this->ColumnName);
+    if (ColumnIndex < 0)
+    {
+        throw std::runtime_error("RuntimeFilter: no column named '" + this->ColumnName + "'");
+    }
+
+    const arrow::ArrayData& KeyData = *Batch.column_data(ColumnIndex);
+
+    if (this->Type == Kind::BOUND)
+    {
+        if (!this->bHasBound.load(std::memory_order_acquire))
+        {
+            for (int64_t i = 0; i < InCount; ++i)
+            {
+                OutSelection[i] = InSelection != nullptr ? InSelection[i] : (int32_t)i;
+            }
+            return InCount;
+        }
+
+        // null rows compare garbage, the owner only pushes a bound when nulls sort last, so dropping them is fine
+        switch (KeyData.type->id())
+        {
+        case arrow::Type::INT32:
+            return ApplyBound<int32_t>(*this, KeyData.GetValues<int32_t>(1), InSelection, InCount, OutSelection, Mode);
+        case arrow::Type::INT64:
+            return ApplyBound<int64_t>(*this, KeyData.GetValues<int64_t>(1), InSelection, InCount, OutSelection, Mode);
+        default:
+            throw std::runtime_error("RuntimeFilter: bound column '" + this->ColumnName + "' must be int32 or int64, got " + KeyData.type->ToString());
+        }
+    }
+
+    bool bAvx2 = Mode != ExecutionMode::SCALAR;
+
+    switch (KeyData.type->id())
+    {
+    case arrow::Type::INT32:
+        return bAvx2 ? ApplyBloom<int32_t, true>(this->Bloom, KeyData.GetValues<int32_t>(1), InSelection, InCount, OutSelection)
+                     : ApplyBloom<int32_t, false>(this->Bloom, KeyData.GetValues<int32_t>(1), InSelection, InCount, OutSelection);
+    case arrow::Type::INT64:
+        return bAvx2 ? ApplyBloom<int64_t, true>(this->Bloom, KeyData.GetValues<int64_t>(1), InSelection, InCount, OutSelection)
+                     : ApplyBloom<int64_t, false>(this->Bloom, KeyData.GetValues<int64_t>(1), InSelection, InCount, OutSelection);
+    default:
+        throw std::runtime_error("RuntimeFilter: key column '" + this->ColumnName + "' must be int32 or int64, got " + KeyData.type->ToString());
+    }
+}
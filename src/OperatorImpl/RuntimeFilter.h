@@ -0,0 +1,48 @@
+#pragma once
+#include "Operator.h"
+#include "Kernels/BloomFilter.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+// A filter built by one part of the plan and handed to another while the query runs.
+// The build side of a hash join knows every key that can match, so it pushes a bloom filter of them
+// into the probe side scan/filter (Operator::PushRuntimeFilter) and rows that can't match are dropped
+// there, before they are decoded further, compacted or hashed by the join.
+// A top-N pushes a bound instead: once it holds k rows, a row has to beat the k-th one to get in
+struct RuntimeFilter
+{
+    enum class Kind
+    {
+        BLOOM, // the key is one of the inserted keys
+        BOUND  // the key is on the right side of a bound that only gets tighter while the query runs
+    };
+
+    std::string ColumnName; // key column on the side that applies the filter
+    Kind Type = Kind::BLOOM;
+    Kernels::BloomFilter Bloom;
+
+    // BOUND: rows pass with Key < Bound (bKeepBelow) or Key > Bound, with bInclusive also Key == Bound.
+    // Every row passes until the owner sets the first bound. The owner moves it from its thread while scans read it on theirs
+    bool bKeepBelow = true;
+    bool bInclusive = false;
+    std::atomic<bool> bHasBound{ false };
+    std::atomic<int64_t> Bound{ 0 };
+
+    RuntimeFilter(const std::string& InColumnName, int64_t ExpectedKeys)
+        : ColumnName(InColumnName), Bloom(ExpectedKeys)
+    {
+    }
+
+    // A BOUND filter on an int32 / int64 column
+    static std::shared_ptr<RuntimeFilter> MakeBound(const std::string& ColumnName, bool bKeepBelow, bool bInclusive);
+
+    // Keys are hashed with Kernels::HashInt64 of the key widened to int64, the same as the join does
+    void Insert(int64_t Key);
+
+    void SetBound(int64_t Value);
+
+    // Writes the rows of InSelection (every row of Batch when InSelection is nullptr) whose key may pass
+    // to OutSelection and returns how many there are. OutSelection may point to InSelection
+    int64_t Apply(const arrow::RecordBatch& Batch, const int32_t* InSelection, int64_t InCount, int32_t* OutSelection, ExecutionMode Mode) const;
+};
@@ -2,36 +2,634 @@
 
 #include "ScanOperator.h"
 #include "parquet/arrow/reader.h"
+#include "parquet/properties.h"
+#include "parquet/file_reader.h"
+#include "parquet/metadata.h"
+#include "parquet/schema.h"
+#include "parquet/statistics.h"
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// batches the same size the sequential record batch reader hands out
+static constexpr int64_t DecodedBatchSize = 64 * 1024;
+
+// every arrow ipc file (and feather v2) starts with this
+static constexpr char IpcMagic[] = "ARROW1";
 
 // This function is used by the engine to physically interface with the file on the disk
 // It reads the file in chunks and returns DataChunks to the engine
-ScanOperator::ScanOperator(const std::string& Filepath)
+ScanOperator::ScanOperator(const std::string& Filepath, const ScanOptions& Options)
+    : Options(Options)
+{
+    this->Open(Filepath, Options.bMemoryMap);
+
+    arrow::Result<std::shared_ptr<arrow::Buffer>> MagicResult = this->InFile->ReadAt(0, sizeof(IpcMagic) - 1);
+    PARQUET_THROW_NOT_OK(MagicResult.status());
+    const std::shared_ptr<arrow::Buffer>& Magic = MagicResult.ValueOrDie();
+    bool bIpc = Magic->size() == sizeof(IpcMagic) - 1 && std::memcmp(Magic->data(), IpcMagic, sizeof(IpcMagic) - 1) == 0;
+
+    if (bIpc)
+    {
+        // reading ipc through a buffered file would copy every batch, the whole point of the format is not to
+        if (this->MappedRegion == nullptr)
+        {
+            this->Open(Filepath, true);
+        }
+
+        arrow::Result<std::shared_ptr<arrow::ipc::RecordBatchFileReader>> IpcResult = arrow::ipc::RecordBatchFileReader::Open(this->InFile);
+        PARQUET_THROW_NOT_OK(IpcResult.status());
+        this->IpcReader = IpcResult.ValueOrDie();
+        this->FileSchema = this->IpcReader->schema();
+        return;
+    }
+
+    std::unique_ptr<parquet::ParquetFileReader> ParquetReader = parquet::ParquetFileReader::Open(this->InFile);
+
+    // the files are flat, so the leaf column index is the arrow field index the reader properties want
+    this->ReaderProperties = std::make_unique<parquet::ArrowReaderProperties>(parquet::default_arrow_reader_properties());
+    for (const std::string& Name : this->Options.DictionaryColumns)
+    {
+        int Leaf = ParquetReader->metadata()->schema()->ColumnIndex(Name);
+        if (Leaf < 0)
+        {
+            throw std::runtime_error("ScanOperator: dictionary column '" + Name + "' is not in the file");
+        }
+        this->ReaderProperties->set_read_dictionary(Leaf, true);
+    }
+
+    PARQUET_THROW_NOT_OK(parquet::arrow::FileReader::Make(arrow::default_memory_pool(), std::move(ParquetReader), *this->ReaderProperties, &this->ArrowReader));
+    PARQUET_THROW_NOT_OK(this->ArrowReader->GetSchema(&this->FileSchema));
+
+    std::shared_ptr<parquet::FileMetaData> Metadata = this->ArrowReader->parquet_reader()->metadata();
+    for (int RowGroup = 0; RowGroup < Metadata->num_row_groups(); ++RowGroup)
+    {
+        this->RowGroups.push_back(RowGroup);
+        this->RowGroupBytes.push_back(Metadata->RowGroup(RowGroup)->total_byte_size());
+        this->RowGroupRows.push_back(Metadata->RowGroup(RowGroup)->num_rows());
+    }
+}
+
+void ScanOperator::Open(const std::string& Filepath, bool bMemoryMap)
 {
-    arrow::Result<std::shared_ptr<arrow::io::ReadableFile>> InFileResult = arrow::io::ReadableFile::Open(Filepath);
+    this->MappedRegion = nullptr;
 
-    PARQUET_THROW_NOT_OK(InFileResult.status());
+    if (!bMemoryMap)
+    {
+        arrow::Result<std::shared_ptr<arrow::io::ReadableFile>> InFileResult = arrow::io::ReadableFile::Open(Filepath);
+        PARQUET_THROW_NOT_OK(InFileResult.status());
+        this->InFile = InFileResult.ValueOrDie();
+        return;
+    }
 
-    std::shared_ptr<arrow::io::ReadableFile> InFile = InFileResult.ValueOrDie();
+    arrow::Result<std::shared_ptr<arrow::io::MemoryMappedFile>> MappedResult = arrow::io::MemoryMappedFile::Open(Filepath, arrow::io::FileMode::READ);
+    PARQUET_THROW_NOT_OK(MappedResult.status());
+    std::shared_ptr<arrow::io::MemoryMappedFile> Mapped = MappedResult.ValueOrDie();
+    this->InFile = Mapped;
 
-    arrow::Result<std::unique_ptr<parquet::arrow::FileReader>> ReaderResult = parquet::arrow::OpenFile(InFile, arrow::default_memory_pool());
-    
-    PARQUET_THROW_NOT_OK(ReaderResult.status());
-    
-    this->ArrowReader = std::move(ReaderResult.ValueOrDie());
+    // ReadAt on a mapped file is a slice of the mapping, this is where the pages live
+    arrow::Result<int64_t> SizeResult = Mapped->GetSize();
+    PARQUET_THROW_NOT_OK(SizeResult.status());
+    arrow::Result<std::shared_ptr<arrow::Buffer>> RegionResult = Mapped->ReadAt(0, SizeResult.ValueOrDie());
+    PARQUET_THROW_NOT_OK(RegionResult.status());
+    this->MappedRegion = RegionResult.ValueOrDie();
 
-    PARQUET_THROW_NOT_OK(
-        this->ArrowReader->GetRecordBatchReader(&this->BatchReader)
-    );
+#ifndef _WIN32
+    // scans run front to back, so the kernel can read ahead aggressively and drop pages behind us early.
+    // Windows has no such hint for mapped views, the WillNeed calls below are all it gets
+    if (this->MappedRegion->size() > 0)
+    {
+        madvise((void*)this->MappedRegion->data(), (size_t)this->MappedRegion->size(), MADV_SEQUENTIAL);
+    }
+#endif
 }
 
 ScanOperator::~ScanOperator()
 {
+    this->StopDecoding();
+}
+
+// Workers finish the row group they are decoding (parquet can't be interrupted in the middle of one) and take no new one
+void ScanOperator::StopDecoding()
+{
+    {
+        std::lock_guard<std::mutex> Lock(this->QueueLock);
+        this->bStopping = true;
+    }
+    this->BudgetFreed.notify_all();
+
+    for (std::thread& Worker : this->DecodeWorkers)
+    {
+        Worker.join();
+    }
+    this->DecodeWorkers.clear();
+}
+
+void ScanOperator::Close()
+{
+    this->bFinished = true;
+    this->StopDecoding();
+
+    // what was read ahead is never handed out, the readers and the file go with it.
+    // Batches already returned keep their own references (ipc batches to the mapping), they stay valid
+    this->Decoded.clear();
+    this->PendingBatches = std::vector<DataChunk>();
+    this->BatchReader = nullptr;
+    this->IpcReader = nullptr;
+    this->ArrowReader = nullptr;
+    this->MappedRegion = nullptr;
+    if (this->InFile)
+    {
+        // nothing is read any more, an error closing it doesn't change the result
+        arrow::Status Closed = this->InFile->Close();
+        (void)Closed;
+        this->InFile = nullptr;
+    }
+}
+
+// Nothing is read before the first Next(), so the plan can still be changed after the scan was constructed
+void ScanOperator::Start()
+{
+    this->bStarted = true;
+    this->PruneRowGroups();
+    this->ResolveProjection();
+
+    if (this->IpcReader)
+    {
+        return;
+    }
+
+    this->AdviseAhead(0);
+
+    if (this->Options.DecodeThreads <= 1)
+    {
+        // the footer was read with the default pool when the file was opened, the decoded columns come from the query's
+        if (this->Memory != arrow::default_memory_pool())
+        {
+            std::unique_ptr<parquet::ParquetFileReader> ParquetReader = parquet::ParquetFileReader::Open(
+                this->InFile, parquet::ReaderProperties(this->Memory), this->ArrowReader->parquet_reader()->metadata());
+            std::unique_ptr<parquet::arrow::FileReader> Reader;
+            PARQUET_THROW_NOT_OK(parquet::arrow::FileReader::Make(this->Memory, std::move(ParquetReader), *this->ReaderProperties, &Reader));
+            this->ArrowReader = std::move(Reader);
+        }
+
+        PARQUET_THROW_NOT_OK(
+            this->ReadColumns.empty() ?
+                this->ArrowReader->GetRecordBatchReader(this->RowGroups, &this->BatchReader) :
+                this->ArrowReader->GetRecordBatchReader(this->RowGroups, this->ReadColumns, &this->BatchReader)
+        );
+        return;
+    }
+
+    int WorkerCount = std::min<int>(this->Options.DecodeThreads, std::max<int>((int)this->RowGroups.size(), 1));
+    for (int Worker = 0; Worker < WorkerCount; ++Worker)
+    {
+        this->DecodeWorkers.emplace_back(&ScanOperator::DecodeLoop, this);
+    }
+}
+
+bool ScanOperator::PushPredicate(const ScanPredicate& Predicate)
+{
+    if (this->bStarted)
+    {
+        return false;
+    }
+
+    this->Options.Predicates.push_back(Predicate);
+    return true;
+}
+
+bool ScanOperator::PushProjection(const std::vector<ColumnRef>& Columns)
+{
+    if (this->bStarted)
+    {
+        return false;
+    }
+
+    this->PushedColumns.insert(this->PushedColumns.end(), Columns.begin(), Columns.end());
+    this->bProjected = true;
+    return true;
+}
+
+// min/max of an int32/int64 column chunk, false if the writer didn't store them.
+// Unsigned columns are stored in the same physical types, their bits have to be read back as unsigned
+static bool ReadMinMax(const parquet::Statistics& Stats, int64_t& OutMin, int64_t& OutMax)
+{
+    if (!Stats.HasMinMax())
+    {
+        return false;
+    }
+
+    bool bUnsigned = Stats.descr()->sort_order() == parquet::SortOrder::UNSIGNED;
+    switch (Stats.physical_type())
+    {
+    case parquet::Type::INT32:
+    {
+        const auto& Typed = static_cast<const parquet::Int32Statistics&>(Stats);
+        OutMin = bUnsigned ? (int64_t)(uint32_t)Typed.min() : Typed.min();
+        OutMax = bUnsigned ? (int64_t)(uint32_t)Typed.max() : Typed.max();
+        return true;
+    }
+    case parquet::Type::INT64:
+    {
+        const auto& Typed = static_cast<const parquet::Int64Statistics&>(Stats);
+        if (bUnsigned && (uint64_t)Typed.max() > (uint64_t)INT64_MAX)
+        {
+            return false; // doesn't fit the int64 the predicates use, just read it
+        }
+        OutMin = Typed.min();
+        OutMax = Typed.max();
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Drops every row group where some predicate can't be true for any row, only the footer is looked at
+void ScanOperator::PruneRowGroups()
+{
+    if (this->Options.Predicates.empty() || this->IpcReader)
+    {
+        return;
+    }
+
+    std::shared_ptr<parquet::FileMetaData> Metadata = this->ArrowReader->parquet_reader()->metadata();
+    const parquet::SchemaDescriptor* Schema = Metadata->schema();
+
+    // the files are flat, so the leaf column index is the same as the arrow field index
+    std::vector<int> LeafColumns;
+    for (const ScanPredicate& Predicate : this->Options.Predicates)
+    {
+        int Leaf = Predicate.ColumnName.empty() ? Predicate.ColumnIndex : Schema->ColumnIndex(Predicate.ColumnName);
+        if (Leaf < 0 || Leaf >= Schema->num_columns())
+        {
+            throw std::runtime_error("ScanOperator: predicate column '" +
+                (Predicate.ColumnName.empty() ? std::to_string(Predicate.ColumnIndex) : Predicate.ColumnName) + "' is not in the file");
+        }
+        LeafColumns.push_back(Leaf);
+    }
+
+    std::vector<int> KeptRowGroups;
+    std::vector<int64_t> KeptBytes;
+    std::vector<int64_t> KeptRows;
+    for (size_t i = 0; i < this->RowGroups.size(); ++i)
+    {
+        std::unique_ptr<parquet::RowGroupMetaData> RowGroup = Metadata->RowGroup(this->RowGroups[i]);
+
+        bool bMayMatch = true;
+        for (size_t p = 0; p < LeafColumns.size() && bMayMatch; ++p)
+        {
+            std::unique_ptr<parquet::ColumnChunkMetaData> Chunk = RowGroup->ColumnChunk(LeafColumns[p]);
+            std::shared_ptr<parquet::Statistics> Stats = Chunk->is_stats_set() ? Chunk->statistics() : nullptr;
+            if (Stats == nullptr)
+            {
+                continue;
+            }
+
+            // a comparison with NULL is never true, so a row group of only nulls has nothing for any predicate
+            if (Stats->HasNullCount() && Stats->null_count() == RowGroup->num_rows())
+            {
+                bMayMatch = false;
+                break;
+            }
+
+            int64_t Min, Max;
+            if (ReadMinMax(*Stats, Min, Max))
+            {
+                bMayMatch = this->Options.Predicates[p].MayMatch(Min, Max);
+            }
+        }
+
+        if (bMayMatch)
+        {
+            KeptRowGroups.push_back(this->RowGroups[i]);
+            KeptBytes.push_back(this->RowGroupBytes[i]);
+            KeptRows.push_back(this->RowGroupRows[i]);
+        }
+    }
 
+    this->NumPrunedRowGroups = (int)(this->RowGroups.size() - KeptRowGroups.size());
+    this->RowGroups = std::move(KeptRowGroups);
+    this->RowGroupBytes = std::move(KeptBytes);
+    this->RowGroupRows = std::move(KeptRows);
+}
+
+// Turns the requested columns into the leaf column indices the reader takes.
+// The files are flat, so the arrow field index is the leaf column index
+void ScanOperator::ResolveProjection()
+{
+    if (!this->bProjected && this->Options.Columns.empty())
+    {
+        return;
+    }
+
+    const std::shared_ptr<arrow::Schema>& Schema = this->FileSchema;
+
+    std::vector<bool> bKeep(Schema->num_fields(), false);
+    for (const std::string& Name : this->Options.Columns)
+    {
+        int Index = Schema->GetFieldIndex(Name);
+        if (Index < 0)
+        {
+            throw std::runtime_error("ScanOperator: no column named '" + Name + "'");
+        }
+        bKeep[Index] = true;
+    }
+
+    for (const ColumnRef& Ref : this->PushedColumns)
+    {
+        if (Ref.Name.empty())
+        {
+            for (int Index = 0; Index <= Ref.Index && Index < Schema->num_fields(); ++Index)
+            {
+                bKeep[Index] = true;
+            }
+        }
+        else
+        {
+            int Index = Schema->GetFieldIndex(Ref.Name);
+            if (Index >= 0)
+            {
+                bKeep[Index] = true;
+            }
+        }
+    }
+
+    for (int Index = 0; Index < Schema->num_fields(); ++Index)
+    {
+        if (bKeep[Index])
+        {
+            this->ReadColumns.push_back(Index);
+        }
+    }
+
+    // COUNT(*) needs no column but still needs the row counts, the first column is read for them
+    if (this->ReadColumns.empty() && Schema->num_fields() > 0)
+    {
+        this->ReadColumns.push_back(0);
+    }
+}
+
+void ScanOperator::DecodeLoop()
+{
+    try
+    {
+        // FileReader isn't thread safe, every worker gets its own on top of the same file (ReadAt is) and the already parsed footer
+        std::unique_ptr<parquet::ParquetFileReader> ParquetReader = parquet::ParquetFileReader::Open(
+            this->InFile, parquet::ReaderProperties(this->Memory), this->ArrowReader->parquet_reader()->metadata());
+        std::unique_ptr<parquet::arrow::FileReader> Reader;
+        PARQUET_THROW_NOT_OK(parquet::arrow::FileReader::Make(this->Memory, std::move(ParquetReader), *this->ReaderProperties, &Reader));
+
+        while (true)
+        {
+            size_t Position;
+            int64_t Bytes;
+            {
+                std::unique_lock<std::mutex> Lock(this->QueueLock);
+                // an empty queue always lets the next row group in, otherwise one that is bigger than the cap would never be read
+                this->BudgetFreed.wait(Lock, [&]()
+                {
+                    return this->bStopping || this->NextToDecode >= this->RowGroups.size() || this->BytesInFlight == 0 ||
+                        this->BytesInFlight + this->RowGroupBytes[this->NextToDecode] <= this->Options.ReadaheadBytes;
+                });
+
+                if (this->bStopping || this->NextToDecode >= this->RowGroups.size())
+                {
+                    return;
+                }
+
+                Position = this->NextToDecode++;
+                Bytes = this->RowGroupBytes[Position];
+                this->BytesInFlight += Bytes;
+                this->AdviseAhead(Position);
+            }
+
+            // decompression and decoding, the part that runs in parallel
+            std::shared_ptr<arrow::Table> Table;
+            PARQUET_THROW_NOT_OK(this->ReadColumns.empty() ?
+                Reader->ReadRowGroup(this->RowGroups[Position], &Table) :
+                Reader->ReadRowGroup(this->RowGroups[Position], this->ReadColumns, &Table));
+
+            DecodedRowGroup Group;
+            Group.Bytes = Bytes;
+
+            arrow::TableBatchReader TableReader(*Table);
+            TableReader.set_chunksize(DecodedBatchSize);
+            std::shared_ptr<arrow::RecordBatch> Batch;
+            while (true)
+            {
+                PARQUET_THROW_NOT_OK(TableReader.ReadNext(&Batch));
+                if (Batch == nullptr)
+                {
+                    break;
+                }
+                Group.Batches.push_back(Batch);
+            }
+
+            {
+                std::lock_guard<std::mutex> Lock(this->QueueLock);
+                this->Decoded.emplace(Position, std::move(Group));
+            }
+            this->ResultReady.notify_all();
+        }
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> Lock(this->QueueLock);
+            if (!this->DecodeError)
+            {
+                this->DecodeError = std::current_exception();
+            }
+        }
+        this->ResultReady.notify_all();
+    }
+}
+
+DataChunk ScanOperator::NextDecoded()
+{
+    while (true)
+    {
+        if (this->PendingIndex < this->PendingBatches.size())
+        {
+            return this->PendingBatches[this->PendingIndex++];
+        }
+
+        DecodedRowGroup Group;
+        {
+            std::unique_lock<std::mutex> Lock(this->QueueLock);
+            if (this->EmittedRowGroups >= this->RowGroups.size())
+            {
+                return nullptr;
+            }
+
+            // ordered: row groups are emitted by position, so the next one is at position EmittedRowGroups
+            this->ResultReady.wait(Lock, [&]()
+            {
+                return this->DecodeError || (this->Options.bOrdered ? this->Decoded.count(this->EmittedRowGroups) != 0 : !this->Decoded.empty());
+            });
+
+            if (this->DecodeError)
+            {
+                std::rethrow_exception(this->DecodeError);
+            }
+
+            auto It = this->Options.bOrdered ? this->Decoded.find(this->EmittedRowGroups) : this->Decoded.begin();
+            Group = std::move(It->second);
+            this->Decoded.erase(It);
+            ++this->EmittedRowGroups;
+            // the batches belong to the consumer from here on, the readahead can go on
+            this->BytesInFlight -= Group.Bytes;
+        }
+        this->BudgetFreed.notify_all();
+
+        this->PendingBatches = std::move(Group.Batches);
+        this->PendingIndex = 0;
+    }
 }
 
 DataChunk ScanOperator::Next()
 {
+    if (this->bFinished)
+    {
+        return nullptr;
+    }
+
+    if (!this->bStarted)
+    {
+        this->Start();
+    }
+
+    if (this->IpcReader)
+    {
+        return this->NextIpc();
+    }
+
+    if (!this->DecodeWorkers.empty())
+    {
+        return this->NextDecoded();
+    }
+
     std::shared_ptr<arrow::RecordBatch> Batch;
     PARQUET_THROW_NOT_OK(this->BatchReader->ReadNext(&Batch));
+
+    // the reader doesn't say when it moves on to the next row group, the row counts from the footer do
+    if (Batch != nullptr)
+    {
+        this->RowsIntoRowGroup += Batch->num_rows();
+        while (this->CurrentRowGroup < this->RowGroupRows.size() && this->RowsIntoRowGroup >= this->RowGroupRows[this->CurrentRowGroup])
+        {
+            this->RowsIntoRowGroup -= this->RowGroupRows[this->CurrentRowGroup];
+            ++this->CurrentRowGroup;
+            this->AdviseAhead(this->CurrentRowGroup);
+        }
+    }
+    return Batch;
+}
+
+// The batches reference the mapping directly, as long as the file was written uncompressed
+DataChunk ScanOperator::NextIpc()
+{
+    int NumBatches = this->IpcReader->num_record_batches();
+    if (this->IpcBatch >= NumBatches)
+    {
+        return nullptr;
+    }
+
+    // the footer doesn't hand out where a batch starts, but batches are written in order,
+    // so batch i sits about i / NumBatches into the file. Good enough for a hint
+    int64_t FileSize = this->MappedRegion->size();
+    int64_t From = FileSize * this->IpcBatch / NumBatches;
+    if (From + this->Options.ReadaheadBytes / 2 >= this->IpcAdvisedBytes)
+    {
+        int64_t Begin = std::max(From, this->IpcAdvisedBytes);
+        int64_t End = std::min(FileSize, From + this->Options.ReadaheadBytes);
+        if (End > Begin)
+        {
+            // only a hint, a failure doesn't change what we read
+            arrow::Status Hint = this->InFile->WillNeed({ { Begin, End - Begin } });
+            (void)Hint;
+        }
+        this->IpcAdvisedBytes = End;
+    }
+
+    arrow::Result<std::shared_ptr<arrow::RecordBatch>> BatchResult = this->IpcReader->ReadRecordBatch(this->IpcBatch++);
+    PARQUET_THROW_NOT_OK(BatchResult.status());
+    std::shared_ptr<arrow::RecordBatch> Batch = BatchResult.ValueOrDie();
+
+    // unread columns cost nothing here, their pages are simply never touched
+    if (!this->ReadColumns.empty() && (int)this->ReadColumns.size() != Batch->num_columns())
+    {
+        arrow::Result<std::shared_ptr<arrow::RecordBatch>> Projected = Batch->SelectColumns(this->ReadColumns);
+        PARQUET_THROW_NOT_OK(Projected.status());
+        Batch = Projected.ValueOrDie();
+    }
     return Batch;
-}
\ No newline at end of file
+}
+
+// Column chunks of the row group at Position that will be read, as byte ranges of the file
+void ScanOperator::AppendRowGroupRanges(size_t Position, std::vector<arrow::io::ReadRange>& OutRanges) const
+{
+    std::unique_ptr<parquet::RowGroupMetaData> RowGroup = this->ArrowReader->parquet_reader()->metadata()->RowGroup(this->RowGroups[Position]);
+
+    auto AppendColumn = [&](int Column)
+    {
+        std::unique_ptr<parquet::ColumnChunkMetaData> Chunk = RowGroup->ColumnChunk(Column);
+        int64_t Start = Chunk->has_dictionary_page() ? Chunk->dictionary_page_offset() : Chunk->data_page_offset();
+        OutRanges.push_back({ Start, Chunk->total_compressed_size() });
+    };
+
+    if (this->ReadColumns.empty())
+    {
+        for (int Column = 0; Column < RowGroup->num_columns(); ++Column)
+        {
+            AppendColumn(Column);
+        }
+    }
+    else
+    {
+        for (int Column : this->ReadColumns)
+        {
+            AppendColumn(Column);
+        }
+    }
+}
+
+// Tells the OS to page in the row groups from Position on, as many as fit into the readahead budget.
+// Called whenever a row group starts being read, only mapped files get hints
+void ScanOperator::AdviseAhead(size_t Position)
+{
+    if (this->MappedRegion == nullptr || Position >= this->RowGroups.size())
+    {
+        return;
+    }
+
+    size_t End = Position;
+    int64_t WindowBytes = 0;
+    while (End < this->RowGroups.size() && (End == Position || WindowBytes + this->RowGroupBytes[End] <= this->Options.ReadaheadBytes))
+    {
+        WindowBytes += this->RowGroupBytes[End];
+        ++End;
+    }
+
+    std::vector<arrow::io::ReadRange> Ranges;
+    for (size_t Next = std::max(Position, this->AdvisedUpTo); Next < End; ++Next)
+    {
+        this->AppendRowGroupRanges(Next, Ranges);
+    }
+    this->AdvisedUpTo = std::max(this->AdvisedUpTo, End);
+
+    if (!Ranges.empty())
+    {
+        // only a hint, a failure doesn't change what we read
+        arrow::Status Hint = this->InFile->WillNeed(Ranges);
+        (void)Hint;
+    }
+}
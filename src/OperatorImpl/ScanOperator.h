@@ -1,19 +1,142 @@
 #pragma once
 #include "Operator.h"
+#include "ScanPredicate.h"
 #include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
-namespace parquet { namespace arrow { class FileReader; } }
-namespace arrow { class RecordBatchReader; }
+namespace parquet { class ArrowReaderProperties; namespace arrow { class FileReader; } }
+namespace arrow { class RecordBatchReader; class Schema; class Buffer; namespace io { class RandomAccessFile; struct ReadRange; } namespace ipc { class RecordBatchFileReader; } }
+
+struct ScanOptions
+{
+    // Threads that decode row groups in the background. 0 or 1 decodes on the thread calling Next()
+    int DecodeThreads = 0;
+
+    // Cap on row groups that are being decoded or wait to be returned (uncompressed size from the file footer).
+    // A single row group bigger than this is still read, just never together with another one
+    int64_t ReadaheadBytes = 256ll * 1024 * 1024;
+
+    // true returns the batches in file order. false returns every row group as soon as it is decoded,
+    // which keeps the consumer busy when one row group takes much longer than the others
+    bool bOrdered = true;
+
+    // All of them have to hold for a row (AND). Row groups whose min/max statistics rule one of them out are never read.
+    // The rows of the remaining row groups are returned unfiltered, a FilterOperator above still decides row by row.
+    // FilterOperator adds its own predicate here through PushPredicate, so this is only needed for predicates nothing else evaluates
+    std::vector<ScanPredicate> Predicates;
+
+    // Columns to read, in file order whatever order they are given in. Empty reads every column, unless the plan above
+    // pushes its own projection (see PushProjection), then only the columns from both are read
+    std::vector<std::string> Columns;
+
+    // Maps the file instead of reading it. Parquet still decodes into new arrays but skips the read calls and the copy
+    // into read buffers, the OS is told which row groups come next so the pages are there before the decoder is.
+    // Arrow IPC / Feather v2 files are always mapped, their batches point straight into the mapping without any copy
+    bool bMemoryMap = false;
+
+    // String columns to hand out dictionary encoded (arrow::DictionaryArray, int32 codes) instead of decoding every value.
+    // Parquet keeps the dictionary of a column chunk as it is, so a row costs 4 bytes however long its string is.
+    // FilterOperator evaluates predicates once per dictionary and GROUP BY groups by the codes, see FilterExpression.h
+    // and HashAggregateOperator.h. Only BYTE_ARRAY columns can be read like this, other columns are decoded as usual.
+    // Arrow IPC files keep whatever encoding they were written with
+    std::vector<std::string> DictionaryColumns;
+};
 
 class ScanOperator : public Operator
 {
 public:
-    ScanOperator(const std::string& Filepath); // parquet file path
-    ~ScanOperator(); 
+    ScanOperator(const std::string& Filepath, const ScanOptions& Options = ScanOptions()); // parquet or arrow ipc file path
+    ~ScanOperator();
 
 	DataChunk Next() override;
 
+    // Accepted until the first Next(), int32 and int64 columns can prune row groups, predicates on other columns are kept but never prune
+    bool PushPredicate(const ScanPredicate& Predicate) override;
+
+    // Columns by name are read when the file has them (the operator that wanted them reports missing ones),
+    // a column by position keeps every column up to it so the positions in the batches stay the same
+    bool PushProjection(const std::vector<ColumnRef>& Columns) override;
+
+    // Joins the decode threads, drops the row groups read ahead and closes the file
+    void Close() override;
+
+    // row groups skipped because of the predicates, known after the first Next()
+    int PrunedRowGroups() const { return this->NumPrunedRowGroups; }
+
 private:
+    ScanOptions Options;
+    std::shared_ptr<arrow::io::RandomAccessFile> InFile;
     std::unique_ptr<parquet::arrow::FileReader> ArrowReader;
+    std::unique_ptr<parquet::ArrowReaderProperties> ReaderProperties; // which columns stay dictionary encoded
     std::shared_ptr<arrow::RecordBatchReader> BatchReader;
-};
\ No newline at end of file
+    std::shared_ptr<arrow::Schema> FileSchema;
+
+    bool bStarted = false;
+
+    // the whole file when it's memory mapped, nullptr otherwise
+    std::shared_ptr<arrow::Buffer> MappedRegion;
+
+    // Arrow IPC input, set instead of ArrowReader. Predicates are ignored (no statistics), row groups are unused
+    std::shared_ptr<arrow::ipc::RecordBatchFileReader> IpcReader;
+    int IpcBatch = 0;
+    int64_t IpcAdvisedBytes = 0;
+
+    // Row groups that will be read, in file order, and their uncompressed sizes
+    std::vector<int> RowGroups;
+    std::vector<int64_t> RowGroupBytes;
+    std::vector<int64_t> RowGroupRows;
+    int NumPrunedRowGroups = 0;
+
+    // Read ahead hints on mapped parquet files: row groups before AdvisedUpTo (by position) were already hinted.
+    // The sequential path tells row groups apart by counting the rows it returned
+    size_t AdvisedUpTo = 0;
+    size_t CurrentRowGroup = 0;
+    int64_t RowsIntoRowGroup = 0;
+
+    // what the plan pushed down, bProjected stays false when nobody did and every column is read
+    std::vector<ColumnRef> PushedColumns;
+    bool bProjected = false;
+
+    // leaf columns passed to the reader, resolved by Start(). Empty reads all of them
+    std::vector<int> ReadColumns;
+
+    // Background decoding. Workers take the next row group (by position in RowGroups) once the readahead budget allows it,
+    // decode it with their own reader and put the batches into Decoded. Next() takes them out again
+    struct DecodedRowGroup
+    {
+        int64_t Bytes = 0;
+        std::vector<DataChunk> Batches;
+    };
+
+    std::vector<std::thread> DecodeWorkers;
+    std::mutex QueueLock;
+    std::condition_variable ResultReady;
+    std::condition_variable BudgetFreed;
+    std::map<size_t, DecodedRowGroup> Decoded; // by position in RowGroups
+    size_t NextToDecode = 0;
+    size_t EmittedRowGroups = 0;
+    int64_t BytesInFlight = 0;
+    bool bStopping = false;
+    std::exception_ptr DecodeError;
+
+    // batches of the row group Next() is currently handing out
+    std::vector<DataChunk> PendingBatches;
+    size_t PendingIndex = 0;
+
+    void Open(const std::string& Filepath, bool bMemoryMap);
+    void Start();
+    void PruneRowGroups();
+    void ResolveProjection();
+    void DecodeLoop();
+    void StopDecoding();
+    DataChunk NextDecoded();
+    DataChunk NextIpc();
+
+    void AdviseAhead(size_t Position);
+    void AppendRowGroupRanges(size_t Position, std::vector<arrow::io::ReadRange>& OutRanges) const;
+};
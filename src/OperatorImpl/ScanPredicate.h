@@ -0,0 +1,124 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+enum class PredicateOp
+{
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    BETWEEN, // Low <= x <= High
+    IN       // x is one of Values
+};
+
+// A simple predicate on one integer column that a scan can check against min/max statistics.
+// It only decides which parts of the file are skipped, the rows that are read still go through the real filter,
+// so a scan is always allowed to ignore it.
+// FilterOperator evaluates the same predicates row by row, as the leaves of a FilterExpression.
+// A text predicate (CompareText, BetweenText, InText) is for string columns, plain or dictionary encoded, and compares bytes.
+// It never prunes anything
+struct ScanPredicate
+{
+    std::string ColumnName;
+    int ColumnIndex = -1; // used when ColumnName is empty
+
+    PredicateOp Op = PredicateOp::EQUAL;
+    int64_t Low = 0;  // the constant of a comparison, the lower bound of BETWEEN
+    int64_t High = 0; // the upper bound of BETWEEN
+    std::vector<int64_t> Values; // IN list, sorted
+
+    // text predicates take their constants from here instead: [Low] for a comparison, [Low, High] for BETWEEN, the sorted IN list
+    bool bText = false;
+    std::vector<std::string> TextValues;
+
+    static ScanPredicate Compare(const std::string& Column, PredicateOp Op, int64_t Value)
+    {
+        ScanPredicate Predicate;
+        Predicate.ColumnName = Column;
+        Predicate.Op = Op;
+        Predicate.Low = Value;
+        return Predicate;
+    }
+
+    static ScanPredicate Between(const std::string& Column, int64_t Low, int64_t High)
+    {
+        ScanPredicate Predicate;
+        Predicate.ColumnName = Column;
+        Predicate.Op = PredicateOp::BETWEEN;
+        Predicate.Low = Low;
+        Predicate.High = High;
+        return Predicate;
+    }
+
+    static ScanPredicate In(const std::string& Column, std::vector<int64_t> Values)
+    {
+        ScanPredicate Predicate;
+        Predicate.ColumnName = Column;
+        Predicate.Op = PredicateOp::IN;
+        Predicate.Values = std::move(Values);
+        std::sort(Predicate.Values.begin(), Predicate.Values.end());
+        return Predicate;
+    }
+
+    static ScanPredicate CompareText(const std::string& Column, PredicateOp Op, std::string Value)
+    {
+        ScanPredicate Predicate;
+        Predicate.ColumnName = Column;
+        Predicate.Op = Op;
+        Predicate.bText = true;
+        Predicate.TextValues.push_back(std::move(Value));
+        return Predicate;
+    }
+
+    static ScanPredicate BetweenText(const std::string& Column, std::string Low, std::string High)
+    {
+        ScanPredicate Predicate;
+        Predicate.ColumnName = Column;
+        Predicate.Op = PredicateOp::BETWEEN;
+        Predicate.bText = true;
+        Predicate.TextValues = { std::move(Low), std::move(High) };
+        return Predicate;
+    }
+
+    static ScanPredicate InText(const std::string& Column, std::vector<std::string> Values)
+    {
+        ScanPredicate Predicate;
+        Predicate.ColumnName = Column;
+        Predicate.Op = PredicateOp::IN;
+        Predicate.bText = true;
+        Predicate.TextValues = std::move(Values);
+        std::sort(Predicate.TextValues.begin(), Predicate.TextValues.end());
+        return Predicate;
+    }
+
+    // false when no value in [Min, Max] can satisfy the predicate
+    bool MayMatch(int64_t Min, int64_t Max) const
+    {
+        if (this->bText)
+        {
+            return true; // Min / Max are integers, they say nothing about text
+        }
+
+        switch (this->Op)
+        {
+        case PredicateOp::EQUAL: return Min <= this->Low && this->Low <= Max;
+        case PredicateOp::NOT_EQUAL: return Min != this->Low || Max != this->Low;
+        case PredicateOp::LESS: return Min < this->Low;
+        case PredicateOp::LESS_EQUAL: return Min <= this->Low;
+        case PredicateOp::GREATER: return Max > this->Low;
+        case PredicateOp::GREATER_EQUAL: return Max >= this->Low;
+        case PredicateOp::BETWEEN: return Max >= this->Low && Min <= this->High;
+        case PredicateOp::IN:
+        {
+            auto First = std::lower_bound(this->Values.begin(), this->Values.end(), Min);
+            return First != this->Values.end() && *First <= Max;
+        }
+        }
+        return true;
+    }
+};
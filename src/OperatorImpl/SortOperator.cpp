@@ -0,0 +1,731 @@
+#include "pch.h"
+#include "SortOperator.h"
+#include "MemoryScanOperator.h"
+#include "Kernels/TypedKernels.h"
+#include "Kernels/Validity.h"
+#include "../Execution/ThreadPool.h"
+#include <arrow/array/concatenate.h>
+#include <arrow/util/bit_util.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+// below this many rows per worker a slice isn't worth waking a thread for
+static constexpr int64_t MinRowsPerWorker = 64 * 1024;
+
+// strings go into the key with their first bytes, rows that are equal in there compare the whole strings
+static constexpr int MaxStringPrefix = 16;
+
+struct SortOperator::KeyEncoding
+{
+    enum class Kind
+    {
+        INTEGER,  // every integer, date and time type and booleans
+        FLOATING,
+        STRING
+    };
+
+    Kind Type = Kind::INTEGER;
+    std::shared_ptr<arrow::Array> Array;
+    const uint8_t* Validity = nullptr; // nullptr when the column has no nulls
+    bool bDescending = false;
+    bool bNullsFirst = false;
+
+    bool bNullFlag = false; // a byte in front of the value orders nulls against values
+    int ValueBytes = 0;
+    int Offset = 0;         // of the key's first byte in the normalized key
+
+    // INTEGER: a value's code is its distance to the smallest value (to the largest for DESC), so the key only needs
+    // as many bytes as Range does. Nulls take the code one past the values (or 0, and the values move up one)
+    uint64_t Min = 0;
+    uint64_t Range = 0;
+
+    // STRING: the prefix of two rows can be the same while the strings aren't (longer than the prefix, or zero bytes)
+    bool bNeedsTieBreak = false;
+
+    int Bytes() const { return (this->bNullFlag ? 1 : 0) + this->ValueBytes; }
+
+    bool IsValid(int64_t Row) const { return this->Validity == nullptr || Kernels::IsValid(this->Validity, this->Array->offset() + Row); }
+
+    uint8_t NullFlag(bool bValid) const { return bValid ? 1 : (this->bNullsFirst ? 0 : 2); }
+
+    std::string_view StringAt(int64_t Row) const
+    {
+        if (this->Array->type_id() == arrow::Type::LARGE_STRING || this->Array->type_id() == arrow::Type::LARGE_BINARY)
+        {
+            return static_cast<const arrow::LargeBinaryArray&>(*this->Array).GetView(Row);
+        }
+        return static_cast<const arrow::BinaryArray&>(*this->Array).GetView(Row);
+    }
+};
+
+static int BytesFor(uint64_t MaxCode)
+{
+    int Bytes = 0;
+    for (; MaxCode != 0; MaxCode >>= 8)
+    {
+        ++Bytes;
+    }
+    return Bytes;
+}
+
+static void WriteBigEndian(uint8_t* Out, uint64_t Code, int Bytes)
+{
+    for (int b = 0; b < Bytes; ++b)
+    {
+        Out[b] = (uint8_t)(Code >> (8 * (Bytes - 1 - b)));
+    }
+}
+
+static uint64_t ReadBigEndian(const uint8_t* In, int Bytes)
+{
+    uint64_t Code = 0;
+    for (int b = 0; b < Bytes; ++b)
+    {
+        Code = (Code << 8) | In[b];
+    }
+    return Code;
+}
+
+// Calls Visitor(Read) with Read(Row) giving Kernels::OrderedBits of the value of an integer or boolean column. False for other types
+template <typename VisitorType>
+static bool VisitIntegerReader(const arrow::Array& Column, VisitorType&& Visitor)
+{
+    if (Column.type_id() == arrow::Type::BOOL)
+    {
+        const uint8_t* Bits = Column.data()->buffers[1]->data();
+        const int64_t Offset = Column.offset();
+        Visitor([Bits, Offset](int64_t Row) { return (uint64_t)arrow::bit_util::GetBit(Bits, Offset + Row); });
+        return true;
+    }
+
+    bool bInteger = false;
+    Kernels::VisitNumericType(Column.type_id(), [&](auto Tag)
+    {
+        using T = typename decltype(Tag)::Type;
+        if constexpr (std::is_integral_v<T>)
+        {
+            const T* Values = Column.data()->GetValues<T>(1);
+            Visitor([Values](int64_t Row) { return Kernels::OrderedBits(Values[Row]); });
+            bInteger = true;
+        }
+    });
+    return bInteger;
+}
+
+template <typename ReaderType>
+static void EncodeIntegers(const SortOperator::KeyEncoding& Key, const ReaderType& Read, int64_t Begin, int64_t End, uint8_t* Keys, int Width)
+{
+    const bool bFoldedNulls = Key.Validity != nullptr && !Key.bNullFlag;
+    const uint64_t NullCode = Key.bNullsFirst ? 0 : Key.Range + 1;
+    const uint64_t ValueShift = bFoldedNulls && Key.bNullsFirst ? 1 : 0;
+
+    for (int64_t Row = Begin; Row < End; ++Row)
+    {
+        uint8_t* Out = Keys + Row * Width + Key.Offset;
+        bool bValid = Key.IsValid(Row);
+        if (Key.bNullFlag)
+        {
+            *Out++ = Key.NullFlag(bValid);
+        }
+
+        uint64_t Code = 0;
+        if (bValid)
+        {
+            uint64_t Distance = Read(Row) - Key.Min;
+            Code = (Key.bDescending ? Key.Range - Distance : Distance) + ValueShift;
+        }
+        else if (bFoldedNulls)
+        {
+            Code = NullCode;
+        }
+        WriteBigEndian(Out, Code, Key.ValueBytes);
+    }
+}
+
+// Kernels::OrderedBits of the value, all of its bytes. DESC flips every bit
+template <typename T>
+static void EncodeFloats(const SortOperator::KeyEncoding& Key, int64_t Begin, int64_t End, uint8_t* Keys, int Width)
+{
+    constexpr uint64_t Mask = sizeof(T) == 4 ? 0xFFFFFFFFull : ~0ull;
+    const T* Values = Key.Array->data()->GetValues<T>(1);
+
+    for (int64_t Row = Begin; Row < End; ++Row)
+    {
+        uint8_t* Out = Keys + Row * Width + Key.Offset;
+        bool bValid = Key.IsValid(Row);
+        if (Key.bNullFlag)
+        {
+            *Out++ = Key.NullFlag(bValid);
+        }
+
+        uint64_t Code = 0;
+        if (bValid)
+        {
+            Code = Kernels::OrderedBits(Values[Row]);
+            if (Key.bDescending) Code = ~Code & Mask;
+        }
+        WriteBigEndian(Out, Code, (int)sizeof(T));
+    }
+}
+
+// the first ValueBytes bytes, zero padded. DESC flips every byte, so a shorter string ends up behind the longer ones
+static void EncodeStrings(const SortOperator::KeyEncoding& Key, int64_t Begin, int64_t End, uint8_t* Keys, int Width)
+{
+    for (int64_t Row = Begin; Row < End; ++Row)
+    {
+        uint8_t* Out = Keys + Row * Width + Key.Offset;
+        bool bValid = Key.IsValid(Row);
+        if (Key.bNullFlag)
+        {
+            *Out++ = Key.NullFlag(bValid);
+        }
+
+        std::memset(Out, 0, Key.ValueBytes);
+        if (bValid)
+        {
+            std::string_view Value = Key.StringAt(Row);
+            size_t Length = std::min<size_t>(Value.size(), (size_t)Key.ValueBytes);
+            if (Length > 0)
+            {
+                std::memcpy(Out, Value.data(), Length);
+            }
+            if (Key.bDescending)
+            {
+                for (int b = 0; b < Key.ValueBytes; ++b)
+                {
+                    Out[b] = (uint8_t)~Out[b];
+                }
+            }
+        }
+    }
+}
+
+// Orders two rows whose normalized keys agree on the bytes before From. A string key that needs a tie break ends a
+// stretch of the key: its full strings decide before the bytes of the keys after it do
+static int CompareKeys(const std::vector<SortOperator::KeyEncoding>& Encodings, const uint8_t* Normalized, int Width, int From, uint32_t A, uint32_t B)
+{
+    const uint8_t* KeyA = Normalized + (int64_t)A * Width;
+    const uint8_t* KeyB = Normalized + (int64_t)B * Width;
+
+    for (const SortOperator::KeyEncoding& Key : Encodings)
+    {
+        if (!Key.bNeedsTieBreak)
+        {
+            continue;
+        }
+
+        int End = Key.Offset + Key.Bytes();
+        if (End > From)
+        {
+            int Result = std::memcmp(KeyA + From, KeyB + From, End - From);
+            if (Result != 0)
+            {
+                return Result;
+            }
+            From = End;
+        }
+
+        // the bytes are the same, so both are null or both start with the same prefix
+        if (Key.IsValid(A))
+        {
+            int Result = Key.StringAt(A).compare(Key.StringAt(B));
+            if (Result != 0)
+            {
+                return (Result < 0) != Key.bDescending ? -1 : 1;
+            }
+        }
+    }
+
+    return Width > From ? std::memcmp(KeyA + From, KeyB + From, Width - From) : 0;
+}
+
+SortOperator::SortOperator(std::unique_ptr<Operator> Child, std::vector<SortKey> Keys, ExecutionMode Mode, ThreadPool* Pool)
+    : Operator(Mode), Keys(std::move(Keys)), Pool(Pool)
+{
+    this->ChildOperator = std::move(Child);
+
+    if (this->Keys.empty())
+    {
+        throw std::runtime_error("SortOperator: needs at least one key column");
+    }
+}
+
+void SortOperator::RunWorkers(int WorkerCount, const std::function<void(int)>& Job) const
+{
+    if (WorkerCount <= 1 || this->Pool == nullptr)
+    {
+        Job(0);
+        return;
+    }
+    this->Pool->Run(WorkerCount, Job);
+}
+
+void SortOperator::ForEachSlice(int WorkerCount, int64_t Count, const std::function<void(int, int64_t, int64_t)>& Job) const
+{
+    this->RunWorkers(WorkerCount, [&](int Worker)
+    {
+        Job(Worker, Count * Worker / WorkerCount, Count * (Worker + 1) / WorkerCount);
+    });
+}
+
+int SortOperator::WorkerCountFor(int64_t Count) const
+{
+    if (this->Pool == nullptr)
+    {
+        return 1;
+    }
+    return (int)std::clamp<int64_t>(Count / MinRowsPerWorker, 1, this->Pool->Size());
+}
+
+template <typename Item>
+void SortOperator::RadixSort(std::vector<Item>& Items, std::vector<Item>& Scratch, int LowShift, int ByteCount) const
+{
+    const int64_t Count = (int64_t)Items.size();
+    if (Count <= 1 || ByteCount <= 0)
+    {
+        return;
+    }
+
+    Kernels::SmallSortKernel SmallSort = Kernels::SortSmallScalar;
+    if (this->CurrentMode == ExecutionMode::AVX512) SmallSort = Kernels::SortSmallAvx512;
+    else if (this->CurrentMode == ExecutionMode::AVX2) SmallSort = Kernels::SortSmallAvx2;
+
+    if (Count <= Kernels::SmallSortRows)
+    {
+        Kernels::SortBucket(Items.data(), Scratch.data(), Count, LowShift, ByteCount, SmallSort);
+        return;
+    }
+
+    // the digits of every key byte, counted per worker
+    const int WorkerCount = this->WorkerCountFor(Count);
+    std::vector<int64_t> Counts((size_t)WorkerCount * 8 * 256, 0);
+    auto CountsOf = [&](int Worker) { return (int64_t(*)[256])(Counts.data() + (size_t)Worker * 8 * 256); };
+
+    this->ForEachSlice(WorkerCount, Count, [&](int Worker, int64_t Begin, int64_t End)
+    {
+        Kernels::CountDigits(Items.data() + Begin, End - Begin, LowShift, ByteCount, CountsOf(Worker));
+    });
+
+    // the MSD pass goes over the highest byte that tells keys apart, the ones above it are the same in every key
+    int TopByte = -1;
+    for (int b = ByteCount - 1; b >= 0 && TopByte < 0; --b)
+    {
+        int64_t Total[256] = {};
+        for (int Worker = 0; Worker < WorkerCount; ++Worker)
+        {
+            for (int d = 0; d < 256; ++d)
+            {
+                Total[d] += CountsOf(Worker)[b][d];
+            }
+        }
+
+        if (!Kernels::IsConstantDigit(Total, Count))
+        {
+            TopByte = b;
+        }
+    }
+
+    if (TopByte < 0)
+    {
+        // every key is the same, the input order already is the sorted order
+        return;
+    }
+
+    // digit by digit and within a digit worker by worker, so the items of a bucket stay in input order
+    std::vector<int64_t> Offsets((size_t)WorkerCount * 256);
+    std::vector<int64_t> BucketBegin(257);
+    int64_t Offset = 0;
+    for (int d = 0; d < 256; ++d)
+    {
+        BucketBegin[d] = Offset;
+        for (int Worker = 0; Worker < WorkerCount; ++Worker)
+        {
+            Offsets[(size_t)Worker * 256 + d] = Offset;
+            Offset += CountsOf(Worker)[TopByte][d];
+        }
+    }
+    BucketBegin[256] = Count;
+
+    this->ForEachSlice(WorkerCount, Count, [&](int Worker, int64_t Begin, int64_t End)
+    {
+        Kernels::ScatterDigits(Items.data() + Begin, End - Begin, LowShift + 8 * TopByte, Offsets.data() + (size_t)Worker * 256, Scratch.data());
+    });
+
+    // the bytes below TopByte are left, each bucket on its own. Workers take the next bucket until there are none left
+    std::atomic<int> NextBucket{ 0 };
+    this->RunWorkers(WorkerCount, [&](int Worker)
+    {
+        for (int d = NextBucket++; d < 256; d = NextBucket++)
+        {
+            int64_t Begin = BucketBegin[d];
+            Kernels::SortBucket(Scratch.data() + Begin, Items.data() + Begin, BucketBegin[d + 1] - Begin, LowShift, TopByte, SmallSort);
+        }
+    });
+
+    Items.swap(Scratch);
+}
+
+void SortOperator::Sort()
+{
+    this->bSorted = true;
+
+    std::vector<DataChunk> Batches;
+    DataChunk Chunk;
+    while ((Chunk = this->ChildOperator->Next()) != nullptr)
+    {
+        if (Chunk->num_rows() > 0)
+        {
+            this->OutputRows = std::max<int64_t>(this->OutputRows, Chunk->num_rows());
+            Batches.push_back(Chunk);
+        }
+    }
+
+    if (Batches.empty())
+    {
+        return;
+    }
+
+    // one batch for the whole input, a row is then a plain int32 like in a selection vector
+    if (Batches.size() == 1)
+    {
+        this->SortedBatch = Batches[0];
+    }
+    else
+    {
+        std::shared_ptr<arrow::Schema> Schema = Batches[0]->schema();
+        std::vector<std::shared_ptr<arrow::Array>> Columns;
+        for (int c = 0; c < Schema->num_fields(); ++c)
+        {
+            arrow::ArrayVector Pieces;
+            for (const DataChunk& Batch : Batches)
+            {
+                Pieces.push_back(Batch->column(c));
+            }
+
+            arrow::Result<std::shared_ptr<arrow::Array>> ColumnResult = arrow::Concatenate(Pieces, this->Memory);
+            PARQUET_THROW_NOT_OK(ColumnResult.status());
+            Columns.push_back(ColumnResult.ValueOrDie());
+        }
+
+        int64_t TotalRows = Columns.empty() ? 0 : Columns[0]->length();
+        this->SortedBatch = arrow::RecordBatch::Make(Schema, TotalRows, std::move(Columns));
+    }
+    Batches.clear();
+
+    const int64_t RowCount = this->SortedBatch->num_rows();
+    if (RowCount > INT32_MAX)
+    {
+        throw std::runtime_error("SortOperator: the input has more rows than an int32 row index can address");
+    }
+
+    const int WorkerCount = this->WorkerCountFor(RowCount);
+
+    // how every key column goes into the normalized key, the integer ranges and string lengths come from one pass over the rows
+    std::vector<KeyEncoding> Encodings;
+    int Width = 0;
+    bool bNeedsTieBreak = false;
+    for (const SortKey& Key : this->Keys)
+    {
+        int Column = Key.Column.Name.empty() ? Key.Column.Index : this->SortedBatch->schema()->GetFieldIndex(Key.Column.Name);
+        if (Column < 0 || Column >= this->SortedBatch->num_columns())
+        {
+            throw std::runtime_error("SortOperator: no column '" + Key.Column.Name + "' to sort by");
+        }
+
+        KeyEncoding Encoding;
+        Encoding.Array = this->SortedBatch->column(Column);
+        Encoding.bDescending = Key.bDescending;
+        Encoding.bNullsFirst = Key.bNullsFirst;
+        if (Encoding.Array->null_count() > 0)
+        {
+            Encoding.Validity = Encoding.Array->null_bitmap_data();
+        }
+        const bool bHasNulls = Encoding.Validity != nullptr;
+        const arrow::Type::type TypeId = Encoding.Array->type_id();
+
+        bool bInteger = VisitIntegerReader(*Encoding.Array, [&](const auto& Read)
+        {
+            std::vector<uint64_t> Mins(WorkerCount, UINT64_MAX);
+            std::vector<uint64_t> Maxs(WorkerCount, 0);
+            this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+            {
+                uint64_t Min = UINT64_MAX;
+                uint64_t Max = 0;
+                for (int64_t Row = Begin; Row < End; ++Row)
+                {
+                    if (Encoding.IsValid(Row))
+                    {
+                        uint64_t Value = Read(Row);
+                        Min = std::min(Min, Value);
+                        Max = std::max(Max, Value);
+                    }
+                }
+                Mins[Worker] = Min;
+                Maxs[Worker] = Max;
+            });
+
+            uint64_t Min = *std::min_element(Mins.begin(), Mins.end());
+            uint64_t Max = *std::max_element(Maxs.begin(), Maxs.end());
+            Encoding.Min = Min <= Max ? Min : 0; // only nulls: every value code is 0
+            Encoding.Range = Min <= Max ? Max - Min : 0;
+
+            // the null code only fits next to the values when the range leaves one free
+            Encoding.bNullFlag = bHasNulls && Encoding.Range == UINT64_MAX;
+            Encoding.ValueBytes = BytesFor(Encoding.Range + (bHasNulls && !Encoding.bNullFlag ? 1 : 0));
+            if (Encoding.bNullFlag)
+            {
+                Encoding.ValueBytes = 8;
+            }
+        });
+
+        if (bInteger)
+        {
+            Encoding.Type = KeyEncoding::Kind::INTEGER;
+        }
+        else if (TypeId == arrow::Type::FLOAT || TypeId == arrow::Type::DOUBLE)
+        {
+            Encoding.Type = KeyEncoding::Kind::FLOATING;
+            Encoding.bNullFlag = bHasNulls;
+            Encoding.ValueBytes = TypeId == arrow::Type::FLOAT ? 4 : 8;
+        }
+        else if (TypeId == arrow::Type::STRING || TypeId == arrow::Type::BINARY || TypeId == arrow::Type::LARGE_STRING || TypeId == arrow::Type::LARGE_BINARY)
+        {
+            Encoding.Type = KeyEncoding::Kind::STRING;
+            Encoding.bNullFlag = bHasNulls;
+
+            std::vector<int64_t> MaxLengths(WorkerCount, 0);
+            std::vector<char> ZeroBytes(WorkerCount, 0);
+            this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+            {
+                for (int64_t Row = Begin; Row < End; ++Row)
+                {
+                    if (Encoding.IsValid(Row))
+                    {
+                        std::string_view Value = Encoding.StringAt(Row);
+                        MaxLengths[Worker] = std::max<int64_t>(MaxLengths[Worker], (int64_t)Value.size());
+                        ZeroBytes[Worker] |= Value.find('\0') != std::string_view::npos;
+                    }
+                }
+            });
+
+            int64_t MaxLength = *std::max_element(MaxLengths.begin(), MaxLengths.end());
+            bool bZeroByte = std::find(ZeroBytes.begin(), ZeroBytes.end(), 1) != ZeroBytes.end();
+            Encoding.ValueBytes = (int)std::min<int64_t>(MaxLength, MaxStringPrefix);
+            // zero padding makes "a" and "a\0" the same bytes
+            Encoding.bNeedsTieBreak = MaxLength > Encoding.ValueBytes || bZeroByte;
+        }
+        else
+        {
+            throw std::runtime_error("SortOperator: can't sort by column '" + Key.Column.Name + "' of type " + Encoding.Array->type()->ToString());
+        }
+
+        Encoding.Offset = Width;
+        Width += Encoding.Bytes();
+        bNeedsTieBreak = bNeedsTieBreak || Encoding.bNeedsTieBreak;
+        Encodings.push_back(std::move(Encoding));
+    }
+
+    // the normalized keys, Width bytes per row
+    std::vector<uint8_t> Normalized((size_t)RowCount * Width);
+    this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+    {
+        for (const KeyEncoding& Key : Encodings)
+        {
+            if (Key.Bytes() == 0)
+            {
+                // one value in every row (or nothing but empty strings), the column doesn't order anything
+                continue;
+            }
+
+            if (Key.Type == KeyEncoding::Kind::INTEGER)
+            {
+                VisitIntegerReader(*Key.Array, [&](const auto& Read) { EncodeIntegers(Key, Read, Begin, End, Normalized.data(), Width); });
+            }
+            else if (Key.Type == KeyEncoding::Kind::FLOATING)
+            {
+                if (Key.ValueBytes == 4) EncodeFloats<float>(Key, Begin, End, Normalized.data(), Width);
+                else EncodeFloats<double>(Key, Begin, End, Normalized.data(), Width);
+            }
+            else
+            {
+                EncodeStrings(Key, Begin, End, Normalized.data(), Width);
+            }
+        }
+    });
+
+    this->Order.resize(RowCount);
+
+    if (!bNeedsTieBreak && Width <= 4)
+    {
+        // the whole key and the row fit into one uint64, the sort never looks at anything else
+        std::vector<uint64_t> Items(RowCount);
+        std::vector<uint64_t> Scratch(RowCount);
+        this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+        {
+            for (int64_t Row = Begin; Row < End; ++Row)
+            {
+                Items[Row] = (ReadBigEndian(Normalized.data() + Row * Width, Width) << 32) | (uint64_t)Row;
+            }
+        });
+        Normalized = std::vector<uint8_t>();
+
+        this->RadixSort(Items, Scratch, 32, Width);
+
+        this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+        {
+            for (int64_t i = Begin; i < End; ++i)
+            {
+                this->Order[i] = (int32_t)(uint32_t)Items[i];
+            }
+        });
+        return;
+    }
+
+    // sorted by the first 8 bytes of the key, then every run of rows with the same 8 bytes by the rest.
+    // The radix sort must not look past a string that needs a tie break, the keys behind it only count when the strings are equal
+    int PrefixBytes = std::min(Width, 8);
+    for (const KeyEncoding& Key : Encodings)
+    {
+        if (Key.bNeedsTieBreak)
+        {
+            PrefixBytes = std::min(PrefixBytes, Key.Offset + Key.Bytes());
+            break;
+        }
+    }
+
+    std::vector<Kernels::KeyRow> Items(RowCount);
+    std::vector<Kernels::KeyRow> Scratch(RowCount);
+    this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+    {
+        for (int64_t Row = Begin; Row < End; ++Row)
+        {
+            Items[Row] = { ReadBigEndian(Normalized.data() + Row * Width, PrefixBytes), (uint32_t)Row };
+        }
+    });
+
+    this->RadixSort(Items, Scratch, 0, PrefixBytes);
+    Scratch = std::vector<Kernels::KeyRow>();
+
+    if (Width > PrefixBytes || bNeedsTieBreak)
+    {
+        auto Less = [&](const Kernels::KeyRow& A, const Kernels::KeyRow& B)
+        {
+            int Result = CompareKeys(Encodings, Normalized.data(), Width, PrefixBytes, A.Row, B.Row);
+            return Result != 0 ? Result < 0 : A.Row < B.Row;
+        };
+
+        // a worker sorts the runs that start in its slice, also when they reach into the next one
+        this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+        {
+            int64_t i = Begin;
+            if (Begin > 0)
+            {
+                while (i < End && Items[i].Key == Items[Begin - 1].Key)
+                {
+                    ++i;
+                }
+            }
+
+            while (i < End)
+            {
+                int64_t RunEnd = i + 1;
+                while (RunEnd < RowCount && Items[RunEnd].Key == Items[i].Key)
+                {
+                    ++RunEnd;
+                }
+
+                if (RunEnd - i > 1)
+                {
+                    std::sort(Items.begin() + i, Items.begin() + RunEnd, Less);
+                }
+                i = RunEnd;
+            }
+        });
+    }
+
+    this->ForEachSlice(WorkerCount, RowCount, [&](int Worker, int64_t Begin, int64_t End)
+    {
+        for (int64_t i = Begin; i < End; ++i)
+        {
+            this->Order[i] = (int32_t)Items[i].Row;
+        }
+    });
+}
+
+DataChunk SortOperator::Next()
+{
+    if (this->bFinished)
+    {
+        return nullptr;
+    }
+
+    if (!this->bSorted)
+    {
+        this->Sort();
+    }
+
+    if (this->OutputOffset >= (int64_t)this->Order.size())
+    {
+        this->bFinished = true;
+        this->SortedBatch = nullptr;
+        this->Order = std::vector<int32_t>();
+        return nullptr;
+    }
+
+    int64_t Count = std::min<int64_t>(this->OutputRows, (int64_t)this->Order.size() - this->OutputOffset);
+    DataChunk Result = SelectedChunk(this->SortedBatch, this->Order.data() + this->OutputOffset, Count).Materialize(this->Memory);
+    this->OutputOffset += Count;
+    return Result;
+}
+
+bool SortOperator::PushPredicate(const ScanPredicate& Predicate)
+{
+    return this->ChildOperator->PushPredicate(Predicate);
+}
+
+bool SortOperator::PushProjection(const std::vector<ColumnRef>& Columns)
+{
+    std::vector<ColumnRef> Needed = Columns;
+    for (const SortKey& Key : this->Keys)
+    {
+        Needed.push_back(Key.Column);
+    }
+    return this->ChildOperator->PushProjection(Needed);
+}
+
+bool SortOperator::FusePipelines()
+{
+    return this->ChildOperator->FusePipelines();
+}
+
+void SortOperator::Close()
+{
+    this->bFinished = true;
+    this->ChildOperator->Close();
+
+    this->SortedBatch = nullptr;
+    this->Order = std::vector<int32_t>();
+}
+
+void SortOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
+}
+
+std::vector<DataChunk> SortOperator::MergePartials(std::vector<DataChunk> Partials) const
+{
+    SortOperator Merge(std::make_unique<MemoryScanOperator>(Partials, this->CurrentMode), this->Keys, this->CurrentMode, this->Pool);
+    Merge.UseMemoryPool(this->Memory);
+
+    std::vector<DataChunk> Result;
+    DataChunk Chunk;
+    while ((Chunk = Merge.Next()) != nullptr)
+    {
+        Result.push_back(Chunk);
+    }
+    return Result;
+}
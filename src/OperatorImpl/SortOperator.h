@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Operator.h"
+#include "Kernels/Sort.h"
+#include <vector>
+#include <string>
+#include <functional>
+
+class ThreadPool;
+
+// One column of an ORDER BY
+struct SortKey
+{
+    ColumnRef Column;
+    bool bDescending = false;
+    bool bNullsFirst = false; // nulls sort behind every value unless asked otherwise, in both directions
+
+    static SortKey Ascending(const std::string& Name) { SortKey Key; Key.Column = ColumnRef::Named(Name); return Key; }
+    static SortKey Descending(const std::string& Name) { SortKey Key; Key.Column = ColumnRef::Named(Name); Key.bDescending = true; return Key; }
+};
+
+// ORDER BY over one or more key columns (any integer, date/time, float, bool or string/binary column).
+// The child is drained completely, then every row gets a normalized key: the key columns turned into bytes whose
+// memcmp order is the ORDER BY order (integers offset by their minimum and cut to as many bytes as their range needs,
+// nulls and DESC folded into the bytes, strings as a prefix). Keys of up to 8 bytes are sorted by radix sort alone,
+// longer ones by their first 8 bytes and runs with the same prefix by the rest of the key (see Kernels/Sort.h).
+// The sort is stable, rows with equal keys come out in input order. The sorted rows are handed out in batches
+// as big as the largest input batch
+class SortOperator : public Operator
+{
+public:
+    // Pool may be nullptr, then everything runs on the calling thread. A sort inside a ParallelOperator pipeline must not
+    // get the pool that runs the pipeline (ThreadPool::Run isn't reentrant), the merge of the workers' runs can use it
+    SortOperator(std::unique_ptr<Operator> Child, std::vector<SortKey> Keys, ExecutionMode Mode, ThreadPool* Pool = nullptr);
+
+    DataChunk Next() override;
+
+    // Sorting doesn't change the rows, so a predicate from above is valid below us too
+    bool PushPredicate(const ScanPredicate& Predicate) override;
+
+    // Passes the columns on together with the key columns
+    bool PushProjection(const std::vector<ColumnRef>& Columns) override;
+
+    bool FusePipelines() override;
+
+    // Drops the sorted rows and closes the child
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    // Every worker sorted its part, the parts are sorted once more as a whole
+    std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const override;
+
+    // How a key column is turned into bytes, defined in the .cpp
+    struct KeyEncoding;
+
+private:
+    std::unique_ptr<Operator> ChildOperator;
+    std::vector<SortKey> Keys;
+    ThreadPool* Pool;
+
+    bool bSorted = false;
+
+    // All input batches concatenated, rows are addressed with an int32 index like a selection vector
+    DataChunk SortedBatch;
+    std::vector<int32_t> Order; // row indices of SortedBatch in ORDER BY order
+    int64_t OutputRows = 0;     // per output batch
+    int64_t OutputOffset = 0;
+
+    void Sort();
+
+    // Calls Job(Worker) for every worker, on the pool if there is one and more than one worker
+    void RunWorkers(int WorkerCount, const std::function<void(int)>& Job) const;
+
+    // Calls Job(Worker, Begin, End) for WorkerCount consecutive slices of [0, Count)
+    void ForEachSlice(int WorkerCount, int64_t Count, const std::function<void(int, int64_t, int64_t)>& Job) const;
+
+    int WorkerCountFor(int64_t Count) const;
+
+    // Sorts Items by the ByteCount key bytes starting at LowShift, Scratch holds as many items.
+    // One MSD pass on the highest byte that isn't the same for every key splits the items into 256 buckets
+    // (counted and scattered in parallel), then the buckets are sorted on their own, in parallel
+    template <typename Item>
+    void RadixSort(std::vector<Item>& Items, std::vector<Item>& Scratch, int LowShift, int ByteCount) const;
+};
@@ -0,0 +1,517 @@
+#include "pch.h"
+#include "TopNOperator.h"
+#include "MemoryScanOperator.h"
+#include "RuntimeFilter.h"
+#include "Kernels/Predicates.h"
+#include "Kernels/TypedKernels.h"
+#include "Kernels/Validity.h"
+#include <arrow/array/concatenate.h>
+#include <arrow/util/bit_util.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// rows that were pushed out of the heap again are dropped from the pieces once there are this many of them (or k)
+static constexpr int64_t MinCompactRows = 4096;
+
+// Kernels::OrderedBits of the value in Row of a number, date/time or bool column
+static uint64_t ReadCode(const arrow::ArrayData& Column, int64_t Row)
+{
+    if (Column.type->id() == arrow::Type::BOOL)
+    {
+        return (uint64_t)arrow::bit_util::GetBit(Column.buffers[1]->data(), Column.offset + Row);
+    }
+
+    uint64_t Code = 0;
+    Kernels::VisitNumericType(Column.type->id(), [&](auto Tag)
+    {
+        using T = typename decltype(Tag)::Type;
+        Code = Kernels::OrderedBits(Column.GetValues<T>(1)[Row]);
+    });
+    return Code;
+}
+
+template <PredicateOp Op, typename T>
+static void EvaluatePredicate(const T* Values, int64_t Length, const Kernels::PredicateConstants<T>& Constants, ExecutionMode Mode, uint64_t* Bits)
+{
+    switch (Mode)
+    {
+    case ExecutionMode::AVX512:
+        Kernels::EvaluatePredicateAvx512<Op>(Values, Length, Constants, Bits);
+        break;
+    case ExecutionMode::AVX2:
+        Kernels::EvaluatePredicateAvx2<Op>(Values, Length, Constants, Bits);
+        break;
+    default:
+        Kernels::EvaluatePredicateScalar<Op>(Values, Length, Constants, Bits);
+        break;
+    }
+}
+
+// Bits of the rows whose value can still beat Threshold. With one key a row equal to the threshold can't (it came later),
+// with more it still can on the next key. DESC keeps what is NOT below the threshold, so NaNs (first in DESC) pass too
+template <typename T>
+static void CompareWithThreshold(const T* Values, int64_t Length, T Threshold, bool bDescending, bool bStrict, ExecutionMode Mode, uint64_t* Bits)
+{
+    Kernels::PredicateConstants<T> Constants;
+    Constants.Low = Threshold;
+
+    if (!bDescending)
+    {
+        if (bStrict) EvaluatePredicate<PredicateOp::LESS>(Values, Length, Constants, Mode, Bits);
+        else EvaluatePredicate<PredicateOp::LESS_EQUAL>(Values, Length, Constants, Mode, Bits);
+        return;
+    }
+
+    if (bStrict) EvaluatePredicate<PredicateOp::LESS_EQUAL>(Values, Length, Constants, Mode, Bits);
+    else EvaluatePredicate<PredicateOp::LESS>(Values, Length, Constants, Mode, Bits);
+
+    int64_t WordCount = (Length + 63) / 64;
+    for (int64_t Word = 0; Word < WordCount; ++Word)
+    {
+        Bits[Word] = ~Bits[Word];
+    }
+    if (Length % 64 != 0)
+    {
+        Bits[WordCount - 1] &= (1ull << (Length % 64)) - 1;
+    }
+}
+
+static DataChunk ConcatenateBatches(const std::vector<DataChunk>& Batches, arrow::MemoryPool* Pool)
+{
+    if (Batches.size() == 1)
+    {
+        return Batches[0];
+    }
+
+    std::shared_ptr<arrow::Schema> Schema = Batches[0]->schema();
+    std::vector<std::shared_ptr<arrow::Array>> Columns;
+    for (int c = 0; c < Schema->num_fields(); ++c)
+    {
+        arrow::ArrayVector Pieces;
+        for (const DataChunk& Batch : Batches)
+        {
+            Pieces.push_back(Batch->column(c));
+        }
+
+        arrow::Result<std::shared_ptr<arrow::Array>> ColumnResult = arrow::Concatenate(Pieces, Pool);
+        PARQUET_THROW_NOT_OK(ColumnResult.status());
+        Columns.push_back(ColumnResult.ValueOrDie());
+    }
+
+    int64_t TotalRows = Columns.empty() ? 0 : Columns[0]->length();
+    return arrow::RecordBatch::Make(Schema, TotalRows, std::move(Columns));
+}
+
+TopNOperator::TopNOperator(std::unique_ptr<Operator> Child, std::vector<SortKey> Keys, int64_t Limit, ExecutionMode Mode)
+    : Operator(Mode), ChildOperator(std::move(Child)), Keys(std::move(Keys)), Limit(Limit)
+{
+    if (this->Keys.empty())
+    {
+        throw std::runtime_error("TopNOperator: needs at least one key to order by");
+    }
+    if (this->Limit < 0 || this->Limit > INT32_MAX)
+    {
+        throw std::runtime_error("TopNOperator: the limit must be between 0 and INT32_MAX");
+    }
+
+    this->RowKeys.resize(this->Keys.size());
+}
+
+void TopNOperator::Bind(const arrow::RecordBatch& Batch)
+{
+    for (const SortKey& Key : this->Keys)
+    {
+        int Column = Key.Column.Name.empty() ? Key.Column.Index : Batch.schema()->GetFieldIndex(Key.Column.Name);
+        if (Column < 0 || Column >= Batch.num_columns())
+        {
+            throw std::runtime_error("TopNOperator: no column '" + Key.Column.Name + "' to order by");
+        }
+
+        arrow::Type::type Type = Batch.column(Column)->type_id();
+        if (Type != arrow::Type::BOOL && !Kernels::VisitNumericType(Type, [](auto) {}))
+        {
+            throw std::runtime_error("TopNOperator: can't order by '" + Batch.schema()->field(Column)->name() + "' of type " +
+                                     Batch.column(Column)->type()->ToString() + ", only numbers, dates/times and bools (use a SortOperator)");
+        }
+        this->KeyColumns.push_back(Column);
+    }
+
+    // the child can drop the rows that can't beat the k-th row before they get here. Null rows are dropped with them,
+    // that's only right when nulls go last
+    const SortKey& First = this->Keys[0];
+    arrow::Type::type FirstType = Batch.column(this->KeyColumns[0])->type_id();
+    if (!First.Column.Name.empty() && !First.bNullsFirst && (FirstType == arrow::Type::INT32 || FirstType == arrow::Type::INT64))
+    {
+        std::shared_ptr<RuntimeFilter> Filter = RuntimeFilter::MakeBound(First.Column.Name, !First.bDescending, this->Keys.size() > 1);
+        if (this->ChildOperator->PushRuntimeFilter(Filter))
+        {
+            this->BoundFilter = Filter;
+        }
+    }
+}
+
+void TopNOperator::ReadKeys(const arrow::RecordBatch& Batch, int64_t Row, KeyValue* Out) const
+{
+    for (size_t k = 0; k < this->Keys.size(); ++k)
+    {
+        const arrow::ArrayData& Column = *Batch.column_data(this->KeyColumns[k]);
+        if (Column.GetNullCount() > 0 && !Kernels::IsValid(Column.buffers[0]->data(), Column.offset + Row))
+        {
+            Out[k].Rank = this->Keys[k].bNullsFirst ? 0 : 2;
+            Out[k].Code = 0;
+            continue;
+        }
+
+        uint64_t Code = ReadCode(Column, Row);
+        Out[k].Rank = 1;
+        Out[k].Code = this->Keys[k].bDescending ? ~Code : Code;
+    }
+}
+
+bool TopNOperator::Before(const KeyValue* A, int64_t SequenceA, const KeyValue* B, int64_t SequenceB) const
+{
+    for (size_t k = 0; k < this->Keys.size(); ++k)
+    {
+        if (A[k].Rank != B[k].Rank)
+        {
+            return A[k].Rank < B[k].Rank;
+        }
+        if (A[k].Code != B[k].Code)
+        {
+            return A[k].Code < B[k].Code;
+        }
+    }
+    return SequenceA < SequenceB;
+}
+
+bool TopNOperator::Before(const Entry& A, const Entry& B) const
+{
+    const size_t KeyCount = this->Keys.size();
+    return this->Before(&this->HeapKeys[A.Slot * KeyCount], A.Sequence, &this->HeapKeys[B.Slot * KeyCount], B.Sequence);
+}
+
+bool TopNOperator::Prefilter(const SelectedChunk& Input, int64_t& CandidateCount)
+{
+    if ((int64_t)this->Heap.size() < this->Limit)
+    {
+        return false;
+    }
+
+    const Entry& Worst = this->Heap.front();
+    if (this->HeapKeys[Worst.Slot * this->Keys.size()].Rank != 1)
+    {
+        return false;
+    }
+
+    const SortKey& Key = this->Keys[0];
+    const arrow::ArrayData& Column = *Input.Batch->column_data(this->KeyColumns[0]);
+    const bool bHasNulls = Column.GetNullCount() > 0;
+    if (bHasNulls && Key.bNullsFirst)
+    {
+        // a null beats any value, the compare can't say that
+        return false;
+    }
+
+    const int64_t Length = Input.Batch->num_rows();
+    const int64_t WordCount = (Length + 63) / 64;
+    this->CandidateBits.resize(WordCount);
+
+    // the threshold row is in a piece, every row of the last batch was moved there
+    const arrow::ArrayData& ThresholdColumn = *this->Pieces[Worst.Piece]->column_data(this->KeyColumns[0]);
+    bool bCompared = false;
+    Kernels::VisitNumericType(Column.type->id(), [&](auto Tag)
+    {
+        using T = typename decltype(Tag)::Type;
+        T Threshold = ThresholdColumn.GetValues<T>(1)[Worst.Row];
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            // everything but NaN is below a NaN, and another NaN can't beat it
+            if (std::isnan(Threshold) && !Key.bDescending)
+            {
+                return;
+            }
+        }
+
+        CompareWithThreshold<T>(Column.GetValues<T>(1), Length, Threshold, Key.bDescending, this->Keys.size() == 1, this->CurrentMode, this->CandidateBits.data());
+        bCompared = true;
+    });
+    if (!bCompared)
+    {
+        return false;
+    }
+
+    // nulls go last here and can't beat a value
+    if (bHasNulls)
+    {
+        Kernels::AndValidity(this->CandidateBits.data(), Length, Column.buffers[0]->data(), Column.offset);
+    }
+
+    if (Input.HasSelection())
+    {
+        this->SelectionBits.resize(WordCount);
+        Kernels::SelectionToBits(Input.Selection, Input.Count, Length, this->SelectionBits.data());
+        for (int64_t Word = 0; Word < WordCount; ++Word)
+        {
+            this->CandidateBits[Word] &= this->SelectionBits[Word];
+        }
+    }
+
+    // BitsToSelection writes up to 16 indices past the last one it keeps
+    this->Candidates.resize(Length + 16);
+    switch (this->CurrentMode)
+    {
+    case ExecutionMode::AVX512:
+        CandidateCount = Kernels::BitsToSelectionAvx512(this->CandidateBits.data(), Length, this->Candidates.data());
+        break;
+    case ExecutionMode::AVX2:
+        CandidateCount = Kernels::BitsToSelectionAvx2(this->CandidateBits.data(), Length, this->Candidates.data());
+        break;
+    default:
+        CandidateCount = Kernels::BitsToSelectionScalar(this->CandidateBits.data(), Length, this->Candidates.data());
+        break;
+    }
+    return true;
+}
+
+void TopNOperator::Consume(const SelectedChunk& Input)
+{
+    const arrow::RecordBatch& Batch = *Input.Batch;
+    if (this->KeyColumns.empty())
+    {
+        this->Bind(Batch);
+    }
+
+    const int32_t* Rows = Input.Selection;
+    int64_t Count = Input.Count;
+    int64_t CandidateCount = 0;
+    if (this->Prefilter(Input, CandidateCount))
+    {
+        Rows = this->Candidates.data();
+        Count = CandidateCount;
+    }
+
+    const size_t KeyCount = this->Keys.size();
+    auto Compare = [this](const Entry& A, const Entry& B) { return this->Before(A, B); };
+    for (int64_t i = 0; i < Count; ++i)
+    {
+        int64_t Row = Rows != nullptr ? Rows[i] : i;
+        int64_t Sequence = this->RowsSeen + Row;
+        this->ReadKeys(Batch, Row, this->RowKeys.data());
+
+        int32_t Slot;
+        if ((int64_t)this->Heap.size() < this->Limit)
+        {
+            Slot = (int32_t)this->Heap.size();
+            this->HeapKeys.resize((Slot + 1) * KeyCount);
+        }
+        else
+        {
+            const Entry& Worst = this->Heap.front();
+            if (!this->Before(this->RowKeys.data(), Sequence, &this->HeapKeys[Worst.Slot * KeyCount], Worst.Sequence))
+            {
+                continue;
+            }
+
+            // the row pushes the worst one out and takes over its slot
+            Slot = Worst.Slot;
+            std::pop_heap(this->Heap.begin(), this->Heap.end(), Compare);
+            this->Heap.pop_back();
+        }
+
+        std::copy(this->RowKeys.begin(), this->RowKeys.end(), this->HeapKeys.begin() + Slot * KeyCount);
+        this->Heap.push_back({ Sequence, Slot, -1, (int32_t)Row });
+        std::push_heap(this->Heap.begin(), this->Heap.end(), Compare);
+    }
+    this->RowsSeen += Batch.num_rows();
+
+    this->KeepNewRows(Input.Batch);
+    if (this->PieceRows - (int64_t)this->Heap.size() > std::max(this->Limit, MinCompactRows))
+    {
+        this->Compact();
+    }
+    this->UpdateBound();
+}
+
+void TopNOperator::KeepNewRows(const DataChunk& Batch)
+{
+    std::vector<Entry*> NewEntries;
+    for (Entry& Item : this->Heap)
+    {
+        if (Item.Piece < 0)
+        {
+            NewEntries.push_back(&Item);
+        }
+    }
+    if (NewEntries.empty())
+    {
+        return;
+    }
+
+    std::sort(NewEntries.begin(), NewEntries.end(), [](const Entry* A, const Entry* B) { return A->Row < B->Row; });
+
+    std::vector<int32_t> Selection(NewEntries.size());
+    for (size_t i = 0; i < NewEntries.size(); ++i)
+    {
+        Selection[i] = NewEntries[i]->Row;
+        NewEntries[i]->Piece = (int32_t)this->Pieces.size();
+        NewEntries[i]->Row = (int32_t)i;
+    }
+
+    this->Pieces.push_back(SelectedChunk(Batch, Selection.data(), (int64_t)Selection.size()).Materialize(this->Memory));
+    this->PieceRows += (int64_t)Selection.size();
+}
+
+void TopNOperator::Compact()
+{
+    if (this->Heap.empty())
+    {
+        this->Pieces.clear();
+        this->PieceRows = 0;
+        return;
+    }
+
+    // the rows go into the new piece grouped by the piece they come from, in the order they are there
+    std::vector<Entry*> Entries;
+    for (Entry& Item : this->Heap)
+    {
+        Entries.push_back(&Item);
+    }
+    std::sort(Entries.begin(), Entries.end(), [](const Entry* A, const Entry* B)
+    {
+        return A->Piece != B->Piece ? A->Piece < B->Piece : A->Row < B->Row;
+    });
+
+    std::vector<DataChunk> Kept;
+    std::vector<int32_t> Selection;
+    for (size_t Begin = 0; Begin < Entries.size();)
+    {
+        size_t End = Begin;
+        Selection.clear();
+        for (; End < Entries.size() && Entries[End]->Piece == Entries[Begin]->Piece; ++End)
+        {
+            Selection.push_back(Entries[End]->Row);
+        }
+
+        Kept.push_back(SelectedChunk(this->Pieces[Entries[Begin]->Piece], Selection.data(), (int64_t)Selection.size()).Materialize(this->Memory));
+        Begin = End;
+    }
+
+    for (size_t i = 0; i < Entries.size(); ++i)
+    {
+        Entries[i]->Piece = 0;
+        Entries[i]->Row = (int32_t)i;
+    }
+
+    this->Pieces = { ConcatenateBatches(Kept, this->Memory) };
+    this->PieceRows = (int64_t)Entries.size();
+}
+
+void TopNOperator::UpdateBound()
+{
+    if (this->BoundFilter == nullptr || (int64_t)this->Heap.size() < this->Limit)
+    {
+        return;
+    }
+
+    const Entry& Worst = this->Heap.front();
+    if (this->HeapKeys[Worst.Slot * this->Keys.size()].Rank != 1)
+    {
+        return;
+    }
+
+    const arrow::ArrayData& Column = *this->Pieces[Worst.Piece]->column_data(this->KeyColumns[0]);
+    int64_t Value = Column.type->id() == arrow::Type::INT32 ? Column.GetValues<int32_t>(1)[Worst.Row] : Column.GetValues<int64_t>(1)[Worst.Row];
+    this->BoundFilter->SetBound(Value);
+}
+
+DataChunk TopNOperator::Next()
+{
+    if (this->bFinished)
+    {
+        return nullptr;
+    }
+    this->bFinished = true;
+
+    if (this->Limit == 0)
+    {
+        return nullptr;
+    }
+
+    SelectedChunk Input;
+    while (!(Input = this->ChildOperator->NextSelected()).IsEnd())
+    {
+        if (Input.Count > 0)
+        {
+            this->Consume(Input);
+        }
+    }
+
+    if (this->Heap.empty())
+    {
+        return nullptr;
+    }
+
+    this->Compact();
+
+    std::vector<Entry> Sorted = this->Heap;
+    std::sort(Sorted.begin(), Sorted.end(), [this](const Entry& A, const Entry& B) { return this->Before(A, B); });
+
+    std::vector<int32_t> Order(Sorted.size());
+    for (size_t i = 0; i < Sorted.size(); ++i)
+    {
+        Order[i] = Sorted[i].Row;
+    }
+
+    DataChunk Result = SelectedChunk(this->Pieces[0], Order.data(), (int64_t)Order.size()).Materialize(this->Memory);
+
+    this->Heap = std::vector<Entry>();
+    this->HeapKeys = std::vector<KeyValue>();
+    this->Pieces.clear();
+    return Result;
+}
+
+bool TopNOperator::PushProjection(const std::vector<ColumnRef>& Columns)
+{
+    std::vector<ColumnRef> Needed = Columns;
+    for (const SortKey& Key : this->Keys)
+    {
+        Needed.push_back(Key.Column);
+    }
+    return this->ChildOperator->PushProjection(Needed);
+}
+
+bool TopNOperator::FusePipelines()
+{
+    return this->ChildOperator->FusePipelines();
+}
+
+void TopNOperator::Close()
+{
+    this->bFinished = true;
+    this->ChildOperator->Close();
+
+    this->Heap = std::vector<Entry>();
+    this->HeapKeys = std::vector<KeyValue>();
+    this->Pieces.clear();
+}
+
+void TopNOperator::UseMemoryPool(arrow::MemoryPool* Pool)
+{
+    this->Memory = Pool;
+    this->ChildOperator->UseMemoryPool(Pool);
+}
+
+std::vector<DataChunk> TopNOperator::MergePartials(std::vector<DataChunk> Partials) const
+{
+    TopNOperator Merge(std::make_unique<MemoryScanOperator>(Partials, this->CurrentMode), this->Keys, this->Limit, this->CurrentMode);
+    Merge.UseMemoryPool(this->Memory);
+
+    std::vector<DataChunk> Result;
+    DataChunk Chunk = Merge.Next();
+    if (Chunk != nullptr)
+    {
+        Result.push_back(Chunk);
+    }
+    return Result;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Operator.h"
+#include "SortOperator.h"
+#include <vector>
+
+// ORDER BY ... LIMIT k without sorting the input. A bounded heap keeps the best k rows seen so far, the worst of them
+// (the k-th row) is the threshold a new row has to beat. Once the heap is full every batch is first compared against the
+// threshold's first key with the bitmap compare kernels (Kernels/Predicates.h): a word of 64 rows that can't beat it
+// becomes 0 and none of them is looked at again, only the few rows that can go through the heap.
+// When the first key is an int32/int64 column with nulls last the threshold is also pushed into the child as a bound
+// RuntimeFilter, so a scan drops those rows before they get here. The bound only gets tighter as the heap fills with better rows.
+// Keys are number, date/time and bool columns (strings go through the SortOperator). Ties keep input order, like the sort.
+// Under a ParallelOperator every worker keeps its own heap over its part of the input, MergePartials runs one more
+// top-k over the workers' rows
+class TopNOperator : public Operator
+{
+public:
+    TopNOperator(std::unique_ptr<Operator> Child, std::vector<SortKey> Keys, int64_t Limit, ExecutionMode Mode);
+
+    // The k rows in order, in one batch
+    DataChunk Next() override;
+
+    // Passes the columns on together with the key columns. Predicates aren't passed on, the rows below a LIMIT aren't
+    // the rows above it
+    bool PushProjection(const std::vector<ColumnRef>& Columns) override;
+
+    bool FusePipelines() override;
+
+    // Drops the heap and closes the child
+    void Close() override;
+
+    void UseMemoryPool(arrow::MemoryPool* Pool) override;
+
+    std::vector<DataChunk> MergePartials(std::vector<DataChunk> Partials) const override;
+
+private:
+    // One key of a row, rows compare (Rank, Code) key by key. Code is Kernels::OrderedBits of the value, flipped for DESC
+    struct KeyValue
+    {
+        uint8_t Rank = 1; // 0 null in front of the values, 1 a value, 2 null behind them
+        uint64_t Code = 0;
+    };
+
+    struct Entry
+    {
+        int64_t Sequence; // position in the input, ties go to the earlier row
+        int32_t Slot;     // the row's keys are HeapKeys[Slot * key count, ...)
+        int32_t Piece;    // where the row is kept, -1 while it is still in the batch being read
+        int32_t Row;
+    };
+
+    std::unique_ptr<Operator> ChildOperator;
+    std::vector<SortKey> Keys;
+    int64_t Limit;
+
+    std::vector<int> KeyColumns; // resolved on the first batch
+    std::shared_ptr<RuntimeFilter> BoundFilter;
+
+    std::vector<Entry> Heap; // max heap, the worst of the kept rows on top
+    std::vector<KeyValue> HeapKeys;
+    int64_t RowsSeen = 0;
+
+    // the rows that made it into the heap, gathered out of their batches. Rows that were pushed out again
+    // stay in here until there are enough of them for a Compact()
+    std::vector<DataChunk> Pieces;
+    int64_t PieceRows = 0;
+
+    std::vector<KeyValue> RowKeys;
+    std::vector<uint64_t> CandidateBits;
+    std::vector<uint64_t> SelectionBits;
+    std::vector<int32_t> Candidates;
+
+    void Bind(const arrow::RecordBatch& Batch);
+    void Consume(const SelectedChunk& Input);
+
+    // The rows of Input whose first key can still beat the threshold into Candidates. False when there is no check
+    // for this batch (heap not full, a null or NaN threshold, nulls in front, a bool key), then every row is a candidate
+    bool Prefilter(const SelectedChunk& Input, int64_t& CandidateCount);
+
+    void ReadKeys(const arrow::RecordBatch& Batch, int64_t Row, KeyValue* Out) const;
+    bool Before(const KeyValue* A, int64_t SequenceA, const KeyValue* B, int64_t SequenceB) const;
+    bool Before(const Entry& A, const Entry& B) const;
+
+    // Gathers the rows this batch put into the heap into a new piece
+    void KeepNewRows(const DataChunk& Batch);
+
+    // All rows still in the heap into a single piece
+    void Compact();
+
+    void UpdateBound();
+};
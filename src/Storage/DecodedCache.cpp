@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "DecodedCache.h"
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
+#include <arrow/ipc/writer.h>
+#include <arrow/util/key_value_metadata.h>
+#include <filesystem>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+// stored in the schema metadata of every entry, an entry is only valid while all of them still match the source
+static const char* SourcePathKey = "olap.source_path";
+static const char* SourceSizeKey = "olap.source_size";
+static const char* SourceTimeKey = "olap.source_mtime";
+
+// what the entry of a source has to match right now
+static std::shared_ptr<arrow::KeyValueMetadata> DescribeSource(const std::string& SourcePath)
+{
+    fs::path Canonical = fs::canonical(SourcePath);
+    std::string Size = std::to_string(fs::file_size(Canonical));
+    std::string Time = std::to_string(fs::last_write_time(Canonical).time_since_epoch().count());
+
+    return arrow::key_value_metadata({ SourcePathKey, SourceSizeKey, SourceTimeKey }, { Canonical.string(), Size, Time });
+}
+
+DecodedCache::DecodedCache(const std::string& Directory)
+    : Directory(Directory)
+{
+}
+
+// <file name>-<hash of the full path>.arrow, the same file name in two directories gets two entries
+std::string DecodedCache::EntryPath(const std::string& SourcePath) const
+{
+    fs::path Canonical = fs::canonical(SourcePath);
+    std::ostringstream Name;
+    Name << Canonical.filename().string() << "-" << std::hex << std::hash<std::string>()(Canonical.string()) << ".arrow";
+    return (fs::path(this->Directory) / Name.str()).string();
+}
+
+bool DecodedCache::TryLoad(const std::string& SourcePath, std::vector<DataChunk>& OutChunks) const
+{
+    std::error_code Error;
+    std::string Entry = this->EntryPath(SourcePath);
+    if (!fs::exists(Entry, Error))
+    {
+        return false;
+    }
+
+    arrow::Result<std::shared_ptr<arrow::io::MemoryMappedFile>> FileResult = arrow::io::MemoryMappedFile::Open(Entry, arrow::io::FileMode::READ);
+    if (!FileResult.ok())
+    {
+        return false;
+    }
+
+    arrow::Result<std::shared_ptr<arrow::ipc::RecordBatchFileReader>> ReaderResult = arrow::ipc::RecordBatchFileReader::Open(FileResult.ValueOrDie());
+    if (!ReaderResult.ok())
+    {
+        return false; // a truncated or foreign file, the next Store replaces it
+    }
+
+    std::shared_ptr<arrow::ipc::RecordBatchFileReader> Reader = ReaderResult.ValueOrDie();
+    std::shared_ptr<const arrow::KeyValueMetadata> Stored = Reader->schema()->metadata();
+    std::shared_ptr<arrow::KeyValueMetadata> Current = DescribeSource(SourcePath);
+    if (Stored == nullptr || !Stored->Equals(*Current))
+    {
+        return false;
+    }
+
+    std::vector<DataChunk> Chunks;
+    for (int i = 0; i < Reader->num_record_batches(); ++i)
+    {
+        arrow::Result<std::shared_ptr<arrow::RecordBatch>> BatchResult = Reader->ReadRecordBatch(i);
+        if (!BatchResult.ok())
+        {
+            return false;
+        }
+
+        // the cache keys are nothing the operators need to see
+        Chunks.push_back(BatchResult.ValueOrDie()->ReplaceSchemaMetadata(nullptr));
+    }
+
+    OutChunks = std::move(Chunks);
+    return true;
+}
+
+void DecodedCache::Store(const std::string& SourcePath, const std::vector<DataChunk>& Chunks) const
+{
+    if (Chunks.empty())
+    {
+        throw std::runtime_error("DecodedCache: nothing to store for '" + SourcePath + "'");
+    }
+
+    fs::create_directories(this->Directory);
+
+    std::string Entry = this->EntryPath(SourcePath);
+    std::string TempEntry = Entry + ".tmp";
+
+    {
+        std::shared_ptr<arrow::Schema> Schema = Chunks[0]->schema()->WithMetadata(DescribeSource(SourcePath));
+
+        arrow::Result<std::shared_ptr<arrow::io::FileOutputStream>> OutResult = arrow::io::FileOutputStream::Open(TempEntry);
+        PARQUET_THROW_NOT_OK(OutResult.status());
+        std::shared_ptr<arrow::io::FileOutputStream> Out = OutResult.ValueOrDie();
+
+        // no compression, batches have to be usable straight from the mapping
+        arrow::Result<std::shared_ptr<arrow::ipc::RecordBatchWriter>> WriterResult = arrow::ipc::MakeFileWriter(Out, Schema);
+        PARQUET_THROW_NOT_OK(WriterResult.status());
+        std::shared_ptr<arrow::ipc::RecordBatchWriter> Writer = WriterResult.ValueOrDie();
+
+        for (const DataChunk& Chunk : Chunks)
+        {
+            PARQUET_THROW_NOT_OK(Writer->WriteRecordBatch(*Chunk));
+        }
+
+        PARQUET_THROW_NOT_OK(Writer->Close());
+        PARQUET_THROW_NOT_OK(Out->Close());
+    }
+
+    fs::rename(TempEntry, Entry);
+}
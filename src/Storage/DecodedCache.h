@@ -0,0 +1,26 @@
+#pragma once
+#include "../OperatorImpl/DataChunk.h"
+#include <string>
+#include <vector>
+
+// Decoded copies of source files, kept as uncompressed Arrow IPC files in one directory.
+// An entry is found by the source's path and is only used while the source still has the size and modification time
+// it had when the entry was written, a changed source is decoded again and its entry replaced.
+// Entries are memory mapped on load, the chunks point into the mapping, so loading one decodes and copies nothing
+class DecodedCache
+{
+public:
+    explicit DecodedCache(const std::string& Directory);
+
+    // false when there's no entry for SourcePath or it is out of date (or unreadable), OutChunks is left alone then
+    bool TryLoad(const std::string& SourcePath, std::vector<DataChunk>& OutChunks) const;
+
+    // Writes the entry of SourcePath, replacing an old one. Written next to it first and renamed, so a crash
+    // half way leaves the old entry (or none), never a broken one
+    void Store(const std::string& SourcePath, const std::vector<DataChunk>& Chunks) const;
+
+private:
+    std::string Directory;
+
+    std::string EntryPath(const std::string& SourcePath) const;
+};
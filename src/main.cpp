@@ -2,20 +2,44 @@
 #include <iostream>
 #include <vector>
 #include "Misc/Logger.h"
+#include "Misc/CpuFeatures.h"
 #include "OperatorImpl/ScanOperator.h"
 #include "OperatorImpl/MemoryScanOperator.h"
 #include "OperatorImpl/AggregateFunctions/SumOperator.h"
+#include "OperatorImpl/AggregateFunctions/MinOperator.h"
+#include "OperatorImpl/AggregateFunctions/AggregateOperator.h"
+#include "OperatorImpl/AggregateFunctions/HashAggregateOperator.h"
 #include "OperatorImpl/FilterOperator.h"
+#include "OperatorImpl/ProjectOperator.h"
+#include "OperatorImpl/SortOperator.h"
+#include "OperatorImpl/TopNOperator.h"
+#include "OperatorImpl/LimitOperator.h"
+#include "OperatorImpl/HashJoinOperator.h"
+#include "OperatorImpl/ParallelOperator.h"
+#include "Execution/ThreadPool.h"
+#include "Storage/DecodedCache.h"
 #include "Benchmarking/BenchmarkRunner.h"
 
 
 
-// Moves all data from disk into RAM to avoid expensive I/O during benchmarking
-std::vector<DataChunk> PreloadData(const std::string& FileName)
+// Moves all data from disk into RAM to avoid expensive I/O during benchmarking.
+// The decoded chunks are kept in CacheDirectory, later runs map them from there instead of decoding the file again
+std::vector<DataChunk> PreloadData(const std::string& FileName, const std::string& CacheDirectory = "DecodedCache")
 {
     LOG_TITLE("SETUP", "Pre-loading data into RAM..");
     std::vector<DataChunk> Chunks;
-    ScanOperator Scan(FileName);
+
+    DecodedCache Cache(CacheDirectory);
+    if (Cache.TryLoad(FileName, Chunks))
+    {
+        LOG_MESSAGEF("Mapped %zu decoded chunks from the cache.", Chunks.size());
+        return Chunks;
+    }
+
+    // row groups are decoded on every core, in file order so the chunks line up with a sequential scan
+    ScanOptions Options;
+    Options.DecodeThreads = (int)std::thread::hardware_concurrency();
+    ScanOperator Scan(FileName, Options);
 
     DataChunk Chunk; // batch of rows
     while ((Chunk = Scan.Next()) != nullptr)
@@ -23,11 +47,110 @@ std::vector<DataChunk> PreloadData(const std::string& FileName)
         Chunks.push_back(Chunk);
     }
     LOG_MESSAGEF("Loaded %zu chunks into memory.", Chunks.size());
+
+    // a cache that can't be written only costs the next start its shortcut
+    try
+    {
+        Cache.Store(FileName, Chunks);
+    }
+    catch (const std::exception& e)
+    {
+        LOG_WARNING("Could not write the decoded cache: " << e.what());
+    }
+    return Chunks;
+}
+// Synthetic single column data with values uniformly spread over [MinValue, MaxValue].
+// With the default [0, 99] "x > 99 - S" keeps S percent of the rows
+std::vector<DataChunk> GenerateUniformData(long long RowCount, long long ChunkSize, int32_t MinValue = 0, int32_t MaxValue = 99)
+{
+    std::vector<DataChunk> Chunks;
+    std::mt19937 Rng(42);
+    std::uniform_int_distribution<int32_t> Dist(MinValue, MaxValue);
+    auto Schema = arrow::schema({ arrow::field("IntColumn", arrow::int32()) });
+
+    for (long long Offset = 0; Offset < RowCount; Offset += ChunkSize)
+    {
+        long long Length = std::min(ChunkSize, RowCount - Offset);
+        arrow::Int32Builder Builder;
+        PARQUET_THROW_NOT_OK(Builder.Resize(Length));
+        for (long long i = 0; i < Length; ++i)
+        {
+            Builder.UnsafeAppend(Dist(Rng));
+        }
+
+        std::shared_ptr<arrow::Array> Column;
+        PARQUET_THROW_NOT_OK(Builder.Finish(&Column));
+        Chunks.push_back(arrow::RecordBatch::Make(Schema, Length, { Column }));
+    }
+    return Chunks;
+}
+
+// Same values as GenerateUniformData, stored as ArrowType (Int8Type, UInt16Type, DoubleType, ...).
+// NullFraction of the rows (picked at random) are null
+template <typename ArrowType>
+std::vector<DataChunk> GenerateTypedData(long long RowCount, long long ChunkSize, int32_t MinValue = 0, int32_t MaxValue = 99, double NullFraction = 0.0)
+{
+    std::vector<DataChunk> Chunks;
+    std::mt19937 Rng(42);
+    std::uniform_int_distribution<int32_t> Dist(MinValue, MaxValue);
+    std::bernoulli_distribution IsNull(NullFraction);
+    auto Schema = arrow::schema({ arrow::field("Value", arrow::TypeTraits<ArrowType>::type_singleton()) });
+
+    for (long long Offset = 0; Offset < RowCount; Offset += ChunkSize)
+    {
+        long long Length = std::min(ChunkSize, RowCount - Offset);
+        arrow::NumericBuilder<ArrowType> Builder;
+        PARQUET_THROW_NOT_OK(Builder.Resize(Length));
+        for (long long i = 0; i < Length; ++i)
+        {
+            if (IsNull(Rng))
+            {
+                Builder.UnsafeAppendNull();
+            }
+            else
+            {
+                Builder.UnsafeAppend((typename ArrowType::c_type)Dist(Rng));
+            }
+        }
+
+        std::shared_ptr<arrow::Array> Column;
+        PARQUET_THROW_NOT_OK(Builder.Finish(&Column));
+        Chunks.push_back(arrow::RecordBatch::Make(Schema, Length, { Column }));
+    }
+    return Chunks;
+}
+
+// Dimension table for the join benchmarks: keys 0, Stride, 2 * Stride, ... below KeyRange and a payload column
+std::vector<DataChunk> GenerateDimensionData(int32_t KeyRange, int32_t Stride, long long ChunkSize)
+{
+    std::vector<DataChunk> Chunks;
+    auto Schema = arrow::schema({ arrow::field("DimKey", arrow::int32()), arrow::field("DimPayload", arrow::int64()) });
+
+    long long KeyCount = (KeyRange + Stride - 1) / Stride;
+    for (long long Offset = 0; Offset < KeyCount; Offset += ChunkSize)
+    {
+        long long Length = std::min(ChunkSize, KeyCount - Offset);
+        arrow::Int32Builder KeyBuilder;
+        arrow::Int64Builder PayloadBuilder;
+        PARQUET_THROW_NOT_OK(KeyBuilder.Resize(Length));
+        PARQUET_THROW_NOT_OK(PayloadBuilder.Resize(Length));
+        for (long long i = Offset; i < Offset + Length; ++i)
+        {
+            KeyBuilder.UnsafeAppend((int32_t)(i * Stride));
+            PayloadBuilder.UnsafeAppend(i * 3);
+        }
+
+        std::shared_ptr<arrow::Array> Keys;
+        std::shared_ptr<arrow::Array> Payloads;
+        PARQUET_THROW_NOT_OK(KeyBuilder.Finish(&Keys));
+        PARQUET_THROW_NOT_OK(PayloadBuilder.Finish(&Payloads));
+        Chunks.push_back(arrow::RecordBatch::Make(Schema, Length, { Keys, Payloads }));
+    }
     return Chunks;
 }
+
 // TODO:
 // - Change benchmarking logic to only measure CPU time
-// - Implement more Aggregate functions (AVG, COUNT, MIN, MAX)
 int main()
 {
 #ifdef _WIN32
@@ -37,9 +160,17 @@ int main()
 
     Logger::Init();
 
+    // cpuid runs once here, every operator clamps its requested mode to what was found
+    LOG_TITLE("SETUP", "CPU features: " + CpuFeatures::Describe());
+    const bool bHasAvx512 = CpuFeatures::Get().bAvx512;
+
     std::string TestFile = "TEST_DATA.parquet";
     BenchmarkRunner Runner(10);
 
+    // every core, created once and shared by all parallel plans
+    ThreadPool Pool;
+    LOG_MESSAGEF("Thread pool: %d threads", Pool.Size());
+
     try
     {
         std::vector<DataChunk> InMemoryData = PreloadData(TestFile);
@@ -51,6 +182,157 @@ int main()
 
         LOG_MESSAGEF("Total Input Rows: %lld", TotalInputRows);
 
+        std::cout << "============================================================" << std::endl;
+        std::cout << "BENCHMARK SUITE: PARQUET SCAN (DECODE BOUND)" << std::endl;
+        std::cout << "============================================================" << std::endl;
+
+        auto ParquetScanPlan = [&](int DecodeThreads, bool bOrdered)
+        {
+            return [&TestFile, DecodeThreads, bOrdered]() -> std::unique_ptr<Operator>
+            {
+                ScanOptions Options;
+                Options.DecodeThreads = DecodeThreads;
+                Options.bOrdered = bOrdered;
+                return std::make_unique<ScanOperator>(TestFile, Options);
+            };
+        };
+
+        BenchmarkRunner ScanRunner(3);
+        BenchmarkResult SequentialScanRes = ScanRunner.Run("Sequential Parquet Scan", ParquetScanPlan(1, true), TotalInputRows);
+        BenchmarkResult ParallelScanRes = ScanRunner.Run("Parallel Parquet Scan", ParquetScanPlan(Pool.Size(), true), TotalInputRows);
+        BenchmarkResult UnorderedScanRes = ScanRunner.Run("Parallel Parquet Scan (unordered)", ParquetScanPlan(Pool.Size(), false), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Sequential Parquet Scan", SequentialScanRes.Stats, "Parallel Parquet Scan", ParallelScanRes.Stats);
+        BenchmarkRunner::PrintComparison("Parallel Parquet Scan", ParallelScanRes.Stats, "Parallel Parquet Scan (unordered)", UnorderedScanRes.Stats);
+
+        // a preview query: the limit closes the scan once it has 100 rows, the decode threads stop after the row groups
+        // they already started instead of going through the whole file
+        auto LimitScanPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            ScanOptions Options;
+            Options.DecodeThreads = Pool.Size();
+            return std::make_unique<LimitOperator>(std::make_unique<ScanOperator>(TestFile, Options), 100);
+        };
+
+        BenchmarkResult LimitScanRes = ScanRunner.Run("Parallel Parquet Scan LIMIT 100", LimitScanPlan, TotalInputRows);
+        BenchmarkRunner::PrintComparison("Parallel Parquet Scan", ParallelScanRes.Stats, "Parallel Parquet Scan LIMIT 100", LimitScanRes.Stats);
+        LOG_MESSAGEF("Rows returned by LIMIT 100: %lld", LimitScanRes.Stats.RowCount);
+
+        auto MappedScanPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            ScanOptions Options;
+            Options.DecodeThreads = Pool.Size();
+            Options.bMemoryMap = true;
+            return std::make_unique<ScanOperator>(TestFile, Options);
+        };
+
+        BenchmarkResult MappedScanRes = ScanRunner.Run("Parallel Parquet Scan (memory mapped)", MappedScanPlan, TotalInputRows);
+        BenchmarkRunner::PrintComparison("Parallel Parquet Scan", ParallelScanRes.Stats, "Parallel Parquet Scan (memory mapped)", MappedScanRes.Stats);
+
+        // batch boundaries can differ (the parallel scan never lets a batch cross a row group), the rows can't
+        LOG_MESSAGEF("Rows scanned: sequential %lld, parallel %lld, unordered %lld, mapped %lld", SequentialScanRes.Stats.RowCount, ParallelScanRes.Stats.RowCount, UnorderedScanRes.Stats.RowCount, MappedScanRes.Stats.RowCount);
+
+        // only IntColumn is decoded, CategoryColumn (strings) and IdColumn stay in the file
+        auto ProjectedScanPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            ScanOptions Options;
+            Options.DecodeThreads = Pool.Size();
+            Options.Columns = { "IntColumn" };
+            return std::make_unique<ScanOperator>(TestFile, Options);
+        };
+
+        // same projection, but derived from the plan: the aggregate tells the scan it reads IntColumn only
+        auto ProjectedAggregatePlan = [&]() -> std::unique_ptr<Operator>
+        {
+            ScanOptions Options;
+            Options.DecodeThreads = Pool.Size();
+            std::vector<AggregateSpec> Aggregates = { AggregateSpec(AggregateFunction::SUM, "IntColumn"), AggregateSpec(AggregateFunction::MAX, "IntColumn") };
+            return std::make_unique<AggregateOperator>(std::make_unique<ScanOperator>(TestFile, Options), Aggregates, BestExecutionMode());
+        };
+
+        BenchmarkResult ProjectedScanRes = ScanRunner.Run("Parallel Parquet Scan (IntColumn only)", ProjectedScanPlan, TotalInputRows);
+        BenchmarkRunner::PrintComparison("Parallel Parquet Scan", ParallelScanRes.Stats, "Parallel Parquet Scan (IntColumn only)", ProjectedScanRes.Stats);
+        ScanRunner.Run("Parquet Scan + SUM/MAX (projection pushed down)", ProjectedAggregatePlan, TotalInputRows);
+
+        // IdColumn is written in order, so a range on it only touches the row groups that hold that range
+        auto PrunedScanPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            ScanOptions Options;
+            Options.DecodeThreads = Pool.Size();
+            Options.Predicates.push_back(ScanPredicate::Between("IdColumn", 0, TotalInputRows / 10));
+            return std::make_unique<ScanOperator>(TestFile, Options);
+        };
+
+        BenchmarkResult PrunedScanRes = ScanRunner.Run("Parallel Parquet Scan (IdColumn in first 10%)", PrunedScanPlan, TotalInputRows);
+        BenchmarkRunner::PrintComparison("Parallel Parquet Scan", ParallelScanRes.Stats, "Parallel Parquet Scan (IdColumn in first 10%)", PrunedScanRes.Stats);
+
+        // the filter pushes x > 5000 into the scan itself, no row group has such a value so nothing is decoded at all
+        auto PushdownFilterPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            ScanOptions Options;
+            Options.DecodeThreads = Pool.Size();
+            return std::make_unique<FilterOperator>(std::make_unique<ScanOperator>(TestFile, Options), 5000, ExecutionMode::AVX2, "IntColumn");
+        };
+
+        BenchmarkResult PushdownFilterRes = ScanRunner.Run("Parquet Scan + Filter (pushed down)", PushdownFilterPlan, TotalInputRows);
+        BenchmarkRunner::PrintComparison("Parallel Parquet Scan", ParallelScanRes.Stats, "Parquet Scan + Filter (pushed down)", PushdownFilterRes.Stats);
+        LOG_MESSAGEF("Rows after pruning: id range %lld, filter pushdown %lld", PrunedScanRes.Stats.RowCount, PushdownFilterRes.Stats.RowCount);
+
+        // CategoryColumn has 5 distinct strings. Kept dictionary encoded a row is a 4 byte code, the strings are never materialized
+        auto CategoryScanPlan = [&](bool bDictionary)
+        {
+            return [&TestFile, &Pool, bDictionary]() -> std::unique_ptr<Operator>
+            {
+                ScanOptions Options;
+                Options.DecodeThreads = Pool.Size();
+                Options.Columns = { "CategoryColumn" };
+                if (bDictionary)
+                {
+                    Options.DictionaryColumns = { "CategoryColumn" };
+                }
+                return std::make_unique<ScanOperator>(TestFile, Options);
+            };
+        };
+
+        BenchmarkResult PlainCategoryRes = ScanRunner.Run("Parquet Scan CategoryColumn (decoded)", CategoryScanPlan(false), TotalInputRows);
+        BenchmarkResult DictionaryCategoryRes = ScanRunner.Run("Parquet Scan CategoryColumn (dictionary)", CategoryScanPlan(true), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Parquet Scan CategoryColumn (decoded)", PlainCategoryRes.Stats, "Parquet Scan CategoryColumn (dictionary)", DictionaryCategoryRes.Stats);
+
+        // WHERE CategoryColumn IN ('alpha', 'gamma'): string compares on every row, or on the 5 dictionary entries and a code lookup per row
+        auto CategoryFilterPlan = [&](bool bDictionary)
+        {
+            return [&TestFile, &Pool, bDictionary]() -> std::unique_ptr<Operator>
+            {
+                ScanOptions Options;
+                Options.DecodeThreads = Pool.Size();
+                if (bDictionary)
+                {
+                    Options.DictionaryColumns = { "CategoryColumn" };
+                }
+                FilterExpression Where = FilterExpression::Where(ScanPredicate::InText("CategoryColumn", { "alpha", "gamma" }));
+                auto Filter = std::make_unique<FilterOperator>(std::make_unique<ScanOperator>(TestFile, Options), std::move(Where), BestExecutionMode());
+                std::vector<AggregateSpec> Aggregates = { AggregateSpec::CountStar(), AggregateSpec(AggregateFunction::SUM, "IntColumn") };
+                return std::make_unique<AggregateOperator>(std::move(Filter), Aggregates, BestExecutionMode());
+            };
+        };
+
+        BenchmarkResult PlainCategoryFilterRes = ScanRunner.Run("Parquet Filter CategoryColumn IN (decoded)", CategoryFilterPlan(false), TotalInputRows);
+        BenchmarkResult DictionaryCategoryFilterRes = ScanRunner.Run("Parquet Filter CategoryColumn IN (dictionary)", CategoryFilterPlan(true), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Parquet Filter CategoryColumn IN (decoded)", PlainCategoryFilterRes.Stats, "Parquet Filter CategoryColumn IN (dictionary)", DictionaryCategoryFilterRes.Stats);
+        BenchmarkRunner::Verify(PlainCategoryFilterRes.ResultChunks, DictionaryCategoryFilterRes.ResultChunks);
+
+        // GROUP BY CategoryColumn: the codes become dense group ids, no string is hashed per row
+        auto CategoryGroupByPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            ScanOptions Options;
+            Options.DecodeThreads = Pool.Size();
+            Options.DictionaryColumns = { "CategoryColumn" };
+            std::vector<AggregateSpec> Aggregates = { AggregateSpec::CountStar(), AggregateSpec(AggregateFunction::SUM, "IntColumn") };
+            return std::make_unique<HashAggregateOperator>(std::make_unique<ScanOperator>(TestFile, Options), std::vector<std::string>{ "CategoryColumn" }, std::move(Aggregates), BestExecutionMode());
+        };
+
+        BenchmarkResult CategoryGroupByRes = ScanRunner.Run("Parquet GROUP BY CategoryColumn (dictionary codes)", CategoryGroupByPlan, TotalInputRows);
+        LOG_MESSAGEF("GROUP BY CategoryColumn: %lld groups", CategoryGroupByRes.Stats.RowCount);
+
         std::cout << "============================================================" << std::endl;
         std::cout << "BENCHMARK SUITE: IN-MEMORY (CPU BOUND)" << std::endl;
         std::cout << "============================================================" << std::endl;
@@ -59,18 +341,94 @@ int main()
         auto ScalarFilterPlan = [&]() -> std::unique_ptr<Operator> 
         {
             auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
-            return std::make_unique<FilterOperator>(std::move(Scan), 5000, ExecutionMode::SCALAR);
+            return std::make_unique<FilterOperator>(std::move(Scan), 5000, ExecutionMode::SCALAR, "IntColumn");
 		};
 
         auto AvxFilterPlan = [&]() -> std::unique_ptr<Operator> 
         {
             auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
-            return std::make_unique<FilterOperator>(std::move(Scan), 5000, ExecutionMode::AVX2);
+            return std::make_unique<FilterOperator>(std::move(Scan), 5000, ExecutionMode::AVX2, "IntColumn");
 		};
 
 		BenchmarkResult ScalarFilterRes = Runner.Run("Scalar Filter", ScalarFilterPlan, TotalInputRows);
 		BenchmarkResult AvxFilterRes = Runner.Run("AVX Filter", AvxFilterPlan, TotalInputRows);
 		BenchmarkRunner::PrintComparison("Scalar Filter", ScalarFilterRes.Stats, "AVX Filter", AvxFilterRes.Stats);
+		BenchmarkRunner::Verify(ScalarFilterRes.ResultChunks, AvxFilterRes.ResultChunks);
+
+        if (bHasAvx512)
+        {
+            auto Avx512FilterPlan = [&]() -> std::unique_ptr<Operator>
+            {
+                auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+                return std::make_unique<FilterOperator>(std::move(Scan), 5000, ExecutionMode::AVX512, "IntColumn");
+            };
+
+            BenchmarkResult Avx512FilterRes = Runner.Run("AVX-512 Filter", Avx512FilterPlan, TotalInputRows);
+            BenchmarkRunner::PrintComparison("AVX Filter", AvxFilterRes.Stats, "AVX-512 Filter", Avx512FilterRes.Stats);
+            BenchmarkRunner::Verify(ScalarFilterRes.ResultChunks, Avx512FilterRes.ResultChunks);
+        }
+
+
+        // The filter should cost the same whether it keeps nothing, half or everything.
+        // A per-bit gather loop would dip in the middle where the branches are unpredictable
+        const long long SweepRows = 10000000;
+        std::vector<DataChunk> UniformData = GenerateUniformData(SweepRows, 64 * 1024);
+
+        auto ScalarSweepPlan = [&](int SelectivityPercent) -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(UniformData);
+            return std::make_unique<FilterOperator>(std::move(Scan), 99 - SelectivityPercent, ExecutionMode::SCALAR);
+        };
+
+        auto AvxSweepPlan = [&](int SelectivityPercent) -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(UniformData);
+            return std::make_unique<FilterOperator>(std::move(Scan), 99 - SelectivityPercent, ExecutionMode::AVX2);
+        };
+
+        Runner.RunSelectivitySweep("Scalar Filter", ScalarSweepPlan, SweepRows);
+        Runner.RunSelectivitySweep("AVX Filter", AvxSweepPlan, SweepRows);
+
+        if (bHasAvx512)
+        {
+            auto Avx512SweepPlan = [&](int SelectivityPercent) -> std::unique_ptr<Operator>
+            {
+                auto Scan = std::make_unique<MemoryScanOperator>(UniformData);
+                return std::make_unique<FilterOperator>(std::move(Scan), 99 - SelectivityPercent, ExecutionMode::AVX512);
+            };
+            Runner.RunSelectivitySweep("AVX-512 Filter", Avx512SweepPlan, SweepRows);
+        }
+
+        // Every batch a filter compacts is a couple of small buffers, with small chunks the allocator shows up in the time.
+        // The query arena hands them out with a pointer bump and reuses a block once the batches in it are gone
+        std::vector<DataChunk> SmallChunkData = GenerateUniformData(SweepRows, 1024);
+        auto SmallChunkFilterPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(SmallChunkData);
+            return std::make_unique<FilterOperator>(std::move(Scan), 49, BestExecutionMode());
+        };
+
+        BenchmarkRunner ArenaRunner(10);
+        ArenaRunner.UseQueryArena(true);
+        BenchmarkResult DefaultPoolRes = Runner.Run("Filter, 1K row chunks (default pool)", SmallChunkFilterPlan, SweepRows);
+        BenchmarkResult ArenaRes = ArenaRunner.Run("Filter, 1K row chunks (query arena)", SmallChunkFilterPlan, SweepRows);
+        BenchmarkRunner::PrintComparison("Filter, 1K row chunks (default pool)", DefaultPoolRes.Stats, "Filter, 1K row chunks (query arena)", ArenaRes.Stats);
+        BenchmarkRunner::Verify(DefaultPoolRes.ResultChunks, ArenaRes.ResultChunks);
+
+        // the filter writes each batch into the buffers of one the runner already dropped, a steady scan allocates nothing
+        if (DefaultPoolRes.Stats.SteadyAllocationsPerBatch > 0.01)
+        {
+            LOG_WARNING("Filter, 1K row chunks: " << DefaultPoolRes.Stats.SteadyAllocationsPerBatch << " allocations per batch, its output buffers aren't recycled");
+        }
+
+        // the first run keeps every batch it returned, half the rows don't fit in 1 MB. The run has to fail, not the process
+        BenchmarkRunner LimitedRunner(1);
+        LimitedRunner.UseQueryArena(true, 1024 * 1024);
+        BenchmarkResult LimitedRes = LimitedRunner.Run("Filter, 1K row chunks (1 MB memory limit)", SmallChunkFilterPlan, SweepRows);
+        if (LimitedRes.Error.empty())
+        {
+            LOG_WARNING("The filter stayed under its 1 MB memory limit, it should have failed");
+        }
 
 
         // Returns a unique pointer to the root of the operator tree
@@ -102,6 +460,420 @@ int main()
         BenchmarkRunner::PrintComparison("Scalar Sum", ScalarSumRes.Stats, "AVX Sum", AvxSumRes.Stats);
         BenchmarkRunner::Verify(ScalarSumRes.ResultChunks, AvxSumRes.ResultChunks);
 
+        if (bHasAvx512)
+        {
+            auto Avx512SumPlan = [&]() -> std::unique_ptr<Operator>
+            {
+                auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+                return std::make_unique<SumOperator>(std::move(Scan), ExecutionMode::AVX512);
+            };
+
+            BenchmarkResult Avx512SumRes = Runner.Run("AVX-512 Sum", Avx512SumPlan, TotalInputRows);
+            BenchmarkRunner::PrintComparison("AVX Sum", AvxSumRes.Stats, "AVX-512 Sum", Avx512SumRes.Stats);
+            BenchmarkRunner::Verify(ScalarSumRes.ResultChunks, Avx512SumRes.ResultChunks);
+        }
+
+        // Values close to INT32_MAX / INT32_MIN, any kernel that adds in 32-bit lanes wraps after a couple of rows.
+        // The odd chunk size makes every chunk end in a partial vector so the tail handling is covered too
+        const long long OverflowRows = 1000003;
+        std::vector<DataChunk> PositiveOverflowData = GenerateUniformData(OverflowRows, 4099, INT32_MAX - 1000, INT32_MAX);
+        std::vector<DataChunk> NegativeOverflowData = GenerateUniformData(OverflowRows, 4099, INT32_MIN, INT32_MIN + 1000);
+        BenchmarkRunner OverflowRunner(1);
+
+        for (const std::vector<DataChunk>* OverflowData : { &PositiveOverflowData, &NegativeOverflowData })
+        {
+            auto OverflowSumPlan = [&](ExecutionMode Mode)
+            {
+                return [&, Mode]() -> std::unique_ptr<Operator>
+                {
+                    auto Scan = std::make_unique<MemoryScanOperator>(*OverflowData);
+                    return std::make_unique<SumOperator>(std::move(Scan), Mode);
+                };
+            };
+
+            BenchmarkResult ScalarOverflowRes = OverflowRunner.Run("Scalar Sum (overflowing input)", OverflowSumPlan(ExecutionMode::SCALAR), OverflowRows);
+            BenchmarkResult AvxOverflowRes = OverflowRunner.Run("AVX Sum (overflowing input)", OverflowSumPlan(ExecutionMode::AVX2), OverflowRows);
+            BenchmarkRunner::Verify(ScalarOverflowRes.ResultChunks, AvxOverflowRes.ResultChunks);
+
+            if (bHasAvx512)
+            {
+                BenchmarkResult Avx512OverflowRes = OverflowRunner.Run("AVX-512 Sum (overflowing input)", OverflowSumPlan(ExecutionMode::AVX512), OverflowRows);
+                BenchmarkRunner::Verify(ScalarOverflowRes.ResultChunks, Avx512OverflowRes.ResultChunks);
+            }
+        }
+
+        // Filter -> Sum and Min over the same values stored in other types. The kernels are picked once from the schema,
+        // narrow types compare 32 (int8) or 16 (int16) values per AVX2 instruction, so they should beat the int32 sweep above.
+        // The values are small integers, even the double sums come out exact and can be compared with Verify
+        const long long TypedRows = 10000000;
+        auto RunTypedBenchmarks = [&](const std::string& TypeName, const std::vector<DataChunk>& TypedData)
+        {
+            auto TypedFilterSumPlan = [&](ExecutionMode Mode)
+            {
+                return [&, Mode]() -> std::unique_ptr<Operator>
+                {
+                    auto Scan = std::make_unique<MemoryScanOperator>(TypedData);
+                    auto Filter = std::make_unique<FilterOperator>(std::move(Scan), 49, Mode);
+                    return std::make_unique<SumOperator>(std::move(Filter), Mode);
+                };
+            };
+
+            auto TypedMinPlan = [&](ExecutionMode Mode)
+            {
+                return [&, Mode]() -> std::unique_ptr<Operator>
+                {
+                    auto Scan = std::make_unique<MemoryScanOperator>(TypedData);
+                    return std::make_unique<MinOperator>(std::move(Scan), Mode);
+                };
+            };
+
+            BenchmarkResult ScalarTypedRes = Runner.Run("Scalar Filter -> Sum (" + TypeName + ")", TypedFilterSumPlan(ExecutionMode::SCALAR), TypedRows);
+            BenchmarkResult BestTypedRes = Runner.Run("Best Available Filter -> Sum (" + TypeName + ")", TypedFilterSumPlan(BestExecutionMode()), TypedRows);
+            BenchmarkRunner::PrintComparison("Scalar Filter -> Sum (" + TypeName + ")", ScalarTypedRes.Stats, "Best Available Filter -> Sum (" + TypeName + ")", BestTypedRes.Stats);
+            BenchmarkRunner::Verify(ScalarTypedRes.ResultChunks, BestTypedRes.ResultChunks);
+
+            BenchmarkResult ScalarTypedMinRes = Runner.Run("Scalar Min (" + TypeName + ")", TypedMinPlan(ExecutionMode::SCALAR), TypedRows);
+            BenchmarkResult BestTypedMinRes = Runner.Run("Best Available Min (" + TypeName + ")", TypedMinPlan(BestExecutionMode()), TypedRows);
+            BenchmarkRunner::PrintComparison("Scalar Min (" + TypeName + ")", ScalarTypedMinRes.Stats, "Best Available Min (" + TypeName + ")", BestTypedMinRes.Stats);
+            BenchmarkRunner::Verify(ScalarTypedMinRes.ResultChunks, BestTypedMinRes.ResultChunks);
+
+            // the same Filter -> Sum with the compare mask going straight into the add (Operator::FusePipelines)
+            Runner.CompareFusion("Best Available Filter -> Sum (" + TypeName + ")", TypedFilterSumPlan(BestExecutionMode()), TypedRows);
+        };
+
+        RunTypedBenchmarks("int8", GenerateTypedData<arrow::Int8Type>(TypedRows, 64 * 1024));
+        RunTypedBenchmarks("uint16", GenerateTypedData<arrow::UInt16Type>(TypedRows, 64 * 1024));
+        RunTypedBenchmarks("int64", GenerateTypedData<arrow::Int64Type>(TypedRows, 64 * 1024));
+        RunTypedBenchmarks("double", GenerateTypedData<arrow::DoubleType>(TypedRows, 64 * 1024));
+
+        // Filter -> Min over the file. Fused, the rows that fail the compare become the identity before the min
+        Runner.CompareFusion("Best Available Filter -> Min", [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+            auto Filter = std::make_unique<FilterOperator>(std::move(Scan), 49, BestExecutionMode());
+            return std::make_unique<MinOperator>(std::move(Filter), BestExecutionMode());
+        }, TotalInputRows);
+
+        // Same plans over columns with a few nulls. The kernels AND the validity bits into the compare mask
+        // (or blend the null lanes to the identity), compare with the no-null int32 / int64 numbers above
+        RunTypedBenchmarks("int32, 1% null", GenerateTypedData<arrow::Int32Type>(TypedRows, 64 * 1024, 0, 99, 0.01));
+        RunTypedBenchmarks("int64, 1% null", GenerateTypedData<arrow::Int64Type>(TypedRows, 64 * 1024, 0, 99, 0.01));
+
+        // A WHERE clause over two columns:
+        //   IntColumn BETWEEN 20 AND 170 AND IntColumn != 42 AND (IntColumn IN (1, 7, 150, 199) OR IdColumn < 5000000)
+        // Every predicate runs its own compiled (op, type) loop into a bitmap, the rows are only compacted once at the end
+        auto WherePlan = [&](ExecutionMode Mode)
+        {
+            return [&, Mode]() -> std::unique_ptr<Operator>
+            {
+                FilterExpression Where = FilterExpression::And({
+                    FilterExpression::Where(ScanPredicate::Between("IntColumn", 20, 170)),
+                    FilterExpression::Where(ScanPredicate::Compare("IntColumn", PredicateOp::NOT_EQUAL, 42)),
+                    FilterExpression::Or({
+                        FilterExpression::Where(ScanPredicate::In("IntColumn", { 1, 7, 150, 199 })),
+                        FilterExpression::Where(ScanPredicate::Compare("IdColumn", PredicateOp::LESS, TotalInputRows / 2))
+                    })
+                });
+                auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+                auto Filter = std::make_unique<FilterOperator>(std::move(Scan), std::move(Where), Mode);
+                return std::make_unique<SumOperator>(std::move(Filter), Mode);
+            };
+        };
+
+        BenchmarkResult ScalarWhereRes = Runner.Run("Scalar WHERE (4 predicates) -> Sum", WherePlan(ExecutionMode::SCALAR), TotalInputRows);
+        BenchmarkResult BestWhereRes = Runner.Run("Best Available WHERE (4 predicates) -> Sum", WherePlan(BestExecutionMode()), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Scalar WHERE (4 predicates) -> Sum", ScalarWhereRes.Stats, "Best Available WHERE (4 predicates) -> Sum", BestWhereRes.Stats);
+        BenchmarkRunner::Verify(ScalarWhereRes.ResultChunks, BestWhereRes.ResultChunks);
+
+        // SUM(IntColumn * 3 + IdColumn) of the rows with IntColumn > 49. The projection runs two column kernels per batch
+        // (widen + multiply-add in int64), the filter's selection is passed through and only the sum reads it
+        auto ComputedSumPlan = [&](ExecutionMode Mode)
+        {
+            return [&, Mode]() -> std::unique_ptr<Operator>
+            {
+                auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+                auto Filter = std::make_unique<FilterOperator>(std::move(Scan), 49, Mode, "IntColumn");
+                std::vector<ProjectedColumn> Columns = {
+                    { "Computed", Expression::Add(Expression::Multiply(Expression::Named("IntColumn"), Expression::Int(3)), Expression::Named("IdColumn")) }
+                };
+                auto Project = std::make_unique<ProjectOperator>(std::move(Filter), std::move(Columns), Mode);
+                return std::make_unique<SumOperator>(std::move(Project), Mode);
+            };
+        };
+
+        BenchmarkResult ScalarComputedRes = Runner.Run("Scalar Filter -> Project -> Sum", ComputedSumPlan(ExecutionMode::SCALAR), TotalInputRows);
+        BenchmarkResult BestComputedRes = Runner.Run("Best Available Filter -> Project -> Sum", ComputedSumPlan(BestExecutionMode()), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Scalar Filter -> Project -> Sum", ScalarComputedRes.Stats, "Best Available Filter -> Project -> Sum", BestComputedRes.Stats);
+        BenchmarkRunner::Verify(ScalarComputedRes.ResultChunks, BestComputedRes.ResultChunks);
+
+        // fused, the projection takes the filter's predicate over and runs it on the scan's batch next to the expression
+        Runner.CompareFusion("Best Available Filter -> Project -> Sum", ComputedSumPlan(BestExecutionMode()), TotalInputRows);
+
+        // ORDER BY over the whole table. IntColumn has ~100 distinct values, so its normalized key is a single byte and one
+        // radix pass sorts it. The parallel plan counts and scatters the rows on every core and sorts the buckets in parallel
+        auto SortPlan = [&](std::vector<SortKey> Keys, ExecutionMode Mode, ThreadPool* SortPool)
+        {
+            return [&, Keys, Mode, SortPool]() -> std::unique_ptr<Operator>
+            {
+                auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+                return std::make_unique<SortOperator>(std::move(Scan), Keys, Mode, SortPool);
+            };
+        };
+
+        BenchmarkResult ScalarSortRes = Runner.Run("Scalar ORDER BY IntColumn", SortPlan({ SortKey::Ascending("IntColumn") }, ExecutionMode::SCALAR, nullptr), TotalInputRows);
+        BenchmarkResult ParallelSortRes = Runner.Run("Parallel ORDER BY IntColumn", SortPlan({ SortKey::Ascending("IntColumn") }, BestExecutionMode(), &Pool), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Scalar ORDER BY IntColumn", ScalarSortRes.Stats, "Parallel ORDER BY IntColumn", ParallelSortRes.Stats);
+        BenchmarkRunner::Verify(ScalarSortRes.ResultChunks, ParallelSortRes.ResultChunks);
+
+        // two keys, a string and a descending int64: the key is compared as bytes, radix sorted on its first 8
+        std::vector<SortKey> MultiKeys = { SortKey::Ascending("CategoryColumn"), SortKey::Descending("IdColumn") };
+        BenchmarkResult ScalarMultiSortRes = Runner.Run("Scalar ORDER BY CategoryColumn, IdColumn DESC", SortPlan(MultiKeys, ExecutionMode::SCALAR, nullptr), TotalInputRows);
+        BenchmarkResult ParallelMultiSortRes = Runner.Run("Parallel ORDER BY CategoryColumn, IdColumn DESC", SortPlan(MultiKeys, BestExecutionMode(), &Pool), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Scalar ORDER BY CategoryColumn, IdColumn DESC", ScalarMultiSortRes.Stats, "Parallel ORDER BY CategoryColumn, IdColumn DESC", ParallelMultiSortRes.Stats);
+        BenchmarkRunner::Verify(ScalarMultiSortRes.ResultChunks, ParallelMultiSortRes.ResultChunks);
+
+        // ORDER BY ... LIMIT 100 through a bounded heap. IdColumn is in order, so after the first batch the heap holds the
+        // smallest ids and the bound pushed into the scan drops every later row before the TopN sees it
+        auto TopNPlan = [&](std::vector<SortKey> Keys, ExecutionMode Mode)
+        {
+            return [&, Keys, Mode]() -> std::unique_ptr<Operator>
+            {
+                auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData, Mode);
+                return std::make_unique<TopNOperator>(std::move(Scan), Keys, 100, Mode);
+            };
+        };
+
+        BenchmarkResult ScalarTopNRes = Runner.Run("Scalar ORDER BY IdColumn LIMIT 100", TopNPlan({ SortKey::Ascending("IdColumn") }, ExecutionMode::SCALAR), TotalInputRows);
+        BenchmarkResult BestTopNRes = Runner.Run("Best ORDER BY IdColumn LIMIT 100", TopNPlan({ SortKey::Ascending("IdColumn") }, BestExecutionMode()), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Scalar ORDER BY IdColumn LIMIT 100", ScalarTopNRes.Stats, "Best ORDER BY IdColumn LIMIT 100", BestTopNRes.Stats);
+        BenchmarkRunner::Verify(ScalarTopNRes.ResultChunks, BestTopNRes.ResultChunks);
+
+        // IntColumn has ~100 values, the threshold soon sits on the largest one and the compare against it rejects most
+        // batches 64 rows at a time. IdColumn breaks the ties, so every plan returns the same rows
+        std::vector<SortKey> TopNKeys = { SortKey::Descending("IntColumn"), SortKey::Ascending("IdColumn") };
+        BenchmarkResult ScalarMultiTopNRes = Runner.Run("Scalar ORDER BY IntColumn DESC, IdColumn LIMIT 100", TopNPlan(TopNKeys, ExecutionMode::SCALAR), TotalInputRows);
+        BenchmarkResult BestMultiTopNRes = Runner.Run("Best ORDER BY IntColumn DESC, IdColumn LIMIT 100", TopNPlan(TopNKeys, BestExecutionMode()), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Scalar ORDER BY IntColumn DESC, IdColumn LIMIT 100", ScalarMultiTopNRes.Stats, "Best ORDER BY IntColumn DESC, IdColumn LIMIT 100", BestMultiTopNRes.Stats);
+        BenchmarkRunner::Verify(ScalarMultiTopNRes.ResultChunks, BestMultiTopNRes.ResultChunks);
+        BenchmarkRunner::PrintComparison("Scalar ORDER BY IntColumn", ScalarSortRes.Stats, "Scalar ORDER BY IntColumn DESC, IdColumn LIMIT 100", ScalarMultiTopNRes.Stats);
+
+        // one heap per worker, the workers' 100 rows each are merged by one more top-100
+        auto ParallelTopNPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Pipeline = [TopNKeys](std::unique_ptr<Operator> Source) -> std::unique_ptr<Operator>
+            {
+                return std::make_unique<TopNOperator>(std::move(Source), TopNKeys, 100, BestExecutionMode());
+            };
+            return std::make_unique<ParallelOperator>(InMemoryData, Pipeline, Pool, Pool.Size());
+        };
+        BenchmarkResult ParallelTopNRes = Runner.Run("Parallel ORDER BY IntColumn DESC, IdColumn LIMIT 100", ParallelTopNPlan, TotalInputRows);
+        BenchmarkRunner::PrintComparison("Best ORDER BY IntColumn DESC, IdColumn LIMIT 100", BestMultiTopNRes.Stats, "Parallel ORDER BY IntColumn DESC, IdColumn LIMIT 100", ParallelTopNRes.Stats);
+        BenchmarkRunner::Verify(ScalarMultiTopNRes.ResultChunks, ParallelTopNRes.ResultChunks);
+
+        auto ScalarMinPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+            return std::make_unique<MinOperator>(std::move(Scan), ExecutionMode::SCALAR);
+        };
+
+        // AVX512 is clamped to AVX2 (or scalar) on hosts that don't have it
+        auto BestMinPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+            return std::make_unique<MinOperator>(std::move(Scan), BestExecutionMode());
+        };
+
+        BenchmarkResult ScalarMinRes = Runner.Run("Scalar Min", ScalarMinPlan, TotalInputRows);
+        BenchmarkResult BestMinRes = Runner.Run("Best Available Min", BestMinPlan, TotalInputRows);
+
+        BenchmarkRunner::PrintComparison("Scalar Min", ScalarMinRes.Stats, "Best Available Min", BestMinRes.Stats);
+        BenchmarkRunner::Verify(ScalarMinRes.ResultChunks, BestMinRes.ResultChunks);
+
+
+        // Filter feeding an aggregate. The filter only hands a selection vector up to the sum,
+        // so this should cost about the same as the plain sum above
+        auto ScalarFilterSumPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+            auto Filter = std::make_unique<FilterOperator>(std::move(Scan), 100, ExecutionMode::SCALAR);
+            return std::make_unique<SumOperator>(std::move(Filter), ExecutionMode::SCALAR);
+        };
+
+        auto AvxFilterSumPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+            auto Filter = std::make_unique<FilterOperator>(std::move(Scan), 100, ExecutionMode::AVX2);
+            return std::make_unique<SumOperator>(std::move(Filter), ExecutionMode::AVX2);
+        };
+
+        BenchmarkResult ScalarFilterSumRes = Runner.Run("Scalar Filter -> Sum", ScalarFilterSumPlan, TotalInputRows);
+        BenchmarkResult AvxFilterSumRes = Runner.Run("AVX Filter -> Sum", AvxFilterSumPlan, TotalInputRows);
+
+        BenchmarkRunner::PrintComparison("AVX Sum", AvxSumRes.Stats, "AVX Filter -> Sum", AvxFilterSumRes.Stats);
+        BenchmarkRunner::Verify(ScalarFilterSumRes.ResultChunks, AvxFilterSumRes.ResultChunks);
+
+
+        // Same filter -> sum, one copy of the pipeline per worker, the partial sums are added up at the end
+        auto ParallelFilterSumPlan = [&](int ThreadCount) -> std::unique_ptr<Operator>
+        {
+            auto Pipeline = [](std::unique_ptr<Operator> Source) -> std::unique_ptr<Operator>
+            {
+                auto Filter = std::make_unique<FilterOperator>(std::move(Source), 100, BestExecutionMode());
+                return std::make_unique<SumOperator>(std::move(Filter), BestExecutionMode());
+            };
+            return std::make_unique<ParallelOperator>(InMemoryData, Pipeline, Pool, ThreadCount);
+        };
+
+        BenchmarkResult ParallelFilterSumRes = Runner.Run("Parallel Filter -> Sum", [&]() { return ParallelFilterSumPlan(Pool.Size()); }, TotalInputRows);
+        BenchmarkRunner::PrintComparison("AVX Filter -> Sum", AvxFilterSumRes.Stats, "Parallel Filter -> Sum", ParallelFilterSumRes.Stats);
+        BenchmarkRunner::Verify(ScalarFilterSumRes.ResultChunks, ParallelFilterSumRes.ResultChunks);
+
+        Runner.RunThreadScaling("Parallel Filter -> Sum", ParallelFilterSumPlan, TotalInputRows, Pool.Size());
+
+        auto ParallelMinPlan = [&](int ThreadCount) -> std::unique_ptr<Operator>
+        {
+            auto Pipeline = [](std::unique_ptr<Operator> Source) -> std::unique_ptr<Operator>
+            {
+                return std::make_unique<MinOperator>(std::move(Source), BestExecutionMode());
+            };
+            return std::make_unique<ParallelOperator>(InMemoryData, Pipeline, Pool, ThreadCount);
+        };
+        Runner.RunThreadScaling("Parallel Min", ParallelMinPlan, TotalInputRows, Pool.Size());
+
+
+        // A dashboard style query: five aggregates over the same column.
+        // The fused operator reads the column once, separate plans read it once per aggregate
+        auto DashboardAggregates = []()
+        {
+            return std::vector<AggregateSpec>{
+                AggregateSpec(AggregateFunction::SUM, "IntColumn"),
+                AggregateSpec(AggregateFunction::MIN, "IntColumn"),
+                AggregateSpec(AggregateFunction::MAX, "IntColumn"),
+                AggregateSpec(AggregateFunction::AVG, "IntColumn"),
+                AggregateSpec::CountStar()
+            };
+        };
+
+        auto ScalarMultiAggPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+            return std::make_unique<AggregateOperator>(std::move(Scan), DashboardAggregates(), ExecutionMode::SCALAR);
+        };
+
+        auto BestMultiAggPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Scan = std::make_unique<MemoryScanOperator>(InMemoryData);
+            return std::make_unique<AggregateOperator>(std::move(Scan), DashboardAggregates(), BestExecutionMode());
+        };
+
+        BenchmarkResult ScalarMultiAggRes = Runner.Run("Scalar SUM/MIN/MAX/AVG/COUNT", ScalarMultiAggPlan, TotalInputRows);
+        BenchmarkResult BestMultiAggRes = Runner.Run("Best Available SUM/MIN/MAX/AVG/COUNT", BestMultiAggPlan, TotalInputRows);
+
+        BenchmarkRunner::PrintComparison("Scalar SUM/MIN/MAX/AVG/COUNT", ScalarMultiAggRes.Stats, "Best Available SUM/MIN/MAX/AVG/COUNT", BestMultiAggRes.Stats);
+        BenchmarkRunner::Verify(ScalarMultiAggRes.ResultChunks, BestMultiAggRes.ResultChunks);
+
+        // five aggregates in one pass should cost about as much as a single aggregate
+        BenchmarkRunner::PrintComparison("Best Available Min", BestMinRes.Stats, "Best Available SUM/MIN/MAX/AVG/COUNT", BestMultiAggRes.Stats);
+
+        // one copy per worker, the copies' sums, mins, maxes and counts are merged into the one row at the end
+        auto ParallelMultiAggPlan = [&]() -> std::unique_ptr<Operator>
+        {
+            auto Pipeline = [DashboardAggregates](std::unique_ptr<Operator> Source) -> std::unique_ptr<Operator>
+            {
+                return std::make_unique<AggregateOperator>(std::move(Source), DashboardAggregates(), BestExecutionMode());
+            };
+            return std::make_unique<ParallelOperator>(InMemoryData, Pipeline, Pool, Pool.Size());
+        };
+        BenchmarkResult ParallelMultiAggRes = Runner.Run("Parallel SUM/MIN/MAX/AVG/COUNT", ParallelMultiAggPlan, TotalInputRows);
+        BenchmarkRunner::PrintComparison("Best Available SUM/MIN/MAX/AVG/COUNT", BestMultiAggRes.Stats, "Parallel SUM/MIN/MAX/AVG/COUNT", ParallelMultiAggRes.Stats);
+        BenchmarkRunner::Verify(ScalarMultiAggRes.ResultChunks, ParallelMultiAggRes.ResultChunks);
+
+
+        // GROUP BY IntColumn: a couple hundred distinct keys, the direct indexed path
+        auto GroupByPlan = [&](const std::vector<DataChunk>& Data, ExecutionMode Mode)
+        {
+            return [&Data, Mode]() -> std::unique_ptr<Operator>
+            {
+                auto Scan = std::make_unique<MemoryScanOperator>(Data);
+                std::vector<AggregateSpec> Aggregates{
+                    AggregateSpec::CountStar(),
+                    AggregateSpec(AggregateFunction::SUM, "IntColumn"),
+                    AggregateSpec(AggregateFunction::MAX, "IntColumn")
+                };
+                return std::make_unique<HashAggregateOperator>(std::move(Scan), std::vector<std::string>{ "IntColumn" }, std::move(Aggregates), Mode);
+            };
+        };
+
+        BenchmarkResult ScalarDenseGroupByRes = Runner.Run("Scalar GROUP BY (dense keys)", GroupByPlan(InMemoryData, ExecutionMode::SCALAR), TotalInputRows);
+        BenchmarkResult BestDenseGroupByRes = Runner.Run("Best Available GROUP BY (dense keys)", GroupByPlan(InMemoryData, BestExecutionMode()), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Scalar GROUP BY (dense keys)", ScalarDenseGroupByRes.Stats, "Best Available GROUP BY (dense keys)", BestDenseGroupByRes.Stats);
+        BenchmarkRunner::Verify(ScalarDenseGroupByRes.ResultChunks, BestDenseGroupByRes.ResultChunks);
+
+        // Every worker groups its morsels, the copies' groups are grouped once more by key. The groups come out in a
+        // different order than from a single copy, so both sides are sorted by the key before comparing
+        auto SortedGroupByPlan = [&](bool bParallel)
+        {
+            return [&, bParallel]() -> std::unique_ptr<Operator>
+            {
+                auto Pipeline = [](std::unique_ptr<Operator> Source) -> std::unique_ptr<Operator>
+                {
+                    std::vector<AggregateSpec> Aggregates{
+                        AggregateSpec::CountStar(),
+                        AggregateSpec(AggregateFunction::SUM, "IntColumn"),
+                        AggregateSpec(AggregateFunction::MAX, "IntColumn"),
+                        AggregateSpec(AggregateFunction::AVG, "IntColumn")
+                    };
+                    return std::make_unique<HashAggregateOperator>(std::move(Source), std::vector<std::string>{ "IntColumn" }, std::move(Aggregates), BestExecutionMode());
+                };
+                std::unique_ptr<Operator> GroupBy;
+                if (bParallel)
+                {
+                    GroupBy = std::make_unique<ParallelOperator>(InMemoryData, Pipeline, Pool, Pool.Size());
+                }
+                else
+                {
+                    GroupBy = Pipeline(std::make_unique<MemoryScanOperator>(InMemoryData));
+                }
+                return std::make_unique<SortOperator>(std::move(GroupBy), std::vector<SortKey>{ SortKey::Ascending("IntColumn") }, BestExecutionMode(), nullptr);
+            };
+        };
+        BenchmarkResult SortedGroupByRes = Runner.Run("Best Available GROUP BY ORDER BY key", SortedGroupByPlan(false), TotalInputRows);
+        BenchmarkResult ParallelGroupByRes = Runner.Run("Parallel GROUP BY ORDER BY key", SortedGroupByPlan(true), TotalInputRows);
+        BenchmarkRunner::PrintComparison("Best Available GROUP BY ORDER BY key", SortedGroupByRes.Stats, "Parallel GROUP BY ORDER BY key", ParallelGroupByRes.Stats);
+        BenchmarkRunner::Verify(SortedGroupByRes.ResultChunks, ParallelGroupByRes.ResultChunks);
+
+        // ~1M distinct keys, too many for the direct array, so this one goes through the hash table probes
+        std::vector<DataChunk> SparseKeyData = GenerateUniformData(SweepRows, 64 * 1024, 0, 999999);
+        BenchmarkResult ScalarSparseGroupByRes = Runner.Run("Scalar GROUP BY (hashed keys)", GroupByPlan(SparseKeyData, ExecutionMode::SCALAR), SweepRows);
+        BenchmarkResult BestSparseGroupByRes = Runner.Run("Best Available GROUP BY (hashed keys)", GroupByPlan(SparseKeyData, BestExecutionMode()), SweepRows);
+        BenchmarkRunner::PrintComparison("Scalar GROUP BY (hashed keys)", ScalarSparseGroupByRes.Stats, "Best Available GROUP BY (hashed keys)", BestSparseGroupByRes.Stats);
+        BenchmarkRunner::Verify(ScalarSparseGroupByRes.ResultChunks, BestSparseGroupByRes.ResultChunks);
+
+
+        // Fact to dimension join: every 10th key of the fact table's domain is in the dimension, so ~90% of the
+        // fact rows have no partner. The bloom filter pushed into the fact scan drops them before the join probes
+        std::vector<DataChunk> DimensionData = GenerateDimensionData(1000000, 10, 64 * 1024);
+
+        auto JoinPlan = [&](JoinType Type, ExecutionMode Mode)
+        {
+            return [&, Type, Mode]() -> std::unique_ptr<Operator>
+            {
+                auto DimensionScan = std::make_unique<MemoryScanOperator>(DimensionData, Mode);
+                auto FactScan = std::make_unique<MemoryScanOperator>(SparseKeyData, Mode);
+                return std::make_unique<HashJoinOperator>(std::move(DimensionScan), std::move(FactScan), "DimKey", "IntColumn", Type, Mode);
+            };
+        };
+
+        BenchmarkResult ScalarJoinRes = Runner.Run("Scalar Inner Join", JoinPlan(JoinType::INNER, ExecutionMode::SCALAR), SweepRows);
+        BenchmarkResult BestJoinRes = Runner.Run("Best Available Inner Join", JoinPlan(JoinType::INNER, BestExecutionMode()), SweepRows);
+        BenchmarkRunner::PrintComparison("Scalar Inner Join", ScalarJoinRes.Stats, "Best Available Inner Join", BestJoinRes.Stats);
+        BenchmarkRunner::Verify(ScalarJoinRes.ResultChunks, BestJoinRes.ResultChunks);
+
+        BenchmarkResult SemiJoinRes = Runner.Run("Best Available Semi Join", JoinPlan(JoinType::SEMI, BestExecutionMode()), SweepRows);
+        BenchmarkResult AntiJoinRes = Runner.Run("Best Available Anti Join", JoinPlan(JoinType::ANTI, BestExecutionMode()), SweepRows);
+
+        // semi + anti have to add up to the whole fact table
+        LOG_MESSAGEF("Semi Join kept %lld rows, Anti Join kept %lld rows (%lld input rows)", SemiJoinRes.Stats.RowCount, AntiJoinRes.Stats.RowCount, SweepRows);
     }
     catch (const std::exception& e)
     {